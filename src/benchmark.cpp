@@ -17,11 +17,21 @@
 */
 
 #include "benchmark.h"
+#include "bitboard.h"
+#include "movegen.h"
 #include "numa.h"
+#include "position.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
+#include <deque>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <vector>
 
 namespace {
@@ -376,6 +386,19 @@ const std::vector<std::vector<std::string>> BenchmarkPositions = {
 
 namespace Stockfish::Benchmark {
 
+// Returns the FENs of the default bench positions, for benchmarks which
+// don't search. Moves appended to a FEN are ignored by Position::set().
+std::vector<std::string> default_fens() {
+
+    std::vector<std::string> fens;
+
+    for (const auto& entry : Defaults)
+        if (entry.find("setoption") != 0)
+            fens.push_back(entry);
+
+    return fens;
+}
+
 // Builds a list of UCI commands to be run by bench. There
 // are five parameters: TT size in MB, number of search threads that
 // should be used, the limit value spent for each position, a file name
@@ -387,6 +410,7 @@ namespace Stockfish::Benchmark {
 // bench 64 1 100000 default nodes  : search default positions for 100K nodes each
 // bench 64 4 5000 current movetime : search current position with 4 threads for 5 sec
 // bench 16 1 5 blah perft          : run a perft 5 on positions in file "blah"
+// bench 16 1 13 default depth json : as bench, with the results as JSON instead of the output
 std::vector<std::string> setup_bench(const std::string& currentFen, std::istream& is) {
 
     std::vector<std::string> fens, list;
@@ -512,4 +536,310 @@ BenchmarkSetup setup_benchmark(std::istream& is) {
     return setup;
 }
 
+// Builds the configurations of "speedtest sweep": every combination of the
+// thread counts, hash sizes and NumaPolicy values given as comma separated
+// lists, in this order, and the seconds for each configuration. "default"
+// stands for the doubling thread counts up to the hardware concurrency, the
+// hash size the benchmark uses for the thread count, and the "auto" policy.
+// Example:
+//
+// speedtest sweep 1,2,4,8 default none,system 30
+//
+// or "system,l3,l3-net" to compare sharing per NUMA node with sharing per L3.
+SweepSetup setup_sweep(std::istream& is) {
+
+    SweepSetup  setup{};
+    std::string token;
+
+    std::string threads = (is >> token) ? token : "default";
+    std::string ttSizes = (is >> token) ? token : "default";
+    std::string numa    = (is >> token) ? token : "default";
+
+    if (!(is >> setup.desiredTimeS))
+        setup.desiredTimeS = 30;
+
+    auto split = [](const std::string& list) {
+        std::vector<std::string> items;
+        std::stringstream        ss(list);
+
+        for (std::string item; std::getline(ss, item, ',');)
+            if (!item.empty())
+                items.push_back(item);
+
+        return items;
+    };
+
+    std::vector<int> threadCounts, sizes;
+
+    if (threads == "default")
+    {
+        const int maxThreads = int(get_hardware_concurrency());
+
+        for (int t = 1; t < maxThreads; t *= 2)
+            threadCounts.push_back(t);
+
+        threadCounts.push_back(maxThreads);
+    }
+    else
+        for (const auto& t : split(threads))
+            threadCounts.push_back(std::max(std::atoi(t.c_str()), 1));
+
+    if (ttSizes != "default")
+        for (const auto& size : split(ttSizes))
+            sizes.push_back(std::max(std::atoi(size.c_str()), 1));
+
+    const std::vector<std::string> policies =
+      numa == "default" ? std::vector<std::string>{"auto"} : split(numa);
+
+    // The positions and times are those of the benchmark with the given duration,
+    // and so is the default hash size
+    auto benchmark = [](const std::string& args) {
+        std::istringstream ss(args);
+        return setup_benchmark(ss);
+    };
+
+    for (int t : threadCounts)
+        for (int size :
+             sizes.empty() ? std::vector<int>{benchmark(std::to_string(t)).ttSize} : sizes)
+            for (const auto& policy : policies)
+                setup.configs.push_back({t, size, policy});
+
+    setup.commands = benchmark("1 16 " + std::to_string(setup.desiredTimeS)).commands;
+
+    return setup;
+}
+
+bool take_json_flag(std::istream& is, std::istringstream& args) {
+
+    std::vector<std::string> tokens{std::istream_iterator<std::string>(is),
+                                    std::istream_iterator<std::string>()};
+
+    const bool json = !tokens.empty() && tokens.back() == "json";
+    if (json)
+        tokens.pop_back();
+
+    std::string joined;
+    for (const auto& token : tokens)
+        joined += token + " ";
+
+    args.str(joined);
+    return json;
+}
+
+// The speeds are spread by the position as much as by the machine, so their
+// percentiles are only comparable between runs on the same positions
+std::string results_json(const std::vector<PositionResult>& results,
+                         std::uint64_t                      nodes,
+                         std::int64_t                       timeMs) {
+
+    std::ostringstream  os;
+    std::vector<double> nps;
+
+    auto speed = [](std::uint64_t n, std::int64_t ms) {
+        return double(n) * 1000 / double(std::max<std::int64_t>(ms, 1));
+    };
+
+    os << "{\"positions\":[";
+
+    for (const auto& r : results)
+    {
+        nps.push_back(speed(r.nodes, r.timeMs));
+
+        os << (&r == &results[0] ? "" : ",") << "{\"fen\":\"";
+
+        for (char c : r.fen)
+            os << (c == '"' || c == '\\' ? "\\" : "") << c;
+
+        os << "\",\"depth\":" << r.depth << ",\"seldepth\":" << r.selDepth
+           << ",\"nodes\":" << r.nodes << ",\"time\":" << r.timeMs
+           << ",\"nps\":" << std::uint64_t(nps.back()) << ",\"hashfull\":" << r.hashfull << "}";
+    }
+
+    os << "],\"nodes\":" << nodes << ",\"time\":" << timeMs
+       << ",\"nps\":" << std::uint64_t(speed(nodes, timeMs));
+
+    if (!nps.empty())
+    {
+        std::sort(nps.begin(), nps.end());
+
+        // Nearest rank percentiles
+        auto percentile = [&](int p) {
+            size_t rank = (p * nps.size() + 99) / 100;
+            return std::uint64_t(nps[std::max<size_t>(rank, 1) - 1]);
+        };
+
+        double mean = 0, variance = 0;
+        for (double v : nps)
+            mean += v / double(nps.size());
+        for (double v : nps)
+            variance += (v - mean) * (v - mean) / double(nps.size());
+
+        os << ",\"positionNps\":{\"min\":" << std::uint64_t(nps.front())
+           << ",\"p10\":" << percentile(10) << ",\"p25\":" << percentile(25)
+           << ",\"median\":" << percentile(50) << ",\"p75\":" << percentile(75)
+           << ",\"p90\":" << percentile(90) << ",\"max\":" << std::uint64_t(nps.back())
+           << ",\"mean\":" << std::uint64_t(mean) << ",\"variance\":" << std::uint64_t(variance)
+           << ",\"stddev\":" << std::uint64_t(std::sqrt(variance)) << "}";
+    }
+
+    os << "}";
+    return os.str();
+}
+
+namespace {
+
+// Keeps the compiler from dropping the work of the timed loops
+volatile uint64_t Sink;
+
+// Repeats a round of calls, which returns how many it made, for 200 ms
+template<typename Round>
+double ns_per_call(Round round) {
+
+    using namespace std::chrono;
+
+    const auto  start = steady_clock::now();
+    uint64_t    calls = 0;
+    nanoseconds elapsed;
+
+    do
+    {
+        calls += round();
+        elapsed = steady_clock::now() - start;
+    } while (elapsed < milliseconds(200));
+
+    return double(elapsed.count()) / double(std::max<uint64_t>(calls, 1));
+}
+
+template<PieceType Pt>
+uint64_t attacks_round(const std::vector<Position*>& positions) {
+
+    Bitboard b = 0;
+
+    for (const Position* pos : positions)
+        for (Square s = SQ_A1; s <= SQ_H8; ++s)
+            b ^= attacks_bb<Pt>(s, pos->pieces());
+
+    Sink = b;
+    return SQUARE_NB * positions.size();
+}
+
+}  // namespace
+
+// The positions are the default ones, and for upcoming_repetition() the same
+// ones after a few moves each, so that there is a history to look through. The
+// moves are generated beforehand, out of the timed loops.
+std::string microbench() {
+
+    const auto fens = default_fens();
+    const auto n    = fens.size();
+
+    std::deque<StateInfo>       states(n);
+    std::unique_ptr<Position[]> positions(new Position[n]);
+    std::unique_ptr<Position[]> played(new Position[n]);
+    std::vector<StateListPtr>   histories;
+
+    std::vector<Position*>         all, notInCheck, inCheck;
+    std::vector<std::vector<Move>> pseudoLegal(n), legal(n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        Position& pos = positions[i];
+        pos.set(fens[i], false, &states[i]);
+
+        all.push_back(&pos);
+        (pos.checkers() ? inCheck : notInCheck).push_back(&pos);
+
+        Move  list[MAX_MOVES];
+        Move* end = pos.checkers() ? generate<EVASIONS>(pos, list)
+                                   : generate<NON_EVASIONS>(pos, list);
+        pseudoLegal[i].assign(list, end);
+
+        for (auto m : MoveList<LEGAL>(pos))
+            legal[i].push_back(m);
+
+        histories.emplace_back(new std::deque<StateInfo>(1));
+        played[i].set(fens[i], false, &histories.back()->back());
+
+        for (int ply = 0; ply < 8; ++ply)
+        {
+            MoveList<LEGAL> replies(played[i]);
+            if (!replies.size())
+                break;
+
+            histories.back()->emplace_back();
+            played[i].do_move(*(replies.begin() + ply * 7 % replies.size()),
+                              histories.back()->back());
+        }
+    }
+
+    auto each_position = [](const std::vector<Position*>& list, auto f) {
+        return [&list, f]() {
+            for (Position* pos : list)
+                f(*pos);
+            return uint64_t(list.size());
+        };
+    };
+
+    auto each_move = [&](const std::vector<std::vector<Move>>& lists, auto f) {
+        return [&, f]() {
+            uint64_t calls = 0;
+            for (size_t i = 0; i < n; ++i)
+                for (Move m : lists[i])
+                    f(positions[i], m), ++calls;
+            return calls;
+        };
+    };
+
+    std::ostringstream os;
+
+    auto report = [&](const std::string& name, auto round) {
+        os << std::left << std::setw(30) << name << std::right << std::setw(10) << std::fixed
+           << std::setprecision(2) << ns_per_call(round) << " ns/call\n";
+    };
+
+    os << "Board primitives on " << n << " positions, " << inCheck.size() << " in check\n\n";
+
+    report("attacks_bb<BISHOP>", [&]() { return attacks_round<BISHOP>(all); });
+    report("attacks_bb<ROOK>", [&]() { return attacks_round<ROOK>(all); });
+    report("attacks_bb<QUEEN>", [&]() { return attacks_round<QUEEN>(all); });
+
+    report("MoveList<CAPTURES>", each_position(notInCheck, [](const Position& pos) {
+               Sink = MoveList<CAPTURES>(pos).size();
+           }));
+    report("MoveList<QUIETS>", each_position(notInCheck, [](const Position& pos) {
+               Sink = MoveList<QUIETS>(pos).size();
+           }));
+    report("MoveList<NON_EVASIONS>", each_position(notInCheck, [](const Position& pos) {
+               Sink = MoveList<NON_EVASIONS>(pos).size();
+           }));
+    if (!inCheck.empty())
+        report("MoveList<EVASIONS>", each_position(inCheck, [](const Position& pos) {
+                   Sink = MoveList<EVASIONS>(pos).size();
+               }));
+    report("MoveList<LEGAL>",
+           each_position(all, [](const Position& pos) { Sink = MoveList<LEGAL>(pos).size(); }));
+
+    report("Position::legal",
+           each_move(pseudoLegal, [](const Position& pos, Move m) { Sink = pos.legal(m); }));
+    report("Position::gives_check",
+           each_move(legal, [](const Position& pos, Move m) { Sink = pos.gives_check(m); }));
+    report("Position::see_ge",
+           each_move(legal, [](const Position& pos, Move m) { Sink = pos.see_ge(m, 0); }));
+    report("Position::key_after",
+           each_move(legal, [](const Position& pos, Move m) { Sink = pos.key_after(m); }));
+    report("Position::do_move + undo_move", each_move(legal, [](Position& pos, Move m) {
+               StateInfo st;
+               pos.do_move(m, st);
+               pos.undo_move(m);
+           }));
+
+    report("Position::upcoming_repetition", [&]() {
+        for (size_t i = 0; i < n; ++i)
+            Sink = played[i].upcoming_repetition(8);
+        return uint64_t(n);
+    });
+
+    return os.str();
+}
+
 }  // namespace Stockfish
@@ -19,12 +19,15 @@
 #ifndef BENCHMARK_H_INCLUDED
 #define BENCHMARK_H_INCLUDED
 
+#include <cstdint>
 #include <iosfwd>
+#include <sstream>
 #include <string>
 #include <vector>
 
 namespace Stockfish::Benchmark {
 
+std::vector<std::string> default_fens();
 std::vector<std::string> setup_bench(const std::string&, std::istream&);
 
 struct BenchmarkSetup {
@@ -37,6 +40,41 @@ struct BenchmarkSetup {
 
 BenchmarkSetup setup_benchmark(std::istream&);
 
+// The configurations of a sweep, each of which runs the benchmark positions
+struct SweepSetup {
+    struct Config {
+        int         threads;
+        int         ttSize;
+        std::string numaPolicy;
+    };
+
+    std::vector<Config>      configs;
+    std::vector<std::string> commands;
+    int                      desiredTimeS;
+};
+
+SweepSetup setup_sweep(std::istream&);
+
+// Times the board primitives on the default positions, and reports ns per call
+std::string microbench();
+
+// What was measured on one position of a bench or benchmark run
+struct PositionResult {
+    std::string   fen;
+    std::uint64_t nodes;
+    std::int64_t  timeMs;
+    int           depth, selDepth, hashfull;
+};
+
+// Reads the arguments into 'args', less a last "json", and tells if it was there
+bool take_json_flag(std::istream& is, std::istringstream& args);
+
+// Formats the results of a run as one line of JSON: each position, the totals,
+// and the spread of the speeds over the positions
+std::string results_json(const std::vector<PositionResult>& results,
+                         std::uint64_t                      nodes,
+                         std::int64_t                       timeMs);
+
 }  // namespace Stockfish
 
 #endif  // #ifndef BENCHMARK_H_INCLUDED
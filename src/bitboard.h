@@ -58,12 +58,16 @@ constexpr Bitboard Rank6BB = Rank1BB << (8 * 5);
 constexpr Bitboard Rank7BB = Rank1BB << (8 * 6);
 constexpr Bitboard Rank8BB = Rank1BB << (8 * 7);
 
+template<typename T>
+using SquareTable = std::array<std::array<T, SQUARE_NB>, SQUARE_NB>;
+
 extern uint8_t PopCnt16[1 << 16];
-extern uint8_t SquareDistance[SQUARE_NB][SQUARE_NB];
 
-extern Bitboard BetweenBB[SQUARE_NB][SQUARE_NB];
-extern Bitboard LineBB[SQUARE_NB][SQUARE_NB];
-extern Bitboard RayPassBB[SQUARE_NB][SQUARE_NB];
+// Computed at compile time, see bitboard.cpp
+extern const SquareTable<uint8_t>  SquareDistance;
+extern const SquareTable<Bitboard> BetweenBB;
+extern const SquareTable<Bitboard> LineBB;
+extern const SquareTable<Bitboard> RayPassBB;
 
 // Magic holds all magic bitboards relevant data for a single square
 struct Magic {
@@ -346,6 +350,14 @@ constexpr Bitboard sliding_attack(PieceType pt, Square sq, Bitboard occupied) {
     return attacks;
 }
 
+// Returns the squares from sq, excluded, to the board edge in direction d
+constexpr Bitboard ray(Square sq, Direction d) {
+    Bitboard b = 0;
+    for (Square s = sq; safe_destination(s, d);)
+        b |= (s += d);
+    return b;
+}
+
 constexpr Bitboard knight_attack(Square sq) {
     Bitboard b = {};
     for (int step : {-17, -15, -10, -6, 6, 10, 15, 17})
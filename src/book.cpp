@@ -0,0 +1,238 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "book.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <sys/stat.h>
+
+#include "misc.h"
+#include "movegen.h"
+#include "position.h"
+#include "search.h"
+#include "ucioption.h"
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#else
+    #define WIN32_LEAN_AND_MEAN
+    #ifndef NOMINMAX
+        #define NOMINMAX  // Disable macros min() and max()
+    #endif
+    #include <windows.h>
+#endif
+
+namespace Stockfish::Book {
+
+void Mapping::unmap() {
+    if (!base)
+        return;
+
+#ifndef _WIN32
+    munmap(base, mapping);
+#else
+    UnmapViewOfFile(base);
+    CloseHandle(HANDLE(mapping));
+#endif
+
+    base    = nullptr;
+    mapping = 0;
+    entries = nullptr;
+    count   = 0;
+}
+
+// Maps the whole file, or returns false
+bool Mapping::map(const std::string& path) {
+#ifndef _WIN32
+    struct stat statbuf;
+    int         fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd == -1)
+        return false;
+
+    if (fstat(fd, &statbuf) == -1 || statbuf.st_size < off_t(sizeof(Header)))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* mem = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (mem == MAP_FAILED)
+        return false;
+
+    const uint64_t size = uint64_t(statbuf.st_size);
+    base                = mem;
+    mapping             = size;
+#else
+    HANDLE fd = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_FLAG_RANDOM_ACCESS, nullptr);
+
+    if (fd == INVALID_HANDLE_VALUE)
+        return false;
+
+    DWORD          sizeHigh;
+    DWORD          sizeLow = GetFileSize(fd, &sizeHigh);
+    const uint64_t size    = uint64_t(sizeHigh) << 32 | sizeLow;
+
+    HANDLE handle = size >= sizeof(Header)
+                    ? CreateFileMapping(fd, nullptr, PAGE_READONLY, 0, 0, nullptr)
+                    : nullptr;
+    CloseHandle(fd);
+
+    if (!handle)
+        return false;
+
+    base    = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+    mapping = uint64_t(handle);
+
+    if (!base)
+    {
+        CloseHandle(handle);
+        mapping = 0;
+        return false;
+    }
+#endif
+
+    const Header expected;
+    Header       header;
+    std::memcpy(&header, base, sizeof(header));
+
+    if (std::memcmp(header.magic, expected.magic, sizeof(header.magic))
+        || header.version != expected.version
+        || header.count != (size - sizeof(Header)) / sizeof(Entry))
+    {
+        unmap();
+        return false;
+    }
+
+    entries = reinterpret_cast<const Entry*>(static_cast<const char*>(base) + sizeof(Header));
+    count   = header.count;
+    return true;
+}
+
+std::optional<std::string> Mapping::init(const std::string& path) {
+    unmap();
+
+    if (path.empty())
+        return std::nullopt;
+
+    if (!map(path))
+        return "Could not open the book " + path + ", or it is not a book of this version";
+
+    return "Book " + path + " with " + std::to_string(count) + " entries";
+}
+
+Mapping::Mapping() :
+    seed(uint64_t(now())) {}
+
+std::vector<Entry> Mapping::probe(const Position& pos) const {
+    std::vector<Entry> moves;
+
+    if (!count)
+        return moves;
+
+    const Key    key   = pos.raw_key();
+    const Entry* first = std::lower_bound(entries, entries + count, key,
+                                          [](const Entry& e, Key k) { return e.key < k; });
+
+    for (const Entry* e = first; e < entries + count && e->key == key; ++e)
+        if (e->weight && pos.pseudo_legal(Move(e->move)) && pos.legal(Move(e->move)))
+            moves.push_back(*e);
+
+    std::stable_sort(moves.begin(), moves.end(),
+                     [](const Entry& a, const Entry& b) { return a.weight > b.weight; });
+    return moves;
+}
+
+bool Mapping::rank_root_moves(const OptionsMap&   options,
+                              const Position&     pos,
+                              Search::RootMoves&  rootMoves,
+                              Search::LimitsType& limits) const {
+
+    std::vector<Entry> moves = probe(pos);
+
+    if (moves.empty())
+        return false;
+
+    // Pick a move at random, the more likely the greater its weight
+    PRNG rng((pos.raw_key() ^ (seed + picks.fetch_add(1, std::memory_order_relaxed))
+                                * 0x9E3779B97F4A7C15ULL)
+             | 1);
+
+    uint64_t total = 0;
+    for (const Entry& e : moves)
+        total += e.weight;
+
+    uint64_t pick = rng.rand<uint64_t>() % total;
+    auto     it   = moves.begin();
+    while (pick >= it->weight)
+        pick -= it++->weight;
+
+    std::rotate(moves.begin(), it, it + 1);
+
+    // Root moves are only those that are legal
+    auto last = rootMoves.begin();
+    for (const Entry& e : moves)
+    {
+        auto rm = std::find(last, rootMoves.end(), Move(e.move));
+        if (rm != rootMoves.end())
+            std::rotate(last++, rm, rm + 1);
+    }
+
+    if (last == rootMoves.begin())
+        return false;
+
+    if (options["Book Instant"] && limits.use_time_management())
+    {
+        rootMoves.erase(rootMoves.begin() + 1, rootMoves.end());
+        limits.depth = 1;
+    }
+
+    return true;
+}
+
+size_t write(std::vector<Entry> entries, std::ostream& out) {
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.key != b.key ? a.key < b.key : a.move < b.move;
+    });
+
+    // Merge the repeated moves of a position, summing their weights
+    std::vector<Entry> merged;
+    for (const Entry& e : entries)
+        if (!merged.empty() && merged.back().key == e.key && merged.back().move == e.move)
+            merged.back().weight = uint16_t(std::min(65535, merged.back().weight + e.weight));
+        else
+            merged.push_back(e);
+
+    Header header;
+    header.count = merged.size();
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(merged.data()),
+              std::streamsize(merged.size() * sizeof(Entry)));
+
+    return out ? merged.size() : 0;
+}
+
+}  // namespace Stockfish::Book
@@ -0,0 +1,116 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BOOK_H_INCLUDED
+#define BOOK_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+namespace Stockfish {
+class Position;
+class OptionsMap;
+
+namespace Search {
+struct LimitsType;
+struct RootMove;
+using RootMoves = std::vector<RootMove>;
+}
+}
+
+// An opening book, memory mapped read only, so that the processes using the same
+// file share its pages. The file starts with a Header and has the Entries sorted
+// by key, little endian. These are laid out as those of Polyglot, but the key is
+// Position::raw_key(), which does not depend on the halfmove clock, and the move
+// is the 16 bits of Move. The Polyglot keys would need a second set of Zobrist
+// keys, kept up to date on every move. A book is thus only valid as long as the
+// Zobrist keys of the engine are unchanged, which the version of the header
+// stands for.
+namespace Stockfish::Book {
+
+struct Header {
+    char     magic[6] = {'S', 'F', 'B', 'O', 'O', 'K'};
+    uint16_t version  = 1;
+    uint64_t count    = 0;
+};
+
+struct Entry {
+    uint64_t key;
+    uint16_t move;
+    uint16_t weight;  // Relative to the other moves of the position
+    uint32_t learn;   // Unused, as in Polyglot
+};
+
+static_assert(sizeof(Header) == 16 && sizeof(Entry) == 16);
+
+// A mapped book, set and read only while no search is running. Each engine has
+// its own, as "Book File" is one of its options.
+class Mapping {
+   public:
+    Mapping();
+    ~Mapping() { unmap(); }
+
+    Mapping(const Mapping&)            = delete;
+    Mapping& operator=(const Mapping&) = delete;
+
+    // Maps the book at path, closing the one before, and returns an info message.
+    // An empty path only closes it.
+    std::optional<std::string> init(const std::string& path);
+
+    // The legal moves of the position in the book, by decreasing weight
+    std::vector<Entry> probe(const Position& pos) const;
+
+    // With a book move for the root, puts the one picked at random by weight first
+    // among the root moves and the other book moves after it. With "Book Instant"
+    // and the clock of a game, it is the only root move and searched to depth 1, so
+    // that it is played at once. Returns whether the root was in the book.
+    bool rank_root_moves(const OptionsMap&   options,
+                         const Position&     pos,
+                         Search::RootMoves&  rootMoves,
+                         Search::LimitsType& limits) const;
+
+   private:
+    bool map(const std::string& path);
+    void unmap();
+
+    void*        base    = nullptr;
+    uint64_t     mapping = 0;  // The size, or the handle of the mapping on Windows
+    const Entry* entries = nullptr;
+    size_t       count   = 0;
+
+    // The picks of rank_root_moves() are seeded by the position, the time this
+    // book was made and the number of picks before, so the engines and the pools
+    // sharing one do not share the state of a generator
+    const uint64_t                seed;
+    mutable std::atomic<uint64_t> picks{0};
+};
+
+// Sorts the entries, merging those of the same position and move, and writes them
+// as a book. Returns the number of entries written, or 0 on a failure to write.
+size_t write(std::vector<Entry> entries, std::ostream& out);
+
+}  // namespace Stockfish::Book
+
+#endif  // #ifndef BOOK_H_INCLUDED
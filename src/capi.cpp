@@ -0,0 +1,257 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "capi.h"
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bitboard.h"
+#include "engine.h"
+#include "misc.h"
+#include "position.h"
+#include "score.h"
+#include "search.h"
+#include "types.h"
+#include "uci.h"
+
+using namespace Stockfish;
+
+struct sf_host {
+    std::shared_ptr<EngineHost> host;
+};
+
+struct sf_engine {
+    explicit sf_engine(std::optional<std::string> path) :
+        engine(path) {}
+    explicit sf_engine(std::shared_ptr<EngineHost> host) :
+        engine(std::move(host)) {}
+
+    Engine engine;
+
+    sf_info_full_cb onInfoFull = nullptr;
+    sf_info_iter_cb onInfoIter = nullptr;
+    sf_bestmove_cb  onBestmove = nullptr;
+    sf_message_cb   onMessage  = nullptr;
+    void*           user       = nullptr;
+};
+
+namespace {
+
+std::once_flag initialized;
+
+void init_once() {
+    std::call_once(initialized, [] {
+        Bitboards::init();
+        Position::init();
+    });
+}
+
+void set_score(sf_info_full& out, const Score& score) {
+    if (score.is<Score::Mate>())
+    {
+        out.score_type = SF_SCORE_MATE;
+        out.score      = score.get<Score::Mate>().plies;
+    }
+    else if (score.is<Score::Tablebase>())
+    {
+        out.score_type = SF_SCORE_TB;
+        out.score      = score.get<Score::Tablebase>().plies;
+    }
+    else
+    {
+        out.score_type = SF_SCORE_CP;
+        out.score      = score.get<Score::InternalUnits>().value;
+    }
+}
+
+// Installs the listeners of the engine, which call those of the caller if set
+void install_listeners(sf_engine* e) {
+    Engine& engine = e->engine;
+
+    engine.set_on_update_no_moves([e](const Engine::InfoShort& info) {
+        if (!e->onInfoFull)
+            return;
+
+        sf_info_full out{};
+        out.depth = info.depth;
+        set_score(out, info.score);
+        e->onInfoFull(e->user, &out);
+    });
+
+    engine.set_on_update_full([e](const Engine::InfoFull& info) {
+        if (!e->onInfoFull)
+            return;
+
+        // Kept between calls, so that the pv of each iteration does not allocate
+        thread_local std::vector<uint16_t> pv;
+
+        pv.clear();
+        for (size_t i = 0; i < info.pvLength; ++i)
+            pv.push_back(info.pvMoves[i].raw());
+
+        sf_info_full out{};
+        out.depth     = info.depth;
+        out.seldepth  = info.selDepth;
+        out.multipv   = uint32_t(info.multiPV);
+        out.bound     = info.bound == "lowerbound" ? SF_BOUND_LOWER
+                      : info.bound == "upperbound" ? SF_BOUND_UPPER
+                                                   : SF_BOUND_EXACT;
+        out.nodes     = info.nodes;
+        out.nps       = info.nps;
+        out.tbhits    = info.tbHits;
+        out.time_ms   = info.timeMs;
+        out.hashfull  = info.hashfull;
+        out.pv        = pv.data();
+        out.pv_length = pv.size();
+        set_score(out, info.score);
+        e->onInfoFull(e->user, &out);
+    });
+
+    engine.set_on_iter([e](const Engine::InfoIter& info) {
+        if (!e->onInfoIter)
+            return;
+
+        const std::string currmove(info.currmove);
+        const sf_info_iter out{info.depth, currmove.c_str(), uint32_t(info.currmovenumber)};
+        e->onInfoIter(e->user, &out);
+    });
+
+    engine.set_on_bestmove([e](std::string_view bestmove, std::string_view ponder) {
+        if (e->onBestmove)
+            e->onBestmove(e->user, std::string(bestmove).c_str(), std::string(ponder).c_str());
+    });
+
+    auto message = [e](std::string_view str) {
+        if (e->onMessage)
+            e->onMessage(e->user, std::string(str).c_str());
+    };
+
+    engine.set_on_verify_networks(message);
+    engine.set_on_cluster_info(message);
+    engine.get_options().add_info_listener([message](const std::optional<std::string>& str) {
+        if (str)
+            message(*str);
+    });
+}
+
+}
+
+extern "C" {
+
+uint32_t sf_abi_version(void) { return SF_ABI_VERSION; }
+
+sf_engine* sf_engine_new(const char* path) {
+    init_once();
+
+    auto e = new sf_engine(path ? std::optional<std::string>(path) : std::nullopt);
+    install_listeners(e);
+    return e;
+}
+
+void sf_engine_free(sf_engine* engine) { delete engine; }
+
+sf_host* sf_host_new(const char* path, size_t maxThreads) {
+    init_once();
+
+    return new sf_host{std::make_shared<EngineHost>(
+      path ? std::optional<std::string>(path) : std::nullopt, maxThreads)};
+}
+
+void sf_host_free(sf_host* host) { delete host; }
+
+sf_engine* sf_engine_new_on_host(sf_host* host) {
+    init_once();
+
+    auto e = new sf_engine(host->host);
+    install_listeners(e);
+    return e;
+}
+
+void sf_set_callbacks(sf_engine*      engine,
+                      sf_info_full_cb onInfoFull,
+                      sf_info_iter_cb onInfoIter,
+                      sf_bestmove_cb  onBestmove,
+                      sf_message_cb   onMessage,
+                      void*           user) {
+    engine->engine.wait_for_search_finished();
+    engine->onInfoFull = onInfoFull;
+    engine->onInfoIter = onInfoIter;
+    engine->onBestmove = onBestmove;
+    engine->onMessage  = onMessage;
+    engine->user       = user;
+}
+
+int sf_set_option(sf_engine* engine, const char* name, const char* value) {
+    if (!engine->engine.get_options().count(name))
+        return 0;
+
+    std::istringstream is(std::string("name ") + name + " value " + (value ? value : ""));
+    engine->engine.wait_for_search_finished();
+    engine->engine.get_options().setoption(is);
+    return 1;
+}
+
+void sf_set_position(sf_engine*         engine,
+                     const char*        fen,
+                     const char* const* moves,
+                     size_t             moveCount) {
+    engine->engine.set_position(fen, std::vector<std::string>(moves, moves + moveCount));
+}
+
+void sf_go(sf_engine* engine, const sf_limits* limits) {
+    Search::LimitsType l;
+
+    l.startTime   = now();
+    l.time[WHITE] = limits->wtime;
+    l.time[BLACK] = limits->btime;
+    l.inc[WHITE]  = limits->winc;
+    l.inc[BLACK]  = limits->binc;
+    l.movestogo   = limits->movestogo;
+    l.depth       = limits->depth;
+    l.nodes       = limits->nodes;
+    l.movetime    = limits->movetime;
+    l.mate        = limits->mate;
+    l.infinite    = limits->infinite != 0;
+
+    engine->engine.go(l);
+}
+
+void sf_stop(sf_engine* engine) { engine->engine.stop(); }
+
+void sf_wait(sf_engine* engine) { engine->engine.wait_for_search_finished(); }
+
+void sf_evaluate(sf_engine* engine, const char* const* fens, size_t count, int32_t* cps) {
+    auto values = engine->engine.evaluate_batch(std::vector<std::string>(fens, fens + count));
+
+    for (size_t i = 0; i < count; ++i)
+        cps[i] = values[i] ? int32_t(*values[i]) : SF_EVAL_NONE;
+}
+
+void sf_move_to_uci(uint16_t move, int chess960, char* buf) {
+    const std::string str = UCIEngine::move(Move(move), chess960 != 0);
+
+    std::memcpy(buf, str.c_str(), str.size() + 1);
+}
+}
@@ -0,0 +1,149 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CAPI_H_INCLUDED
+#define CAPI_H_INCLUDED
+
+// The C ABI of the shared library built by 'make lib', to run engines in the
+// process of the caller without going through the text of UCI. Structs are only
+// ever extended at their end, and SF_ABI_VERSION is raised when they are.
+//
+// The callbacks are called on the threads of the search, and their pointers are
+// only valid during the call. Moves are given as the 16 bits of Stockfish's
+// Move: the target square in bits 0-5, the origin square in bits 6-11, the
+// promotion piece minus a knight in bits 12-13 and the move type in bits 14-15,
+// with castling as the king taking its own rook. Squares go from 0 for a1 to 63
+// for h8. sf_move_to_uci() gives their UCI text.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+    #define SF_API __declspec(dllexport)
+#else
+    #define SF_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SF_ABI_VERSION 1
+
+typedef struct sf_engine sf_engine;
+typedef struct sf_host   sf_host;
+
+enum sf_score_type {
+    SF_SCORE_CP,    // value in centipawns
+    SF_SCORE_MATE,  // value in plies to mate, negative when mated
+    SF_SCORE_TB     // value in plies to a tablebase win, negative for a loss
+};
+
+enum sf_bound {
+    SF_BOUND_EXACT,
+    SF_BOUND_LOWER,
+    SF_BOUND_UPPER
+};
+
+typedef struct {
+    int32_t         depth;
+    int32_t         seldepth;
+    uint32_t        multipv;
+    int32_t         score_type;  // sf_score_type
+    int32_t         score;
+    int32_t         bound;  // sf_bound
+    uint64_t        nodes;
+    uint64_t        nps;
+    uint64_t        tbhits;
+    uint64_t        time_ms;
+    int32_t         hashfull;
+    const uint16_t* pv;
+    size_t          pv_length;
+} sf_info_full;
+
+typedef struct {
+    int32_t     depth;
+    const char* currmove;
+    uint32_t    currmovenumber;
+} sf_info_iter;
+
+// The limits of sf_go(), zero when unused, as the arguments of 'go'
+typedef struct {
+    int64_t  wtime, btime, winc, binc;  // In ms
+    int32_t  movestogo;
+    int32_t  depth;
+    uint64_t nodes;
+    int64_t  movetime;  // In ms
+    int32_t  mate;
+    int32_t  infinite;
+} sf_limits;
+
+typedef void (*sf_info_full_cb)(void* user, const sf_info_full* info);
+typedef void (*sf_info_iter_cb)(void* user, const sf_info_iter* info);
+typedef void (*sf_bestmove_cb)(void* user, const char* bestmove, const char* ponder);
+typedef void (*sf_message_cb)(void* user, const char* message);  // What would be 'info string'
+
+SF_API uint32_t sf_abi_version(void);
+
+// The nets of EvalFile are looked for next to the binary at path, which may be null
+SF_API sf_engine* sf_engine_new(const char* path);
+SF_API void       sf_engine_free(sf_engine* engine);
+
+// The engines made on a host share its nets, loaded once, a budget of maxThreads
+// search threads, zero for no limit, and the tablebases of the first SyzygyPath.
+// A host can be freed before its engines, which keep it until the last is freed.
+SF_API sf_host*   sf_host_new(const char* path, size_t maxThreads);
+SF_API void       sf_host_free(sf_host* host);
+SF_API sf_engine* sf_engine_new_on_host(sf_host* host);
+
+// Any callback may be null. Not to be called during a search.
+SF_API void sf_set_callbacks(sf_engine*      engine,
+                             sf_info_full_cb onInfoFull,
+                             sf_info_iter_cb onInfoIter,
+                             sf_bestmove_cb  onBestmove,
+                             sf_message_cb   onMessage,
+                             void*           user);
+
+// Returns 0 when there is no such option
+SF_API int sf_set_option(sf_engine* engine, const char* name, const char* value);
+
+// The moves are in UCI, those after the first illegal one are ignored
+SF_API void sf_set_position(sf_engine*         engine,
+                            const char*        fen,
+                            const char* const* moves,
+                            size_t             moveCount);
+
+// Non blocking, the search ends with the bestmove callback
+SF_API void sf_go(sf_engine* engine, const sf_limits* limits);
+SF_API void sf_stop(sf_engine* engine);
+SF_API void sf_wait(sf_engine* engine);
+
+// Static evaluations in centipawns from White's point of view, or SF_EVAL_NONE
+// when the side to move is in check
+#define SF_EVAL_NONE INT32_MIN
+SF_API void sf_evaluate(sf_engine* engine, const char* const* fens, size_t count, int32_t* cps);
+
+// Writes the UCI text of the move with its terminating zero to buf, which must
+// hold 8 characters, for "(none)" at most
+SF_API void sf_move_to_uci(uint16_t move, int chess960, char* buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // #ifndef CAPI_H_INCLUDED
@@ -0,0 +1,148 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "datagen.h"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <ostream>
+
+#include "bitboard.h"
+#include "movegen.h"
+#include "syzygy/tbprobe.h"
+
+namespace Stockfish::Datagen {
+
+namespace {
+
+// The wdl of a win by the given side
+uint8_t win_for(Color c) { return c == WHITE ? 2 : 0; }
+
+}
+
+void Game::start(const PackedPosition& root, int randomPlies) {
+    rootPosition = root;
+    kept.clear();
+    decided = -1;
+
+    // Start again when the random moves run into a game without legal moves,
+    // unless the root has none itself
+    do
+    {
+        states = StateListPtr(new std::deque<StateInfo>(1));
+        pos.set(rootPosition, false, &states->back());
+        moves.clear();
+
+        for (int ply = 0; ply < randomPlies && MoveList<LEGAL>(pos).size(); ++ply)
+        {
+            MoveList<LEGAL> legal(pos);
+            moves.push_back(*(legal.begin() + rng.rand<uint64_t>() % legal.size()));
+            states->emplace_back();
+            pos.do_move(moves.back(), states->back());
+        }
+    } while (!MoveList<LEGAL>(pos).size() && !moves.empty());
+
+    openingPlies = int(moves.size());
+}
+
+int Game::result(int maxPlies) {
+    if (decided >= 0)
+        return decided;
+
+    const Color stm = pos.side_to_move();
+
+    if (!MoveList<LEGAL>(pos).size())
+        return decided = pos.checkers() ? win_for(~stm) : 1;
+
+    // Any repetition in the game is enough, as the highest ply takes them all
+    if (pos.is_draw(MAX_PLY) || int(moves.size()) - openingPlies >= maxPlies)
+        return decided = 1;
+
+    if (popcount(pos.pieces()) <= Tablebases::MaxCardinality && !pos.can_castle(ANY_CASTLING))
+    {
+        Tablebases::ProbeState state;
+        Tablebases::WDLScore   wdl = Tablebases::probe_wdl(pos, &state);
+
+        if (state != Tablebases::FAIL)
+            return decided = wdl == Tablebases::WDLWin  ? win_for(stm)
+                           : wdl == Tablebases::WDLLoss ? win_for(~stm)
+                                                        : 1;
+    }
+
+    return -1;
+}
+
+void Game::set_up(Position& searchPos, StateListPtr& searchStates) const {
+    searchStates = StateListPtr(new std::deque<StateInfo>(1));
+    searchPos.set(rootPosition, false, &searchStates->back());
+
+    for (Move m : moves)
+    {
+        searchStates->emplace_back();
+        searchPos.do_move(m, searchStates->back());
+    }
+}
+
+void Game::play(Move best, const std::optional<Score>& score) {
+    const Color stm = pos.side_to_move();
+
+    if (best == Move::none() || !score)
+    {
+        decided = 1;
+        return;
+    }
+
+    // A mate or a tablebase result found by the search ends the game
+    if (score->is<Score::Mate>())
+    {
+        decided = score->get<Score::Mate>().plies > 0 ? win_for(stm) : win_for(~stm);
+        return;
+    }
+
+    if (score->is<Score::Tablebase>())
+    {
+        decided = score->get<Score::Tablebase>().win ? win_for(stm) : win_for(~stm);
+        return;
+    }
+
+    // Captures and checks make poor training positions, as their score is that
+    // of the position after the exchange
+    if (!pos.checkers() && !pos.capture(best))
+    {
+        const int cp = score->get<Score::InternalUnits>().value;
+        kept.push_back(pos.pack());
+        kept.back().eval = int16_t(std::clamp(stm == WHITE ? cp : -cp, -32767, 32767));
+    }
+
+    moves.push_back(best);
+    states->emplace_back();
+    pos.do_move(best, states->back());
+}
+
+size_t Game::write(std::ostream& out, uint8_t wdl) {
+    for (auto& pb : kept)
+        pb.wdl = wdl;
+
+    out.write(reinterpret_cast<const char*>(kept.data()),
+              std::streamsize(kept.size() * sizeof(PackedPosition)));
+
+    return kept.size();
+}
+
+}  // namespace Stockfish::Datagen
@@ -0,0 +1,95 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DATAGEN_H_INCLUDED
+#define DATAGEN_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "misc.h"
+#include "position.h"
+#include "score.h"
+#include "types.h"
+
+// Generation of training data by self-play, see Engine::datagen()
+namespace Stockfish::Datagen {
+
+struct Params {
+    size_t   threads     = 1;
+    size_t   games       = 100;
+    uint64_t nodes       = 5000;  // Searched for each move
+    size_t   hashMb      = 16;    // Of the TT of each thread
+    int      randomPlies = 8;     // Played at random before the first search
+    int      maxPlies    = 400;   // After which the game is drawn
+    uint64_t seed        = 1;
+
+    // Packed positions to start the games from in turn, from the start position
+    // when null. Read again from the beginning when all are used.
+    std::istream* openings = nullptr;
+};
+
+struct Stats {
+    size_t games = 0, positions = 0;
+    size_t results[3]{};  // By wdl
+};
+
+// A game of one search pool with itself. It opens with random moves from its root,
+// and is then played with the best move of the search of each position until
+// adjudicated.
+class Game {
+   public:
+    explicit Game(uint64_t seed) :
+        rng(seed) {}
+
+    void start(const PackedPosition& root, int randomPlies);
+
+    // The wdl of the game if it is over: without legal moves, drawn by rule or by
+    // repetition, decided by the tablebases or by a mate found by the search, or
+    // longer than maxPlies. Otherwise -1.
+    int result(int maxPlies);
+
+    // Sets up the position to be searched with its own copy of the game's states
+    void set_up(Position& searchPos, StateListPtr& searchStates) const;
+
+    // Keeps the position with its score, if quiet, and plays the best move
+    void play(Move best, const std::optional<Score>& score);
+
+    // Writes the kept positions with the result and returns their number
+    size_t write(std::ostream& out, uint8_t wdl);
+
+    const Position& position() const { return pos; }
+
+   private:
+    PRNG                        rng;
+    Position                    pos;
+    StateListPtr                states;
+    PackedPosition              rootPosition{};
+    std::vector<Move>           moves;  // Played since the root
+    std::vector<PackedPosition> kept;
+    int                         openingPlies = 0;
+    int                         decided      = -1;
+};
+
+}  // namespace Stockfish::Datagen
+
+#endif  // #ifndef DATAGEN_H_INCLUDED
@@ -0,0 +1,146 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Entry point of a dispatch build ('make dispatch-build'), which links several
+// complete copies of the engine, each compiled for one x86-64 ARCH into its own
+// namespace, into a single binary. This file is compiled for the baseline ARCH,
+// checks the host with cpuid and runs the best variant that was linked in.
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "evaluate.h"
+
+#if !defined(NNUE_EMBEDDING_OFF)
+    #define INCBIN_SILENCE_BITCODE_WARNING
+    #include "incbin/incbin.h"
+
+// The nets are embedded here once and shared by all variants
+INCBIN(EmbeddedNNUEBig, EvalFileDefaultNameBig);
+INCBIN(EmbeddedNNUESmall, EvalFileDefaultNameSmall);
+#endif
+
+// Variants left out of DISPATCH_ARCHS are simply not linked, their weak
+// entry points then resolve to null and are skipped. The static constructors
+// of each variant are in a section of their own, bounded by the linker symbols
+// __start_<section> and __stop_<section>, and must be run before its entry point.
+#define DECLARE_VARIANT(ns) \
+    namespace ns { \
+    __attribute__((weak)) int entry_point(int argc, char* argv[]); \
+    } \
+    extern "C" __attribute__((weak)) void (*const __start_##ns##_init[])(); \
+    extern "C" __attribute__((weak)) void (*const __stop_##ns##_init[])();
+
+DECLARE_VARIANT(Stockfish_x86_64_avx512icl)
+DECLARE_VARIANT(Stockfish_x86_64_vnni512)
+DECLARE_VARIANT(Stockfish_x86_64_avx512)
+DECLARE_VARIANT(Stockfish_x86_64_bmi2)
+DECLARE_VARIANT(Stockfish_x86_64_avx2)
+DECLARE_VARIANT(Stockfish_x86_64_sse41_popcnt)
+DECLARE_VARIANT(Stockfish_x86_64)
+
+namespace {
+
+using Constructor = void (*)();
+
+struct Variant {
+    const char* arch;
+    int (*entry)(int, char*[]);
+    const Constructor* initBegin;
+    const Constructor* initEnd;
+    bool (*supported)();
+};
+
+bool has_avx512icl() {
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512cd")
+        && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq")
+        && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512ifma")
+        && __builtin_cpu_supports("avx512vbmi") && __builtin_cpu_supports("avx512vbmi2")
+        && __builtin_cpu_supports("avx512vpopcntdq") && __builtin_cpu_supports("avx512bitalg")
+        && __builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("vpclmulqdq")
+        && __builtin_cpu_supports("gfni") && __builtin_cpu_supports("vaes");
+}
+
+bool has_vnni512() {
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+        && __builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512dq")
+        && __builtin_cpu_supports("avx512vl");
+}
+
+bool has_avx512() {
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+        && __builtin_cpu_supports("bmi2");
+}
+
+// pext is microcoded and very slow on AMD before Zen 3, prefer the avx2 build there
+bool has_bmi2() {
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2")
+        && !__builtin_cpu_is("znver1") && !__builtin_cpu_is("znver2");
+}
+
+bool has_avx2() { return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"); }
+
+bool has_sse41_popcnt() {
+    return __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("popcnt");
+}
+
+bool always() { return true; }
+
+#define VARIANT(arch, ns, supported) \
+    {arch, ns::entry_point, __start_##ns##_init, __stop_##ns##_init, supported}
+
+// Ordered from the fastest to the most portable
+const Variant Variants[] = {
+  VARIANT("x86-64-avx512icl", Stockfish_x86_64_avx512icl, has_avx512icl),
+  VARIANT("x86-64-vnni512", Stockfish_x86_64_vnni512, has_vnni512),
+  VARIANT("x86-64-avx512", Stockfish_x86_64_avx512, has_avx512),
+  VARIANT("x86-64-bmi2", Stockfish_x86_64_bmi2, has_bmi2),
+  VARIANT("x86-64-avx2", Stockfish_x86_64_avx2, has_avx2),
+  VARIANT("x86-64-sse41-popcnt", Stockfish_x86_64_sse41_popcnt, has_sse41_popcnt),
+  VARIANT("x86-64", Stockfish_x86_64, always)};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+
+    __builtin_cpu_init();
+
+    // SF_DISPATCH_ARCH caps the selection, e.g. to compare variants on one host
+    const char* cap = std::getenv("SF_DISPATCH_ARCH");
+    bool        capped = cap && *cap;
+
+    for (const Variant& v : Variants)
+    {
+        if (capped && std::strcmp(cap, v.arch) != 0)
+            continue;
+
+        capped = false;
+
+        if (v.entry && v.supported())
+        {
+            for (const Constructor* c = v.initBegin; c != v.initEnd; ++c)
+                (*c)();
+
+            return v.entry(argc, argv);
+        }
+    }
+
+    std::cerr << "No engine variant in this build runs on this CPU" << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,566 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "distributed.h"
+
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <utility>
+
+#include "position.h"
+#include "thread.h"
+
+#if !defined(_WIN32)
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+namespace Stockfish::Distributed {
+
+namespace {
+
+enum MessageType : std::uint32_t {
+    GoMessage = 1,  // Root fen, a newline and the moves, separated by spaces
+    StopMessage,
+    EntriesMessage,  // An array of TTExchangeEntry
+    ReportMessage,   // A Report
+    HelloMessage     // The secret, first from the main engine
+};
+
+struct Header {
+    std::uint32_t type;
+    std::uint32_t size;
+};
+
+struct Report {
+    std::uint64_t nodes;
+    std::int32_t  depth;
+    char          move[8];
+};
+
+// How often the TT writes are sent, and the workers report
+constexpr auto ExchangePeriod = std::chrono::milliseconds(10);
+constexpr auto ReportPeriod   = std::chrono::milliseconds(100);
+
+// How long a connection may take to give the secret, and how many may wait
+constexpr auto        HelloTimeout   = std::chrono::seconds(5);
+constexpr std::size_t MaxUnconfirmed = 4;
+
+// The entries of one message, larger batches are split
+constexpr std::size_t MaxEntries = 1 << 14;
+
+// The largest payload of each type of message, zero for unknown types
+std::size_t max_size(std::uint32_t type) {
+    switch (type)
+    {
+    case GoMessage :
+        return 1 << 20;
+    case EntriesMessage :
+        return MaxEntries * sizeof(TTExchangeEntry);
+    case ReportMessage :
+        return sizeof(Report);
+    case HelloMessage :
+        return 256;
+    default :
+        return 0;
+    }
+}
+
+bool is_known(std::uint32_t type) { return type >= GoMessage && type <= HelloMessage; }
+
+// A move as UCI gives it, so that nothing else gets into the commands of onGo
+bool is_uci_move(const std::string& m) {
+    return (m.size() == 4 || (m.size() == 5 && std::strchr("qrbn", m[4])))
+        && m[0] >= 'a' && m[0] <= 'h' && m[1] >= '1' && m[1] <= '8' && m[2] >= 'a'
+        && m[2] <= 'h' && m[3] >= '1' && m[3] <= '8';
+}
+
+// Compares in a time that does not tell how much of the secret matched
+bool same_secret(const std::string& a, const std::string& b) {
+    unsigned char diff = a.size() != b.size();
+    for (std::size_t i = 0; i < a.size() && i < b.size(); ++i)
+        diff |= a[i] ^ b[i];
+    return !diff;
+}
+
+}  // namespace
+
+Link::Link(ThreadPool& threadPool, TranspositionTable& transpositionTable, OnInfo info) :
+    threads(threadPool),
+    tt(transpositionTable),
+    onInfo(std::move(info)) {}
+
+#if defined(_WIN32)
+
+// Not implemented with Winsock yet
+Link::~Link() {}
+bool Link::serve(const std::string&, std::uint16_t, const std::string&, OnGo, OnStop) {
+    return false;
+}
+bool Link::connect(const std::vector<std::string>&, const std::string&) { return false; }
+void Link::start_search(const std::string&, const std::vector<std::string>&) {}
+void Link::stop_search() {}
+void Link::report(int, std::uint64_t, std::string_view) {}
+std::string Link::status() const { return "Distributed search is not supported on Windows"; }
+
+#else
+
+Link::~Link() {
+    exit = true;
+
+    if (ioThread.joinable())
+        ioThread.join();
+
+    for (Peer& peer : peers)
+        close_peer(peer);
+
+    if (listenFd >= 0)
+        ::close(listenFd);
+
+    threads.externalNodes = 0;
+}
+
+bool Link::serve(const std::string& address,
+                 std::uint16_t      port,
+                 const std::string& key,
+                 OnGo               go,
+                 OnStop             stop) {
+
+    if (key.empty() || key.size() > max_size(HelloMessage))
+        return false;
+
+    addrinfo  hints{};
+    addrinfo* result  = nullptr;
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = AI_PASSIVE | AI_NUMERICHOST;
+
+    if (::getaddrinfo(address.c_str(), std::to_string(port).c_str(), &hints, &result) != 0)
+        return false;
+
+    for (addrinfo* ai = result; ai && listenFd < 0; ai = ai->ai_next)
+    {
+        listenFd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (listenFd < 0)
+            continue;
+
+        int on = 1;
+        ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+        if (::bind(listenFd, ai->ai_addr, ai->ai_addrlen) < 0 || ::listen(listenFd, 4) < 0)
+        {
+            ::close(listenFd);
+            listenFd = -1;
+        }
+    }
+    ::freeaddrinfo(result);
+
+    if (listenFd < 0)
+        return false;
+
+    secret   = key;
+    onGo     = std::move(go);
+    onStop   = std::move(stop);
+    ioThread = std::thread(&Link::loop, this);
+    return true;
+}
+
+bool Link::connect(const std::vector<std::string>& workers, const std::string& key) {
+
+    if (key.empty() || key.size() > max_size(HelloMessage))
+        return false;
+
+    for (const std::string& worker : workers)
+    {
+        const auto colon = worker.rfind(':');
+        if (colon == std::string::npos)
+            return false;
+
+        addrinfo  hints{};
+        addrinfo* result  = nullptr;
+        hints.ai_family   = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        if (::getaddrinfo(worker.substr(0, colon).c_str(), worker.substr(colon + 1).c_str(),
+                          &hints, &result)
+            != 0)
+            return false;
+
+        int fd = -1;
+        for (addrinfo* ai = result; ai && fd < 0; ai = ai->ai_next)
+        {
+            fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd >= 0 && ::connect(fd, ai->ai_addr, ai->ai_addrlen) < 0)
+            {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        ::freeaddrinfo(result);
+
+        if (fd < 0)
+            return false;
+
+        int on = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        Peer& peer         = peers.emplace_back();
+        peer.fd            = fd;
+        peer.authenticated = true;
+
+        std::lock_guard<std::mutex> lk(mutex);
+        send(peer, HelloMessage, key.data(), key.size());
+    }
+
+    isMain   = true;
+    ioThread = std::thread(&Link::loop, this);
+    return true;
+}
+
+void Link::start_search(const std::string& fen, const std::vector<std::string>& moves) {
+
+    std::string payload = fen + "\n";
+    for (const auto& m : moves)
+        payload += m + " ";
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    for (Peer& peer : peers)
+        peer.nodes = 0, peer.depth = 0, peer.bestMove.clear();
+
+    threads.externalNodes = 0;
+    searching             = true;
+    send_all(GoMessage, payload.data(), payload.size(), nullptr);
+}
+
+void Link::stop_search() {
+
+    if (!isMain)
+        return;
+
+    std::lock_guard<std::mutex> lk(mutex);
+    searching = false;
+    send_all(StopMessage, nullptr, 0, nullptr);
+}
+
+void Link::report(int depth, std::uint64_t nodes, std::string_view pv) {
+
+    std::lock_guard<std::mutex> lk(mutex);
+    reportDepth = depth;
+    reportNodes = nodes;
+    reportMove  = std::string(pv.substr(0, pv.find(' ')));
+}
+
+std::string Link::status() const {
+
+    std::lock_guard<std::mutex> lk(mutex);
+    std::stringstream           ss;
+
+    if (!isMain)
+    {
+        ss << "Distributed search: worker, " << (peers.empty() ? "waiting for" : "connected to")
+           << " the main engine";
+        return ss.str();
+    }
+
+    ss << "Distributed search: main engine with " << peers.size() << " workers";
+    for (std::size_t i = 0; i < peers.size(); ++i)
+        ss << "\nworker " << i << (peers[i].fd < 0 ? " disconnected" : "") << " depth "
+           << peers[i].depth << " nodes " << peers[i].nodes << " bestmove "
+           << (peers[i].bestMove.empty() ? "(none)" : peers[i].bestMove);
+    return ss.str();
+}
+
+// Runs on the I/O thread: accepts the main engine, reads the messages of the
+// peers, and sends the new deep TT writes and, on a worker, its progress.
+void Link::loop() {
+
+    auto lastReport = std::chrono::steady_clock::now();
+
+    while (!exit)
+    {
+        // A worker forgets the closed connections, and those that gave no secret in time
+        if (!isMain)
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            const auto                  now = std::chrono::steady_clock::now();
+
+            for (Peer& peer : peers)
+                if (!peer.authenticated && now - peer.connected > HelloTimeout)
+                    close_peer(peer);
+
+            peers.erase(std::remove_if(peers.begin(), peers.end(),
+                                       [](const Peer& p) { return p.fd < 0; }),
+                        peers.end());
+        }
+
+        std::vector<pollfd> fds;
+        for (const Peer& peer : peers)
+            fds.push_back({peer.fd, POLLIN, 0});
+
+        if (listenFd >= 0)
+            fds.push_back({listenFd, POLLIN, 0});
+
+        const int ready = ::poll(fds.data(), fds.size(), int(ExchangePeriod.count()));
+
+        for (std::size_t i = 0; ready > 0 && i < peers.size(); ++i)
+            if (peers[i].fd >= 0 && (fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                receive(peers[i]);
+
+        // A connection waits for its secret, see handle(), before it replaces the
+        // main engine served so far
+        if (ready > 0 && listenFd >= 0 && (fds.back().revents & POLLIN))
+        {
+            const int fd = ::accept(listenFd, nullptr, nullptr);
+            if (fd >= 0)
+            {
+                int on = 1;
+                ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+                std::lock_guard<std::mutex> lk(mutex);
+                if (std::count_if(peers.begin(), peers.end(),
+                                  [](const Peer& p) { return !p.authenticated; })
+                    < std::ptrdiff_t(MaxUnconfirmed))
+                    peers.emplace_back().fd = fd;
+                else
+                    ::close(fd);
+            }
+        }
+
+        batch.clear();
+        tt.drain_exports(batch);
+        for (std::size_t i = 0; i < batch.size(); i += MaxEntries)
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            send_all(EntriesMessage, batch.data() + i,
+                     std::min(MaxEntries, batch.size() - i) * sizeof(TTExchangeEntry), nullptr);
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (!isMain && searching && now - lastReport >= ReportPeriod)
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            Report                      r{reportNodes, reportDepth, {}};
+            std::memcpy(r.move, reportMove.data(),
+                        std::min(reportMove.size(), sizeof(r.move) - 1));
+            send_all(ReportMessage, &r, sizeof(r), nullptr);
+            lastReport = now;
+        }
+    }
+}
+
+void Link::receive(Peer& peer) {
+
+    char          buffer[1 << 16];
+    const ssize_t n = ::recv(peer.fd, buffer, sizeof(buffer), 0);
+
+    if (n <= 0)
+    {
+        drop(peer);
+        return;
+    }
+
+    peer.input.append(buffer, std::size_t(n));
+
+    Header header;
+    while (peer.fd >= 0 && peer.input.size() >= sizeof(header))
+    {
+        std::memcpy(&header, peer.input.data(), sizeof(header));
+
+        // Nothing is waited for beyond the size of the type, nor before the secret
+        if (!is_known(header.type) || header.size > max_size(header.type)
+            || (!peer.authenticated && header.type != HelloMessage))
+        {
+            drop(peer);
+            return;
+        }
+
+        if (peer.input.size() < sizeof(header) + header.size)
+            break;
+
+        const std::string payload = peer.input.substr(sizeof(header), header.size);
+        peer.input.erase(0, sizeof(header) + header.size);
+        handle(peer, std::uint8_t(header.type), payload);
+    }
+}
+
+// Closes the connection. A worker that lost its main engine stops searching for it.
+void Link::drop(Peer& peer) {
+
+    const bool wasMain = !isMain && peer.authenticated;
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        close_peer(peer);
+        peer.input.clear();
+    }
+
+    if (wasMain && searching.exchange(false))
+        onStop();
+}
+
+// The callbacks are run without holding the mutex, as they wait for the search
+void Link::handle(Peer& peer, std::uint8_t type, const std::string& payload) {
+
+    if (type == HelloMessage)
+    {
+        if (isMain || peer.authenticated || !same_secret(payload, secret))
+        {
+            onInfo("Distributed search: dropped a connection without the secret");
+            drop(peer);
+            return;
+        }
+
+        // The main engine served so far is replaced
+        std::lock_guard<std::mutex> lk(mutex);
+        for (Peer& p : peers)
+            if (&p != &peer && p.authenticated)
+                close_peer(p);
+        peer.authenticated = true;
+    }
+    else if (type == EntriesMessage)
+    {
+        if (payload.size() % sizeof(TTExchangeEntry))
+        {
+            drop(peer);
+            return;
+        }
+
+        std::vector<TTExchangeEntry> entries(payload.size() / sizeof(TTExchangeEntry));
+        std::memcpy(entries.data(), payload.data(), entries.size() * sizeof(TTExchangeEntry));
+        tt.import_entries(entries);
+
+        // The main engine relays the writes of a worker to the others
+        if (isMain && peers.size() > 1)
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            send_all(EntriesMessage, payload.data(), payload.size(), &peer);
+        }
+    }
+    else if (type == ReportMessage && isMain && payload.size() == sizeof(Report))
+    {
+        Report r;
+        std::memcpy(&r, payload.data(), sizeof(r));
+        r.move[sizeof(r.move) - 1] = '\0';
+
+        std::string info;
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            if (!searching)
+                return;
+
+            if (peer.bestMove != r.move)
+                info = "worker " + std::to_string(&peer - peers.data()) + " depth "
+                     + std::to_string(r.depth) + " bestmove " + r.move;
+
+            peer.nodes    = r.nodes;
+            peer.depth    = r.depth;
+            peer.bestMove = r.move;
+
+            std::uint64_t total = 0;
+            for (const Peer& p : peers)
+                total += p.nodes;
+            threads.externalNodes = total;
+        }
+
+        if (!info.empty())
+            onInfo(info);
+    }
+    else if (type == GoMessage && !isMain)
+    {
+        const auto               newline = payload.find('\n');
+        const std::string        fen     = payload.substr(0, newline);
+        bool                     valid   = newline != std::string::npos;
+        std::istringstream       is(valid ? payload.substr(newline + 1) : "");
+        std::vector<std::string> moves;
+        std::string              move;
+
+        valid = valid && Position::is_valid_fen(fen);
+
+        while (valid && is >> move)
+        {
+            valid = is_uci_move(move);
+            moves.push_back(move);
+        }
+
+        // The moves are replayed by the UCI thread, which stops at the first illegal one
+        if (!valid)
+        {
+            onInfo("Distributed search: ignored an invalid position from the main engine");
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            reportDepth = 0;
+            reportMove.clear();
+        }
+
+        searching = true;
+        onGo(fen, moves);
+    }
+    else if (type == StopMessage && !isMain)
+    {
+        searching = false;
+        onStop();
+    }
+}
+
+// Sends a whole message, or closes the peer. The mutex must be held.
+void Link::send(Peer& peer, std::uint8_t type, const void* data, std::size_t size) {
+
+    if (peer.fd < 0)
+        return;
+
+    const Header header{type, std::uint32_t(size)};
+    std::string  message(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (size)
+        message.append(static_cast<const char*>(data), size);
+
+    for (std::size_t sent = 0; sent < message.size();)
+    {
+        const ssize_t n =
+          ::send(peer.fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            close_peer(peer);
+            return;
+        }
+        sent += std::size_t(n);
+    }
+}
+
+void Link::send_all(std::uint8_t type, const void* data, std::size_t size, const Peer* except) {
+    for (Peer& peer : peers)
+        if (&peer != except)
+            send(peer, type, data, size);
+}
+
+void Link::close_peer(Peer& peer) {
+    if (peer.fd >= 0)
+        ::close(peer.fd);
+    peer.fd = -1;
+}
+
+#endif
+
+}  // namespace Stockfish::Distributed
@@ -0,0 +1,131 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DISTRIBUTED_H_INCLUDED
+#define DISTRIBUTED_H_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "tt.h"
+
+namespace Stockfish {
+
+class ThreadPool;
+
+namespace Distributed {
+
+// A Link joins the engine to others over TCP for one distributed search. The
+// main engine connects to its workers. On every 'go' it sends them the root
+// position, and they search it as Lazy SMP helpers until told to stop. While
+// they search, all engines send each other their TT writes above a depth, in
+// batches, so every table gains the deep results of the others. The workers
+// also report their node counts and best moves, which the main engine adds to
+// its own. The machines must be alike: the messages are raw structs, and are
+// not converted between byte orders or layouts.
+//
+// A worker listens on the given address only, and the main engine must open
+// with the shared secret before anything else is read from it. Messages above
+// the size of their type drop the peer, and the positions to search are checked
+// before they are handed to the callback, which runs on the I/O thread.
+class Link {
+   public:
+    using OnGo   = std::function<void(const std::string&, const std::vector<std::string>&)>;
+    using OnStop = std::function<void()>;
+    using OnInfo = std::function<void(std::string_view)>;
+
+    Link(ThreadPool& threadPool, TranspositionTable& transpositionTable, OnInfo onInfo);
+    ~Link();
+
+    Link(const Link&)            = delete;
+    Link& operator=(const Link&) = delete;
+
+    // Worker side, waits for the main engine on the address and port and searches
+    // for it. An empty secret is refused.
+    bool serve(const std::string& address,
+               std::uint16_t      port,
+               const std::string& secret,
+               OnGo               onGo,
+               OnStop             onStop);
+    // Main side, connects to workers given as host:port
+    bool connect(const std::vector<std::string>& workers, const std::string& secret);
+
+    bool is_main() const { return isMain; }
+
+    void start_search(const std::string& fen, const std::vector<std::string>& moves);
+    void stop_search();
+
+    // Worker side, the latest iteration of the local search
+    void report(int depth, std::uint64_t nodes, std::string_view pv);
+
+    std::string status() const;
+
+   private:
+    struct Peer {
+        int           fd = -1;
+        bool          authenticated = false;
+        std::string   input;
+        std::uint64_t nodes = 0;
+        int           depth = 0;
+        std::string   bestMove;
+
+        std::chrono::steady_clock::time_point connected = std::chrono::steady_clock::now();
+    };
+
+    void loop();
+    void receive(Peer& peer);
+    void drop(Peer& peer);
+    void handle(Peer& peer, std::uint8_t type, const std::string& payload);
+    void send(Peer& peer, std::uint8_t type, const void* data, std::size_t size);
+    void send_all(std::uint8_t type, const void* data, std::size_t size, const Peer* except);
+    void close_peer(Peer& peer);
+
+    ThreadPool&         threads;
+    TranspositionTable& tt;
+    OnInfo              onInfo;
+    OnGo                onGo;
+    OnStop              onStop;
+
+    bool              isMain   = false;
+    int               listenFd = -1;
+    std::string       secret;
+    std::vector<Peer> peers;
+    std::atomic_bool  exit{false}, searching{false};
+
+    // Guards the sockets and the peer and report fields against the caller's thread
+    mutable std::mutex mutex;
+    int                reportDepth = 0;
+    std::uint64_t      reportNodes = 0;
+    std::string        reportMove;
+
+    std::vector<TTExchangeEntry> batch;
+    std::thread                  ioThread;
+};
+
+}  // namespace Distributed
+
+}  // namespace Stockfish
+
+#endif  // #ifndef DISTRIBUTED_H_INCLUDED
@@ -20,18 +20,25 @@
 
 #include <algorithm>
 #include <cassert>
+#include <condition_variable>
 #include <deque>
+#include <iomanip>
 #include <iosfwd>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <sstream>
 #include <string_view>
 #include <utility>
 #include <vector>
 
+#include "benchmark.h"
+#include "book.h"
 #include "evaluate.h"
 #include "misc.h"
+#include "movegen.h"
 #include "nnue/network.h"
+#include "nnue/nnue_accumulator.h"
 #include "nnue/nnue_common.h"
 #include "nnue/nnue_misc.h"
 #include "numa.h"
@@ -52,11 +59,45 @@ constexpr auto StartFEN   = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq
 constexpr int  MaxHashMB  = Is64Bit ? 33554432 : 2048;
 int            MaxThreads = std::max(1024, 4 * int(get_hardware_concurrency()));
 
-Engine::Engine(std::optional<std::string> path) :
-    binaryDirectory(path ? CommandLine::get_binary_directory(*path) : ""),
+// Ponder candidates are only searched if their score is within this margin of
+// the best reply
+constexpr Value PonderCandidateMargin = 2 * PawnValue;
+
+namespace {
+
+// The engine the calling thread is the loader of, which must not wait for itself
+thread_local const Engine* loadingEngine = nullptr;
+
+void set_up_position(Position&                       pos,
+                     StateListPtr&                   states,
+                     const std::string&              fen,
+                     const std::vector<std::string>& moves,
+                     bool                            isChess960) {
+
+    // Drop the old states but keep their list, unless it went to the last search
+    if (states)
+        states->resize(1);
+    else
+        states = StateListPtr(new std::deque<StateInfo>(1));
+
+    pos.set(fen, isChess960, &states->back());
+
+    for (const auto& move : moves)
+    {
+        auto m = UCIEngine::to_move(pos, move);
+
+        if (m == Move::none())
+            break;
+
+        states->emplace_back();
+        pos.do_move(m, states->back());
+    }
+}
+
+}  // namespace
+
+EngineHost::EngineHost(Unloaded) :
     numaContext(NumaConfig::from_system()),
-    states(new std::deque<StateInfo>(1)),
-    threads(),
     networks(
       numaContext,
       // Heap-allocate because sizeof(NN::Networks) is large
@@ -64,9 +105,84 @@ Engine::Engine(std::optional<std::string> path) :
         std::make_unique<NN::NetworkBig>(NN::EvalFile{EvalFileDefaultNameBig, "None", ""},
                                          NN::EmbeddedNNUEType::BIG),
         std::make_unique<NN::NetworkSmall>(NN::EvalFile{EvalFileDefaultNameSmall, "None", ""},
-                                           NN::EmbeddedNNUEType::SMALL))) {
+                                           NN::EmbeddedNNUEType::SMALL))),
+    pinnedTables(numaContext) {}
+
+EngineHost::EngineHost(std::optional<std::string> path,
+                       size_t                     threadBudget,
+                       std::string                evalFile,
+                       std::string                evalFileSmall) :
+    EngineHost(Unloaded{}) {
+
+    binaryDirectory = path ? CommandLine::get_binary_directory(*path) : "";
+    evalFiles[0]    = evalFile.empty() ? EvalFileDefaultNameBig : evalFile;
+    evalFiles[1]    = evalFileSmall.empty() ? EvalFileDefaultNameSmall : evalFileSmall;
+    maxThreads      = threadBudget;
+
+    networks.modify_and_replicate([this](NN::Networks& networks_) {
+        networks_.big.load(binaryDirectory, evalFiles[0]);
+        networks_.small.load(binaryDirectory, evalFiles[1]);
+    });
+}
+
+// First fit, or the longest free run when none is long enough. Without a budget
+// the slots grow, so that there is always a run of n at their end.
+std::pair<size_t, size_t> EngineHost::take_threads(size_t n) {
+    std::lock_guard<std::mutex> lk(mutex);
+
+    const size_t size = maxThreads ? maxThreads : usedSlots.size() + n;
+    usedSlots.resize(std::max(usedSlots.size(), size), false);
+
+    size_t first = 0, count = 0;
+
+    for (size_t i = 0; i < size && count < n;)
+    {
+        size_t end = i;
+        while (end < size && !usedSlots[end] && end - i < n)
+            ++end;
+
+        if (end - i > count)
+            first = i, count = end - i;
+
+        i = std::max(end, i + 1);
+    }
+
+    if (!count)
+        return {maxThreads, 0};
+
+    std::fill(usedSlots.begin() + first, usedSlots.begin() + first + count, true);
+    return {first, count};
+}
+
+void EngineHost::give_back_threads(std::pair<size_t, size_t> slots) {
+    std::lock_guard<std::mutex> lk(mutex);
+
+    std::fill(usedSlots.begin() + slots.first, usedSlots.begin() + slots.first + slots.second,
+              false);
+}
+
+Engine::Engine(std::optional<std::string> path) :
+    Engine(std::shared_ptr<EngineHost>(new EngineHost(EngineHost::Unloaded{})), path, true) {}
+
+Engine::Engine(std::shared_ptr<EngineHost> engineHost) :
+    Engine(engineHost, std::nullopt, false) {}
+
+Engine::Engine(std::shared_ptr<EngineHost> engineHost,
+               std::optional<std::string>  path,
+               bool                        isOwnHost) :
+    host(std::move(engineHost)),
+    ownHost(isOwnHost),
+    binaryDirectory(ownHost ? (path ? CommandLine::get_binary_directory(*path) : "")
+                            : host->binaryDirectory),
+    numaContext(host->numaContext),
+    states(new std::deque<StateInfo>(1)),
+    threads(),
+    networks(host->networks),
+    pinnedTables(host->pinnedTables) {
 
     pos.set(StartFEN, false, &states->back());
+    Tablebases::set_pinned(&pinnedTables);
+    threads.book = &book;
 
     options.add(  //
       "Debug Log File", Option("", [](const Option& o) {
@@ -74,11 +190,14 @@ Engine::Engine(std::optional<std::string> path) :
           return std::nullopt;
       }));
 
+    // "auto", "system", "hardware", "none", a list of processors per node as for
+    // NumaConfig::from_string(), or "l3" and "l3-net" to split the nodes by their
+    // L3 caches, see NumaConfig::from_system_l3()
     options.add(  //
       "NumaPolicy", Option("auto", [this](const Option& o) {
           set_numa_config_from_option(o);
-          return numa_config_information_as_string() + "\n"
-               + thread_allocation_information_as_string();
+          return host_information_as_string().value_or(numa_config_information_as_string() + "\n"
+                                                       + thread_allocation_information_as_string());
       }));
 
     options.add(  //
@@ -90,6 +209,74 @@ Engine::Engine(std::optional<std::string> path) :
     options.add(  //
       "Hash", Option(16, 1, MaxHashMB, [this](const Option& o) {
           set_tt_size(o);
+          return tt_allocation_information_as_string();
+      }));
+
+    options.add(  //
+      "HashNumaPolicy", Option("chunked", [this](const Option&) {
+          set_tt_size(options["Hash"]);
+          return tt_allocation_information_as_string();
+      }));
+
+    options.add(  //
+      "SharedHashName", Option("", [this](const Option&) {
+          set_tt_size(options["Hash"]);
+          return tt_allocation_information_as_string();
+      }));
+
+    options.add(  //
+      "CorrectionHistorySize", Option(0, 0, 65536, [this](const Option&) {
+          resize_threads();
+          return shared_history_information_as_string();
+      }));
+
+    options.add(  //
+      "PawnHistorySize", Option(0, 0, 65536, [this](const Option&) {
+          resize_threads();
+          return shared_history_information_as_string();
+      }));
+
+    // Per thread, in MB. Zero disables the cache.
+    options.add("Eval Cache", Option(0, 0, 1024));
+
+    // In microseconds, how long idle threads spin before sleeping. Zero sleeps at once.
+    options.add("Idle Spin", Option(0, 0, 100000));
+
+    // Generates only legal moves in the search, rather than checking each move
+    options.add("Legal Move Picker", Option(false));
+
+    // Sends positions whose small net eval would likely be redone to the big net
+    options.add("Eval Speculation", Option(false));
+
+    // Prints the share of each phase of the search after 'go', needs -DPHASE_PROFILER
+    if constexpr (Profiler::Enabled)
+        options.add("Phase Profiler", Option(false));
+
+    // Minimum depth of the TT writes exchanged in a distributed search
+    options.add("Cluster Depth", Option(12, 1, 240));
+
+    // A worker listens on the address, and serves the main engines with the secret.
+    // Without a secret there is no distributed search.
+    options.add("Cluster Address", Option("127.0.0.1"));
+    options.add("Cluster Secret", Option(""));
+
+    // Independent searches run with the 'job' command, see set_search_groups().
+    // A Group Hash of zero shares the main hash.
+    options.add(  //
+      "Search Groups", Option(0, 0, MaxThreads, [this](const Option&) {
+          resize_search_groups();
+          return std::nullopt;
+      }));
+
+    options.add(  //
+      "Group Threads", Option(1, 1, MaxThreads, [this](const Option&) {
+          resize_search_groups();
+          return std::nullopt;
+      }));
+
+    options.add(  //
+      "Group Hash", Option(0, 0, MaxHashMB, [this](const Option&) {
+          resize_search_groups();
           return std::nullopt;
       }));
 
@@ -102,13 +289,31 @@ Engine::Engine(std::optional<std::string> path) :
     options.add(  //
       "Ponder", Option(false));
 
+    // Replies pondered on, the expected one and the best others. See start_ponder_candidates().
+    options.add(  //
+      "Ponder Candidates", Option(1, 1, 8, [this](const Option&) {
+          resize_threads();
+          return std::nullopt;
+      }));
+
     options.add(  //
       "MultiPV", Option(1, 1, MAX_MOVES));
 
+    // Searches the PV lines side by side on their own threads, see Search::MultiPVLines
+    options.add("MultiPV Split", Option(false));
+
+    // Searches the iterations up to this depth with the threads together rather
+    // than with Lazy SMP, see Search::RootSplit
+    options.add("Root Split Depth", Option(0, 0, 30));
+
     options.add("Skill Level", Option(20, 0, 20));
 
     options.add("Move Overhead", Option(10, 0, 5000));
 
+    // Replaces Move Overhead, after the first move of a game, with what the clocks
+    // sent by the GUI show to be lost per move, see TimeManagement::calibrate()
+    options.add("Auto Move Overhead", Option(false));
+
     options.add("nodestime", Option(0, 0, 10000));
 
     options.add("UCI_Chess960", Option(false));
@@ -121,10 +326,41 @@ Engine::Engine(std::optional<std::string> path) :
 
     options.add("UCI_ShowWDL", Option(false));
 
+    // Keep back the PV reports closer than this many ms to the previous one, or
+    // the lines that have not changed since their last report. The PV at the end
+    // of the search is sent in any case.
+    options.add("PV Interval", Option(0, 0, 10000));
+
+    options.add("PV Changes Only", Option(false));
+
+    // Writes the statistics of the running search as JSON this often in ms, see
+    // Search::SearchManager::metrics()
+    options.add("Metrics Interval", Option(0, 0, 60000));
+
+    // An opening book written by the 'makebook' command, see Book::Mapping
+    options.add(  //
+      "Book File", Option("", [this](const Option& o) { return book.init(o); }));
+
+    // Plays a book move at once in a game, rather than searching it first
+    options.add("Book Instant", Option(true));
+
     options.add(  //
-      "SyzygyPath", Option("", [](const Option& o) {
+      "SyzygyPath", Option("", [this](const Option& o) -> std::optional<std::string> {
+          if (!ownHost)
+          {
+              std::lock_guard<std::mutex> lk(host->mutex);
+
+              if (host->syzygyPath == std::string(o))
+                  return std::nullopt;
+              if (!host->syzygyPath.empty())
+                  return "SyzygyPath is shared by the engines of the host, it stays "
+                       + host->syzygyPath;
+              host->syzygyPath = std::string(o);
+          }
+
           Tablebases::init(o);
-          return std::nullopt;
+          Tablebases::preload(options["SyzygyPreload"], options["SyzygyPreloadHugePages"]);
+          return pin_tablebases();
       }));
 
     options.add("SyzygyProbeDepth", Option(1, 1, 100));
@@ -133,25 +369,90 @@ Engine::Engine(std::optional<std::string> path) :
 
     options.add("SyzygyProbeLimit", Option(7, 0, 7));
 
+    // Tables read into memory in the background, as 6 for those of up to 6 pieces or
+    // a list such as "KQvK, KRPvKR"
+    options.add(  //
+      "SyzygyPreload", Option("", [this](const Option& o) -> std::optional<std::string> {
+          if (shared_tablebases_set())
+              return "SyzygyPreload of a shared host takes effect with its first SyzygyPath";
+
+          Tablebases::preload(o, options["SyzygyPreloadHugePages"]);
+          return std::nullopt;
+      }));
+
+    // Asks the kernel for huge pages for the preloaded tables, if the filesystem allows
+    options.add("SyzygyPreloadHugePages", Option(false));
+
+    // Probes in the search skip tables not yet in memory instead of waiting for the disk
+    options.add("SyzygyNonBlocking", Option(false));
+
+    // WDL tables held whole in memory on each NUMA node, in large pages when available,
+    // selected as for SyzygyPreload
+    options.add(  //
+      "SyzygyPin", Option("", [this](const Option&) -> std::optional<std::string> {
+          if (shared_tablebases_set())
+              return "SyzygyPin of a shared host takes effect with its first SyzygyPath";
+
+          return pin_tablebases();
+      }));
+
     options.add(  //
       "EvalFile", Option(EvalFileDefaultNameBig, [this](const Option& o) {
           load_big_network(o);
-          return std::nullopt;
+          return host_information_as_string();
       }));
 
     options.add(  //
       "EvalFileSmall", Option(EvalFileDefaultNameSmall, [this](const Option& o) {
           load_small_network(o);
-          return std::nullopt;
+          return host_information_as_string();
       }));
 
-    load_networks();
-    resize_threads();
+    // Evaluates every position with the small net, for more speed from less memory
+    // traffic at the cost of strength. The big net is then not loaded.
+    options.add(  //
+      "Small Net Only", Option(false, [this](const Option& o) {
+          if (o)
+              unload_big_network();
+          else
+              load_big_network(options["EvalFile"]);
+          return host_information_as_string();
+      }));
+
+    std::lock_guard<std::mutex> lock(loaderMutex);
+    loader = std::thread([this] {
+        loadingEngine = this;
+
+        if (ownHost)
+            load_networks();
+
+        resize_threads();
+    });
+}
+
+// Nothing to wait for on the loader itself, whose resize_threads() goes through here.
+// The first caller joins it under the lock, the others wait on the lock and then
+// only see the flag.
+void Engine::wait_for_loading() const {
+    if (loaded.load(std::memory_order_acquire) || loadingEngine == this)
+        return;
+
+    std::lock_guard<std::mutex> lock(loaderMutex);
+    if (loader.joinable())
+        loader.join();
+
+    loaded.store(true, std::memory_order_release);
 }
 
-std::uint64_t Engine::perft(const std::string& fen, Depth depth, bool isChess960) {
+std::uint64_t
+Engine::perft(const std::string& fen, Depth depth, bool isChess960, int threadCount, int hashMB) {
     verify_networks();
 
+    // The hash is bounded as that of the Hash option
+    if (threadCount > 1 || hashMB > 0)
+        return Benchmark::parallel_perft(fen, depth, isChess960, threads, size_t(threadCount),
+                                         size_t(std::clamp(hashMB, 0, MaxHashMB)));
+
     return Benchmark::perft(fen, depth, isChess960);
 }
 
@@ -159,62 +460,110 @@ void Engine::go(Search::LimitsType& limits) {
     assert(limits.perft == 0);
     verify_networks();
 
+    if (!limits.ponderMode && !link && limits.searchmoves.empty()
+        && continue_ponder_candidate(limits))
+        return;
+
+    stop_ponder_candidates(true);
+
+    if (link && link->is_main())
+        link->start_search(rootFen, rootMoves);
+
+    Tablebases::set_pinned(&pinnedTables);  // For the root probes on this thread
     threads.start_thinking(options, pos, states, limits);
+
+    if (limits.ponderMode)
+        start_ponder_candidates(limits);
+}
+
+void Engine::stop() {
+    threads.stop = true;
+
+    if (activePonderGroup >= 0)
+        ponderGroups[activePonderGroup]->threads.stop = true;
 }
-void Engine::stop() { threads.stop = true; }
 
 void Engine::search_clear() {
     wait_for_search_finished();
 
-    tt.clear(threads);
-    threads.clear();
+    threads.clear(&tt);
+
+    for (auto& group : groups)
+        group->threads.clear(group->tt != &tt ? group->tt : nullptr);
 
-    // @TODO wont work with multiple instances
-    Tablebases::init(options["SyzygyPath"]);  // Free mapped files
+    for (auto& group : ponderGroups)
+        group->threads.clear();
+
+    // Free mapped files, unless they were preloaded to stay in memory or other
+    // engines of the host may be searching with them
+    if (ownHost && std::string(options["SyzygyPreload"]).empty())
+        Tablebases::init(options["SyzygyPath"]);
 }
 
 void Engine::set_on_update_no_moves(std::function<void(const Engine::InfoShort&)>&& f) {
     updateContext.onUpdateNoMoves = std::move(f);
 }
 
+// The workers of a distributed search report each iteration to the main engine
 void Engine::set_on_update_full(std::function<void(const Engine::InfoFull&)>&& f) {
-    updateContext.onUpdateFull = std::move(f);
+    updateContext.onUpdateFull = [this, f = std::move(f)](const InfoFull& info) {
+        if (link && !link->is_main())
+            link->report(info.depth, info.nodes, info.pv);
+        f(info);
+    };
 }
 
 void Engine::set_on_iter(std::function<void(const Engine::InfoIter&)>&& f) {
     updateContext.onIter = std::move(f);
 }
 
+void Engine::set_on_metrics(std::function<void(std::string_view)>&& f) {
+    updateContext.onMetrics = std::move(f);
+}
+
+// The workers of a distributed search stop with the main engine
 void Engine::set_on_bestmove(std::function<void(std::string_view, std::string_view)>&& f) {
-    updateContext.onBestmove = std::move(f);
+    updateContext.onBestmove = [this, f = std::move(f)](std::string_view bm, std::string_view p) {
+        if (link)
+            link->stop_search();
+        f(bm, p);
+    };
 }
 
 void Engine::set_on_verify_networks(std::function<void(std::string_view)>&& f) {
     onVerifyNetworks = std::move(f);
 }
 
-void Engine::wait_for_search_finished() { threads.main_thread()->wait_for_search_finished(); }
+// The ponder candidates that are not the active search never finish by
+// themselves, so they are stopped here
+void Engine::wait_for_search_finished() {
+    wait_for_loading();
+    stop_ponder_candidates(false);
 
-void Engine::set_position(const std::string& fen, const std::vector<std::string>& moves) {
-    // Drop the old state and create a new one
-    states = StateListPtr(new std::deque<StateInfo>(1));
-    pos.set(fen, options["UCI_Chess960"], &states->back());
+    threads.main_thread()->wait_for_search_finished();
 
-    for (const auto& move : moves)
-    {
-        auto m = UCIEngine::to_move(pos, move);
+    for (auto& group : groups)
+        group->threads.main_thread()->wait_for_search_finished();
 
-        if (m == Move::none())
-            break;
+    for (auto& group : ponderGroups)
+        group->threads.main_thread()->wait_for_search_finished();
+}
 
-        states->emplace_back();
-        pos.do_move(m, states->back());
-    }
+void Engine::set_position(const std::string& fen, const std::vector<std::string>& moves) {
+    rootFen   = fen;
+    rootMoves = moves;
+
+    set_up_position(pos, states, fen, moves, options["UCI_Chess960"]);
 }
 
 // modifiers
 
 void Engine::set_numa_config_from_option(const std::string& o) {
+    wait_for_loading();
+
+    if (!ownHost)
+        return;
+
     if (o == "auto" || o == "system")
     {
         numaContext.set_numa_config(NumaConfig::from_system());
@@ -224,6 +573,10 @@ void Engine::set_numa_config_from_option(const std::string& o) {
         // Don't respect affinity set in the system.
         numaContext.set_numa_config(NumaConfig::from_system(false));
     }
+    else if (o == "l3" || o == "l3-net")
+    {
+        numaContext.set_numa_config(NumaConfig::from_system_l3(o == "l3-net"));
+    }
     else if (o == "none")
     {
         numaContext.set_numa_config(NumaConfig{});
@@ -239,27 +592,82 @@ void Engine::set_numa_config_from_option(const std::string& o) {
 }
 
 void Engine::resize_threads() {
+    wait_for_loading();
     threads.wait_for_search_finished();
-    threads.set(numaContext.get_numa_config(), {options, threads, tt, sharedHists, networks},
-                updateContext);
-
-    // Reallocate the hash with the new threadpool size
-    set_tt_size(options["Hash"]);
+    host->give_back_threads(threadSlots);
+    threadSlots = host->take_threads(size_t(options["Threads"]));
+    const size_t kept = threads.set(
+      numaContext.get_numa_config(), {options, threads, tt, sharedHists, networks, &pinnedTables},
+      updateContext, main_pool_threads(), threadSlots.first);
+
+    // Reallocate the hash with the new threadpool size, unless the pool only had
+    // threads added or removed at its end and the hash is where it was
+    if (!kept)
+        set_tt_size(options["Hash"]);
     threads.ensure_network_replicated();
+
+    resize_ponder_groups();
 }
 
 void Engine::set_tt_size(size_t mb) {
     wait_for_search_finished();
-    tt.resize(mb, threads);
+    tt.set_numa_interleave(std::string(options["HashNumaPolicy"]) == "interleave");
+    tt.resize(mb, threads, options["SharedHashName"]);
+}
+
+bool Engine::save_tt(const std::string& file) {
+    wait_for_search_finished();
+    return tt.save(file);
 }
 
-void Engine::set_ponderhit(bool b) { threads.main_manager()->ponder = b; }
+bool Engine::load_tt(const std::string& file) {
+    wait_for_search_finished();
+    return tt.load(file, threads);
+}
+
+void Engine::set_ponderhit(bool b) {
+    threads.main_manager()->ponder = b;
+
+    if (!b)
+        stop_ponder_candidates(false);
+}
+
+// Whether the tablebases of a shared host were set, see EngineHost::syzygyPath
+bool Engine::shared_tablebases_set() const {
+    if (ownHost)
+        return false;
+
+    std::lock_guard<std::mutex> lk(host->mutex);
+    return !host->syzygyPath.empty();
+}
 
 // network related
 
+std::optional<std::string> Engine::pin_tablebases() {
+    const TimePoint start = now();
+
+    pinnedTables = Tablebases::PinnedTables::load(options["SyzygyPin"]);
+
+    if (!pinnedTables->tables())
+        return std::nullopt;
+
+    size_t bytes = 0;
+    for (const auto& part : pinnedTables->memory())
+        bytes += part.second;
+
+    return "Pinned " + std::to_string(pinnedTables->tables()) + " WDL tablebases, "
+         + std::to_string(bytes >> 20) + " MB on each NUMA node, in "
+         + std::to_string(now() - start) + " ms";
+}
+
 void Engine::verify_networks() const {
-    networks->big.verify(options["EvalFile"], onVerifyNetworks);
-    networks->small.verify(options["EvalFileSmall"], onVerifyNetworks);
+    wait_for_loading();
+
+    if (!options["Small Net Only"])
+        networks->big.verify(ownHost ? std::string(options["EvalFile"]) : host->evalFiles[0],
+                             onVerifyNetworks);
+    networks->small.verify(ownHost ? std::string(options["EvalFileSmall"]) : host->evalFiles[1],
+                           onVerifyNetworks);
 
     auto statuses = networks.get_status_and_errors();
     for (size_t i = 0; i < statuses.size(); ++i)
@@ -293,8 +701,12 @@ void Engine::verify_networks() const {
 }
 
 void Engine::load_networks() {
+    if (!ownHost)
+        return;
+
     networks.modify_and_replicate([this](NN::Networks& networks_) {
-        networks_.big.load(binaryDirectory, options["EvalFile"]);
+        if (!options["Small Net Only"])
+            networks_.big.load(binaryDirectory, options["EvalFile"]);
         networks_.small.load(binaryDirectory, options["EvalFileSmall"]);
     });
     threads.clear();
@@ -302,13 +714,35 @@ void Engine::load_networks() {
 }
 
 void Engine::load_big_network(const std::string& file) {
+    if (!ownHost || options["Small Net Only"])
+        return;
+
     networks.modify_and_replicate(
       [this, &file](NN::Networks& networks_) { networks_.big.load(binaryDirectory, file); });
     threads.clear();
     threads.ensure_network_replicated();
 }
 
+// Puts back the big net as it is before loading, so that its file is read again
+// when it is next needed. Networks of a shared host are left to it.
+void Engine::unload_big_network() {
+    if (!ownHost)
+        return;
+
+    // Heap-allocate because sizeof(NN::NetworkBig) is large
+    auto unloaded = std::make_unique<NN::NetworkBig>(
+      NN::EvalFile{EvalFileDefaultNameBig, "None", ""}, NN::EmbeddedNNUEType::BIG);
+
+    networks.modify_and_replicate(
+      [&unloaded](NN::Networks& networks_) { networks_.big = std::move(*unloaded); });
+    threads.clear();
+    threads.ensure_network_replicated();
+}
+
 void Engine::load_small_network(const std::string& file) {
+    if (!ownHost)
+        return;
+
     networks.modify_and_replicate(
       [this, &file](NN::Networks& networks_) { networks_.small.load(binaryDirectory, file); });
     threads.clear();
@@ -322,6 +756,16 @@ void Engine::save_network(const std::pair<std::optional<std::string>, std::strin
     });
 }
 
+bool Engine::save_network_images(const std::string& bigFile, const std::string& smallFile) const {
+    if (bigFile.empty())
+        return false;
+
+    verify_networks();
+
+    return networks->big.save_image(bigFile)
+        && (smallFile.empty() || networks->small.save_image(smallFile));
+}
+
 // utility functions
 
 void Engine::trace_eval() const {
@@ -331,7 +775,82 @@ void Engine::trace_eval() const {
 
     verify_networks();
 
-    sync_cout << "\n" << Eval::trace(p, *networks) << sync_endl;
+    sync_cout << "\n" << Eval::trace(p, *networks, options["Small Net Only"]) << sync_endl;
+}
+
+std::vector<std::optional<int>> Engine::evaluate_batch(const std::vector<std::string>& fens) const {
+    const bool chess960 = options["UCI_Chess960"];
+
+    return evaluate_batch(fens.size(), [&](size_t i, Position& p, StateInfo* si) {
+        p.set(fens[i], chess960, si);
+    });
+}
+
+std::vector<std::optional<int>>
+Engine::evaluate_batch(const std::vector<PackedPosition>& packed) const {
+    const bool chess960 = options["UCI_Chess960"];
+
+    return evaluate_batch(packed.size(), [&](size_t i, Position& p, StateInfo* si) {
+        p.set(packed[i], chess960, si);
+    });
+}
+
+std::vector<std::optional<int>>
+Engine::evaluate_batch(size_t                                                    count,
+                       const std::function<void(size_t, Position&, StateInfo*)>& setUp) const {
+    std::deque<StateInfo>        batchStates(count);
+    std::vector<Position>        batch(count);
+    std::vector<const Position*> positions;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        setUp(i, batch[i], &batchStates[i]);
+        positions.push_back(&batch[i]);
+    }
+
+    verify_networks();
+
+    auto accumulators = std::make_unique<Eval::NNUE::AccumulatorStack>();
+    auto caches       = std::make_unique<Eval::NNUE::AccumulatorCaches>(*networks);
+    auto values =
+      Eval::evaluate_batch(*networks, positions, *accumulators, *caches, options["Small Net Only"]);
+
+    std::vector<std::optional<int>> cps(count);
+
+    for (std::size_t i = 0; i < count; ++i)
+        if (values[i] != VALUE_NONE)
+            cps[i] = UCIEngine::to_cp(batch[i].side_to_move() == WHITE ? values[i] : -values[i],
+                                      batch[i]);
+
+    return cps;
+}
+
+// Times the NNUE layers on the default bench positions
+std::string Engine::benchmark_nnue() const {
+    const auto fens = Benchmark::default_fens();
+
+    std::deque<StateInfo>        batchStates(fens.size());
+    std::unique_ptr<Position[]>  batch(new Position[fens.size()]);
+    std::vector<const Position*> positions;
+
+    for (std::size_t i = 0; i < fens.size(); ++i)
+    {
+        batch[i].set(fens[i], false, &batchStates[i]);
+        positions.push_back(&batch[i]);
+    }
+
+    verify_networks();
+
+    auto accumulators = std::make_unique<Eval::NNUE::AccumulatorStack>();
+    auto caches       = std::make_unique<Eval::NNUE::AccumulatorCaches>(*networks);
+
+    // With "Small Net Only" the big net is not loaded, and not timed
+    const std::string small =
+      networks->small.benchmark_layers(positions, *accumulators, caches->small);
+    if (options["Small Net Only"])
+        return small;
+
+    return networks->big.benchmark_layers(positions, *accumulators, caches->big) + "\n\n" + small;
 }
 
 const OptionsMap& Engine::get_options() const { return options; }
@@ -349,6 +868,632 @@ std::string Engine::visualize() const {
 
 int Engine::get_hashfull(int maxAge) const { return tt.hashfull(maxAge); }
 
+std::string Engine::get_tt_stats() const { return tt.stats(); }
+
+std::string Engine::get_refresh_stats() const { return Eval::NNUE::refresh_stats(); }
+
+// The search counters of all threads since startup or the last clear
+std::string Engine::get_search_counters() const {
+#ifdef SEARCH_COUNTERS
+    return Search::format_counters(threads.search_counters());
+#else
+    return "";
+#endif
+}
+
+void Engine::clear_search_counters() {
+#ifdef SEARCH_COUNTERS
+    wait_for_search_finished();
+    threads.clear_search_counters();
+#endif
+}
+
+std::string Engine::get_eval_cache_stats() const {
+    const auto [hits, probes] = threads.eval_cache_stats();
+    if (!probes)
+        return "";
+
+    std::stringstream ss;
+    ss << "Eval cache: " << probes << " probes, " << hits << " hits (" << std::fixed
+       << std::setprecision(2) << 100.0 * hits / probes << "%)";
+    return ss.str();
+}
+
+std::string Engine::get_tb_cache_stats() const {
+    const auto [hits, probes] = threads.tb_cache_stats();
+    if (!probes)
+        return "";
+
+    std::stringstream ss;
+    ss << "Tablebase cache: " << probes << " probes, " << hits << " hits (" << std::fixed
+       << std::setprecision(2) << 100.0 * hits / probes << "%)";
+    return ss.str();
+}
+
+std::string Engine::get_net_choice_stats() const {
+    const Eval::NetChoice nc    = threads.net_choice_stats();
+    const uint64_t        evals = nc.smallEvals + nc.bigEvals - nc.doubleEvals;
+    if (!evals)
+        return "";
+
+    std::stringstream ss;
+    ss << "Net evaluations: " << evals << " positions, " << nc.smallEvals << " small, "
+       << nc.bigEvals << " big, " << nc.doubleEvals << " both (" << std::fixed
+       << std::setprecision(2) << 100.0 * nc.doubleEvals / evals << "%), " << nc.speculated
+       << " speculated";
+
+    // The resident weights of the nets the evaluation reads, its working set, of
+    // the replica of this thread. The big net keeps its memory with "Small Net Only".
+    const bool   smallOnly = options["Small Net Only"];
+    const size_t bytes =
+      residency(&networks->small, sizeof(networks->small)).resident
+      + (smallOnly ? 0 : residency(&networks->big, sizeof(networks->big)).resident);
+    ss << "\nEvaluation working set: " << (bytes >> 20) << " MB of resident weights, "
+       << (smallOnly ? "small net only" : "big and small nets");
+    return ss.str();
+}
+
+// Replaces the search groups by 'count' new ones. Each group is a pool of
+// 'threadsPerGroup' threads with its own position, search manager and shared
+// histories, which searches independently of the main pool and of the other
+// groups. The networks are shared, and so is the main TT unless 'hashMb' gives
+// every group a table of its own. Each group takes its threads from the host as
+// the main pool does, so that it gets its own slice of the machine, after the
+// main pool and the other engines.
+void Engine::set_search_groups(size_t count, size_t threadsPerGroup, size_t hashMb) {
+    wait_for_search_finished();
+    clear_search_groups();
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto group           = std::make_unique<SearchGroup>();
+        group->tt            = hashMb ? &group->ownTT : &tt;
+        group->updateContext = group_update_context(i);
+        group->threadSlots   = host->take_threads(threadsPerGroup);
+        group->threads.set(numaContext.get_numa_config(),
+                           {options, group->threads, *group->tt, group->sharedHists, networks,
+                            &pinnedTables},
+                           group->updateContext, std::max<size_t>(1, group->threadSlots.second),
+                           group->threadSlots.first);
+        group->threads.ownsTT = hashMb != 0;
+        group->threads.book   = &book;
+
+        if (hashMb)
+            group->tt->resize(hashMb, group->threads);
+
+        group->threads.ensure_network_replicated();
+        group->states = StateListPtr(new std::deque<StateInfo>(1));
+        group->pos.set(StartFEN, false, &group->states->back());
+        groups.push_back(std::move(group));
+    }
+}
+
+void Engine::clear_search_groups() {
+    for (auto& group : groups)
+        host->give_back_threads(group->threadSlots);
+    groups.clear();
+}
+
+void Engine::resize_search_groups() {
+    set_search_groups(size_t(options["Search Groups"]), size_t(options["Group Threads"]),
+                      size_t(options["Group Hash"]));
+}
+
+size_t Engine::search_groups() const { return groups.size(); }
+
+void Engine::set_group_position(size_t                          group,
+                                const std::string&              fen,
+                                const std::vector<std::string>& moves) {
+    assert(group < groups.size());
+    SearchGroup& g = *groups[group];
+
+    g.threads.main_thread()->wait_for_search_finished();
+    set_up_position(g.pos, g.states, fen, moves, options["UCI_Chess960"]);
+}
+
+// Non blocking, like go(). Pondering is not supported in a group.
+void Engine::go_group(size_t group, Search::LimitsType& limits) {
+    assert(group < groups.size());
+    assert(limits.perft == 0);
+    verify_networks();
+
+    SearchGroup& g    = *groups[group];
+    limits.ponderMode = false;
+    g.threads.start_thinking(options, g.pos, g.states, limits);
+}
+
+void Engine::stop_group(size_t group) {
+    assert(group < groups.size());
+    groups[group]->threads.stop = true;
+}
+
+void Engine::wait_for_group(size_t group) {
+    assert(group < groups.size());
+    groups[group]->threads.main_thread()->wait_for_search_finished();
+}
+
+// Runs the positions on pools of one thread each, built like the search groups.
+// Lazy SMP gains little from more threads at small node counts, while searching
+// several positions side by side scales with the threads. A pool that finishes
+// takes the next position at once, and results that come early wait for those
+// before them. Each pool has a hash of hashMb, or shares the main one when zero,
+// which then starts one new generation for the whole run. The pools take their
+// threads from the host as the search groups do, sharing them out when the host
+// has fewer left than threadCount.
+void Engine::analyse(const std::function<bool(Position&, StateInfo*)>& next,
+                     Search::LimitsType                                limits,
+                     size_t                                            threadCount,
+                     size_t                                            hashMb,
+                     const std::function<void(const AnalysisResult&)>& onResult) {
+    assert(limits.perft == 0);
+    wait_for_search_finished();
+    verify_networks();
+
+    limits.ponderMode = false;
+
+    std::vector<std::unique_ptr<SearchGroup>> pools;
+    std::vector<AnalysisResult>               results(threadCount);
+    std::map<size_t, AnalysisResult>          waiting;
+    std::vector<size_t>                       finished;
+    std::mutex                                mutex;
+    std::condition_variable                   cv;
+
+    const auto slots = host->take_threads(threadCount);
+
+    if (!hashMb)
+        tt.new_search();
+
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        auto  pool = std::make_unique<SearchGroup>();
+        auto& r    = results[i];
+
+        pool->tt            = hashMb ? &pool->ownTT : &tt;
+        pool->updateContext = {[&r](const InfoShort& info) { r.score = info.score; },
+                               [&r](const InfoFull& info) {
+                                   r.depth = info.depth;
+                                   r.score = info.score;
+                                   r.pv    = info.pv;
+                               },
+                               [](const InfoIter&) {},
+                               [&, i](std::string_view bestmove, std::string_view) {
+                                   r.bestmove = bestmove;
+                                   r.nodes    = pools[i]->threads.nodes_searched();
+
+                                   std::lock_guard<std::mutex> lk(mutex);
+                                   finished.push_back(i);
+                                   cv.notify_one();
+                               },
+                               nullptr};
+        pool->threads.set(numaContext.get_numa_config(),
+                          {options, pool->threads, *pool->tt, pool->sharedHists, networks,
+                           &pinnedTables},
+                          pool->updateContext, 1,
+                          slots.first + i % std::max<size_t>(1, slots.second));
+        pool->threads.ownsTT = hashMb != 0;
+
+        if (hashMb)
+            pool->tt->resize(hashMb, pool->threads);
+
+        pool->threads.ensure_network_replicated();
+        pools.push_back(std::move(pool));
+    }
+
+    size_t read = 0, running = 0, written = 0;
+    bool   more = true;
+
+    auto start = [&](size_t i) {
+        SearchGroup& pool = *pools[i];
+
+        if (!more)
+            return;
+
+        pool.threads.main_thread()->wait_for_search_finished();
+        pool.states = StateListPtr(new std::deque<StateInfo>(1));
+
+        if (!(more = next(pool.pos, &pool.states->back())))
+            return;
+
+        results[i]          = AnalysisResult();
+        results[i].index    = read++;
+        results[i].position = pool.pos.pack();
+        limits.startTime = now();
+        pool.threads.start_thinking(options, pool.pos, pool.states, limits);
+        ++running;
+    };
+
+    for (size_t i = 0; i < threadCount; ++i)
+        start(i);
+
+    while (running)
+    {
+        size_t i;
+        {
+            std::unique_lock<std::mutex> lk(mutex);
+            cv.wait(lk, [&] { return !finished.empty(); });
+            i = finished.back();
+            finished.pop_back();
+        }
+
+        --running;
+        pools[i]->threads.main_thread()->wait_for_search_finished();
+        waiting.emplace(results[i].index, std::move(results[i]));
+        start(i);
+
+        for (auto it = waiting.find(written); it != waiting.end(); it = waiting.find(++written))
+        {
+            onResult(it->second);
+            waiting.erase(it);
+        }
+    }
+
+    pools.clear();
+    host->give_back_threads(slots);
+}
+
+Datagen::Stats Engine::datagen(const Datagen::Params& params, std::ostream& out) {
+    wait_for_search_finished();
+    verify_networks();
+
+    Search::LimitsType limits;
+    limits.nodes = params.nodes;
+
+    std::vector<std::unique_ptr<SearchGroup>> pools;
+    std::deque<Datagen::Game>                 games;  // Not movable, as Position is not
+    std::vector<std::optional<Score>>         scores(params.threads);
+    std::vector<std::string>                  bestmoves(params.threads);
+    std::vector<size_t>                       finished;
+    std::mutex                                mutex;
+    std::condition_variable                   cv;
+
+    // Taken from the host as for analyse()
+    const auto slots = host->take_threads(params.threads);
+
+    for (size_t i = 0; i < params.threads; ++i)
+    {
+        auto pool = std::make_unique<SearchGroup>();
+
+        pool->tt            = &pool->ownTT;
+        pool->updateContext = {[](const InfoShort&) {},
+                               [&, i](const InfoFull& info) { scores[i] = info.score; },
+                               [](const InfoIter&) {},
+                               [&, i](std::string_view bestmove, std::string_view) {
+                                   bestmoves[i] = bestmove;
+
+                                   std::lock_guard<std::mutex> lk(mutex);
+                                   finished.push_back(i);
+                                   cv.notify_one();
+                               },
+                               nullptr};
+        pool->threads.set(numaContext.get_numa_config(),
+                          {options, pool->threads, *pool->tt, pool->sharedHists, networks,
+                           &pinnedTables},
+                          pool->updateContext, 1,
+                          slots.first + i % std::max<size_t>(1, slots.second));
+        pool->tt->resize(params.hashMb, pool->threads);
+        pool->threads.ensure_network_replicated();
+        pools.push_back(std::move(pool));
+        games.emplace_back(params.seed * 0x9E3779B97F4A7C15ULL + i + 1);
+    }
+
+    StateInfo startState;
+    Position  startPos;
+    const PackedPosition startRoot = startPos.set(StartFEN, false, &startState).pack();
+
+    // The root of the next game, from the openings when there are any
+    auto nextRoot = [&]() {
+        PackedPosition pp;
+
+        for (int pass = 0; params.openings && pass < 2; ++pass)
+        {
+            if (params.openings->read(reinterpret_cast<char*>(&pp), sizeof(pp)))
+                return pp;
+
+            params.openings->clear();
+            params.openings->seekg(0);
+        }
+
+        return startRoot;
+    };
+
+    Datagen::Stats stats;
+    size_t         started = 0, running = 0;
+
+    // Writes out the game of pool i while it is over, and starts a new one
+    // while any are left, then searches the position of the game
+    auto next = [&](size_t i) {
+        Datagen::Game& game = games[i];
+        SearchGroup&   pool = *pools[i];
+
+        for (int wdl; (wdl = game.result(params.maxPlies)) >= 0;)
+        {
+            stats.positions += game.write(out, uint8_t(wdl));
+            ++stats.games;
+            ++stats.results[wdl];
+
+            if (started == params.games)
+                return;
+
+            ++started;
+            game.start(nextRoot(), params.randomPlies);
+            pool.threads.clear(pool.tt);
+        }
+
+        game.set_up(pool.pos, pool.states);
+        scores[i]        = std::nullopt;
+        limits.startTime = now();
+        pool.threads.start_thinking(options, pool.pos, pool.states, limits);
+        ++running;
+    };
+
+    for (size_t i = 0; i < params.threads && started < params.games; ++i)
+    {
+        ++started;
+        games[i].start(nextRoot(), params.randomPlies);
+        pools[i]->threads.clear(pools[i]->tt);
+        next(i);
+    }
+
+    while (running)
+    {
+        size_t i;
+        {
+            std::unique_lock<std::mutex> lk(mutex);
+            cv.wait(lk, [&] { return !finished.empty(); });
+            i = finished.back();
+            finished.pop_back();
+        }
+
+        --running;
+        pools[i]->threads.main_thread()->wait_for_search_finished();
+        games[i].play(UCIEngine::to_move(games[i].position(), bestmoves[i]), scores[i]);
+        next(i);
+    }
+
+    pools.clear();
+    host->give_back_threads(slots);
+    return stats;
+}
+
+// Turns this engine into a worker of a distributed search, searching for the
+// main engine that connects to the port
+bool Engine::cluster_serve(std::uint16_t           port,
+                           Distributed::Link::OnGo   onGo,
+                           Distributed::Link::OnStop onStop) {
+    cluster_close();
+    tt.set_export_depth(Depth(int(options["Cluster Depth"])));
+
+    link = std::make_unique<Distributed::Link>(threads, tt, onClusterInfo);
+    if (link->serve(options["Cluster Address"], port, options["Cluster Secret"], std::move(onGo),
+                    std::move(onStop)))
+        return true;
+
+    cluster_close();
+    return false;
+}
+
+// Makes this engine the main one of a distributed search with the given workers
+bool Engine::cluster_connect(const std::vector<std::string>& workers) {
+    cluster_close();
+    tt.set_export_depth(Depth(int(options["Cluster Depth"])));
+
+    link = std::make_unique<Distributed::Link>(threads, tt, onClusterInfo);
+    if (link->connect(workers, options["Cluster Secret"]))
+        return true;
+
+    cluster_close();
+    return false;
+}
+
+void Engine::cluster_close() {
+    wait_for_search_finished();
+    link.reset();
+    tt.set_export_depth(0);
+}
+
+std::string Engine::cluster_status() const {
+    return link ? link->status() : "Distributed search: off";
+}
+
+void Engine::set_on_cluster_info(std::function<void(std::string_view)>&& f) {
+    onClusterInfo = std::move(f);
+}
+
+// Takes effect on the next set_search_groups()
+void Engine::set_group_listeners(
+  std::function<Search::SearchManager::UpdateContext(size_t)>&& f) {
+    groupListeners = std::move(f);
+}
+
+// The listeners of a group, doing nothing for those that were not given
+Search::SearchManager::UpdateContext Engine::group_update_context(size_t group) const {
+    Search::SearchManager::UpdateContext ctx;
+
+    if (groupListeners)
+        ctx = groupListeners(group);
+
+    if (!ctx.onUpdateNoMoves)
+        ctx.onUpdateNoMoves = [](const InfoShort&) {};
+    if (!ctx.onUpdateFull)
+        ctx.onUpdateFull = [](const InfoFull&) {};
+    if (!ctx.onIter)
+        ctx.onIter = [](const InfoIter&) {};
+    if (!ctx.onBestmove)
+        ctx.onBestmove = [](std::string_view, std::string_view) {};
+
+    return ctx;
+}
+
+// With "Ponder Candidates" at K, the threads are split into the main pool and
+// K - 1 pools of Threads / K threads each, which ponder on other replies than
+// the expected one. There are at most Threads - 1 of them. They share the main
+// TT, and are bound to the threads after those of the main pool.
+std::pair<size_t, size_t> Engine::ponder_group_split() const {
+    const size_t total      = std::max<size_t>(1, threadSlots.second);
+    const size_t candidates = std::min(size_t(options["Ponder Candidates"]), total);
+
+    return {candidates - 1, total / candidates};
+}
+
+size_t Engine::main_pool_threads() const {
+    const auto [groupCount, count] = ponder_group_split();
+    return std::max<size_t>(1, threadSlots.second) - groupCount * count;
+}
+
+void Engine::resize_ponder_groups() {
+    wait_for_search_finished();
+    ponderGroups.clear();
+
+    const auto [groupCount, count] = ponder_group_split();
+    const size_t mainCount         = main_pool_threads();
+
+    for (size_t i = 0; i < groupCount; ++i)
+    {
+        auto group           = std::make_unique<SearchGroup>();
+        group->tt            = &tt;
+        group->updateContext = ponder_update_context(*group);
+        group->threads.set(numaContext.get_numa_config(),
+                           {options, group->threads, tt, group->sharedHists, networks,
+                            &pinnedTables},
+                           group->updateContext, count,
+                           threadSlots.first + mainCount + i * count);
+        group->threads.ownsTT = false;
+        group->threads.book   = &book;
+        group->threads.ensure_network_replicated();
+        group->states = StateListPtr(new std::deque<StateInfo>(1));
+        group->pos.set(StartFEN, false, &group->states->back());
+        ponderGroups.push_back(std::move(group));
+    }
+}
+
+// Called on 'go ponder', when the main pool searches the position after the
+// expected reply. The other replies of the opponent are ranked by their scores
+// in the TT, and the best ones within PonderCandidateMargin of the best reply
+// are searched by the ponder groups, as ponder searches of their own. Without a
+// TT entry a reply is not considered.
+void Engine::start_ponder_candidates(const Search::LimitsType& limits) {
+    if (ponderGroups.empty() || rootMoves.empty())
+        return;
+
+    const bool               chess960 = options["UCI_Chess960"];
+    std::vector<std::string> moves(rootMoves.begin(), rootMoves.end() - 1);
+    StateListPtr             parentStates;
+    Position                 parent;
+    set_up_position(parent, parentStates, rootFen, moves, chess960);
+
+    std::vector<std::pair<Value, std::string>> replies;
+    for (const auto& m : MoveList<LEGAL>(parent))
+    {
+        std::string uciMove = UCIEngine::move(m, chess960);
+        if (uciMove == rootMoves.back())
+            continue;
+
+        // The entry is from our point of view, after the reply
+        auto [ttHit, ttData, ttWriter] = tt.probe(parent.key_after(m));
+        if (ttHit && is_valid(ttData.value))
+            replies.emplace_back(-ttData.value, uciMove);
+    }
+
+    std::stable_sort(replies.begin(), replies.end(),
+                     [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    for (size_t i = 0; i < replies.size() && i < ponderGroups.size(); ++i)
+    {
+        if (replies[i].first < replies[0].first - PonderCandidateMargin)
+            break;
+
+        SearchGroup& g = *ponderGroups[i];
+        moves.push_back(replies[i].second);
+        set_up_position(g.pos, g.states, rootFen, moves, chess960);
+        moves.pop_back();
+
+        g.forward   = false;
+        g.pondering = true;
+        g.threads.start_thinking(options, g.pos, g.states, limits);
+    }
+}
+
+// Called on a 'go' after a ponder miss. If a ponder group has been searching the
+// position that was played, its search goes on as the real one with the limits
+// of the 'go', as if it had got a 'ponderhit', with its output now sent to the
+// main listeners.
+bool Engine::continue_ponder_candidate(const Search::LimitsType& limits) {
+    for (size_t i = 0; i < ponderGroups.size(); ++i)
+    {
+        SearchGroup& g = *ponderGroups[i];
+
+        if (g.pondering && g.pos.key() == pos.key() && g.pos.fen() == pos.fen())
+        {
+            g.forward = true;
+            g.threads.main_manager()->continue_with(limits);
+            activePonderGroup = int(i);
+            stop_ponder_candidates(false);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Engine::stop_ponder_candidates(bool includingActive) {
+    for (size_t i = 0; i < ponderGroups.size(); ++i)
+    {
+        SearchGroup& g = *ponderGroups[i];
+
+        if (int(i) == activePonderGroup && !includingActive)
+            continue;
+
+        g.threads.stop = true;
+        g.pondering    = false;
+    }
+
+    if (includingActive && activePonderGroup >= 0)
+    {
+        ponderGroups[activePonderGroup]->threads.main_thread()->wait_for_search_finished();
+        ponderGroups[activePonderGroup]->forward = false;
+        activePonderGroup                        = -1;
+    }
+}
+
+// Silent, unless the group has become the real search
+Search::SearchManager::UpdateContext
+Engine::ponder_update_context(const SearchGroup& group) const {
+    Search::SearchManager::UpdateContext ctx;
+    const SearchGroup*                   g = &group;
+
+    ctx.onUpdateNoMoves = [this, g](const InfoShort& info) {
+        if (g->forward)
+            updateContext.onUpdateNoMoves(info);
+    };
+    ctx.onUpdateFull = [this, g](const InfoFull& info) {
+        if (g->forward)
+            updateContext.onUpdateFull(info);
+    };
+    ctx.onIter = [this, g](const InfoIter& info) {
+        if (g->forward)
+            updateContext.onIter(info);
+    };
+    ctx.onBestmove = [this, g](std::string_view bestmove, std::string_view ponder) {
+        if (g->forward)
+            updateContext.onBestmove(bestmove, ponder);
+    };
+
+    return ctx;
+}
+
+std::string Engine::get_latency_stats() const {
+    const uint64_t starts = threads.starts, stops = threads.stops;
+    if (!starts || !stops)
+        return "";
+
+    std::stringstream ss;
+    ss << "Thread latency: start " << std::fixed << std::setprecision(1)
+       << threads.startLatency / 1000.0 / starts << " us avg over " << starts
+       << " thread starts, stop " << threads.stopLatency / 1000.0 / stops << " us avg over "
+       << stops << " searches";
+    return ss.str();
+}
+
 std::vector<std::pair<size_t, size_t>> Engine::get_bound_thread_count_by_numa_node() const {
     auto                                   counts = threads.get_bound_thread_count_by_numa_node();
     const NumaConfig&                      cfg    = numaContext.get_numa_config();
@@ -366,6 +1511,13 @@ std::string Engine::get_numa_config_as_string() const {
     return numaContext.get_numa_config().to_string();
 }
 
+std::optional<std::string> Engine::host_information_as_string() const {
+    if (ownHost)
+        return std::nullopt;
+
+    return "The networks and the NUMA policy of an engine on a shared host are those of the host";
+}
+
 std::string Engine::numa_config_information_as_string() const {
     auto cfgStr = get_numa_config_as_string();
     return "Available processors: " + cfgStr;
@@ -396,6 +1548,10 @@ std::string Engine::thread_allocation_information_as_string() const {
     size_t threadsSize = threads.size();
     ss << "Using " << threadsSize << (threadsSize > 1 ? " threads" : " thread");
 
+    if (threadSlots.second < size_t(options["Threads"]))
+        ss << " of the " << size_t(options["Threads"]) << " asked, as the host budget of "
+           << host->maxThreads << " allows";
+
     auto boundThreadsByNodeStr = thread_binding_information_as_string();
     if (boundThreadsByNodeStr.empty())
         return ss.str();
@@ -405,4 +1561,231 @@ std::string Engine::thread_allocation_information_as_string() const {
 
     return ss.str();
 }
+
+// Describes the explicit large pages backing an allocation, if any
+static std::string page_size_information(size_t pageSize) {
+    if (!pageSize)
+        return "";
+
+    return pageSize >= (size_t(1) << 30) ? " on " + std::to_string(pageSize >> 30) + "GB pages"
+                                         : " on " + std::to_string(pageSize >> 20) + "MB pages";
+}
+
+std::string Engine::shared_history_information_as_string() const {
+    std::stringstream ss;
+    bool              isFirst = true;
+
+    for (auto&& [node, hists] : sharedHists)
+    {
+        const auto& corr = hists.correctionHistory;
+        const auto& pawn = hists.pawnHistory;
+
+        if (!isFirst)
+            ss << "\n";
+        ss << "Using shared histories on NUMA node " << node << ": correction "
+           << (corr.size_bytes() >> 20) << "MB" << page_size_information(corr.page_size())
+           << ", pawn " << (pawn.size_bytes() >> 20) << "MB"
+           << page_size_information(pawn.page_size());
+        isFirst = false;
+    }
+
+    return ss.str();
+}
+
+namespace {
+
+// Builds the table of get_memory_report(), one line per allocation
+class MemoryReport {
+   public:
+    // Parts of an allocation are listed but not counted in the total. A page kind
+    // given by the caller, as for shared memory, replaces the one found.
+    void add(const std::string& name,
+             const void*        mem,
+             size_t             size,
+             bool               counted = true,
+             const std::string& pageKind = "") {
+        Residency r = residency(mem, size);
+        line(name, size, r.resident, pageKind.empty() ? pages(mem, size, r) : pageKind);
+
+        if (counted)
+        {
+            total += size;
+            totalResident += r.resident;
+        }
+    }
+
+    // Without a page kind, that of the first part is shown
+    void add_files(const std::string&                                 name,
+                   const std::vector<std::pair<const void*, size_t>>& files,
+                   const std::string&                                 pageKind = "file mappings") {
+        size_t size = 0, resident = 0;
+        for (const auto& [mem, bytes] : files)
+        {
+            size += bytes;
+            resident += residency(mem, bytes).resident;
+        }
+
+        line(name, size, resident,
+             !pageKind.empty() || files.empty()
+               ? pageKind
+               : pages(files[0].first, files[0].second,
+                       residency(files[0].first, files[0].second)));
+        total += size;
+        totalResident += resident;
+    }
+
+    std::string str() {
+        line("total", total, totalResident, "");
+
+        std::stringstream header;
+        header << std::left << std::setw(40) << "Memory use in MB" << std::right << std::setw(10)
+               << "allocated" << std::setw(10) << "resident" << "  pages";
+        return header.str() + ss.str();
+    }
+
+   private:
+    void line(const std::string& name, size_t size, size_t resident, const std::string& kind) {
+        ss << "\n"
+           << std::left << std::setw(40) << name << std::right << std::setw(10) << mb(size)
+           << std::setw(10) << mb(resident) << (kind.empty() ? "" : "  " + kind);
+    }
+
+    static std::string mb(size_t bytes) {
+        std::stringstream s;
+        s << std::fixed << std::setprecision(1) << double(bytes) / (1 << 20);
+        return s.str();
+    }
+
+    static std::string pages(const void* mem, size_t size, Residency r) {
+        if (size_t pageSize = large_page_size(mem))
+            return pageSize >= (size_t(1) << 30) ? std::to_string(pageSize >> 30) + "GB pages"
+                                                 : std::to_string(pageSize >> 20) + "MB pages";
+
+        if (r.transparentHuge)
+            return "transparent huge pages, " + std::to_string(100 * r.transparentHuge / size)
+                 + "%";
+
+        return size ? "normal pages" : "";
+    }
+
+    std::stringstream ss;
+    size_t            total = 0, totalResident = 0;
+};
+
+}
+
+// Covers the TTs, network replicas, shared histories and workers of the main pool
+// and of the search groups, and the mapped Syzygy files. Smaller allocations and
+// the binary itself are not counted.
+std::string Engine::get_memory_report() const {
+    MemoryReport report;
+
+    auto addTT = [&](const std::string& name, const TranspositionTable& table) {
+        report.add(name, table.address(), table.size_bytes(), true,
+                   table.is_shared() ? "shared memory" : "");
+    };
+
+    auto addPool = [&](const std::string&                          prefix,
+                       const ThreadPool&                           pool,
+                       const std::map<NumaIndex, SharedHistories>& hists) {
+        for (auto&& [node, h] : hists)
+        {
+            const std::string onNode = ", node " + std::to_string(node);
+            report.add(prefix + "correction history" + onNode, h.correctionHistory.address(),
+                       h.correctionHistory.size_bytes());
+            report.add(prefix + "pawn history" + onNode, h.pawnHistory.address(),
+                       h.pawnHistory.size_bytes());
+        }
+
+        for (auto it = pool.cbegin(); it != pool.cend(); ++it)
+        {
+            const Search::Worker& w = *(*it)->worker;
+
+            report.add(prefix + "worker " + std::to_string((*it)->id()), &w, sizeof(w));
+            report.add("  accumulator stack", &w.accumulator_stack(),
+                       sizeof(w.accumulator_stack()), false);
+            report.add("  accumulator caches", &w.accumulator_caches(),
+                       sizeof(w.accumulator_caches()), false);
+            report.add("  eval cache", w.eval_cache().address(), w.eval_cache().size_bytes());
+        }
+    };
+
+    addTT("TT", tt);
+
+    const auto status = networks.get_status_and_errors();
+    for (size_t i = 0; i < status.size(); ++i)
+    {
+        const NN::Networks* replica = networks.get_if_present(NumaIndex(i));
+        const bool          shared =
+          status[i].first == SystemWideSharedConstantAllocationStatus::SharedMemory;
+
+        if (replica)
+            report.add("network replica, node " + std::to_string(i), replica, sizeof(*replica),
+                       true, shared ? "shared memory" : "");
+    }
+
+    addPool("", threads, sharedHists);
+
+    for (size_t i = 0; i < groups.size(); ++i)
+    {
+        const std::string prefix = "group " + std::to_string(i) + " ";
+
+        if (groups[i]->tt != &tt)
+            addTT(prefix + "TT", *groups[i]->tt);
+
+        addPool(prefix, groups[i]->threads, groups[i]->sharedHists);
+    }
+
+    for (size_t i = 0; i < ponderGroups.size(); ++i)
+        addPool("ponder group " + std::to_string(i) + " ", ponderGroups[i]->threads,
+                ponderGroups[i]->sharedHists);
+
+    const auto files = Tablebases::mapped_files();
+    report.add_files("Syzygy, " + std::to_string(files.size()) + " mapped files", files);
+
+    // One copy of the pinned tables on each node when the networks are replicated
+    const NumaConfig& cfg   = numaContext.get_numa_config();
+    const NumaIndex   nodes = cfg.requires_memory_replication() ? cfg.num_numa_nodes() : 1;
+    for (NumaIndex n = 0; n < nodes; ++n)
+    {
+        const auto& pinned = pinnedTables[NumaReplicatedAccessToken(n)];
+        if (pinned.tables())
+            report.add_files("Syzygy, " + std::to_string(pinned.tables())
+                               + " pinned tables, node " + std::to_string(n),
+                             pinned.memory(), "");
+    }
+
+    return report.str();
+}
+
+std::string Engine::tt_allocation_information_as_string() const {
+    const std::string shmName = options["SharedHashName"];
+    const size_t      mbSize  = size_t(int(options["Hash"]));
+
+    if (shmName.empty())
+    {
+        std::string str = "Using a local hash of " + std::to_string(mbSize) + "MB";
+
+        str += page_size_information(tt.page_size());
+
+        auto placement = tt.numa_placement(threads);
+        if (placement.empty())
+            return str;
+
+        const bool interleaved = std::string(options["HashNumaPolicy"]) == "interleave";
+
+        str += interleaved ? ", interleaved over NUMA nodes:" : ", chunked over NUMA nodes:";
+        for (size_t n = 0; n < placement.size(); ++n)
+            if (placement[n])
+                str += " " + std::to_string(n) + ":" + std::to_string(placement[n] >> 20) + "MB";
+
+        return str;
+    }
+
+    if (tt.is_shared())
+        return "Using a shared hash of " + std::to_string(mbSize) + "MB named " + shmName;
+
+    return "Failed to map the shared hash " + shmName + ", using a local hash of "
+         + std::to_string(mbSize) + "MB";
+}
 }
@@ -19,16 +19,23 @@
 #ifndef ENGINE_H_INCLUDED
 #define ENGINE_H_INCLUDED
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include "book.h"
+#include "datagen.h"
+#include "distributed.h"
 #include "history.h"
 #include "nnue/network.h"
 #include "numa.h"
@@ -41,13 +48,71 @@
 
 namespace Stockfish {
 
+// What the engines of one process can share: the NUMA context, the networks,
+// loaded once by the host, and a budget of search threads. Each engine on a
+// shared host takes its "Threads" from the budget and binds them after those of
+// the other engines. It leaves the networks and the NUMA policy to the host, so
+// that none of them is duplicated. An engine made without a host has one of its
+// own, with no limit on the threads, and works as if there were none.
+class EngineHost {
+   public:
+    // Loads the networks, the default ones for empty names, as EvalFile would from
+    // the directory of the binary at path. A maxThreads of zero is no limit.
+    explicit EngineHost(std::optional<std::string> path          = std::nullopt,
+                        size_t                     maxThreads    = 0,
+                        std::string                evalFile      = "",
+                        std::string                evalFileSmall = "");
+
+    EngineHost(const EngineHost&)            = delete;
+    EngineHost& operator=(const EngineHost&) = delete;
+
+   private:
+    friend class Engine;
+
+    // For the host of a single engine, which loads the networks itself
+    struct Unloaded {};
+    explicit EngineHost(Unloaded);
+
+    // Takes a run of up to n free thread slots, as the first slot and the count.
+    // The count is zero when the budget is used up, and the engine then runs one
+    // thread outside of it.
+    std::pair<size_t, size_t> take_threads(size_t n);
+    void                      give_back_threads(std::pair<size_t, size_t> slots);
+
+    std::string                                        binaryDirectory;
+    std::string                                        evalFiles[2];  // Big and small
+    NumaReplicationContext                             numaContext;
+    LazyNumaReplicatedSystemWide<Eval::NNUE::Networks> networks;
+    NumaReplicated<Tablebases::PinnedTables>           pinnedTables;
+
+    // The tablebases are mapped for the whole process. On a shared host the first
+    // SyzygyPath sets them, and they are not mapped again under another search.
+    std::string syzygyPath;
+
+    size_t            maxThreads = 0;
+    std::vector<bool> usedSlots;
+    std::mutex        mutex;
+};
+
 class Engine {
    public:
     using InfoShort = Search::InfoShort;
     using InfoFull  = Search::InfoFull;
     using InfoIter  = Search::InfoIteration;
 
+    // The outcome of the search of one position by analyse()
+    struct AnalysisResult {
+        size_t         index = 0;  // Of the position in the input
+        PackedPosition position;   // The position searched, with an eval and a wdl of zero
+        std::string    bestmove, pv;
+        Score          score;
+        int            depth = 0;
+        uint64_t       nodes = 0;
+    };
+
     Engine(std::optional<std::string> path = std::nullopt);
+    // An engine sharing the networks and the thread budget of the host
+    explicit Engine(std::shared_ptr<EngineHost> engineHost);
 
     // Cannot be movable due to components holding backreferences to fields
     Engine(const Engine&)            = delete;
@@ -55,9 +120,19 @@ class Engine {
     Engine& operator=(const Engine&) = delete;
     Engine& operator=(Engine&&)      = delete;
 
-    ~Engine() { wait_for_search_finished(); }
+    ~Engine() {
+        wait_for_search_finished();
+        Tablebases::set_pinned(nullptr);  // Those of the calling thread
+        clear_search_groups();
+        host->give_back_threads(threadSlots);
+    }
 
-    std::uint64_t perft(const std::string& fen, Depth depth, bool isChess960);
+    // With more than one thread or a hash, the threads of the pool share the work
+    std::uint64_t perft(const std::string& fen,
+                        Depth              depth,
+                        bool               isChess960,
+                        int                threadCount = 1,
+                        int                hashMB      = 0);
 
     // non blocking call to start searching
     void go(Search::LimitsType&);
@@ -71,9 +146,16 @@ class Engine {
 
     // modifiers
 
+    // Loading the networks, replicating them on the NUMA nodes and faulting in the
+    // TT are done by a thread of their own, made by the constructor. Everything
+    // that needs them waits here first, which does nothing once they are done.
+    void wait_for_loading() const;
+
     void set_numa_config_from_option(const std::string& o);
     void resize_threads();
     void set_tt_size(size_t mb);
+    bool save_tt(const std::string& file);
+    bool load_tt(const std::string& file);
     void set_ponderhit(bool);
     void search_clear();
 
@@ -82,23 +164,85 @@ class Engine {
     void set_on_iter(std::function<void(const InfoIter&)>&&);
     void set_on_bestmove(std::function<void(std::string_view, std::string_view)>&&);
     void set_on_verify_networks(std::function<void(std::string_view)>&&);
+    void set_on_metrics(std::function<void(std::string_view)>&&);
+
+    // search groups, independent searches side by side with the main one
+
+    void   set_search_groups(size_t count, size_t threadsPerGroup, size_t hashMb);
+    void   resize_search_groups();
+    size_t search_groups() const;
+    void   set_group_position(size_t                          group,
+                              const std::string&              fen,
+                              const std::vector<std::string>& moves);
+    void   go_group(size_t group, Search::LimitsType&);
+    void   stop_group(size_t group);
+    void   wait_for_group(size_t group);
+    // Gives the listeners of each group, by index
+    void set_group_listeners(std::function<Search::SearchManager::UpdateContext(size_t)>&&);
+
+    // Searches each position set up by next() with a single thread, threadCount of
+    // them at once, and gives the results in input order. Blocking.
+    void analyse(const std::function<bool(Position&, StateInfo*)>& next,
+                 Search::LimitsType                                limits,
+                 size_t                                            threadCount,
+                 size_t                                            hashMb,
+                 const std::function<void(const AnalysisResult&)>& onResult);
+
+    // Plays params.games self-play games, one per thread at a time, and writes the
+    // quiet positions of each finished game to out. Blocking.
+    Datagen::Stats datagen(const Datagen::Params& params, std::ostream& out);
+
+    // distributed search, see Distributed::Link. Not to be used during a search.
+    // A worker gets the searches of the main engine through onGo and onStop,
+    // called on the I/O thread of the link.
+
+    bool        cluster_serve(std::uint16_t             port,
+                              Distributed::Link::OnGo   onGo,
+                              Distributed::Link::OnStop onStop);
+    bool        cluster_connect(const std::vector<std::string>& workers);
+    void        cluster_close();
+    std::string cluster_status() const;
+    void        set_on_cluster_info(std::function<void(std::string_view)>&&);
 
     // network related
 
     void verify_networks() const;
+    // Loads the tables of the "SyzygyPin" option and returns the info to print
+    std::optional<std::string> pin_tablebases();
+    bool                       shared_tablebases_set() const;
     void load_networks();
     void load_big_network(const std::string& file);
+    void unload_big_network();
     void load_small_network(const std::string& file);
     void save_network(const std::pair<std::optional<std::string>, std::string> files[2]);
+    // Writes the loaded networks in the pre-permuted image format, an empty name skips a net
+    bool save_network_images(const std::string& bigFile, const std::string& smallFile) const;
 
     // utility functions
 
     void trace_eval() const;
+    // Static evaluations in centipawns from White's point of view, none when in check.
+    // The positions must be valid, see Position::is_valid_fen() and is_valid().
+    std::vector<std::optional<int>> evaluate_batch(const std::vector<std::string>& fens) const;
+    std::vector<std::optional<int>>
+    evaluate_batch(const std::vector<PackedPosition>& positions) const;
+    std::string                     benchmark_nnue() const;
 
     const OptionsMap& get_options() const;
     OptionsMap&       get_options();
 
-    int get_hashfull(int maxAge = 0) const;
+    int         get_hashfull(int maxAge = 0) const;
+    std::string get_tt_stats() const;
+    std::string get_refresh_stats() const;
+    std::string get_eval_cache_stats() const;
+    std::string get_tb_cache_stats() const;
+    std::string get_net_choice_stats() const;
+    std::string get_latency_stats() const;
+    // Allocated and resident bytes of each large allocation, with their pages
+    std::string get_memory_report() const;
+    // Empty unless compiled with SEARCH_COUNTERS
+    std::string get_search_counters() const;
+    void        clear_search_counters();
 
     std::string                            fen() const;
     void                                   flip();
@@ -108,23 +252,83 @@ class Engine {
     std::string                            numa_config_information_as_string() const;
     std::string                            thread_allocation_information_as_string() const;
     std::string                            thread_binding_information_as_string() const;
+    std::string                            tt_allocation_information_as_string() const;
+    std::string                            shared_history_information_as_string() const;
+    std::optional<std::string>             host_information_as_string() const;
 
    private:
-    const std::string binaryDirectory;
+    Engine(std::shared_ptr<EngineHost> engineHost, std::optional<std::string> path, bool ownHost);
 
-    NumaReplicationContext numaContext;
+    std::shared_ptr<EngineHost> host;
+    const bool                  ownHost;  // Alone on its host, see EngineHost
+    const std::string           binaryDirectory;
 
-    Position     pos;
-    StateListPtr states;
+    // Joined by wait_for_loading(), which sets loaded once it is done
+    mutable std::mutex        loaderMutex;
+    mutable std::thread       loader;
+    mutable std::atomic<bool> loaded{false};
 
-    OptionsMap                                         options;
-    ThreadPool                                         threads;
-    TranspositionTable                                 tt;
-    LazyNumaReplicatedSystemWide<Eval::NNUE::Networks> networks;
+    NumaReplicationContext&   numaContext;
+    std::pair<size_t, size_t> threadSlots{0, 0};  // Taken from the host
+
+    Position                 pos;
+    StateListPtr             states;
+    std::string              rootFen;  // The position as set, sent to the workers of a cluster
+    std::vector<std::string> rootMoves;
+
+    OptionsMap                                          options;
+    Book::Mapping                                       book;
+    ThreadPool                                          threads;
+    TranspositionTable                                  tt;
+    LazyNumaReplicatedSystemWide<Eval::NNUE::Networks>& networks;
+    NumaReplicated<Tablebases::PinnedTables>&           pinnedTables;  // Of the host
 
     Search::SearchManager::UpdateContext  updateContext;
     std::function<void(std::string_view)> onVerifyNetworks;
+    std::function<void(std::string_view)> onClusterInfo;
     std::map<NumaIndex, SharedHistories>  sharedHists;
+
+    struct SearchGroup {
+        ThreadPool                           threads;
+        TranspositionTable                   ownTT;
+        TranspositionTable*                  tt;  // ownTT, or the main TT when shared
+        std::map<NumaIndex, SharedHistories> sharedHists;
+        Position                             pos;
+        StateListPtr                         states;
+        Search::SearchManager::UpdateContext updateContext;
+        std::pair<size_t, size_t>            threadSlots{0, 0};  // Taken from the host
+
+        // Used by the ponder candidates only
+        bool              pondering = false;
+        std::atomic<bool> forward{false};  // Send the output to the main listeners
+    };
+
+    Search::SearchManager::UpdateContext group_update_context(size_t group) const;
+    void                                 clear_search_groups();  // Giving back their threads
+
+    // Evaluates count positions, the i-th set up by setUp(i, pos, si)
+    std::vector<std::optional<int>>
+    evaluate_batch(size_t count,
+                   const std::function<void(size_t, Position&, StateInfo*)>& setUp) const;
+
+    // Pondering on more than the expected reply, see start_ponder_candidates()
+    std::pair<size_t, size_t> ponder_group_split() const;  // The groups and their threads
+    size_t                    main_pool_threads() const;
+    void                      resize_ponder_groups();
+    void                      start_ponder_candidates(const Search::LimitsType& limits);
+    bool                      continue_ponder_candidate(const Search::LimitsType& limits);
+    void                      stop_ponder_candidates(bool includingActive);
+
+    Search::SearchManager::UpdateContext ponder_update_context(const SearchGroup& group) const;
+
+    int activePonderGroup = -1;  // The candidate searching for the last 'go', if any
+
+    std::function<Search::SearchManager::UpdateContext(size_t)> groupListeners;
+
+    // Last, so that they are destroyed before what their threads refer to
+    std::vector<std::unique_ptr<SearchGroup>> groups;
+    std::vector<std::unique_ptr<SearchGroup>> ponderGroups;
+    std::unique_ptr<Distributed::Link>        link;
 };
 
 }  // namespace Stockfish
@@ -21,16 +21,19 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstddef>
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
 #include <memory>
 #include <sstream>
 #include <tuple>
+#include <vector>
 
 #include "nnue/network.h"
 #include "nnue/nnue_misc.h"
 #include "position.h"
+#include "profiler.h"
 #include "types.h"
 #include "uci.h"
 #include "nnue/nnue_accumulator.h"
@@ -46,31 +49,24 @@ int Eval::simple_eval(const Position& pos) {
          - pos.non_pawn_material(~c);
 }
 
-bool Eval::use_smallnet(const Position& pos) { return std::abs(simple_eval(pos)) > 962; }
+namespace {
 
-// Evaluate is the evaluator for the outer world. It returns a static evaluation
-// of the position from the point of view of the side to move.
-Value Eval::evaluate(const Eval::NNUE::Networks&    networks,
-                     const Position&                pos,
-                     Eval::NNUE::AccumulatorStack&  accumulators,
-                     Eval::NNUE::AccumulatorCaches& caches,
-                     int                            optimism) {
+// Material imbalance above which the small net is used
+constexpr int SmallNetThreshold = 962;
 
-    assert(!pos.checkers());
+// Imbalance above the threshold up to which a speculative evaluation may go to
+// the big net directly, see NetChoice
+constexpr int SpeculationMargin = 2 * PawnValue;
 
-    bool smallNet           = use_smallnet(pos);
-    auto [psqt, positional] = smallNet ? networks.small.evaluate(pos, accumulators, caches.small)
-                                       : networks.big.evaluate(pos, accumulators, caches.big);
+// Re-evaluate the position with the big net when higher eval accuracy is worth the time spent
+bool needs_bignet(int psqt, int positional) {
+    return std::abs((125 * psqt + 131 * positional) / 128) < 277;
+}
 
-    Value nnue = (125 * psqt + 131 * positional) / 128;
+// Turns the output of the chosen network into the final evaluation
+Value scale_nnue(const Position& pos, int psqt, int positional, int optimism) {
 
-    // Re-evaluate the position when higher eval accuracy is worth the time spent
-    if (smallNet && (std::abs(nnue) < 277))
-    {
-        std::tie(psqt, positional) = networks.big.evaluate(pos, accumulators, caches.big);
-        nnue                       = (125 * psqt + 131 * positional) / 128;
-        smallNet                   = false;
-    }
+    Value nnue = (125 * psqt + 131 * positional) / 128;
 
     // Blend optimism and eval with nnue complexity
     int nnueComplexity = std::abs(psqt - positional);
@@ -89,11 +85,131 @@ Value Eval::evaluate(const Eval::NNUE::Networks&    networks,
     return v;
 }
 
+}
+
+bool Eval::use_smallnet(const Position& pos) {
+    return std::abs(simple_eval(pos)) > SmallNetThreshold;
+}
+
+// Evaluate is the evaluator for the outer world. It returns a static evaluation
+// of the position from the point of view of the side to move.
+Value Eval::evaluate(const Eval::NNUE::Networks&    networks,
+                     const Position&                pos,
+                     Eval::NNUE::AccumulatorStack&  accumulators,
+                     Eval::NNUE::AccumulatorCaches& caches,
+                     EvalCache&                     evalCache,
+                     NetChoice&                     netChoice,
+                     int                            optimism) {
+
+    assert(!pos.checkers());
+
+    Profiler::ScopedPhase timer(Profiler::Evaluation);
+
+    const std::size_t ply = std::min<std::size_t>(accumulators.ply(), MAX_PLY);
+
+    int psqt, positional;
+    if (!evalCache.probe(pos.key(), psqt, positional))
+    {
+        bool smallNet = netChoice.smallOnly || use_smallnet(pos);
+
+        // The small net result would most likely be thrown away, skip it
+        if (smallNet && netChoice.speculate && !netChoice.smallOnly && ply > 0
+            && netChoice.nearZero[ply - 1]
+            && std::abs(simple_eval(pos)) <= SmallNetThreshold + SpeculationMargin)
+        {
+            smallNet = false;
+            ++netChoice.speculated;
+        }
+
+        if (smallNet)
+        {
+            ++netChoice.smallEvals;
+            std::tie(psqt, positional) = networks.small.evaluate(pos, accumulators, caches.small);
+        }
+
+        if (!smallNet || (!netChoice.smallOnly && needs_bignet(psqt, positional)))
+        {
+            netChoice.doubleEvals += smallNet;
+            ++netChoice.bigEvals;
+            std::tie(psqt, positional) = networks.big.evaluate(pos, accumulators, caches.big);
+        }
+
+        if (evalCache.enabled())
+            evalCache.save(pos.key(), psqt, positional);
+    }
+
+    netChoice.nearZero[ply] = needs_bignet(psqt, positional);
+
+    return scale_nnue(pos, psqt, positional, optimism);
+}
+
+void Eval::EvalCache::resize(std::size_t mbSize) {
+    const std::size_t count = mbSize * 1024 * 1024 / sizeof(Entry);
+
+    if (count != table.size())
+    {
+        table = std::vector<Entry>(count);
+        hits = probes = 0;
+    }
+}
+
+void Eval::EvalCache::clear() { std::fill(table.begin(), table.end(), Entry{}); }
+
+// Evaluates many unrelated positions, giving the same values as evaluate() with
+// zero optimism. Each network evaluates all its positions in one batch, which
+// lets it reuse cached accumulators and weights between them. Positions in check
+// get VALUE_NONE. With smallOnly the big net is not used.
+std::vector<Value> Eval::evaluate_batch(const Eval::NNUE::Networks&         networks,
+                                        const std::vector<const Position*>& positions,
+                                        Eval::NNUE::AccumulatorStack&       accumulators,
+                                        Eval::NNUE::AccumulatorCaches&      caches,
+                                        bool                                smallOnly) {
+
+    std::vector<Value>               values(positions.size(), VALUE_NONE);
+    std::vector<std::size_t>         smallIdx, bigIdx;
+    std::vector<const Position*>     batch;
+    std::vector<NNUE::NetworkOutput> outputs;
+
+    for (std::size_t i = 0; i < positions.size(); ++i)
+        if (!positions[i]->checkers())
+            (smallOnly || use_smallnet(*positions[i]) ? smallIdx : bigIdx).push_back(i);
+
+    for (std::size_t i : smallIdx)
+        batch.push_back(positions[i]);
+
+    networks.small.evaluate_batch(batch, accumulators, caches.small, outputs);
+
+    for (std::size_t j = 0; j < smallIdx.size(); ++j)
+    {
+        auto [psqt, positional] = outputs[j];
+
+        if (!smallOnly && needs_bignet(psqt, positional))
+            bigIdx.push_back(smallIdx[j]);
+        else
+            values[smallIdx[j]] = scale_nnue(*positions[smallIdx[j]], psqt, positional, 0);
+    }
+
+    batch.clear();
+    for (std::size_t i : bigIdx)
+        batch.push_back(positions[i]);
+
+    networks.big.evaluate_batch(batch, accumulators, caches.big, outputs);
+
+    for (std::size_t j = 0; j < bigIdx.size(); ++j)
+    {
+        auto [psqt, positional] = outputs[j];
+        values[bigIdx[j]]       = scale_nnue(*positions[bigIdx[j]], psqt, positional, 0);
+    }
+
+    return values;
+}
+
 // Like evaluate(), but instead of returning a value, it returns
 // a string (suitable for outputting to stdout) that contains the detailed
 // descriptions and values of each evaluation term. Useful for debugging.
-// Trace scores are from white's point of view
-std::string Eval::trace(Position& pos, const Eval::NNUE::Networks& networks) {
+// Trace scores are from white's point of view. With smallOnly the big net, which
+// may not be loaded, is not traced.
+std::string Eval::trace(Position& pos, const Eval::NNUE::Networks& networks, bool smallOnly) {
 
     if (pos.checkers())
         return "Final evaluation: none (in check)";
@@ -103,16 +219,23 @@ std::string Eval::trace(Position& pos, const Eval::NNUE::Networks& networks) {
 
     std::stringstream ss;
     ss << std::showpoint << std::noshowpos << std::fixed << std::setprecision(2);
-    ss << '\n' << NNUE::trace(pos, networks, *caches) << '\n';
+    ss << '\n';
+    if (!smallOnly)
+        ss << NNUE::trace(pos, networks, *caches) << '\n';
 
     ss << std::showpoint << std::showpos << std::fixed << std::setprecision(2) << std::setw(15);
 
-    auto [psqt, positional] = networks.big.evaluate(pos, *accumulators, caches->big);
+    auto [psqt, positional] = smallOnly
+                              ? networks.small.evaluate(pos, *accumulators, caches->small)
+                              : networks.big.evaluate(pos, *accumulators, caches->big);
     Value v                 = psqt + positional;
     v                       = pos.side_to_move() == WHITE ? v : -v;
     ss << "NNUE evaluation        " << 0.01 * UCIEngine::to_cp(v, pos) << " (white side)\n";
 
-    v = evaluate(networks, pos, *accumulators, *caches, VALUE_ZERO);
+    EvalCache noCache;
+    NetChoice netChoice;
+    netChoice.smallOnly = smallOnly;
+    v = evaluate(networks, pos, *accumulators, *caches, noCache, netChoice, VALUE_ZERO);
     v = pos.side_to_move() == WHITE ? v : -v;
     ss << "Final evaluation       " << 0.01 * UCIEngine::to_cp(v, pos) << " (white side)";
     ss << " [with scaled NNUE, ...]";
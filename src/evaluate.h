@@ -19,8 +19,13 @@
 #ifndef EVALUATE_H_INCLUDED
 #define EVALUATE_H_INCLUDED
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
 
+#include "misc.h"
 #include "types.h"
 
 namespace Stockfish {
@@ -42,7 +47,67 @@ struct AccumulatorCaches;
 class AccumulatorStack;
 }
 
-std::string trace(Position& pos, const Eval::NNUE::Networks& networks);
+// EvalCache is a small per-thread hash table of raw network outputs, consulted
+// before the forward pass so that transpositions whose eval is no longer in the
+// TT get it back without running either net. The full key is stored, so a hit
+// returns exactly what the networks would have.
+class EvalCache {
+   public:
+    void resize(std::size_t mbSize);
+    void clear();
+
+    bool probe(Key key, int& psqt, int& positional) {
+        if (table.empty())
+            return false;
+
+        ++probes;
+        const Entry& e = table[mul_hi64(key, table.size())];
+        if (e.key != key)
+            return false;
+
+        ++hits;
+        psqt       = e.psqt;
+        positional = e.positional;
+        return true;
+    }
+
+    void save(Key key, int psqt, int positional) {
+        table[mul_hi64(key, table.size())] = {key, std::int32_t(psqt), std::int32_t(positional)};
+    }
+
+    bool enabled() const { return !table.empty(); }
+
+    const void* address() const { return table.data(); }
+    std::size_t size_bytes() const { return table.size() * sizeof(Entry); }
+
+    std::uint64_t hits = 0, probes = 0;
+
+   private:
+    struct Entry {
+        Key          key;
+        std::int32_t psqt, positional;
+    };
+
+    std::vector<Entry> table;
+};
+
+// NetChoice follows which positions evaluate() gives to which network, and
+// counts how often the small net is overruled so that both nets run. With
+// speculation on, a small net position goes to the big net directly when the
+// last evaluation on the parent ply was close enough to zero for the small net
+// to be overruled and the material is still near the small net threshold. With
+// smallOnly, as for "Small Net Only", every position goes to the small net.
+struct NetChoice {
+    bool speculate = false;
+    bool smallOnly = false;
+
+    std::uint64_t smallEvals = 0, bigEvals = 0, doubleEvals = 0, speculated = 0;
+
+    // Whether the last evaluation on each ply fell in the re-evaluation band
+    std::array<bool, MAX_PLY + 1> nearZero{};
+};
+
+std::string trace(Position& pos, const Eval::NNUE::Networks& networks, bool smallOnly);
 
 int   simple_eval(const Position& pos);
 bool  use_smallnet(const Position& pos);
@@ -50,7 +115,15 @@ Value evaluate(const NNUE::Networks&          networks,
                const Position&                pos,
                Eval::NNUE::AccumulatorStack&  accumulators,
                Eval::NNUE::AccumulatorCaches& caches,
+               EvalCache&                     evalCache,
+               NetChoice&                     netChoice,
                int                            optimism);
+
+std::vector<Value> evaluate_batch(const NNUE::Networks&               networks,
+                                  const std::vector<const Position*>& positions,
+                                  Eval::NNUE::AccumulatorStack&       accumulators,
+                                  Eval::NNUE::AccumulatorCaches&      caches,
+                                  bool                                smallOnly);
 }  // namespace Eval
 
 }  // namespace Stockfish
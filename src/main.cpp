@@ -27,7 +27,17 @@
 
 using namespace Stockfish;
 
+#if defined(USE_DISPATCH)
+// In a dispatch build every ISA variant is compiled into its own namespace and
+// exports this instead of main(). The real main() in dispatch.cpp picks one.
+namespace Stockfish {
+int entry_point(int argc, char* argv[]);
+}
+
+int Stockfish::entry_point(int argc, char* argv[]) {
+#else
 int main(int argc, char* argv[]) {
+#endif
     std::cout << engine_info() << std::endl;
 
     Bitboards::init();
@@ -18,7 +18,14 @@
 
 #include "memory.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #if __has_include("features.h")
     #include <features.h>
@@ -26,6 +33,14 @@
 
 #if defined(__linux__) && !defined(__ANDROID__)
     #include <sys/mman.h>
+    #include <unistd.h>
+
+    #if defined(MAP_HUGETLB)
+        #define USE_HUGETLB
+        #if !defined(MAP_HUGE_SHIFT)
+            #define MAP_HUGE_SHIFT 26
+        #endif
+    #endif
 #endif
 
 #if defined(__APPLE__) || defined(__ANDROID__) || defined(__OpenBSD__) \
@@ -93,6 +108,54 @@ void std_aligned_free(void* ptr) {
 #endif
 }
 
+// Allocations made with explicit large pages, with their size and page size,
+// so that they can be released accordingly and reported to the user.
+
+struct LargePageAllocation {
+    size_t size, pageSize;
+};
+
+struct LargePageRegistry {
+    std::mutex                                 mutex;
+    std::map<const void*, LargePageAllocation> allocations;
+};
+
+// Never destroyed, as memory may still be freed during static destruction
+static LargePageRegistry& large_page_registry() {
+    static LargePageRegistry* registry = new LargePageRegistry();
+    return *registry;
+}
+
+[[maybe_unused]] static void register_large_pages(void* mem, size_t size, size_t pageSize) {
+    LargePageRegistry&          registry = large_page_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    registry.allocations[mem] = {size, pageSize};
+}
+
+// Returns the size of the allocation, or 0 if mem was not allocated with large pages
+[[maybe_unused]] static size_t unregister_large_pages(void* mem) {
+    LargePageRegistry&          registry = large_page_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    auto it = registry.allocations.find(mem);
+    if (it == registry.allocations.end())
+        return 0;
+
+    size_t size = it->second.size;
+    registry.allocations.erase(it);
+    return size;
+}
+
+size_t large_page_size(const void* mem) {
+    LargePageRegistry&          registry = large_page_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    auto it = registry.allocations.find(mem);
+    return it != registry.allocations.end() ? it->second.pageSize : 0;
+}
+
+
 // aligned_large_pages_alloc() will return suitably aligned memory,
 // if possible using large pages.
 
@@ -104,8 +167,11 @@ static void* aligned_large_pages_alloc_windows([[maybe_unused]] size_t allocSize
       [&](size_t largePageSize) {
           // Round up size to full pages and allocate
           allocSize = (allocSize + largePageSize - 1) & ~size_t(largePageSize - 1);
-          return VirtualAlloc(nullptr, allocSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
-                              PAGE_READWRITE);
+          void* mem = VirtualAlloc(nullptr, allocSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                                   PAGE_READWRITE);
+          if (mem)
+              register_large_pages(mem, allocSize, largePageSize);
+          return mem;
       },
       []() { return (void*) nullptr; });
 }
@@ -124,8 +190,47 @@ void* aligned_large_pages_alloc(size_t allocSize) {
 
 #else
 
+    #if defined(USE_HUGETLB)
+
+// Maps memory on huge pages of 1 << pageShift bytes from the hugetlbfs pool.
+// This only succeeds if the administrator reserved enough of them, for example
+// through /proc/sys/vm/nr_hugepages or the hugepages= kernel parameter.
+static void* aligned_large_pages_alloc_hugetlb(size_t allocSize, int pageShift) {
+
+    const size_t pageSize = size_t(1) << pageShift;
+    const size_t size     = (allocSize + pageSize - 1) / pageSize * pageSize;
+
+    void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (pageShift << MAP_HUGE_SHIFT), -1,
+                     0);
+    if (mem == MAP_FAILED)
+        return nullptr;
+
+    register_large_pages(mem, size, pageSize);
+    return mem;
+}
+
+    #endif
+
 void* aligned_large_pages_alloc(size_t allocSize) {
 
+    #if defined(USE_HUGETLB)
+    // Explicit huge pages can't silently fall back to small pages under fragmentation,
+    // unlike transparent ones. Use 1GB pages if they are filled well (at most 1/16 of
+    // the mapping wasted), then 2MB pages, and only then transparent huge pages.
+    constexpr size_t OneGB = size_t(1) << 30;
+
+    void* hugeMem = nullptr;
+    if (allocSize >= OneGB && (OneGB - allocSize % OneGB) % OneGB <= allocSize / 16)
+        hugeMem = aligned_large_pages_alloc_hugetlb(allocSize, 30);
+
+    if (!hugeMem && allocSize >= (size_t(2) << 20))
+        hugeMem = aligned_large_pages_alloc_hugetlb(allocSize, 21);
+
+    if (hugeMem)
+        return hugeMem;
+    #endif
+
     #if defined(__linux__)
     constexpr size_t alignment = 2 * 1024 * 1024;  // 2MB page size assumed
     #else
@@ -182,6 +287,8 @@ bool has_large_pages() {
 
 void aligned_large_pages_free(void* mem) {
 
+    unregister_large_pages(mem);
+
     if (mem && !VirtualFree(mem, 0, MEM_RELEASE))
     {
         DWORD err = GetLastError();
@@ -193,7 +300,101 @@ void aligned_large_pages_free(void* mem) {
 
 #else
 
-void aligned_large_pages_free(void* mem) { std_aligned_free(mem); }
+void aligned_large_pages_free(void* mem) {
+
+    #if defined(USE_HUGETLB)
+    if (size_t size = unregister_large_pages(mem))
+    {
+        munmap(mem, size);
+        return;
+    }
+    #endif
+
+    std_aligned_free(mem);
+}
 
 #endif
+
+bool is_resident_or_read_ahead([[maybe_unused]] const void* mem, [[maybe_unused]] size_t size) {
+
+#if defined(__linux__) && !defined(__ANDROID__)
+    static const uintptr_t page = uintptr_t(sysconf(_SC_PAGESIZE));
+
+    const uintptr_t first = uintptr_t(mem) & ~(page - 1);
+    const uintptr_t end   = uintptr_t(mem) + size;
+    unsigned char   pages[64];
+
+    for (uintptr_t from = first; from < end; from += 64 * page)
+    {
+        const uintptr_t to = std::min(end, from + 64 * page);
+
+        if (mincore(reinterpret_cast<void*>(from), to - from, pages))
+            return true;
+
+        for (size_t i = 0; i < (to - from + page - 1) / page; ++i)
+            if (!(pages[i] & 1))
+            {
+                madvise(reinterpret_cast<void*>(first), end - first, MADV_WILLNEED);
+                return false;
+            }
+    }
+#endif
+
+    return true;
+}
+
+// Residency is found with mincore(), and the share on transparent huge pages from
+// the AnonHugePages of the mappings in /proc/self/smaps, prorated to the range.
+Residency residency([[maybe_unused]] const void* mem, size_t size) {
+
+#if defined(__linux__) && !defined(__ANDROID__)
+    if (!mem || !size)
+        return {0, 0};
+
+    const uintptr_t page  = uintptr_t(sysconf(_SC_PAGESIZE));
+    const uintptr_t start = uintptr_t(mem), end = start + size;
+    const uintptr_t first = start & ~(page - 1);
+
+    std::vector<unsigned char> pages((end - first + page - 1) / page);
+    if (mincore(reinterpret_cast<void*>(first), end - first, pages.data()))
+        return {size, 0};
+
+    size_t resident = 0;
+    for (size_t i = 0; i < pages.size(); ++i)
+        if (pages[i] & 1)
+        {
+            uintptr_t from = std::max(start, first + i * page);
+            uintptr_t to   = std::min(end, first + (i + 1) * page);
+            resident += to - from;
+        }
+
+    std::ifstream smaps("/proc/self/smaps");
+    std::string   line;
+    uintptr_t     vmaStart = 0, vmaEnd = 0;
+    double        huge     = 0;
+
+    while (std::getline(smaps, line))
+    {
+        unsigned long long from, to;
+        size_t             kB;
+        char               dash;
+
+        std::istringstream ss(line);
+        if (ss >> std::hex >> from >> dash >> to && dash == '-')
+            vmaStart = uintptr_t(from), vmaEnd = uintptr_t(to);
+
+        else if (line.rfind("AnonHugePages:", 0) == 0 && vmaEnd > start && vmaStart < end)
+        {
+            std::istringstream(line.substr(14)) >> kB;
+            huge += double(kB) * 1024 * double(std::min(end, vmaEnd) - std::max(start, vmaStart))
+                  / double(vmaEnd - vmaStart);
+        }
+    }
+
+    return {resident, std::min(size_t(huge), resident)};
+#else
+    return {size, 0};
+#endif
+}
+
 }  // namespace Stockfish
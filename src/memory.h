@@ -70,6 +70,23 @@ void  aligned_large_pages_free(void* mem);
 
 bool has_large_pages();
 
+// Page size of memory from aligned_large_pages_alloc() if it got explicit large
+// pages, 0 otherwise (including transparent huge pages, which are up to the kernel)
+size_t large_page_size(const void* mem);
+
+// How much of [mem, mem + size) is in physical memory, and how much of it on
+// transparent huge pages. Where the system can't tell, all of it and none.
+struct Residency {
+    size_t resident, transparentHuge;
+};
+
+Residency residency(const void* mem, size_t size);
+
+// Whether all of [mem, mem + size) is in physical memory, meant for small ranges.
+// When it is not, the system is asked to read the range of the mapped file in the
+// background. Where the system can't tell, always true.
+bool is_resident_or_read_ahead(const void* mem, size_t size);
+
 // Frees memory which was placed there with placement new.
 // Works for both single objects and arrays of unknown bound.
 template<typename T, typename FREE_FUNC>
@@ -23,6 +23,7 @@
 #include <cassert>
 #include <cctype>
 #include <cmath>
+#include <condition_variable>
 #include <cstdlib>
 #include <fstream>
 #include <iomanip>
@@ -32,6 +33,8 @@
 #include <mutex>
 #include <sstream>
 #include <string_view>
+#include <thread>
+#include <utility>
 
 #include "types.h"
 
@@ -237,6 +240,9 @@ std::string compiler_info() {
 
     compiler += "\nCompilation settings       : ";
     compiler += (Is64Bit ? "64bit" : "32bit");
+#if defined(USE_AMX)
+    compiler += " AMX";
+#endif
 #if defined(USE_AVX512ICL)
     compiler += " AVX512ICL";
 #endif
@@ -264,11 +270,21 @@ std::string compiler_info() {
 #elif defined(USE_NEON)
     compiler += " NEON";
 #endif
+
+#if defined(USE_SVE2)
+    compiler += " SVE2";
+#endif
     compiler += (HasPopCnt ? " POPCNT" : "");
 
 #if !defined(NDEBUG)
     compiler += " DEBUG";
 #endif
+#if defined(COPY_MAKE)
+    compiler += " COPY_MAKE";
+#endif
+#if defined(PHASE_PROFILER)
+    compiler += " PHASE_PROFILER";
+#endif
 
     compiler += "\nCompiler __VERSION__ macro : ";
 #ifdef __VERSION__
@@ -410,21 +426,130 @@ void dbg_clear() {
     extremes.fill({});
 }
 
+namespace {
+
 // Used to serialize access to std::cout
 // to avoid multiple threads writing at the same time.
-std::ostream& operator<<(std::ostream& os, SyncCout sc) {
+std::mutex ioMutex;
+
+// The lines of async_cout(), in a lock-free queue of many producers and one
+// consumer at a time, as in Vyukov's intrusive MPSC queue. Producers link their
+// node at the head, and the consumer, which holds ioMutex, takes them from the
+// tail. The writer thread sleeps on a condition variable while there are none,
+// and the producers take its mutex only to wake it.
+class AsyncOutput {
+   public:
+    ~AsyncOutput() {
+        if (!writer.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lk(sleepMutex);
+            exit = true;
+        }
+        cv.notify_one();
+        writer.join();
 
-    static std::mutex m;
+        for (Node* n = tail; n;)
+            release(std::exchange(n, n->next.load()));
+    }
+
+    void push(std::string line) {
+        std::call_once(started, [this] { writer = std::thread(&AsyncOutput::idle_loop, this); });
+
+        Node* n = new Node;
+        n->line = std::move(line);
+
+        head.exchange(n, std::memory_order_acq_rel)->next.store(n, std::memory_order_release);
+        pending.fetch_add(1);
+
+        if (sleeping.load())
+        {
+            std::lock_guard<std::mutex> lk(sleepMutex);
+            cv.notify_one();
+        }
+    }
+
+    // Writes the queued lines. The caller must hold ioMutex.
+    void drain() {
+        bool wrote = false;
+
+        for (Node* next; (next = tail->next.load(std::memory_order_acquire));)
+        {
+            std::cout << next->line << '\n';
+            release(std::exchange(tail, next));
+            pending.fetch_sub(1);
+            wrote = true;
+        }
+
+        if (wrote)
+            std::cout.flush();
+    }
+
+   private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        std::string        line;
+    };
+
+    void release(Node* n) {
+        if (n != &stub)
+            delete n;
+    }
+
+    void idle_loop() {
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lk(ioMutex);
+                drain();
+            }
+
+            std::unique_lock<std::mutex> lk(sleepMutex);
+            sleeping = true;
+            cv.wait(lk, [this] { return exit || pending.load() > 0; });
+            sleeping = false;
+
+            if (exit && pending.load() == 0)
+                break;
+        }
+    }
+
+    Node               stub;
+    std::atomic<Node*> head{&stub};
+    Node*              tail = &stub;  // Already written, its next is the first to write
+    std::atomic<int>   pending{0};
+    std::atomic<bool>  sleeping{false};
+    bool               exit = false;
+
+    std::once_flag          started;
+    std::thread             writer;
+    std::mutex              sleepMutex;
+    std::condition_variable cv;
+};
+
+AsyncOutput asyncOutput;
+
+}
+
+// The queued lines of async_cout() are written first, to keep the order of the
+// output of all threads.
+std::ostream& operator<<(std::ostream& os, SyncCout sc) {
 
     if (sc == IO_LOCK)
-        m.lock();
+    {
+        ioMutex.lock();
+        asyncOutput.drain();
+    }
 
     if (sc == IO_UNLOCK)
-        m.unlock();
+        ioMutex.unlock();
 
     return os;
 }
 
+void async_cout(std::string line) { asyncOutput.push(std::move(line)); }
+
 void sync_cout_start() { std::cout << IO_LOCK; }
 void sync_cout_end() { std::cout << IO_UNLOCK; }
 
@@ -124,6 +124,11 @@ std::ostream& operator<<(std::ostream&, SyncCout);
 void sync_cout_start();
 void sync_cout_end();
 
+// Queues a line for std::cout, without its newline. It is written by a thread of
+// its own, so that the caller never waits on a slow reader, and before whatever
+// a later sync_cout writes.
+void async_cout(std::string line);
+
 // True if and only if the binary is compiled on a little-endian machine
 static inline const std::uint16_t Le             = 1;
 static inline const bool          IsLittleEndian = *reinterpret_cast<const char*>(&Le) == 1;
@@ -141,6 +146,8 @@ class ValueList {
     }
     const T* begin() const { return values_; }
     const T* end() const { return values_ + size_; }
+    T*       begin() { return values_; }
+    T*       end() { return values_ + size_; }
     const T& operator[](int index) const { return values_[index]; }
 
     T* make_space(size_t count) {
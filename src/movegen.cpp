@@ -206,18 +206,50 @@ Move* generate_pawn_moves(const Position& pos, Move* moveList, Bitboard target)
 }
 
 
-template<Color Us, PieceType Pt>
+// Removes the illegal moves among the pawn moves from 'cur' to 'end'. A pinned
+// pawn can only move along the pin. En passant, which can also uncover the king
+// along the rank, is checked in full.
+template<Color Us>
+Move* legal_pawn_moves(const Position& pos, Move* cur, Move* end) {
+
+    const Bitboard pinned = pos.blockers_for_king(Us) & pos.pieces(Us, PAWN);
+    const Square   ksq    = pos.square<KING>(Us);
+
+    if (!pinned && pos.ep_square() == SQ_NONE)
+        return end;
+
+    while (cur != end)
+        if (cur->type_of() == EN_PASSANT
+              ? !pos.legal(*cur)
+              : (pinned & cur->from_sq()) && !(line_bb(ksq, cur->from_sq()) & cur->to_sq()))
+            *cur = *(--end);
+        else
+            ++cur;
+
+    return end;
+}
+
+
+template<Color Us, PieceType Pt, bool Legal>
 Move* generate_moves(const Position& pos, Move* moveList, Bitboard target) {
 
     static_assert(Pt != KING && Pt != PAWN, "Unsupported piece type in generate_moves()");
 
     Bitboard bb = pos.pieces(Us, Pt);
 
+    [[maybe_unused]] const Bitboard pinned = Legal ? pos.blockers_for_king(Us) & bb : 0;
+
     while (bb)
     {
         Square   from = pop_lsb(bb);
         Bitboard b    = attacks_bb<Pt>(from, pos.pieces()) & target;
 
+        // A pinned piece can only move along the pin. When in check, the only
+        // such moves the target allows capture a checker on the line, in which
+        // case the piece was not pinned, as the blockers are found without it.
+        if (Legal && (pinned & from))
+            b &= line_bb(pos.square<KING>(Us), from);
+
         moveList = splat_moves(moveList, from, b);
     }
 
@@ -225,7 +257,7 @@ Move* generate_moves(const Position& pos, Move* moveList, Bitboard target) {
 }
 
 
-template<Color Us, GenType Type>
+template<Color Us, GenType Type, bool Legal>
 Move* generate_all(const Position& pos, Move* moveList) {
 
     static_assert(Type != LEGAL, "Unsupported type in generate_all()");
@@ -241,21 +273,51 @@ Move* generate_all(const Position& pos, Move* moveList) {
                : Type == CAPTURES     ? pos.pieces(~Us)
                                       : ~pos.pieces();  // QUIETS
 
-        moveList = generate_pawn_moves<Us, Type>(pos, moveList, target);
-        moveList = generate_moves<Us, KNIGHT>(pos, moveList, target);
-        moveList = generate_moves<Us, BISHOP>(pos, moveList, target);
-        moveList = generate_moves<Us, ROOK>(pos, moveList, target);
-        moveList = generate_moves<Us, QUEEN>(pos, moveList, target);
+        Move* pawnMoves = moveList;
+        moveList        = generate_pawn_moves<Us, Type>(pos, moveList, target);
+
+        if constexpr (Legal)
+            moveList = legal_pawn_moves<Us>(pos, pawnMoves, moveList);
+
+        moveList = generate_moves<Us, KNIGHT, Legal>(pos, moveList, target);
+        moveList = generate_moves<Us, BISHOP, Legal>(pos, moveList, target);
+        moveList = generate_moves<Us, ROOK, Legal>(pos, moveList, target);
+        moveList = generate_moves<Us, QUEEN, Legal>(pos, moveList, target);
     }
 
     Bitboard b = attacks_bb<KING>(ksq) & (Type == EVASIONS ? ~pos.pieces(Us) : target);
 
+    // The king may not move to an attacked square, nor along the line of a slider
+    // checking it, as the square behind the king is attacked once the king leaves.
+    // The attacks are those kept in the state, which the move picker uses as well.
+    // The sliders are found again, as qsearch() fakes the checkers to get king moves.
+    if constexpr (Legal)
+    {
+        b &= ~pos.attacks_by(~Us);
+
+        Bitboard sliders =
+          pos.checkers()
+            ? (attacks_bb<ROOK>(ksq, pos.pieces()) & pos.pieces(~Us, ROOK, QUEEN))
+                | (attacks_bb<BISHOP>(ksq, pos.pieces()) & pos.pieces(~Us, BISHOP, QUEEN))
+            : 0;
+
+        while (sliders)
+        {
+            Square s = pop_lsb(sliders);
+            b &= ~(line_bb(s, ksq) ^ s);
+        }
+    }
+
     moveList = splat_moves(moveList, ksq, b);
 
     if ((Type == QUIETS || Type == NON_EVASIONS) && pos.can_castle(Us & ANY_CASTLING))
         for (CastlingRights cr : {Us & KING_SIDE, Us & QUEEN_SIDE})
             if (!pos.castling_impeded(cr) && pos.can_castle(cr))
-                *moveList++ = Move::make<CASTLING>(ksq, pos.castling_rook_square(cr));
+            {
+                Move m = Move::make<CASTLING>(ksq, pos.castling_rook_square(cr));
+                if (!Legal || pos.legal(m))
+                    *moveList++ = m;
+            }
 
     return moveList;
 }
@@ -277,8 +339,8 @@ Move* generate(const Position& pos, Move* moveList) {
 
     Color us = pos.side_to_move();
 
-    return us == WHITE ? generate_all<WHITE, Type>(pos, moveList)
-                       : generate_all<BLACK, Type>(pos, moveList);
+    return us == WHITE ? generate_all<WHITE, Type, false>(pos, moveList)
+                       : generate_all<BLACK, Type, false>(pos, moveList);
 }
 
 // Explicit template instantiations
@@ -292,21 +354,28 @@ template Move* generate<NON_EVASIONS>(const Position&, Move*);
 template<>
 Move* generate<LEGAL>(const Position& pos, Move* moveList) {
 
-    Color    us     = pos.side_to_move();
-    Bitboard pinned = pos.blockers_for_king(us) & pos.pieces(us);
-    Square   ksq    = pos.square<KING>(us);
-    Move*    cur    = moveList;
+    return pos.checkers() ? generate_legal<EVASIONS>(pos, moveList)
+                          : generate_legal<NON_EVASIONS>(pos, moveList);
+}
 
-    moveList =
-      pos.checkers() ? generate<EVASIONS>(pos, moveList) : generate<NON_EVASIONS>(pos, moveList);
-    while (cur != moveList)
-        if (((pinned & cur->from_sq()) || cur->from_sq() == ksq || cur->type_of() == EN_PASSANT)
-            && !pos.legal(*cur))
-            *cur = *(--moveList);
-        else
-            ++cur;
+// Like generate(), but emits only the legal moves of the type. The pins and the
+// check are taken once from the position, and only castling and en passant
+// moves are checked one by one with Position::legal().
+template<GenType Type>
+Move* generate_legal(const Position& pos, Move* moveList) {
 
-    return moveList;
+    static_assert(Type != LEGAL, "Unsupported type in generate_legal()");
+    assert((Type == EVASIONS) == bool(pos.checkers()));
+
+    Color us = pos.side_to_move();
+
+    return us == WHITE ? generate_all<WHITE, Type, true>(pos, moveList)
+                       : generate_all<BLACK, Type, true>(pos, moveList);
 }
 
+template Move* generate_legal<CAPTURES>(const Position&, Move*);
+template Move* generate_legal<QUIETS>(const Position&, Move*);
+template Move* generate_legal<EVASIONS>(const Position&, Move*);
+template Move* generate_legal<NON_EVASIONS>(const Position&, Move*);
+
 }  // namespace Stockfish
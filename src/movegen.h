@@ -50,15 +50,17 @@ inline bool operator<(const ExtMove& f, const ExtMove& s) { return f.value < s.v
 
 template<GenType>
 Move* generate(const Position& pos, Move* moveList);
+template<GenType>
+Move* generate_legal(const Position& pos, Move* moveList);
 
 // The MoveList struct wraps the generate() function and returns a convenient
 // list of moves. Using MoveList is sometimes preferable to directly calling
-// the lower level generate() function.
-template<GenType T>
+// the lower level generate() function. With Legal, generate_legal() is used.
+template<GenType T, bool Legal = false>
 struct MoveList {
 
     explicit MoveList(const Position& pos) :
-        last(generate<T>(pos, moveList)) {}
+        last(Legal ? generate_legal<T>(pos, moveList) : generate<T>(pos, moveList)) {}
     const Move* begin() const { return moveList; }
     const Move* end() const { return last; }
     size_t      size() const { return last - moveList; }
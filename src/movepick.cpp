@@ -18,13 +18,21 @@
 
 #include "movepick.h"
 
+#include <algorithm>
 #include <cassert>
+#include <iterator>
 #include <limits>
 #include <utility>
 
+#if defined(USE_AVX2)
+    #include <immintrin.h>
+#endif
+
 #include "bitboard.h"
 #include "misc.h"
 #include "position.h"
+#include "profiler.h"
+#include "tt.h"
 
 namespace Stockfish {
 
@@ -58,20 +66,90 @@ enum Stages {
 
 
 // Sort moves in descending order up to and including a given limit.
-// The order of moves smaller than the limit is left unspecified.
+// The order of moves smaller than the limit is left unspecified. The place
+// of each move in the sorted part is found by a binary search, after the
+// moves of the same value, which orders the moves as a linear scan would.
 void partial_insertion_sort(ExtMove* begin, ExtMove* end, int limit) {
 
     for (ExtMove *sortedEnd = begin, *p = begin + 1; p < end; ++p)
         if (p->value >= limit)
         {
-            ExtMove tmp = *p, *q;
+            ExtMove tmp = *p;
             *p          = *++sortedEnd;
-            for (q = sortedEnd; q != begin && *(q - 1) < tmp; --q)
-                *q = *(q - 1);
+            ExtMove* q  = std::upper_bound(
+              begin, sortedEnd, tmp, [](const ExtMove& a, const ExtMove& b) { return b < a; });
+            std::move_backward(q, sortedEnd, sortedEnd + 1);
             *q = tmp;
         }
 }
 
+// The sum of the main history, twice, and of the continuation histories of each
+// quiet move, in a pass of its own over the whole list. With AVX2 eight moves are
+// done at once by gathering from each table by [piece][to] or by the raw move. The
+// gathers load the 32 bits that end with each 16-bit entry and keep the high half,
+// so that they stay in the table: no move has an index of zero, as there is no
+// piece slot 0 and no move from A1 to A1.
+template<typename MoveListT>
+void quiet_histories(const Position&         pos,
+                     const MoveListT&        ml,
+                     int*                    hist,
+                     const ButterflyHistory& mainHistory,
+                     const PieceToHistory**  contHist) {
+
+    static_assert(sizeof(PieceToHistory) == sizeof(int16_t) * PIECE_SLOT_NB * SQUARE_NB);
+
+    constexpr int Plies[] = {0, 1, 2, 3, 5};  // Of the continuation histories used
+    const Color   us      = pos.side_to_move();
+    const int     n       = int(ml.size());
+    int           pieceTo[MAX_MOVES], raw[MAX_MOVES];
+    int           i = 0;
+
+    for (Move move : ml)
+    {
+        pieceTo[i] = piece_slot(pos.moved_piece(move)) * SQUARE_NB + move.to_sq();
+        raw[i]     = move.raw();
+        assert(pieceTo[i] > 0 && raw[i] > 0);
+        ++i;
+    }
+
+    i = 0;
+
+#if defined(USE_AVX2)
+    const int* butterfly = reinterpret_cast<const int*>(&mainHistory[us][0]);
+    const int* cont[std::size(Plies)];
+    for (size_t k = 0; k < std::size(Plies); ++k)
+        cont[k] = reinterpret_cast<const int*>(contHist[Plies[k]]->data());
+
+    auto gather = [](const int* table, __m256i idx) {
+        const __m256i v =
+          _mm256_i32gather_epi32(table, _mm256_sub_epi32(idx, _mm256_set1_epi32(1)), 2);
+        return _mm256_srai_epi32(v, 16);
+    };
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256i pt = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pieceTo + i));
+        const __m256i mv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(raw + i));
+
+        __m256i sum = _mm256_slli_epi32(gather(butterfly, mv), 1);
+        for (const int* table : cont)
+            sum = _mm256_add_epi32(sum, gather(table, pt));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(hist + i), sum);
+    }
+#endif
+
+    for (; i < n; ++i)
+    {
+        const Piece  pc = pos.moved_piece(ml.begin()[i]);
+        const Square to = ml.begin()[i].to_sq();
+
+        hist[i] = 2 * mainHistory[us][raw[i]];
+        for (int ply : Plies)
+            hist[i] += (*contHist[ply])[pc][to];
+    }
+}
+
 }  // namespace
 
 
@@ -88,22 +166,28 @@ MovePicker::MovePicker(const Position&              p,
                        const CapturePieceToHistory* cph,
                        const PieceToHistory**       ch,
                        const SharedHistories*       sh,
-                       int                          pl) :
+                       int                          pl,
+                       const TranspositionTable*    t,
+                       bool                         legal) :
     pos(p),
     mainHistory(mh),
     lowPlyHistory(lph),
     captureHistory(cph),
     continuationHistory(ch),
     sharedHistory(sh),
+    tt(t),
     ttMove(ttm),
     depth(d),
-    ply(pl) {
+    ply(pl),
+    legalOnly(legal) {
+
+    const bool validTT = ttm && pos.pseudo_legal(ttm) && (!legalOnly || pos.legal(ttm));
 
     if (pos.checkers())
-        stage = EVASION_TT + !(ttm && pos.pseudo_legal(ttm));
+        stage = EVASION_TT + !validTT;
 
     else
-        stage = (depth > 0 ? MAIN_TT : QSEARCH_TT) + !(ttm && pos.pseudo_legal(ttm));
+        stage = (depth > 0 ? MAIN_TT : QSEARCH_TT) + !validTT;
 }
 
 // MovePicker constructor for ProbCut: we generate captures with Static Exchange
@@ -121,8 +205,8 @@ MovePicker::MovePicker(const Position& p, Move ttm, int th, const CapturePieceTo
 // Assigns a numerical value to each move in a list, used for sorting.
 // Captures are ordered by Most Valuable Victim (MVV), preferring captures
 // with a good history. Quiets moves are ordered using the history tables.
-template<GenType Type>
-ExtMove* MovePicker::score(MoveList<Type>& ml) {
+template<GenType Type, bool Legal>
+ExtMove* MovePicker::score(const MoveList<Type, Legal>& ml) {
 
     static_assert(Type == CAPTURES || Type == QUIETS || Type == EVASIONS, "Wrong type");
 
@@ -139,6 +223,10 @@ ExtMove* MovePicker::score(MoveList<Type>& ml) {
         threatByLesser[KING]  = pos.attacks_by<QUEEN>(~us) | threatByLesser[QUEEN];
     }
 
+    [[maybe_unused]] int hist[MAX_MOVES];
+    if constexpr (Type == QUIETS)
+        quiet_histories(pos, ml, hist, *mainHistory, continuationHistory);
+
     ExtMove* it = cur;
     for (auto move : ml)
     {
@@ -158,16 +246,11 @@ ExtMove* MovePicker::score(MoveList<Type>& ml) {
         else if constexpr (Type == QUIETS)
         {
             // histories
-            m.value = 2 * (*mainHistory)[us][m.raw()];
+            m.value = hist[&m - cur];
             m.value += 2 * sharedHistory->pawn_entry(pos)[pc][to];
-            m.value += (*continuationHistory[0])[pc][to];
-            m.value += (*continuationHistory[1])[pc][to];
-            m.value += (*continuationHistory[2])[pc][to];
-            m.value += (*continuationHistory[3])[pc][to];
-            m.value += (*continuationHistory[5])[pc][to];
 
             // bonus for checks
-            m.value += (bool(pos.check_squares(pt) & to) && pos.see_ge(m, -75)) * 16384;
+            m.value += (bool(pos.check_squares(pt) & to) && pos.see_ge(m, -75, seeCache)) * 16384;
 
             // penalty for moving to a square threatened by a lesser piece
             // or bonus for escaping an attack by a lesser piece.
@@ -190,6 +273,12 @@ ExtMove* MovePicker::score(MoveList<Type>& ml) {
     return it;
 }
 
+template<GenType Type>
+ExtMove* MovePicker::generate_and_score() {
+    Profiler::ScopedPhase timer(Profiler::MoveGeneration);
+    return legalOnly ? score(MoveList<Type, true>(pos)) : score(MoveList<Type>(pos));
+}
+
 // Returns the next move satisfying a predicate function.
 // This never returns the TT move, as it was emitted before.
 template<typename Pred>
@@ -197,7 +286,16 @@ Move MovePicker::select(Pred filter) {
 
     for (; cur < endCur; ++cur)
         if (*cur != ttMove && filter())
+        {
+#ifndef NO_PREFETCH
+            // The moves are sorted already, so the next one is likely the next to be
+            // searched. Start loading its TT cluster while this move is being searched,
+            // which gives the memory far more time than the prefetch in do_move().
+            if (tt && cur + 1 < endCur)
+                prefetch(tt->first_entry(pos.key_after(cur[1])));
+#endif
             return *cur++;
+        }
 
     return Move::none();
 }
@@ -222,10 +320,8 @@ top:
     case CAPTURE_INIT :
     case PROBCUT_INIT :
     case QCAPTURE_INIT : {
-        MoveList<CAPTURES> ml(pos);
-
         cur = endBadCaptures = moves;
-        endCur = endCaptures = score<CAPTURES>(ml);
+        endCur = endCaptures = generate_and_score<CAPTURES>();
 
         partial_insertion_sort(cur, endCur, std::numeric_limits<int>::min());
         ++stage;
@@ -234,7 +330,7 @@ top:
 
     case GOOD_CAPTURE :
         if (select([&]() {
-                if (pos.see_ge(*cur, -cur->value / 18))
+                if (pos.see_ge(*cur, -cur->value / 18, seeCache))
                     return true;
                 std::swap(*endBadCaptures++, *cur);
                 return false;
@@ -247,9 +343,7 @@ top:
     case QUIET_INIT :
         if (!skipQuiets)
         {
-            MoveList<QUIETS> ml(pos);
-
-            endCur = endGenerated = score<QUIETS>(ml);
+            endCur = endGenerated = generate_and_score<QUIETS>();
 
             partial_insertion_sort(cur, endCur, -3560 * depth);
         }
@@ -286,10 +380,8 @@ top:
         return Move::none();
 
     case EVASION_INIT : {
-        MoveList<EVASIONS> ml(pos);
-
         cur    = moves;
-        endCur = endGenerated = score<EVASIONS>(ml);
+        endCur = endGenerated = generate_and_score<EVASIONS>();
 
         partial_insertion_sort(cur, endCur, std::numeric_limits<int>::min());
         ++stage;
@@ -301,7 +393,7 @@ top:
         return select([]() { return true; });
 
     case PROBCUT :
-        return select([&]() { return pos.see_ge(*cur, threshold); });
+        return select([&]() { return pos.see_ge(*cur, threshold, seeCache); });
     }
 
     assert(false);
@@ -26,13 +26,15 @@
 namespace Stockfish {
 
 class Position;
+class TranspositionTable;
 
 // The MovePicker class is used to pick one pseudo-legal move at a time from the
 // current position. The most important method is next_move(), which emits one
 // new pseudo-legal move on every call, until there are no moves left, when
-// Move::none() is returned. In order to improve the efficiency of the alpha-beta
-// algorithm, MovePicker attempts to return the moves which are most likely to get
-// a cut-off first.
+// Move::none() is returned. If constructed with legalOnly, the moves are all
+// legal. In order to improve the efficiency of the alpha-beta algorithm,
+// MovePicker attempts to return the moves which are most likely to get a
+// cut-off first.
 class MovePicker {
 
    public:
@@ -46,7 +48,9 @@ class MovePicker {
                const CapturePieceToHistory*,
                const PieceToHistory**,
                const SharedHistories*,
-               int);
+               int,
+               const TranspositionTable* = nullptr,
+               bool                      = false);
     MovePicker(const Position&, Move, int, const CapturePieceToHistory*);
     Move next_move();
     void skip_quiet_moves();
@@ -54,8 +58,10 @@ class MovePicker {
    private:
     template<typename Pred>
     Move select(Pred);
+    template<GenType T, bool Legal>
+    ExtMove* score(const MoveList<T, Legal>&);
     template<GenType T>
-    ExtMove* score(MoveList<T>&);
+    ExtMove* generate_and_score();
     ExtMove* begin() { return cur; }
     ExtMove* end() { return endCur; }
 
@@ -65,6 +71,7 @@ class MovePicker {
     const CapturePieceToHistory* captureHistory;
     const PieceToHistory**       continuationHistory;
     const SharedHistories*       sharedHistory;
+    const TranspositionTable*    tt = nullptr;
     Move                         ttMove;
     ExtMove *                    cur, *endCur, *endBadCaptures, *endCaptures, *endGenerated;
     int                          stage;
@@ -72,6 +79,8 @@ class MovePicker {
     Depth                        depth;
     int                          ply;
     bool                         skipQuiets = false;
+    bool                         legalOnly  = false;  // Only legal moves, see generate_legal()
+    SeeCache                     seeCache;  // Shared by the see_ge() of all the moves
     ExtMove                      moves[MAX_MOVES];
 };
 
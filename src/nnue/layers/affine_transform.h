@@ -190,10 +190,87 @@ class AffineTransform {
         return h;
     }
 
+#if defined(USE_AMX)
+    // propagate_amx() handles 16 rows of inputs, AmxInputStride bytes apart, at once
+    static constexpr IndexType AmxRows        = 16;
+    static constexpr IndexType AmxInputStride = 64;
+    static constexpr IndexType AmxInputBytes  = ceil_to_multiple<IndexType>(InputDimensions, 8);
+
+    static constexpr bool CanUseAMX = OutputDimensions % 16 == 0 && AmxInputBytes <= 64;
+
+    // Tile 0 holds 16 outputs of each row, tile 1 the input rows and tile 2 the weights
+    static constexpr SIMD::TileConfig AmxConfig = {
+      1, 0, {}, {64, std::uint16_t(AmxInputBytes), 64}, {16, 16, std::uint8_t(AmxInputBytes / 4)}};
+
+    // Propagates AmxRows inputs, typically of different positions, to AmxRows rows of
+    // OutputDimensions outputs. The scrambled weights are rows of 4 consecutive inputs
+    // for each output, which is the layout tdpbusd expects for its weight operand, so
+    // each block of 16 outputs takes one tile multiply. A tile multiply is slower than
+    // propagate() for a single row, so this only pays off for batches.
+    void propagate_amx(const InputType* input, OutputType* output) const {
+        static_assert(CanUseAMX);
+
+        SIMD::amx_configure(AmxConfig);
+
+        _tile_loadd(1, input, AmxInputStride);
+
+        for (IndexType k = 0; k < OutputDimensions / 16; ++k)
+        {
+            // A zero stride repeats the biases in every row
+            _tile_loadd(0, &biases[16 * k], 0);
+            _tile_loadd(2, &weights[64 * k], OutputDimensions * 4);
+            _tile_dpbusd(0, 1, 2);
+            _tile_stored(0, &output[16 * k], OutputDimensions * 4);
+        }
+
+        SIMD::amx_release();
+    }
+#endif
+
     // Forward propagation
     void propagate(const InputType* input, OutputType* output) const {
 
-#ifdef ENABLE_SEQ_OPT
+#if defined(USE_SVE2)
+
+        if constexpr (OutputDimensions > 1)
+        {
+            constexpr IndexType NumChunks = ceil_to_multiple<IndexType>(InputDimensions, 8) / 4;
+
+            const auto input32   = reinterpret_cast<const std::int32_t*>(input);
+            const auto weights32 = reinterpret_cast<const std::int32_t*>(weights);
+
+            // The registers hold a vector-length dependent number of outputs, so the
+            // outputs are done one register at a time, each over all input chunks.
+            for (IndexType k = 0; k < OutputDimensions; k += svcntw())
+            {
+                const svbool_t pg  = svwhilelt_b32(k, OutputDimensions);
+                svint32_t      acc = svld1(pg, &biases[k]);
+
+                for (IndexType i = 0; i < NumChunks; ++i)
+                {
+                    const svint8_t in0 = svreinterpret_s8(svdup_n_s32(input32[i]));
+                    const svint8_t col0 =
+                      svreinterpret_s8(svld1(pg, &weights32[i * OutputDimensions + k]));
+                    acc = svdot(acc, in0, col0);
+                }
+
+                svst1(pg, &output[k], acc);
+            }
+        }
+        else if constexpr (OutputDimensions == 1)
+        {
+            svint32_t sum = svdup_n_s32(0);
+
+            for (IndexType j = 0; j < PaddedInputDimensions; j += svcntb())
+            {
+                const svbool_t pg = svwhilelt_b8(j, PaddedInputDimensions);
+                sum = svdot(sum, svreinterpret_s8(svld1(pg, &input[j])), svld1(pg, &weights[j]));
+            }
+
+            output[0] = std::int32_t(svaddv(svptrue_b32(), sum)) + biases[0];
+        }
+
+#elif defined(ENABLE_SEQ_OPT)
 
         if constexpr (OutputDimensions > 1)
         {
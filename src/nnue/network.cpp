@@ -18,11 +18,21 @@
 
 #include "network.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <optional>
+#include <sstream>
+#include <string_view>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #define INCBIN_SILENCE_BITCODE_WARNING
@@ -30,6 +40,7 @@
 
 #include "../evaluate.h"
 #include "../misc.h"
+#include "../movegen.h"
 #include "../position.h"
 #include "../types.h"
 #include "nnue_architecture.h"
@@ -43,7 +54,12 @@
 //     const unsigned char *const gEmbeddedNNUEEnd;     // a marker to the end
 //     const unsigned int         gEmbeddedNNUESize;    // the size of the embedded file
 // Note that this does not work in Microsoft Visual Studio.
-#if !defined(_MSC_VER) && !defined(NNUE_EMBEDDING_OFF)
+// In a dispatch build the nets are embedded once, by dispatch.cpp, and shared
+// by all the ISA variants.
+#if !defined(_MSC_VER) && !defined(NNUE_EMBEDDING_OFF) && defined(USE_DISPATCH)
+INCBIN_EXTERN(unsigned char, EmbeddedNNUEBig);
+INCBIN_EXTERN(unsigned char, EmbeddedNNUESmall);
+#elif !defined(_MSC_VER) && !defined(NNUE_EMBEDDING_OFF)
 INCBIN(EmbeddedNNUEBig, EvalFileDefaultNameBig);
 INCBIN(EmbeddedNNUESmall, EvalFileDefaultNameSmall);
 #else
@@ -78,6 +94,42 @@ EmbeddedNNUE get_embedded(EmbeddedNNUEType type) {
         return EmbeddedNNUE(gEmbeddedNNUESmallData, gEmbeddedNNUESmallEnd, gEmbeddedNNUESmallSize);
 }
 
+// A network image is a snapshot of the parameters exactly as they are laid out
+// in memory after loading, i.e. already decompressed and permuted for the SIMD
+// kernels of the build that wrote it. Loading one is a single bulk read, so it
+// is only valid for the same architecture, which is recorded in the header.
+constexpr char          ImageMagic[8]   = {'S', 'F', 'N', 'N', 'I', 'M', 'G', '1'};
+constexpr std::uint32_t ImageHeaderSize = 4096;
+
+struct ImageHeader {
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t hash;
+    std::uint64_t parametersSize;
+    std::uint64_t parametersHash;
+    char          arch[64];
+    char          description[256];
+};
+
+static_assert(sizeof(ImageHeader) <= ImageHeaderSize);
+
+// Bytes a layer reads and writes per call: its inputs, its outputs and its
+// parameters, which are the only data members of the affine layers
+template<typename Layer>
+constexpr std::size_t layer_bytes() {
+    return Layer::InputDimensions * sizeof(typename Layer::InputType)
+         + Layer::OutputDimensions * sizeof(typename Layer::OutputType)
+         + (std::is_empty_v<Layer> ? 0 : sizeof(Layer));
+}
+
+const char* image_arch() {
+#if defined(ARCH)
+    return stringify(ARCH);
+#else
+    return "unknown";
+#endif
+}
+
 }
 
 
@@ -189,6 +241,376 @@ Network<Arch, Transformer>::evaluate(const Position&                         pos
 }
 
 
+// Evaluates unrelated positions, with the results in the order of the input. The
+// positions are evaluated sorted by layer stack and king squares, so that the refresh
+// cache entries, which are per king square, need only small updates from one position
+// to the next, and the weights of a layer stack stay in cache while it is in use.
+template<typename Arch, typename Transformer>
+void Network<Arch, Transformer>::evaluate_batch(
+  const std::vector<const Position*>&     positions,
+  AccumulatorStack&                       accumulatorStack,
+  AccumulatorCaches::Cache<FTDimensions>& cache,
+  std::vector<NetworkOutput>&             outputs) const {
+
+    constexpr uint64_t alignment = CacheLineSize;
+
+    alignas(alignment)
+      TransformedFeatureType transformedFeatures[FeatureTransformer<FTDimensions>::BufferSize];
+
+    ASSERT_ALIGNED(transformedFeatures, alignment);
+
+    auto bucket_of = [&](std::size_t i) { return (positions[i]->count<ALL_PIECES>() - 1) / 4; };
+
+    std::vector<std::pair<int, std::size_t>> order;
+    order.reserve(positions.size());
+
+    for (std::size_t i = 0; i < positions.size(); ++i)
+        order.emplace_back((bucket_of(i) * SQUARE_NB + positions[i]->square<KING>(WHITE))
+                               * SQUARE_NB
+                             + positions[i]->square<KING>(BLACK),
+                           i);
+
+    std::sort(order.begin(), order.end());
+
+    outputs.resize(positions.size());
+
+#if defined(USE_AMX)
+    // Positions with the same layer stack go through it together, BatchSize at a time
+    if (SIMD::UseAMX)
+    {
+        constexpr IndexType BatchSize = Arch::BatchSize;
+
+        struct alignas(alignment) Features {
+            TransformedFeatureType data[FeatureTransformer<FTDimensions>::BufferSize];
+        };
+
+        auto features = std::make_unique<Features[]>(BatchSize);
+
+        for (std::size_t first = 0; first < order.size();)
+        {
+            const int                     bucket = bucket_of(order[first].second);
+            const TransformedFeatureType* rows[BatchSize];
+            std::int32_t                  psqt[BatchSize], positional[BatchSize];
+            IndexType                     count = 0;
+
+            for (; count < BatchSize && first + count < order.size()
+                   && bucket_of(order[first + count].second) == bucket;
+                 ++count)
+            {
+                accumulatorStack.reset();
+                psqt[count] = featureTransformer.transform(*positions[order[first + count].second],
+                                                           accumulatorStack, cache,
+                                                           features[count].data, bucket);
+                rows[count] = features[count].data;
+            }
+
+            // Fill a partial batch with copies of its first position
+            for (IndexType j = count; j < BatchSize; ++j)
+                rows[j] = rows[0];
+
+            network[bucket].propagate_batch(rows, positional);
+
+            for (IndexType j = 0; j < count; ++j)
+                outputs[order[first + j].second] = {
+                  static_cast<Value>(psqt[j] / OutputScale),
+                  static_cast<Value>(positional[j] / OutputScale)};
+
+            first += count;
+        }
+
+        return;
+    }
+#endif
+
+    for (const auto& entry : order)
+    {
+        const std::size_t i      = entry.second;
+        const int         bucket = bucket_of(i);
+
+        // The positions are unrelated, so the accumulators are refreshed via the cache
+        accumulatorStack.reset();
+
+        const auto psqt = featureTransformer.transform(*positions[i], accumulatorStack, cache,
+                                                       transformedFeatures, bucket);
+        const auto positional = network[bucket].propagate(transformedFeatures);
+        outputs[i] = {static_cast<Value>(psqt / OutputScale),
+                      static_cast<Value>(positional / OutputScale)};
+    }
+}
+
+
+// Times the feature transformer stages and each layer of the layer stacks in
+// isolation, on the inputs they get when evaluating the given positions, and
+// reports the average ns and bytes moved per position. The accumulator update
+// is timed for the first non-king legal move of each position. With AMX, fc_1
+// is also timed with the batched kernel used by evaluate_batch().
+template<typename Arch, typename Transformer>
+std::string Network<Arch, Transformer>::benchmark_layers(
+  const std::vector<const Position*>&     positions,
+  AccumulatorStack&                       accumulatorStack,
+  AccumulatorCaches::Cache<FTDimensions>& cache) const {
+
+    constexpr int Rounds = 10000;
+
+    // The input of each layer for one position, as in NetworkArchitecture::propagate()
+    struct alignas(CacheLineSize) LayerInputs {
+        alignas(CacheLineSize)
+          TransformedFeatureType transformed[FeatureTransformer<FTDimensions>::BufferSize];
+        alignas(CacheLineSize) typename decltype(Arch::fc_0)::OutputBuffer fc_0_out;
+        alignas(CacheLineSize) typename decltype(Arch::ac_sqr_0)::OutputType
+          ac_sqr_0_out[ceil_to_multiple<IndexType>(Arch::FC_0_OUTPUTS * 2, 32)];
+        alignas(CacheLineSize) typename decltype(Arch::fc_1)::OutputBuffer fc_1_out;
+        alignas(CacheLineSize) typename decltype(Arch::ac_1)::OutputBuffer ac_1_out;
+        int bucket;
+    };
+
+    // Outputs are written here, then one value is summed so the calls are not elided
+    struct alignas(CacheLineSize) LayerOutputs {
+        alignas(CacheLineSize) std::int32_t wide[FeatureTransformer<FTDimensions>::BufferSize];
+        alignas(CacheLineSize) std::uint8_t narrow[FeatureTransformer<FTDimensions>::BufferSize];
+    };
+
+    std::vector<LayerInputs> inputs(positions.size());
+    auto                     outputs = std::make_unique<LayerOutputs>();
+
+    std::stringstream ss;
+    std::int64_t      sink = 0;
+
+    ss << "Stages of the " << (embeddedType == EmbeddedNNUEType::BIG ? "big" : "small")
+       << " net over " << positions.size() << " positions, per position:\n"
+       << std::left << std::setw(16) << "stage" << std::right << std::setw(10) << "ns"
+       << std::setw(10) << "bytes";
+
+    auto report = [&](const char* name, double ns, double bytes) {
+        ss << "\n"
+           << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(2)
+           << std::setw(10) << ns << std::setprecision(0) << std::setw(10) << bytes;
+    };
+
+    // Bytes read and written by the feature transformer: a weight column per
+    // feature added or removed, and the accumulators it starts from and updates.
+    // The cache entries of both kings are cleared before each refresh, so it is a
+    // rebuild from scratch.
+    constexpr bool UseThreats = FTDimensions == TransformedFeatureDimensionsBig;
+
+    const std::size_t psqColumn = FTDimensions * sizeof(featureTransformer.weights[0])
+                                + PSQTBuckets * sizeof(featureTransformer.psqtWeights[0]);
+    const std::size_t threatColumn =
+      UseThreats ? FTDimensions * sizeof(featureTransformer.threatWeights[0])
+                     + PSQTBuckets * sizeof(featureTransformer.threatPsqtWeights[0])
+                 : 0;
+    const std::size_t accumulatorSize =
+      (1 + UseThreats) * (FTDimensions * sizeof(BiasType) + PSQTBuckets * sizeof(std::int32_t));
+
+    constexpr int FTRounds = 1000;
+
+    double refreshNs = 0, refreshBytes = 0, updateNs = 0, updateBytes = 0, transformNs = 0,
+           transformBytes = 0;
+
+    for (const Position* p : positions)
+    {
+        StateInfo    st[2];
+        Position     pos;
+        Move         move   = Move::none();
+        const int    bucket = (p->count<ALL_PIECES>() - 1) / 4;
+        DirtyPiece   savedDp;
+        DirtyThreats savedDts;
+
+        pos.set(p->fen(), p->is_chess960(), &st[0]);
+
+        for (const auto& m : MoveList<LEGAL>(pos))
+            if (type_of(pos.moved_piece(m)) != KING)
+            {
+                move = m;
+                break;
+            }
+
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < FTRounds; ++r)
+        {
+            for (Color c : {WHITE, BLACK})
+            {
+                cache[pos.square<KING>(c)][c].clear(featureTransformer.biases);
+                if (UseThreats)
+                    cache.threat_entry(pos.square<KING>(c), c).clear();
+            }
+            accumulatorStack.reset();
+            accumulatorStack.evaluate(pos, featureTransformer, cache);
+        }
+        refreshNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now()
+                                                              - start)
+                       .count();
+
+        for (Color c : {WHITE, BLACK})
+        {
+            PSQFeatureSet::IndexList    psqActive;
+            ThreatFeatureSet::IndexList threatActive;
+            PSQFeatureSet::append_active_indices(c, pos, psqActive);
+            if (UseThreats)
+                ThreatFeatureSet::append_active_indices(c, pos, threatActive);
+            refreshBytes +=
+              psqActive.size() * psqColumn + threatActive.size() * threatColumn + accumulatorSize;
+        }
+
+        if (move != Move::none())
+        {
+            auto [dp, dts] = accumulatorStack.push();
+            pos.do_move(move, st[1], pos.gives_check(move), dp, dts, nullptr, nullptr);
+            savedDp  = dp;
+            savedDts = dts;
+
+            start = std::chrono::steady_clock::now();
+            for (int r = 0; r < FTRounds; ++r)
+            {
+                accumulatorStack.pop();
+                auto [rdp, rdts] = accumulatorStack.push();
+                rdp              = savedDp;
+                rdts             = savedDts;
+                accumulatorStack.evaluate(pos, featureTransformer, cache);
+            }
+            updateNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now()
+                                                                 - start)
+                          .count();
+
+            for (Color c : {WHITE, BLACK})
+            {
+                const Square                ksq = pos.square<KING>(c);
+                PSQFeatureSet::IndexList    psqRemoved, psqAdded;
+                ThreatFeatureSet::IndexList threatRemoved, threatAdded;
+                PSQFeatureSet::append_changed_indices(c, ksq, savedDp, psqRemoved, psqAdded);
+                if (UseThreats)
+                    ThreatFeatureSet::append_changed_indices(c, ksq, savedDts, threatRemoved,
+                                                             threatAdded);
+                updateBytes += (psqRemoved.size() + psqAdded.size()) * psqColumn
+                             + (threatRemoved.size() + threatAdded.size()) * threatColumn
+                             + 2 * accumulatorSize;
+            }
+        }
+
+        // The accumulators are now up to date, so this is only the output conversion
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < FTRounds; ++r)
+            sink += featureTransformer.transform(pos, accumulatorStack, cache, outputs->narrow,
+                                                 bucket);
+        transformNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now()
+                                                                - start)
+                         .count();
+        transformBytes += 2 * accumulatorSize + Transformer::BufferSize;
+    }
+
+    const double count = double(std::max<std::size_t>(positions.size(), 1));
+
+    report("ft refresh", refreshNs / (FTRounds * count), refreshBytes / count);
+    report("ft update", updateNs / (FTRounds * count), updateBytes / count);
+    report("ft transform", transformNs / (FTRounds * count), transformBytes / count);
+
+    for (std::size_t i = 0; i < positions.size(); ++i)
+    {
+        LayerInputs& in   = inputs[i];
+        const auto&  arch = network[in.bucket = (positions[i]->count<ALL_PIECES>() - 1) / 4];
+
+        accumulatorStack.reset();
+        featureTransformer.transform(*positions[i], accumulatorStack, cache, in.transformed,
+                                     in.bucket);
+
+        arch.fc_0.propagate(in.transformed, in.fc_0_out);
+        arch.ac_sqr_0.propagate(in.fc_0_out, in.ac_sqr_0_out);
+        arch.ac_0.propagate(in.fc_0_out, outputs->narrow);
+        std::memcpy(in.ac_sqr_0_out + Arch::FC_0_OUTPUTS, outputs->narrow,
+                    Arch::FC_0_OUTPUTS * sizeof(typename decltype(arch.ac_0)::OutputType));
+        arch.fc_1.propagate(in.ac_sqr_0_out, in.fc_1_out);
+        arch.ac_1.propagate(in.fc_1_out, in.ac_1_out);
+    }
+
+    auto time = [&](const char* name, auto&& propagate, std::size_t bytes,
+                    IndexType rowsPerCall = 1) {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (int r = 0; r < Rounds; ++r)
+            for (const LayerInputs& in : inputs)
+                sink += propagate(network[in.bucket], in);
+
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+
+        report(name, double(ns) / (double(Rounds) * rowsPerCall * count),
+               double(bytes) / rowsPerCall);
+    };
+
+    auto fc_0 = [&](const Arch& arch, const LayerInputs& in) {
+        arch.fc_0.propagate(in.transformed, outputs->wide);
+        return outputs->wide[0];
+    };
+    auto ac_sqr_0 = [&](const Arch& arch, const LayerInputs& in) {
+        arch.ac_sqr_0.propagate(in.fc_0_out, outputs->narrow);
+        return outputs->narrow[0];
+    };
+    auto ac_0 = [&](const Arch& arch, const LayerInputs& in) {
+        arch.ac_0.propagate(in.fc_0_out, outputs->narrow);
+        return outputs->narrow[0];
+    };
+    auto fc_1 = [&](const Arch& arch, const LayerInputs& in) {
+        arch.fc_1.propagate(in.ac_sqr_0_out, outputs->wide);
+        return outputs->wide[0];
+    };
+    auto ac_1 = [&](const Arch& arch, const LayerInputs& in) {
+        arch.ac_1.propagate(in.fc_1_out, outputs->narrow);
+        return outputs->narrow[0];
+    };
+    auto fc_2 = [&](const Arch& arch, const LayerInputs& in) {
+        arch.fc_2.propagate(in.ac_1_out, outputs->wide);
+        return outputs->wide[0];
+    };
+
+    time("fc_0", fc_0, layer_bytes<decltype(Arch::fc_0)>());
+    time("ac_sqr_0", ac_sqr_0, layer_bytes<decltype(Arch::ac_sqr_0)>());
+    time("ac_0", ac_0, layer_bytes<decltype(Arch::ac_0)>());
+
+    time("fc_1", fc_1, layer_bytes<decltype(Arch::fc_1)>());
+
+#if defined(USE_AMX)
+    // The AMX kernel takes the rows of Arch::BatchSize consecutive positions per call
+    if (SIMD::UseAMX)
+    {
+        constexpr IndexType BatchSize = Arch::BatchSize;
+        constexpr IndexType RowStride = decltype(Arch::fc_1)::AmxInputStride;
+
+        struct alignas(CacheLineSize) Rows {
+            typename decltype(Arch::ac_sqr_0)::OutputType data[BatchSize][RowStride];
+        };
+
+        std::vector<Rows> rows(inputs.size());
+
+        // The output of a call has BatchSize rows, more than outputs->wide may hold
+        alignas(CacheLineSize) typename decltype(Arch::fc_1)::OutputType
+          tileOutputs[BatchSize][Arch::FC_1_OUTPUTS];
+
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+            for (IndexType j = 0; j < BatchSize; ++j)
+                std::memcpy(rows[i].data[j], inputs[(i + j) % inputs.size()].ac_sqr_0_out,
+                            sizeof(inputs[0].ac_sqr_0_out));
+
+        auto fc_1_amx = [&](const Arch& arch, const LayerInputs& in) {
+            arch.fc_1.propagate_amx(rows[&in - &inputs[0]].data[0], tileOutputs[0]);
+            return tileOutputs[0][0];
+        };
+
+        time("fc_1 (AMX)", fc_1_amx, BatchSize * layer_bytes<decltype(Arch::fc_1)>(), BatchSize);
+    }
+#endif
+
+    time("ac_1", ac_1, layer_bytes<decltype(Arch::ac_1)>());
+    time("fc_2", fc_2, layer_bytes<decltype(Arch::fc_2)>());
+
+    // Never true, but keeps the compiler from discarding the results
+    if (sink == std::numeric_limits<std::int64_t>::min())
+        ss << " ";
+
+    return ss.str();
+}
+
+
 template<typename Arch, typename Transformer>
 void Network<Arch, Transformer>::verify(std::string                                  evalfilePath,
                                         const std::function<void(std::string_view)>& f) const {
@@ -259,11 +681,48 @@ Network<Arch, Transformer>::trace_evaluate(const Position&
 }
 
 
+template<typename Arch, typename Transformer>
+bool Network<Arch, Transformer>::save_image(const std::string& filename) const {
+    static_assert(std::is_trivially_copyable_v<Transformer> && std::is_trivially_copyable_v<Arch>);
+
+    if (!initialized || std::string(evalFile.current) == "None")
+        return false;
+
+    ImageHeader header{};
+    std::memcpy(header.magic, ImageMagic, sizeof(ImageMagic));
+    header.version        = Version;
+    header.hash           = Network::hash;
+    header.parametersSize = sizeof(Transformer) + sizeof(Arch) * LayerStacks;
+    header.parametersHash = parametersHash;
+    // The header is zeroed, so the copies stay null terminated
+    const std::string_view arch = image_arch(), desc = evalFile.netDescription;
+    std::memcpy(header.arch, arch.data(), std::min(arch.size(), sizeof(header.arch) - 1));
+    std::memcpy(header.description, desc.data(),
+                std::min(desc.size(), sizeof(header.description) - 1));
+
+    std::ofstream stream(filename, std::ios_base::binary);
+    std::vector<char> padding(ImageHeaderSize - sizeof(header), 0);
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(padding.data(), padding.size());
+    stream.write(reinterpret_cast<const char*>(&featureTransformer), sizeof(Transformer));
+    for (std::size_t i = 0; i < LayerStacks; ++i)
+        stream.write(reinterpret_cast<const char*>(&network[i]), sizeof(Arch));
+
+    return bool(stream);
+}
+
+
 template<typename Arch, typename Transformer>
 void Network<Arch, Transformer>::load_user_net(const std::string& dir,
                                                const std::string& evalfilePath) {
     std::ifstream stream(dir + evalfilePath, std::ios::binary);
-    auto          description = load(stream);
+    char          magic[sizeof(ImageMagic)] = {};
+    stream.read(magic, sizeof(magic));
+    stream.clear();
+    stream.seekg(0);
+
+    auto description = std::memcmp(magic, ImageMagic, sizeof(magic)) == 0 ? load_image(stream)
+                                                                           : load(stream);
 
     if (description.has_value())
     {
@@ -322,19 +781,62 @@ std::optional<std::string> Network<Arch, Transformer>::load(std::istream& stream
     initialize();
     std::string description;
 
-    return read_parameters(stream, description) ? std::make_optional(description) : std::nullopt;
+    bool success   = read_parameters(stream, description);
+    parametersHash = hash_parameters();
+
+    return success ? std::make_optional(description) : std::nullopt;
 }
 
 
 template<typename Arch, typename Transformer>
-std::size_t Network<Arch, Transformer>::get_content_hash() const {
-    if (!initialized)
-        return 0;
+std::optional<std::string> Network<Arch, Transformer>::load_image(std::istream& stream) {
+    ImageHeader header;
+    stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+    stream.ignore(ImageHeaderSize - sizeof(header));
+
+    header.arch[sizeof(header.arch) - 1]               = '\0';
+    header.description[sizeof(header.description) - 1] = '\0';
+
+    if (!stream || header.version != Version || header.hash != Network::hash
+        || header.parametersSize != sizeof(Transformer) + sizeof(Arch) * LayerStacks
+        || std::string(header.arch) != image_arch())
+        return std::nullopt;
 
+    initialize();
+
+    // The parameters are read directly into place, no conversion is needed
+    stream.read(reinterpret_cast<char*>(&featureTransformer), sizeof(Transformer));
+    for (std::size_t i = 0; i < LayerStacks; ++i)
+        stream.read(reinterpret_cast<char*>(&network[i]), sizeof(Arch));
+
+    parametersHash = hash_parameters();
+
+    // A truncated or corrupted image does not match the hash it was saved with
+    if (!stream || stream.peek() != std::ios::traits_type::eof()
+        || parametersHash != header.parametersHash)
+        return std::nullopt;
+
+    return std::make_optional(std::string(header.description));
+}
+
+
+template<typename Arch, typename Transformer>
+std::size_t Network<Arch, Transformer>::hash_parameters() const {
     std::size_t h = 0;
     hash_combine(h, featureTransformer);
     for (auto&& layerstack : network)
         hash_combine(h, layerstack);
+    return h;
+}
+
+
+template<typename Arch, typename Transformer>
+std::size_t Network<Arch, Transformer>::get_content_hash() const {
+    if (!initialized)
+        return 0;
+
+    // Hashing the parameters is expensive, so it is done once at load time
+    std::size_t h = parametersHash;
     hash_combine(h, evalFile);
     hash_combine(h, static_cast<int>(embeddedType));
     return h;
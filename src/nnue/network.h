@@ -29,6 +29,7 @@
 #include <string_view>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include "../misc.h"
 #include "../types.h"
@@ -71,6 +72,7 @@ class Network {
 
     void load(const std::string& rootDirectory, std::string evalfilePath);
     bool save(const std::optional<std::string>& filename) const;
+    bool save_image(const std::string& filename) const;
 
     std::size_t get_content_hash() const;
 
@@ -78,6 +80,14 @@ class Network {
                            AccumulatorStack&                       accumulatorStack,
                            AccumulatorCaches::Cache<FTDimensions>& cache) const;
 
+    void evaluate_batch(const std::vector<const Position*>&     positions,
+                        AccumulatorStack&                       accumulatorStack,
+                        AccumulatorCaches::Cache<FTDimensions>& cache,
+                        std::vector<NetworkOutput>&             outputs) const;
+
+    std::string benchmark_layers(const std::vector<const Position*>&     positions,
+                                 AccumulatorStack&                       accumulatorStack,
+                                 AccumulatorCaches::Cache<FTDimensions>& cache) const;
 
     void verify(std::string evalfilePath, const std::function<void(std::string_view)>&) const;
     NnueEvalTrace trace_evaluate(const Position&                         pos,
@@ -92,6 +102,8 @@ class Network {
 
     bool                       save(std::ostream&, const std::string&, const std::string&) const;
     std::optional<std::string> load(std::istream&);
+    std::optional<std::string> load_image(std::istream&);
+    std::size_t                hash_parameters() const;
 
     bool read_header(std::istream&, std::uint32_t*, std::string*) const;
     bool write_header(std::ostream&, std::uint32_t, const std::string&) const;
@@ -110,6 +122,9 @@ class Network {
 
     bool initialized = false;
 
+    // Hash of the parameters, computed once when they are loaded
+    std::size_t parametersHash = 0;
+
     // Hash value of evaluation function structure
     static constexpr std::uint32_t hash = Transformer::get_hash_value() ^ Arch::get_hash_value();
 
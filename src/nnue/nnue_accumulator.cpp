@@ -18,14 +18,20 @@
 
 #include "nnue_accumulator.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
+#include <iomanip>
 #include <new>
+#include <sstream>
+#include <string>
 #include <type_traits>
 
 #include "../bitboard.h"
 #include "../misc.h"
 #include "../position.h"
+#include "../profiler.h"
 #include "../types.h"
 #include "features/half_ka_v2_hm.h"
 #include "nnue_architecture.h"
@@ -72,15 +78,62 @@ void update_accumulator_refresh_cache(Color                                 pers
                                       AccumulatorCaches::Cache<Dimensions>& cache);
 
 template<IndexType Dimensions>
-void update_threats_accumulator_full(Color                                 perspective,
-                                     const FeatureTransformer<Dimensions>& featureTransformer,
-                                     const Position&                       pos,
-                                     AccumulatorState<ThreatFeatureSet>&   accumulatorState);
+void update_threats_accumulator_refresh_cache(
+  Color                                 perspective,
+  const FeatureTransformer<Dimensions>& featureTransformer,
+  const Position&                       pos,
+  AccumulatorState<ThreatFeatureSet>&   accumulatorState,
+  AccumulatorCaches::Cache<Dimensions>& cache);
+
+// Optional statistics of the refreshes, compiled in with -DNNUE_STATS. Without it
+// CollectStats is false and all the counting is discarded at compile time.
+#ifdef NNUE_STATS
+constexpr bool CollectStats = true;
+#else
+constexpr bool CollectStats = false;
+#endif
+
+// The cost of a refresh is the number of weight columns added or removed, compared
+// with the number a refresh from scratch would have added.
+struct RefreshStats {
+    std::atomic<std::uint64_t> refreshes{0}, columns{0}, fullColumns{0};
+
+    void add(std::size_t cols, std::size_t fullCols) {
+        refreshes.fetch_add(1, std::memory_order_relaxed);
+        columns.fetch_add(cols, std::memory_order_relaxed);
+        fullColumns.fetch_add(fullCols, std::memory_order_relaxed);
+    }
+};
+
+RefreshStats psqRefreshStats, threatRefreshStats;
+}
+
+// Reports the refreshes done by all threads since startup, if compiled with NNUE_STATS
+std::string refresh_stats() {
+    if constexpr (!CollectStats)
+        return "";
+
+    std::stringstream ss;
+
+    auto print = [&](const char* name, const RefreshStats& stats) {
+        const std::uint64_t refreshes = std::max<std::uint64_t>(stats.refreshes, 1);
+
+        ss << "\n" << std::left << std::setw(14) << name << std::right << std::setw(12)
+           << stats.refreshes << " refreshes, " << std::fixed << std::setprecision(1)
+           << double(stats.columns) / refreshes << " columns each, "
+           << double(stats.fullColumns) / refreshes << " from scratch";
+    };
+
+    ss << "NNUE accumulator refreshes";
+    print("Piece-square:", psqRefreshStats);
+    print("Threats:", threatRefreshStats);
+
+    return ss.str();
 }
 
 template<typename T>
 const AccumulatorState<T>& AccumulatorStack::latest() const noexcept {
-    return accumulators<T>()[size - 1];
+    return accumulators<T>()[(size - 1) % Slots];
 }
 
 // Explicit template instantiations
@@ -89,11 +142,11 @@ template const AccumulatorState<ThreatFeatureSet>& AccumulatorStack::latest() co
 
 template<typename T>
 AccumulatorState<T>& AccumulatorStack::mut_latest() noexcept {
-    return mut_accumulators<T>()[size - 1];
+    return state<T>(size - 1);
 }
 
 template<typename T>
-const std::array<AccumulatorState<T>, AccumulatorStack::MaxSize>&
+const std::array<AccumulatorState<T>, AccumulatorStack::Slots>&
 AccumulatorStack::accumulators() const noexcept {
     static_assert(std::is_same_v<T, PSQFeatureSet> || std::is_same_v<T, ThreatFeatureSet>,
                   "Invalid Feature Set Type");
@@ -106,7 +159,7 @@ AccumulatorStack::accumulators() const noexcept {
 }
 
 template<typename T>
-std::array<AccumulatorState<T>, AccumulatorStack::MaxSize>&
+std::array<AccumulatorState<T>, AccumulatorStack::Slots>&
 AccumulatorStack::mut_accumulators() noexcept {
     static_assert(std::is_same_v<T, PSQFeatureSet> || std::is_same_v<T, ThreatFeatureSet>,
                   "Invalid Feature Set Type");
@@ -118,14 +171,80 @@ AccumulatorStack::mut_accumulators() noexcept {
         return threat_accumulators;
 }
 
+template<typename T>
+AccumulatorState<T>& AccumulatorStack::state(std::size_t ply) noexcept {
+    if constexpr (!Lean)
+        return mut_accumulators<T>()[ply];
+    else
+    {
+        auto& owners = std::is_same_v<T, PSQFeatureSet> ? psq_owners : threat_owners;
+        auto& st     = mut_accumulators<T>()[ply % Slots];
+
+        if (owners[ply % Slots] != ply)
+        {
+            if constexpr (std::is_same_v<T, PSQFeatureSet>)
+                st.reset(psq_diffs[ply]);
+            else
+                st.reset(threat_diffs[ply]);
+
+            owners[ply % Slots] = ply;
+        }
+        return st;
+    }
+}
+
+template<typename T, IndexType Dimensions>
+bool AccumulatorStack::computed(std::size_t ply, Color perspective) const noexcept {
+    const auto& st = accumulators<T>()[ply % Slots];
+
+    if constexpr (Lean)
+    {
+        const auto& owners = std::is_same_v<T, PSQFeatureSet> ? psq_owners : threat_owners;
+        if (owners[ply % Slots] != ply)
+            return false;
+    }
+
+    return st.template acc<Dimensions>().computed[perspective];
+}
+
+template<typename T>
+const typename T::DiffType& AccumulatorStack::diff(std::size_t ply) const noexcept {
+    if constexpr (!Lean)
+        return accumulators<T>()[ply].diff;
+    else if constexpr (std::is_same_v<T, PSQFeatureSet>)
+        return psq_diffs[ply];
+    else
+        return threat_diffs[ply];
+}
+
 void AccumulatorStack::reset() noexcept {
-    psq_accumulators[0].reset({});
-    threat_accumulators[0].reset({});
+    if constexpr (Lean)
+    {
+        psq_diffs[0]    = {};
+        threat_diffs[0] = {};
+        psq_owners.fill(MaxSize);
+        threat_owners.fill(MaxSize);
+    }
+
+    state<PSQFeatureSet>(0).reset({});
+    state<ThreatFeatureSet>(0).reset({});
     size = 1;
 }
 
 std::pair<DirtyPiece&, DirtyThreats&> AccumulatorStack::push() noexcept {
     assert(size < MaxSize);
+
+    if constexpr (Lean)
+    {
+        // The slot is bound lazily, once do_move() has filled in the deltas
+        auto& dp  = psq_diffs[size];
+        auto& dts = threat_diffs[size];
+        new (&dts) DirtyThreats;
+        psq_owners[size % Slots] = threat_owners[size % Slots] = MaxSize;
+        size++;
+        return {dp, dts};
+    }
+
     auto& dp  = psq_accumulators[size].reset();
     auto& dts = threat_accumulators[size].reset();
     new (&dts) DirtyThreats;
@@ -142,6 +261,8 @@ template<IndexType Dimensions>
 void AccumulatorStack::evaluate(const Position&                       pos,
                                 const FeatureTransformer<Dimensions>& featureTransformer,
                                 AccumulatorCaches::Cache<Dimensions>& cache) noexcept {
+    Profiler::ScopedPhase timer(Profiler::AccumulatorUpdates);
+
     constexpr bool UseThreats = (Dimensions == TransformedFeatureDimensionsBig);
 
     evaluate_side<PSQFeatureSet>(WHITE, pos, featureTransformer, cache);
@@ -164,8 +285,7 @@ void AccumulatorStack::evaluate_side(Color                                 persp
     const auto last_usable_accum =
       find_last_usable_accumulator<FeatureSet, Dimensions>(perspective);
 
-    if ((accumulators<FeatureSet>()[last_usable_accum].template acc<Dimensions>())
-          .computed[perspective])
+    if (computed<FeatureSet, Dimensions>(last_usable_accum, perspective))
         forward_update_incremental<FeatureSet>(perspective, pos, featureTransformer,
                                                last_usable_accum);
 
@@ -175,8 +295,8 @@ void AccumulatorStack::evaluate_side(Color                                 persp
             update_accumulator_refresh_cache(perspective, featureTransformer, pos,
                                              mut_latest<PSQFeatureSet>(), cache);
         else
-            update_threats_accumulator_full(perspective, featureTransformer, pos,
-                                            mut_latest<ThreatFeatureSet>());
+            update_threats_accumulator_refresh_cache(perspective, featureTransformer, pos,
+                                                     mut_latest<ThreatFeatureSet>(), cache);
 
         backward_update_incremental<FeatureSet>(perspective, pos, featureTransformer,
                                                 last_usable_accum);
@@ -184,20 +304,26 @@ void AccumulatorStack::evaluate_side(Color                                 persp
 }
 
 // Find the earliest usable accumulator, this can either be a computed accumulator or the accumulator
-// state just before a change that requires full refresh.
+// state just before a change that requires full refresh. In lean mode the search stops at the
+// oldest ply still in the ring, and when nothing there is usable only the latest ply is refreshed.
 template<typename FeatureSet, IndexType Dimensions>
 std::size_t AccumulatorStack::find_last_usable_accumulator(Color perspective) const noexcept {
 
-    for (std::size_t curr_idx = size - 1; curr_idx > 0; curr_idx--)
+    const std::size_t oldest = Lean && size > Slots ? size - Slots : 0;
+
+    for (std::size_t curr_idx = size - 1; curr_idx > oldest; curr_idx--)
     {
-        if ((accumulators<FeatureSet>()[curr_idx].template acc<Dimensions>()).computed[perspective])
+        if (computed<FeatureSet, Dimensions>(curr_idx, perspective))
             return curr_idx;
 
-        if (FeatureSet::requires_refresh(accumulators<FeatureSet>()[curr_idx].diff, perspective))
+        if (FeatureSet::requires_refresh(diff<FeatureSet>(curr_idx), perspective))
             return curr_idx;
     }
 
-    return 0;
+    if (Lean && !computed<FeatureSet, Dimensions>(oldest, perspective))
+        return size - 1;
+
+    return oldest;
 }
 
 template<typename FeatureSet, IndexType Dimensions>
@@ -207,8 +333,8 @@ void AccumulatorStack::forward_update_incremental(
   const FeatureTransformer<Dimensions>& featureTransformer,
   const std::size_t                     begin) noexcept {
 
-    assert(begin < accumulators<FeatureSet>().size());
-    assert((accumulators<FeatureSet>()[begin].template acc<Dimensions>()).computed[perspective]);
+    assert(begin < size);
+    assert((computed<FeatureSet, Dimensions>(begin, perspective)));
 
     const Square ksq = pos.square<KING>(perspective);
 
@@ -216,18 +342,16 @@ void AccumulatorStack::forward_update_incremental(
     {
         if (next + 1 < size)
         {
-            DirtyPiece& dp1 = mut_accumulators<PSQFeatureSet>()[next].diff;
-            DirtyPiece& dp2 = mut_accumulators<PSQFeatureSet>()[next + 1].diff;
-
-            auto& accumulators = mut_accumulators<FeatureSet>();
-
             if constexpr (std::is_same_v<FeatureSet, ThreatFeatureSet>)
             {
+                const DirtyPiece& dp2 = diff<PSQFeatureSet>(next + 1);
+
                 if (dp2.remove_sq != SQ_NONE
-                    && (accumulators[next].diff.threateningSqs & square_bb(dp2.remove_sq)))
+                    && (diff<ThreatFeatureSet>(next).threateningSqs & square_bb(dp2.remove_sq)))
                 {
-                    double_inc_update(perspective, featureTransformer, ksq, accumulators[next],
-                                      accumulators[next + 1], accumulators[next - 1], dp2);
+                    double_inc_update(perspective, featureTransformer, ksq,
+                                      state<FeatureSet>(next), state<FeatureSet>(next + 1),
+                                      state<FeatureSet>(next - 1), dp2);
                     next++;
                     continue;
                 }
@@ -235,12 +359,16 @@ void AccumulatorStack::forward_update_incremental(
 
             if constexpr (std::is_same_v<FeatureSet, PSQFeatureSet>)
             {
+                DirtyPiece& dp1 = state<PSQFeatureSet>(next).diff;
+                DirtyPiece& dp2 = state<PSQFeatureSet>(next + 1).diff;
+
                 if (dp1.to != SQ_NONE && dp1.to == dp2.remove_sq)
                 {
                     const Square captureSq = dp1.to;
                     dp1.to = dp2.remove_sq = SQ_NONE;
-                    double_inc_update(perspective, featureTransformer, ksq, accumulators[next],
-                                      accumulators[next + 1], accumulators[next - 1]);
+                    double_inc_update(perspective, featureTransformer, ksq,
+                                      state<FeatureSet>(next), state<FeatureSet>(next + 1),
+                                      state<FeatureSet>(next - 1));
                     dp1.to = dp2.remove_sq = captureSq;
                     next++;
                     continue;
@@ -249,8 +377,7 @@ void AccumulatorStack::forward_update_incremental(
         }
 
         update_accumulator_incremental<true>(perspective, featureTransformer, ksq,
-                                             mut_accumulators<FeatureSet>()[next],
-                                             accumulators<FeatureSet>()[next - 1]);
+                                             state<FeatureSet>(next), state<FeatureSet>(next - 1));
     }
 
     assert((latest<PSQFeatureSet>().acc<Dimensions>()).computed[perspective]);
@@ -264,18 +391,16 @@ void AccumulatorStack::backward_update_incremental(
   const FeatureTransformer<Dimensions>& featureTransformer,
   const std::size_t                     end) noexcept {
 
-    assert(end < accumulators<FeatureSet>().size());
     assert(end < size);
-    assert((latest<FeatureSet>().template acc<Dimensions>()).computed[perspective]);
+    assert((computed<FeatureSet, Dimensions>(size - 1, perspective)));
 
     const Square ksq = pos.square<KING>(perspective);
 
     for (std::int64_t next = std::int64_t(size) - 2; next >= std::int64_t(end); next--)
         update_accumulator_incremental<false>(perspective, featureTransformer, ksq,
-                                              mut_accumulators<FeatureSet>()[next],
-                                              accumulators<FeatureSet>()[next + 1]);
+                                              state<FeatureSet>(next), state<FeatureSet>(next + 1));
 
-    assert((accumulators<FeatureSet>()[end].template acc<Dimensions>()).computed[perspective]);
+    assert((computed<FeatureSet, Dimensions>(end, perspective)));
 }
 
 // Explicit template instantiations
@@ -298,6 +423,17 @@ template<typename VectorWrapper,
          typename... Ts,
          std::enable_if_t<is_all_same_v<ElementType, Ts...>, bool> = true>
 void fused_row_reduce(const ElementType* in, ElementType* out, const Ts* const... rows) {
+#if defined(USE_SVE2)
+    for (IndexType i = 0; i < Width; i += sve_lanes<ElementType>())
+    {
+        const svbool_t pg  = sve_whilelt<ElementType>(i, Width);
+        auto           acc = svld1(pg, in + i);
+
+        ((acc = sve_update<ops>(pg, acc, svld1(pg, rows + i))), ...);
+
+        svst1(pg, out + i, acc);
+    }
+#else
     constexpr IndexType size = Width * sizeof(ElementType) / sizeof(typename VectorWrapper::type);
 
     auto* vecIn  = reinterpret_cast<const typename VectorWrapper::type*>(in);
@@ -306,6 +442,173 @@ void fused_row_reduce(const ElementType* in, ElementType* out, const Ts* const..
     for (IndexType i = 0; i < size; ++i)
         vecOut[i] = fused<VectorWrapper, ops...>(
           vecIn[i], reinterpret_cast<const typename VectorWrapper::type*>(rows)[i]...);
+#endif
+}
+
+// Updates a threat accumulator from another one, which may be the same. Used for
+// the incremental updates as well as for the refreshes from the cache.
+template<IndexType Dimensions>
+void update_threats(const FeatureTransformer<Dimensions>&          featureTransformer,
+                    const std::array<BiasType, Dimensions>&        fromAcc,
+                    std::array<BiasType, Dimensions>&              toAcc,
+                    const std::array<PSQTWeightType, PSQTBuckets>& fromPsqtAcc,
+                    std::array<PSQTWeightType, PSQTBuckets>&       toPsqtAcc,
+                    const ThreatFeatureSet::IndexList&             added,
+                    const ThreatFeatureSet::IndexList&             removed) {
+
+#if defined(USE_SVE2)
+    const auto* threatWeights     = &featureTransformer.threatWeights[0];
+    const auto* threatPsqtWeights = &featureTransformer.threatPsqtWeights[0];
+
+    for (IndexType j = 0; j < Dimensions; j += svcnth())
+    {
+        const svbool_t pg  = svwhilelt_b16(j, Dimensions);
+        svint16_t      acc = svld1(pg, &fromAcc[j]);
+
+        // The int8 weights are sign extended to 16 bits by the load
+        for (const auto index : removed)
+            acc = svsub_x(pg, acc, svld1sb_s16(pg, &threatWeights[Dimensions * index + j]));
+
+        for (const auto index : added)
+            acc = svadd_x(pg, acc, svld1sb_s16(pg, &threatWeights[Dimensions * index + j]));
+
+        svst1(pg, &toAcc[j], acc);
+    }
+
+    for (IndexType j = 0; j < PSQTBuckets; j += svcntw())
+    {
+        const svbool_t pg   = svwhilelt_b32(j, PSQTBuckets);
+        svint32_t      psqt = svld1(pg, &fromPsqtAcc[j]);
+
+        for (const auto index : removed)
+            psqt = svsub_x(pg, psqt, svld1(pg, &threatPsqtWeights[PSQTBuckets * index + j]));
+
+        for (const auto index : added)
+            psqt = svadd_x(pg, psqt, svld1(pg, &threatPsqtWeights[PSQTBuckets * index + j]));
+
+        svst1(pg, &toPsqtAcc[j], psqt);
+    }
+
+#elif defined(VECTOR)
+    using Tiling = SIMDTiling<Dimensions, Dimensions, PSQTBuckets>;
+    vec_t      acc[Tiling::NumRegs];
+    psqt_vec_t psqt[Tiling::NumPsqtRegs];
+
+    const auto* threatWeights = &featureTransformer.threatWeights[0];
+
+    for (IndexType j = 0; j < Dimensions / Tiling::TileHeight; ++j)
+    {
+        auto* fromTile = reinterpret_cast<const vec_t*>(&fromAcc[j * Tiling::TileHeight]);
+        auto* toTile   = reinterpret_cast<vec_t*>(&toAcc[j * Tiling::TileHeight]);
+
+        for (IndexType k = 0; k < Tiling::NumRegs; ++k)
+            acc[k] = fromTile[k];
+
+        for (int i = 0; i < removed.ssize(); ++i)
+        {
+            size_t       index  = removed[i];
+            const size_t offset = Dimensions * index;
+            auto*        column = reinterpret_cast<const vec_i8_t*>(&threatWeights[offset]);
+
+    #ifdef USE_NEON
+            for (IndexType k = 0; k < Tiling::NumRegs; k += 2)
+            {
+                acc[k]     = vec_sub_16(acc[k], vmovl_s8(vget_low_s8(column[k / 2])));
+                acc[k + 1] = vec_sub_16(acc[k + 1], vmovl_high_s8(column[k / 2]));
+            }
+    #else
+            for (IndexType k = 0; k < Tiling::NumRegs; ++k)
+                acc[k] = vec_sub_16(acc[k], vec_convert_8_16(column[k]));
+    #endif
+        }
+
+        for (int i = 0; i < added.ssize(); ++i)
+        {
+            size_t       index  = added[i];
+            const size_t offset = Dimensions * index;
+            auto*        column = reinterpret_cast<const vec_i8_t*>(&threatWeights[offset]);
+
+    #ifdef USE_NEON
+            for (IndexType k = 0; k < Tiling::NumRegs; k += 2)
+            {
+                acc[k]     = vec_add_16(acc[k], vmovl_s8(vget_low_s8(column[k / 2])));
+                acc[k + 1] = vec_add_16(acc[k + 1], vmovl_high_s8(column[k / 2]));
+            }
+    #else
+            for (IndexType k = 0; k < Tiling::NumRegs; ++k)
+                acc[k] = vec_add_16(acc[k], vec_convert_8_16(column[k]));
+    #endif
+        }
+
+        for (IndexType k = 0; k < Tiling::NumRegs; k++)
+            vec_store(&toTile[k], acc[k]);
+
+        threatWeights += Tiling::TileHeight;
+    }
+
+    for (IndexType j = 0; j < PSQTBuckets / Tiling::PsqtTileHeight; ++j)
+    {
+        auto* fromTilePsqt =
+          reinterpret_cast<const psqt_vec_t*>(&fromPsqtAcc[j * Tiling::PsqtTileHeight]);
+        auto* toTilePsqt = reinterpret_cast<psqt_vec_t*>(&toPsqtAcc[j * Tiling::PsqtTileHeight]);
+
+        for (IndexType k = 0; k < Tiling::NumPsqtRegs; ++k)
+            psqt[k] = fromTilePsqt[k];
+
+        for (int i = 0; i < removed.ssize(); ++i)
+        {
+            size_t       index      = removed[i];
+            const size_t offset     = PSQTBuckets * index + j * Tiling::PsqtTileHeight;
+            auto*        columnPsqt =
+              reinterpret_cast<const psqt_vec_t*>(&featureTransformer.threatPsqtWeights[offset]);
+
+            for (std::size_t k = 0; k < Tiling::NumPsqtRegs; ++k)
+                psqt[k] = vec_sub_psqt_32(psqt[k], columnPsqt[k]);
+        }
+
+        for (int i = 0; i < added.ssize(); ++i)
+        {
+            size_t       index      = added[i];
+            const size_t offset     = PSQTBuckets * index + j * Tiling::PsqtTileHeight;
+            auto*        columnPsqt =
+              reinterpret_cast<const psqt_vec_t*>(&featureTransformer.threatPsqtWeights[offset]);
+
+            for (std::size_t k = 0; k < Tiling::NumPsqtRegs; ++k)
+                psqt[k] = vec_add_psqt_32(psqt[k], columnPsqt[k]);
+        }
+
+        for (IndexType k = 0; k < Tiling::NumPsqtRegs; ++k)
+            vec_store_psqt(&toTilePsqt[k], psqt[k]);
+    }
+
+#else
+
+    toAcc     = fromAcc;
+    toPsqtAcc = fromPsqtAcc;
+
+    for (const auto index : removed)
+    {
+        const IndexType offset = Dimensions * index;
+
+        for (IndexType j = 0; j < Dimensions; ++j)
+            toAcc[j] -= featureTransformer.threatWeights[offset + j];
+
+        for (std::size_t k = 0; k < PSQTBuckets; ++k)
+            toPsqtAcc[k] -= featureTransformer.threatPsqtWeights[index * PSQTBuckets + k];
+    }
+
+    for (const auto index : added)
+    {
+        const IndexType offset = Dimensions * index;
+
+        for (IndexType j = 0; j < Dimensions; ++j)
+            toAcc[j] += featureTransformer.threatWeights[offset + j];
+
+        for (std::size_t k = 0; k < PSQTBuckets; ++k)
+            toPsqtAcc[k] += featureTransformer.threatPsqtWeights[index * PSQTBuckets + k];
+    }
+
+#endif
 }
 
 template<typename FeatureSet, IndexType Dimensions>
@@ -349,133 +652,13 @@ struct AccumulatorUpdateContext {
 
     void apply(const typename FeatureSet::IndexList& added,
                const typename FeatureSet::IndexList& removed) {
-        const auto& fromAcc = from.template acc<Dimensions>().accumulation[perspective];
-        auto&       toAcc   = to.template acc<Dimensions>().accumulation[perspective];
-
-        const auto& fromPsqtAcc = from.template acc<Dimensions>().psqtAccumulation[perspective];
-        auto&       toPsqtAcc   = to.template acc<Dimensions>().psqtAccumulation[perspective];
-
-#ifdef VECTOR
-        using Tiling = SIMDTiling<Dimensions, Dimensions, PSQTBuckets>;
-        vec_t      acc[Tiling::NumRegs];
-        psqt_vec_t psqt[Tiling::NumPsqtRegs];
-
-        const auto* threatWeights = &featureTransformer.threatWeights[0];
-
-        for (IndexType j = 0; j < Dimensions / Tiling::TileHeight; ++j)
-        {
-            auto* fromTile = reinterpret_cast<const vec_t*>(&fromAcc[j * Tiling::TileHeight]);
-            auto* toTile   = reinterpret_cast<vec_t*>(&toAcc[j * Tiling::TileHeight]);
-
-            for (IndexType k = 0; k < Tiling::NumRegs; ++k)
-                acc[k] = fromTile[k];
-
-            for (int i = 0; i < removed.ssize(); ++i)
-            {
-                size_t       index  = removed[i];
-                const size_t offset = Dimensions * index;
-                auto*        column = reinterpret_cast<const vec_i8_t*>(&threatWeights[offset]);
-
-    #ifdef USE_NEON
-                for (IndexType k = 0; k < Tiling::NumRegs; k += 2)
-                {
-                    acc[k]     = vec_sub_16(acc[k], vmovl_s8(vget_low_s8(column[k / 2])));
-                    acc[k + 1] = vec_sub_16(acc[k + 1], vmovl_high_s8(column[k / 2]));
-                }
-    #else
-                for (IndexType k = 0; k < Tiling::NumRegs; ++k)
-                    acc[k] = vec_sub_16(acc[k], vec_convert_8_16(column[k]));
-    #endif
-            }
-
-            for (int i = 0; i < added.ssize(); ++i)
-            {
-                size_t       index  = added[i];
-                const size_t offset = Dimensions * index;
-                auto*        column = reinterpret_cast<const vec_i8_t*>(&threatWeights[offset]);
-
-    #ifdef USE_NEON
-                for (IndexType k = 0; k < Tiling::NumRegs; k += 2)
-                {
-                    acc[k]     = vec_add_16(acc[k], vmovl_s8(vget_low_s8(column[k / 2])));
-                    acc[k + 1] = vec_add_16(acc[k + 1], vmovl_high_s8(column[k / 2]));
-                }
-    #else
-                for (IndexType k = 0; k < Tiling::NumRegs; ++k)
-                    acc[k] = vec_add_16(acc[k], vec_convert_8_16(column[k]));
-    #endif
-            }
-
-            for (IndexType k = 0; k < Tiling::NumRegs; k++)
-                vec_store(&toTile[k], acc[k]);
-
-            threatWeights += Tiling::TileHeight;
-        }
-
-        for (IndexType j = 0; j < PSQTBuckets / Tiling::PsqtTileHeight; ++j)
-        {
-            auto* fromTilePsqt =
-              reinterpret_cast<const psqt_vec_t*>(&fromPsqtAcc[j * Tiling::PsqtTileHeight]);
-            auto* toTilePsqt =
-              reinterpret_cast<psqt_vec_t*>(&toPsqtAcc[j * Tiling::PsqtTileHeight]);
-
-            for (IndexType k = 0; k < Tiling::NumPsqtRegs; ++k)
-                psqt[k] = fromTilePsqt[k];
-
-            for (int i = 0; i < removed.ssize(); ++i)
-            {
-                size_t       index      = removed[i];
-                const size_t offset     = PSQTBuckets * index + j * Tiling::PsqtTileHeight;
-                auto*        columnPsqt = reinterpret_cast<const psqt_vec_t*>(
-                  &featureTransformer.threatPsqtWeights[offset]);
-
-                for (std::size_t k = 0; k < Tiling::NumPsqtRegs; ++k)
-                    psqt[k] = vec_sub_psqt_32(psqt[k], columnPsqt[k]);
-            }
-
-            for (int i = 0; i < added.ssize(); ++i)
-            {
-                size_t       index      = added[i];
-                const size_t offset     = PSQTBuckets * index + j * Tiling::PsqtTileHeight;
-                auto*        columnPsqt = reinterpret_cast<const psqt_vec_t*>(
-                  &featureTransformer.threatPsqtWeights[offset]);
-
-                for (std::size_t k = 0; k < Tiling::NumPsqtRegs; ++k)
-                    psqt[k] = vec_add_psqt_32(psqt[k], columnPsqt[k]);
-            }
-
-            for (IndexType k = 0; k < Tiling::NumPsqtRegs; ++k)
-                vec_store_psqt(&toTilePsqt[k], psqt[k]);
-        }
-
-#else
-
-        toAcc     = fromAcc;
-        toPsqtAcc = fromPsqtAcc;
-
-        for (const auto index : removed)
-        {
-            const IndexType offset = Dimensions * index;
-
-            for (IndexType j = 0; j < Dimensions; ++j)
-                toAcc[j] -= featureTransformer.threatWeights[offset + j];
-
-            for (std::size_t k = 0; k < PSQTBuckets; ++k)
-                toPsqtAcc[k] -= featureTransformer.threatPsqtWeights[index * PSQTBuckets + k];
-        }
-
-        for (const auto index : added)
-        {
-            const IndexType offset = Dimensions * index;
+        const auto& fromAcc = from.template acc<Dimensions>();
+        auto&       toAcc   = to.template acc<Dimensions>();
 
-            for (IndexType j = 0; j < Dimensions; ++j)
-                toAcc[j] += featureTransformer.threatWeights[offset + j];
-
-            for (std::size_t k = 0; k < PSQTBuckets; ++k)
-                toPsqtAcc[k] += featureTransformer.threatPsqtWeights[index * PSQTBuckets + k];
-        }
-
-#endif
+        update_threats<Dimensions>(featureTransformer, fromAcc.accumulation[perspective],
+                                   toAcc.accumulation[perspective],
+                                   fromAcc.psqtAccumulation[perspective],
+                                   toAcc.psqtAccumulation[perspective], added, removed);
     }
 };
 
@@ -695,6 +878,9 @@ void update_accumulator_refresh_cache(Color                                 pers
         added.push_back(PSQFeatureSet::make_index(perspective, sq, pos.piece_on(sq), ksq));
     }
 
+    if constexpr (CollectStats)
+        psqRefreshStats.add(removed.size() + added.size(), popcount(pos.pieces()));
+
     entry.pieceBB = pos.pieces();
     entry.pieces  = pos.piece_array();
 
@@ -822,103 +1008,56 @@ void update_accumulator_refresh_cache(Color                                 pers
 }
 
 template<IndexType Dimensions>
-void update_threats_accumulator_full(Color                                 perspective,
-                                     const FeatureTransformer<Dimensions>& featureTransformer,
-                                     const Position&                       pos,
-                                     AccumulatorState<ThreatFeatureSet>&   accumulatorState) {
-    using Tiling [[maybe_unused]] = SIMDTiling<Dimensions, Dimensions, PSQTBuckets>;
+void update_threats_accumulator_refresh_cache(
+  Color                                 perspective,
+  const FeatureTransformer<Dimensions>& featureTransformer,
+  const Position&                       pos,
+  AccumulatorState<ThreatFeatureSet>&   accumulatorState,
+  AccumulatorCaches::Cache<Dimensions>& cache) {
 
-    ThreatFeatureSet::IndexList active;
+    ThreatFeatureSet::IndexList active, removed, added;
     ThreatFeatureSet::append_active_indices(perspective, pos, active);
+    std::sort(active.begin(), active.end());
 
-    auto& accumulator                 = accumulatorState.acc<Dimensions>();
-    accumulator.computed[perspective] = true;
+    auto& entry = cache.threat_entry(pos.square<KING>(perspective), perspective);
 
-#ifdef VECTOR
-    vec_t      acc[Tiling::NumRegs];
-    psqt_vec_t psqt[Tiling::NumPsqtRegs];
-
-    const auto* threatWeights = &featureTransformer.threatWeights[0];
+    // Both lists are sorted, so a single merge finds the features to remove and add
+    const IndexType* cached = entry.active.begin();
 
-    for (IndexType j = 0; j < Dimensions / Tiling::TileHeight; ++j)
+    for (const IndexType index : active)
     {
-        auto* accTile =
-          reinterpret_cast<vec_t*>(&accumulator.accumulation[perspective][j * Tiling::TileHeight]);
-
-        for (IndexType k = 0; k < Tiling::NumRegs; ++k)
-            acc[k] = vec_zero();
-
-        int i = 0;
-
-        for (; i < active.ssize(); ++i)
-        {
-            size_t       index  = active[i];
-            const size_t offset = Dimensions * index;
-            auto*        column = reinterpret_cast<const vec_i8_t*>(&threatWeights[offset]);
-
-    #ifdef USE_NEON
-            for (IndexType k = 0; k < Tiling::NumRegs; k += 2)
-            {
-                acc[k]     = vec_add_16(acc[k], vmovl_s8(vget_low_s8(column[k / 2])));
-                acc[k + 1] = vec_add_16(acc[k + 1], vmovl_high_s8(column[k / 2]));
-            }
-    #else
-            for (IndexType k = 0; k < Tiling::NumRegs; ++k)
-                acc[k] = vec_add_16(acc[k], vec_convert_8_16(column[k]));
-    #endif
-        }
-
-        for (IndexType k = 0; k < Tiling::NumRegs; k++)
-            vec_store(&accTile[k], acc[k]);
+        while (cached != entry.active.end() && *cached < index)
+            removed.push_back(*cached++);
 
-        threatWeights += Tiling::TileHeight;
+        if (cached != entry.active.end() && *cached == index)
+            ++cached;
+        else
+            added.push_back(index);
     }
 
-    for (IndexType j = 0; j < PSQTBuckets / Tiling::PsqtTileHeight; ++j)
-    {
-        auto* accTilePsqt = reinterpret_cast<psqt_vec_t*>(
-          &accumulator.psqtAccumulation[perspective][j * Tiling::PsqtTileHeight]);
-
-        for (IndexType k = 0; k < Tiling::NumPsqtRegs; ++k)
-            psqt[k] = vec_zero_psqt();
-
-        for (int i = 0; i < active.ssize(); ++i)
-        {
-            size_t       index  = active[i];
-            const size_t offset = PSQTBuckets * index + j * Tiling::PsqtTileHeight;
-            auto*        columnPsqt =
-              reinterpret_cast<const psqt_vec_t*>(&featureTransformer.threatPsqtWeights[offset]);
-
-            for (std::size_t k = 0; k < Tiling::NumPsqtRegs; ++k)
-                psqt[k] = vec_add_psqt_32(psqt[k], columnPsqt[k]);
-        }
+    while (cached != entry.active.end())
+        removed.push_back(*cached++);
 
-        for (IndexType k = 0; k < Tiling::NumPsqtRegs; ++k)
-            vec_store_psqt(&accTilePsqt[k], psqt[k]);
+    // Refresh from scratch when the cached position is too different
+    if (removed.size() + added.size() > active.size())
+    {
+        entry.clear();
+        removed = {};
+        added   = active;
     }
 
-#else
+    if constexpr (CollectStats)
+        threatRefreshStats.add(removed.size() + added.size(), active.size());
 
-    for (IndexType j = 0; j < Dimensions; ++j)
-        accumulator.accumulation[perspective][j] = 0;
+    update_threats<Dimensions>(featureTransformer, entry.accumulation, entry.accumulation,
+                               entry.psqtAccumulation, entry.psqtAccumulation, added, removed);
 
-    for (std::size_t k = 0; k < PSQTBuckets; ++k)
-        accumulator.psqtAccumulation[perspective][k] = 0;
+    entry.active = active;
 
-    for (const auto index : active)
-    {
-        const IndexType offset = Dimensions * index;
-
-        for (IndexType j = 0; j < Dimensions; ++j)
-            accumulator.accumulation[perspective][j] +=
-              featureTransformer.threatWeights[offset + j];
-
-        for (std::size_t k = 0; k < PSQTBuckets; ++k)
-            accumulator.psqtAccumulation[perspective][k] +=
-              featureTransformer.threatPsqtWeights[index * PSQTBuckets + k];
-    }
-
-#endif
+    auto& accumulator                         = accumulatorState.acc<Dimensions>();
+    accumulator.accumulation[perspective]     = entry.accumulation;
+    accumulator.psqtAccumulation[perspective] = entry.psqtAccumulation;
+    accumulator.computed[perspective]         = true;
 }
 
 }
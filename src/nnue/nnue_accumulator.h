@@ -25,6 +25,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <string>
 #include <utility>
 
 #include "../types.h"
@@ -83,16 +84,41 @@ struct AccumulatorCaches {
             }
         };
 
+        // The threat features depend on the king square only through the half of the
+        // board the king is on, so there is one entry per half and perspective. It keeps
+        // the sorted list of its active features to find what changed since.
+        struct alignas(CacheLineSize) ThreatEntry {
+            std::array<BiasType, Size>              accumulation;
+            std::array<PSQTWeightType, PSQTBuckets> psqtAccumulation;
+            ThreatFeatureSet::IndexList             active;
+
+            // The threat accumulation has no biases, so without features it is zero
+            void clear() {
+                accumulation.fill(0);
+                psqtAccumulation.fill(0);
+                active = {};
+            }
+        };
+
         template<typename Network>
         void clear(const Network& network) {
             for (auto& entries1D : entries)
                 for (auto& entry : entries1D)
                     entry.clear(network.featureTransformer.biases);
+
+            for (auto& entries1D : threatEntries)
+                for (auto& entry : entries1D)
+                    entry.clear();
         }
 
         std::array<Entry, COLOR_NB>& operator[](Square sq) { return entries[sq]; }
 
+        ThreatEntry& threat_entry(Square ksq, Color perspective) {
+            return threatEntries[file_of(ksq) >= FILE_E][perspective];
+        }
+
         std::array<std::array<Entry, COLOR_NB>, SQUARE_NB> entries;
+        std::array<std::array<ThreatEntry, COLOR_NB>, 2>   threatEntries;
     };
 
     template<typename Networks>
@@ -153,12 +179,26 @@ class AccumulatorStack {
    public:
     static constexpr std::size_t MaxSize = MAX_PLY + 1;
 
+#ifdef NNUE_LEAN_STACK
+    // Lean mode, for hosts running very many threads: the accumulators of only
+    // the last Slots plies are materialised, in a ring indexed by ply % Slots,
+    // while the feature deltas are kept for every ply. A ply whose slot has been
+    // reused by a deeper one is rebuilt from its deltas, or from the refresh
+    // cache, when the search comes back to it.
+    static constexpr bool        Lean  = true;
+    static constexpr std::size_t Slots = 16;
+#else
+    static constexpr bool        Lean  = false;
+    static constexpr std::size_t Slots = MaxSize;
+#endif
+
     template<typename T>
     [[nodiscard]] const AccumulatorState<T>& latest() const noexcept;
 
     void                                  reset() noexcept;
     std::pair<DirtyPiece&, DirtyThreats&> push() noexcept;
     void                                  pop() noexcept;
+    std::size_t                           ply() const noexcept { return size - 1; }
 
     template<IndexType Dimensions>
     void evaluate(const Position&                       pos,
@@ -170,10 +210,20 @@ class AccumulatorStack {
     [[nodiscard]] AccumulatorState<T>& mut_latest() noexcept;
 
     template<typename T>
-    [[nodiscard]] const std::array<AccumulatorState<T>, MaxSize>& accumulators() const noexcept;
+    [[nodiscard]] const std::array<AccumulatorState<T>, Slots>& accumulators() const noexcept;
 
     template<typename T>
-    [[nodiscard]] std::array<AccumulatorState<T>, MaxSize>& mut_accumulators() noexcept;
+    [[nodiscard]] std::array<AccumulatorState<T>, Slots>& mut_accumulators() noexcept;
+
+    // The accumulator state of a ply, bound to its slot first in lean mode
+    template<typename T>
+    [[nodiscard]] AccumulatorState<T>& state(std::size_t ply) noexcept;
+
+    template<typename T, IndexType Dimensions>
+    [[nodiscard]] bool computed(std::size_t ply, Color perspective) const noexcept;
+
+    template<typename T>
+    [[nodiscard]] const typename T::DiffType& diff(std::size_t ply) const noexcept;
 
     template<typename FeatureSet, IndexType Dimensions>
     void evaluate_side(Color                                 perspective,
@@ -196,11 +246,19 @@ class AccumulatorStack {
                                      const FeatureTransformer<Dimensions>& featureTransformer,
                                      const std::size_t                     end) noexcept;
 
-    std::array<AccumulatorState<PSQFeatureSet>, MaxSize>    psq_accumulators;
-    std::array<AccumulatorState<ThreatFeatureSet>, MaxSize> threat_accumulators;
-    std::size_t                                             size = 1;
+    std::array<AccumulatorState<PSQFeatureSet>, Slots>    psq_accumulators;
+    std::array<AccumulatorState<ThreatFeatureSet>, Slots> threat_accumulators;
+    std::size_t                                           size = 1;
+
+    // Lean mode only: the deltas of every ply and the ply owning each slot
+    std::array<DirtyPiece, Lean ? MaxSize : 0>   psq_diffs;
+    std::array<DirtyThreats, Lean ? MaxSize : 0> threat_diffs;
+    std::array<std::size_t, Lean ? Slots : 0>    psq_owners, threat_owners;
 };
 
+// Statistics of the accumulator refreshes, empty unless compiled with NNUE_STATS
+std::string refresh_stats();
+
 }  // namespace Stockfish::Eval::NNUE
 
 #endif  // NNUE_ACCUMULATOR_H_INCLUDED
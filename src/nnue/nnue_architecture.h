@@ -139,6 +139,57 @@ struct NetworkArchitecture {
         return outputValue;
     }
 
+#if defined(USE_AMX)
+    static constexpr IndexType BatchSize = decltype(fc_1)::AmxRows;
+
+    // Like propagate() for BatchSize positions at once, so that fc_1 runs as AMX tile
+    // multiplies over all of them. Unused entries must still point to valid features.
+    void propagate_batch(const TransformedFeatureType* const transformedFeatures[BatchSize],
+                         std::int32_t                        outputValues[BatchSize]) const {
+        static constexpr IndexType RowStride = decltype(fc_1)::AmxInputStride;
+
+        static_assert(decltype(fc_1)::CanUseAMX);
+        static_assert(ceil_to_multiple<IndexType>(FC_0_OUTPUTS * 2, 32) <= RowStride);
+
+        struct alignas(CacheLineSize) Buffer {
+            alignas(CacheLineSize) typename decltype(fc_0)::OutputBuffer fc_0_out;
+            alignas(CacheLineSize) typename decltype(ac_0)::OutputBuffer ac_0_out;
+            alignas(CacheLineSize) typename decltype(ac_sqr_0)::OutputType
+              ac_sqr_0_out[BatchSize][RowStride];
+            alignas(CacheLineSize) typename decltype(fc_1)::OutputType
+              fc_1_out[BatchSize][FC_1_OUTPUTS];
+            alignas(CacheLineSize) typename decltype(ac_1)::OutputBuffer ac_1_out;
+            alignas(CacheLineSize) typename decltype(fc_2)::OutputBuffer fc_2_out;
+            std::int32_t fwdOut[BatchSize];
+
+            Buffer() { std::memset(this, 0, sizeof(*this)); }
+        };
+
+        alignas(CacheLineSize) static thread_local Buffer buffer;
+
+        for (IndexType i = 0; i < BatchSize; ++i)
+        {
+            fc_0.propagate(transformedFeatures[i], buffer.fc_0_out);
+            ac_sqr_0.propagate(buffer.fc_0_out, buffer.ac_sqr_0_out[i]);
+            ac_0.propagate(buffer.fc_0_out, buffer.ac_0_out);
+            std::memcpy(buffer.ac_sqr_0_out[i] + FC_0_OUTPUTS, buffer.ac_0_out,
+                        FC_0_OUTPUTS * sizeof(typename decltype(ac_0)::OutputType));
+
+            buffer.fwdOut[i] = buffer.fc_0_out[FC_0_OUTPUTS] * (600 * OutputScale)
+                             / (127 * (1 << WeightScaleBits));
+        }
+
+        fc_1.propagate_amx(&buffer.ac_sqr_0_out[0][0], &buffer.fc_1_out[0][0]);
+
+        for (IndexType i = 0; i < BatchSize; ++i)
+        {
+            ac_1.propagate(buffer.fc_1_out[i], buffer.ac_1_out);
+            fc_2.propagate(buffer.ac_1_out, buffer.fc_2_out);
+            outputValues[i] = buffer.fc_2_out[0] + buffer.fwdOut[i];
+        }
+    }
+#endif
+
     std::size_t get_content_hash() const {
         std::size_t h = 0;
         hash_combine(h, fc_0.get_content_hash());
@@ -35,6 +35,17 @@
     #include <arm_neon.h>
 #endif
 
+#if defined(USE_SVE2)
+    #include <arm_sve.h>
+#endif
+
+#if defined(USE_AMX) && defined(__linux__)
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+#include <cstdint>
+
 #include "../types.h"
 #include "nnue_common.h"
 
@@ -365,6 +376,92 @@ dotprod_m128_add_dpbusd_epi32(int32x4_t& acc, int8x16_t a, int8x16_t b) {
 
 #endif
 
+#if defined(USE_SVE2)
+
+// SVE registers have no size known at compile time, so they cannot be kept in
+// arrays like the tiles of the fixed-width code. The SVE kernels instead stream
+// over the rows with predicated loops, whatever the vector length is.
+
+template<typename T>
+inline std::uint64_t sve_lanes() {
+    static_assert(sizeof(T) == 2 || sizeof(T) == 4);
+
+    if constexpr (sizeof(T) == 2)
+        return svcnth();
+    else
+        return svcntw();
+}
+
+template<typename T>
+inline svbool_t sve_whilelt(std::uint64_t i, std::uint64_t n) {
+    static_assert(sizeof(T) == 2 || sizeof(T) == 4);
+
+    if constexpr (sizeof(T) == 2)
+        return svwhilelt_b16(i, n);
+    else
+        return svwhilelt_b32(i, n);
+}
+
+template<UpdateOperation op, typename VecType>
+inline VecType sve_update(svbool_t pg, VecType acc, VecType operand) {
+    static_assert(op == Add || op == Sub, "Only Add and Sub are currently supported.");
+
+    if constexpr (op == Add)
+        return svadd_x(pg, acc, operand);
+    else
+        return svsub_x(pg, acc, operand);
+}
+
+#endif
+
+#if defined(USE_AMX)
+
+// Operand of ldtilecfg, the shapes of the tile registers for palette 1
+struct alignas(64) TileConfig {
+    std::uint8_t  palette;
+    std::uint8_t  startRow;
+    std::uint8_t  reserved[14];
+    std::uint16_t colsb[16];  // Bytes per row
+    std::uint8_t  rows[16];
+};
+
+// Linux enables the large AMX register state only for processes asking for it
+inline bool request_amx_permission() {
+    #if defined(__linux__)
+    constexpr long ARCH_REQ_XCOMP_PERM = 0x1023;
+    constexpr long XFEATURE_XTILEDATA  = 18;
+
+    return syscall(SYS_arch_prctl, ARCH_REQ_XCOMP_PERM, XFEATURE_XTILEDATA) == 0;
+    #else
+    return true;
+    #endif
+}
+
+// Whether the batched evaluation uses the AMX kernels. Without OS support the
+// AMX instructions fault, so then they are never used.
+inline const bool UseAMX = request_amx_permission();
+
+// The tile configuration of the calling thread, null when its tiles are released
+inline thread_local const TileConfig* amxConfig = nullptr;
+
+// The tile configuration is per thread, reload it only when a kernel needs another one
+inline void amx_configure(const TileConfig& config) {
+    if (amxConfig != &config)
+    {
+        _tile_loadconfig(&config);
+        amxConfig = &config;
+    }
+}
+
+// Returns the tiles to their initial state, so that the OS does not save and restore
+// the large tile state on every context switch of a thread done with them
+inline void amx_release() {
+    _tile_release();
+    amxConfig = nullptr;
+}
+
+#endif
+
 #if USE_NEON >= 8
 [[maybe_unused]] static void neon_m128_add_dpbusd_epi32(int32x4_t& acc, int8x16_t a, int8x16_t b) {
 
@@ -29,6 +29,7 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <set>
 #include <sstream>
 #include <string>
@@ -464,7 +465,8 @@ class NumaConfig {
    public:
     NumaConfig() :
         highestCpuIndex(0),
-        customAffinity(false) {
+        customAffinity(false),
+        domainNetworks(false) {
         const auto numCpus = SYSTEM_THREADS_NB;
         add_cpu_range_to_node(NumaIndex{0}, CpuIndex{0}, numCpus - 1);
     }
@@ -644,6 +646,46 @@ class NumaConfig {
         return cfg;
     }
 
+    // The configuration of from_system() with each NUMA node split into domains of
+    // the processors that share an L3 cache, as read from the cache topology in
+    // sysfs. On CPUs with several L3s per node, such as the CCDs of AMD EPYC, the
+    // threads then share their histories only with those on the same cache. The
+    // networks stay one copy per NUMA node, as the shared memory of the domains of
+    // a node is the same, unless domainNetworks is set. Elsewhere than on Linux
+    // this is the configuration of from_system().
+    static NumaConfig from_system_l3(bool domainNetworks) {
+        NumaConfig nodeCfg = from_system();
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+        NumaConfig cfg = empty();
+        NumaIndex  n   = 0;
+
+        for (auto&& cpus : nodeCfg.nodes)
+        {
+            // Processors whose L3 is unknown are put together
+            std::map<std::string, NumaIndex> domains;
+
+            for (CpuIndex c : cpus)
+            {
+                auto [it, inserted] = domains.try_emplace(l3_cpu_list(c).value_or(""), n);
+                if (inserted)
+                    ++n;
+
+                cfg.add_cpu_to_node(it->second, c);
+            }
+        }
+
+        cfg.customAffinity = nodeCfg.customAffinity;
+        nodeCfg            = std::move(cfg);
+
+#endif
+
+        nodeCfg.domainNetworks = domainNetworks;
+
+        return nodeCfg;
+    }
+
     // ':'-separated numa nodes
     // ','-separated cpu indices
     // supports "first-last" range syntax for cpu indices
@@ -690,6 +732,10 @@ class NumaConfig {
 
     bool requires_memory_replication() const { return customAffinity || nodes.size() > 1; }
 
+    // Whether the networks have a copy in each node even when it is an L3 domain
+    // of a NUMA node shared with others, see from_system_l3()
+    bool replicates_networks_per_domain() const { return domainNetworks; }
+
     std::string to_string() const {
         std::string str;
 
@@ -952,14 +998,43 @@ class NumaConfig {
     CpuIndex highestCpuIndex;
 
     bool customAffinity;
+    bool domainNetworks;
 
     static NumaConfig empty() { return NumaConfig(EmptyNodeTag{}); }
 
+#if defined(__linux__) && !defined(__ANDROID__)
+
+    // The processors sharing the L3 cache of the given one, as in a cpulist
+    static std::optional<std::string> l3_cpu_list(CpuIndex c) {
+        const std::string path =
+          std::string("/sys/devices/system/cpu/cpu") + std::to_string(c) + "/cache/index";
+
+        for (int i = 0;; ++i)
+        {
+            auto level = read_file_to_string(path + std::to_string(i) + "/level");
+            if (!level.has_value())
+                return std::nullopt;
+
+            remove_whitespace(*level);
+            if (*level != "3")
+                continue;
+
+            auto cpus = read_file_to_string(path + std::to_string(i) + "/shared_cpu_list");
+            if (cpus.has_value())
+                remove_whitespace(*cpus);
+
+            return cpus;
+        }
+    }
+
+#endif
+
     struct EmptyNodeTag {};
 
     NumaConfig(EmptyNodeTag) :
         highestCpuIndex(0),
-        customAffinity(false) {}
+        customAffinity(false),
+        domainNetworks(false) {}
 
     void remove_empty_numa_nodes() {
         std::vector<std::set<CpuIndex>> newNodes;
@@ -1311,6 +1386,11 @@ class LazyNumaReplicatedSystemWide: public NumaReplicatedBase {
 
     const T* operator->() const { return &*instances[0]; }
 
+    // The replica of the node, or nullptr if it was not needed yet
+    const T* get_if_present(NumaIndex idx) const {
+        return idx < instances.size() && instances[idx] != nullptr ? &*instances[idx] : nullptr;
+    }
+
     std::vector<std::pair<SystemWideSharedConstantAllocationStatus, std::optional<std::string>>>
     get_status_and_errors() const {
         std::vector<std::pair<SystemWideSharedConstantAllocationStatus, std::optional<std::string>>>
@@ -1350,6 +1430,9 @@ class LazyNumaReplicatedSystemWide: public NumaReplicatedBase {
         CpuIndex    cpu     = *cfg.nodes[idx].begin();  // get a CpuIndex from NumaIndex
         NumaIndex   sys_idx = cfg_sys.is_cpu_assigned(cpu) ? cfg_sys.nodeByCpu.at(cpu) : 0;
         std::string s       = cfg_sys.to_string() + "$" + std::to_string(sys_idx);
+        // The L3 domains of a system node share its copy, unless asked otherwise
+        if (cfg.replicates_networks_per_domain())
+            s += "$" + std::to_string(idx);
         return std::hash<std::string>{}(s);
     }
 
@@ -0,0 +1,189 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "perft.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "misc.h"
+#include "thread.h"
+
+namespace Stockfish::Benchmark {
+
+namespace {
+
+// Caches the leaf counts of subtrees by position and depth. An entry keeps its
+// key xored with its count, so that one torn by two threads writing it at the
+// same time fails the check, and the threads need no locks. When the memory
+// cannot be allocated, the table is left empty and the counts are not cached.
+class PerftTable {
+   public:
+    explicit PerftTable(size_t mb) {
+        const size_t count = mb * 1024 * 1024 / sizeof(Entry);
+
+        if (count && !(entries = std::unique_ptr<Entry[]>(new (std::nothrow) Entry[count]())))
+            sync_cout << "info string Failed to allocate " << mb
+                      << "MB for the perft hash, counting without it" << sync_endl;
+
+        size = entries ? count : 0;
+    }
+
+    bool probe(Key key, uint64_t& count) const {
+        const Entry& e = entries[mul_hi64(key, size)];
+        count          = e.count.load(std::memory_order_relaxed);
+        return (e.check.load(std::memory_order_relaxed) ^ count) == key;
+    }
+
+    void save(Key key, uint64_t count) {
+        Entry& e = entries[mul_hi64(key, size)];
+        e.check.store(key ^ count, std::memory_order_relaxed);
+        e.count.store(count, std::memory_order_relaxed);
+    }
+
+    bool enabled() const { return size; }
+
+   private:
+    struct Entry {
+        std::atomic<uint64_t> check, count;
+    };
+
+    std::unique_ptr<Entry[]> entries;
+    size_t                   size = 0;
+};
+
+// The same position at another depth needs an entry of its own
+Key perft_key(const Position& pos, Depth depth) {
+    return pos.key() ^ (Key(depth) * 0x9E3779B97F4A7C15ULL);
+}
+
+uint64_t hashed_perft(Position& pos, Depth depth, PerftTable& table) {
+
+    if (depth == 1)
+        return MoveList<LEGAL>(pos).size();
+
+    const Key key = perft_key(pos, depth);
+    uint64_t  nodes;
+
+    if (table.enabled() && table.probe(key, nodes))
+        return nodes;
+
+    StateInfo st;
+    nodes = 0;
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+    {
+        pos.do_move(m, st);
+        nodes += hashed_perft(pos, depth - 1, table);
+        pos.undo_move(m);
+    }
+
+    if (table.enabled())
+        table.save(key, nodes);
+
+    return nodes;
+}
+
+// A reply to a root move, whose subtree one thread counts
+struct PerftTask {
+    size_t rootIdx;
+    Move   root, reply;
+};
+
+}  // namespace
+
+// The tasks are the replies to the root moves rather than the root moves
+// themselves, as there are too few of those to keep many threads busy to the
+// end. Each thread takes the next task left until there are none.
+uint64_t parallel_perft(const std::string& fen,
+                        Depth              depth,
+                        bool               isChess960,
+                        ThreadPool&        threads,
+                        size_t             threadCount,
+                        size_t             hashMB) {
+
+    if (depth <= 2)
+        return perft(fen, depth, isChess960);
+
+    StateInfo st, moveSt;
+    Position  pos;
+    pos.set(fen, isChess960, &st);
+
+    const MoveList<LEGAL>  rootMoves(pos);
+    std::vector<PerftTask> tasks;
+
+    for (size_t i = 0; i < rootMoves.size(); ++i)
+    {
+        const Move m = *(rootMoves.begin() + i);
+
+        pos.do_move(m, moveSt);
+
+        for (const auto& reply : MoveList<LEGAL>(pos))
+            tasks.push_back({i, m, reply});
+
+        pos.undo_move(m);
+    }
+
+    PerftTable                               table(hashMB);
+    std::atomic<size_t>                      next{0};
+    std::unique_ptr<std::atomic<uint64_t>[]> counts(new std::atomic<uint64_t>[rootMoves.size()]());
+
+    // The pool is that of the Threads option, which bounds the threads perft gets
+    if (threadCount > threads.num_threads())
+        sync_cout << "info string perft limited to " << threads.num_threads()
+                  << " threads, set the Threads option for more" << sync_endl;
+
+    threadCount = std::clamp(threadCount, size_t(1), threads.num_threads());
+
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.run_on_thread(i, [&]() {
+            StateInfo rootSt, moveSt1, moveSt2;
+            Position  p;
+            p.set(fen, isChess960, &rootSt);
+
+            for (size_t t; (t = next.fetch_add(1, std::memory_order_relaxed)) < tasks.size();)
+            {
+                const PerftTask& task = tasks[t];
+
+                p.do_move(task.root, moveSt1);
+                p.do_move(task.reply, moveSt2);
+                counts[task.rootIdx] += hashed_perft(p, depth - 2, table);
+                p.undo_move(task.reply);
+                p.undo_move(task.root);
+            }
+        });
+
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.wait_on_thread(i);
+
+    uint64_t nodes = 0;
+
+    for (size_t i = 0; i < rootMoves.size(); ++i)
+    {
+        nodes += counts[i];
+        sync_cout << UCIEngine::move(*(rootMoves.begin() + i), isChess960) << ": " << counts[i]
+                  << sync_endl;
+    }
+
+    return nodes;
+}
+
+}  // namespace Stockfish::Benchmark
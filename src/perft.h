@@ -19,14 +19,20 @@
 #ifndef PERFT_H_INCLUDED
 #define PERFT_H_INCLUDED
 
+#include <cstddef>
 #include <cstdint>
+#include <string>
 
 #include "movegen.h"
 #include "position.h"
 #include "types.h"
 #include "uci.h"
 
-namespace Stockfish::Benchmark {
+namespace Stockfish {
+
+class ThreadPool;
+
+namespace Benchmark {
 
 // Utility to verify move generation. All the leaf nodes up
 // to the given depth are generated and counted, and the sum is returned.
@@ -62,6 +68,16 @@ inline uint64_t perft(const std::string& fen, Depth depth, bool isChess960) {
 
     return perft<true>(p, depth);
 }
+
+// Like perft(), but shares the subtrees out among the first 'threadCount'
+// threads of the pool, and with 'hashMB' above 0, caches their counts
+uint64_t parallel_perft(const std::string& fen,
+                        Depth              depth,
+                        bool               isChess960,
+                        ThreadPool&        threads,
+                        size_t             threadCount,
+                        size_t             hashMB);
+}
 }
 
 #endif  // PERFT_H_INCLUDED
@@ -22,6 +22,7 @@
 #include <array>
 #include <cassert>
 #include <cctype>
+#include <charconv>
 #include <cstddef>
 #include <cstring>
 #include <initializer_list>
@@ -35,6 +36,7 @@
 #include "history.h"
 #include "misc.h"
 #include "movegen.h"
+#include "profiler.h"
 #include "syzygy/tbprobe.h"
 #include "tt.h"
 #include "uci.h"
@@ -160,8 +162,9 @@ void Position::init() {
 
 // Initializes the position object with the given FEN string.
 // This function is not very robust - make sure that input FENs are correct,
-// this is assumed to be the responsibility of the GUI.
-Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si) {
+// this is assumed to be the responsibility of the GUI. The string is read in
+// place, without a stream or any allocation.
+Position& Position::set(std::string_view fenStr, bool isChess960, StateInfo* si) {
     /*
    A FEN string defines a particular position using only the ASCII character set.
 
@@ -197,19 +200,33 @@ Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si) {
       incremented after Black's move.
 */
 
-    unsigned char      col, row, token;
-    size_t             idx;
-    Square             sq = SQ_A8;
-    std::istringstream ss(fenStr);
+    unsigned char col = 0, row = 0, token = 0;
+    size_t        idx, i = 0;
+    Square        sq = SQ_A8;
+
+    // The next character, as 'ss >> std::noskipws >> c' would read it
+    auto next = [&](unsigned char& c) {
+        if (i == fenStr.size())
+            return false;
+        c = fenStr[i++];
+        return true;
+    };
+
+    // The next number, as 'ss >> std::skipws >> n' would read it
+    auto number = [&](int& n) {
+        while (i < fenStr.size() && isspace(static_cast<unsigned char>(fenStr[i])))
+            ++i;
+        auto [end, ec] = std::from_chars(fenStr.data() + i, fenStr.data() + fenStr.size(), n);
+        i              = size_t(end - fenStr.data());
+        return ec == std::errc();
+    };
 
     std::memset(reinterpret_cast<char*>(this), 0, sizeof(Position));
     std::memset(si, 0, sizeof(StateInfo));
     st = si;
 
-    ss >> std::noskipws;
-
     // 1. Piece placement
-    while ((ss >> token) && !isspace(token))
+    while (next(token) && !isspace(token))
     {
         if (isdigit(token))
             sq += (token - '0') * EAST;  // Advance the given number of files
@@ -225,16 +242,16 @@ Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si) {
     }
 
     // 2. Active color
-    ss >> token;
+    next(token);
     sideToMove = (token == 'w' ? WHITE : BLACK);
-    ss >> token;
+    next(token);
 
     // 3. Castling availability. Compatible with 3 standards: Normal FEN standard,
     // Shredder-FEN that uses the letters of the columns on which the rooks began
     // the game instead of KQkq and also X-FEN standard that, in case of Chess960,
     // if an inner rook is associated with the castling right, the castling tag is
     // replaced by the file letter of the involved rook, as for the Shredder-FEN.
-    while ((ss >> token) && !isspace(token))
+    while (next(token) && !isspace(token))
     {
         Square rsq;
         Color  c    = islower(token) ? BLACK : WHITE;
@@ -263,25 +280,19 @@ Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si) {
     // Ignore if square is invalid or not on side to move relative rank 6.
     bool enpassant = false;
 
-    if (((ss >> col) && (col >= 'a' && col <= 'h'))
-        && ((ss >> row) && (row == (sideToMove == WHITE ? '6' : '3'))))
+    if ((next(col) && (col >= 'a' && col <= 'h'))
+        && (next(row) && (row == (sideToMove == WHITE ? '6' : '3'))))
     {
         st->epSquare = make_square(File(col - 'a'), Rank(row - '1'));
-
-        // En passant square will be considered only if
-        // a) side to move have a pawn threatening epSquare
-        // b) there is an enemy pawn in front of epSquare
-        // c) there is no piece on epSquare or behind epSquare
-        enpassant = attacks_bb<PAWN>(st->epSquare, ~sideToMove) & pieces(sideToMove, PAWN)
-                 && (pieces(~sideToMove, PAWN) & (st->epSquare + pawn_push(~sideToMove)))
-                 && !(pieces() & (st->epSquare | (st->epSquare + pawn_push(sideToMove))));
+        enpassant    = en_passant_possible(st->epSquare);
     }
 
     if (!enpassant)
         st->epSquare = SQ_NONE;
 
     // 5-6. Halfmove clock and fullmove number
-    ss >> std::skipws >> st->rule50 >> gamePly;
+    if (number(st->rule50))
+        number(gamePly);
 
     // Convert from fullmove starting from 1 to gamePly starting from 0,
     // handle also common incorrect FEN with fullmove = 0.
@@ -315,6 +326,18 @@ void Position::set_castling_right(Color c, Square rfrom) {
 }
 
 
+// En passant square will be considered only if
+// a) side to move have a pawn threatening epSquare
+// b) there is an enemy pawn in front of epSquare
+// c) there is no piece on epSquare or behind epSquare
+bool Position::en_passant_possible(Square epSq) const {
+
+    return attacks_bb<PAWN>(epSq, ~sideToMove) & pieces(sideToMove, PAWN)
+        && (pieces(~sideToMove, PAWN) & (epSq + pawn_push(~sideToMove)))
+        && !(pieces() & (epSq | (epSq + pawn_push(sideToMove))));
+}
+
+
 // Sets king attacks to detect if a move gives check
 void Position::set_check_info() const {
 
@@ -409,6 +432,219 @@ Position& Position::set(const string& code, Color c, StateInfo* si) {
 }
 
 
+// Initializes the position from a PackedPosition, with the checks of the FEN
+// parser: castling rights only for rooks on the rank of their king, and the en
+// passant square only when the capture is possible. Nibbles of 7 are skipped. The
+// position must have passed is_valid().
+Position& Position::set(const PackedPosition& pp, bool isChess960, StateInfo* si) {
+
+    assert(popcount(pp.occupancy) <= 32);
+
+    std::memset(reinterpret_cast<char*>(this), 0, sizeof(Position));
+    std::memset(si, 0, sizeof(StateInfo));
+    st = si;
+
+    Bitboard b             = pp.occupancy;
+    Bitboard castlingRooks = 0;
+
+    for (int i = 0; b; ++i)
+    {
+        Square s    = pop_lsb(b);
+        int    code = (pp.pieces[i / 2] >> (i % 2 * 4)) & 0xF;
+        Color  c    = code & 8 ? BLACK : WHITE;
+
+        if ((code & 7) == 6)
+        {
+            put_piece(make_piece(c, ROOK), s);
+            castlingRooks |= s;
+        }
+        else if ((code & 7) < 6)
+            put_piece(make_piece(c, PieceType(PAWN + (code & 7))), s);
+    }
+
+    sideToMove = pp.stmEpSquare & 0x80 ? BLACK : WHITE;
+
+    while (castlingRooks)
+    {
+        Square rsq = pop_lsb(castlingRooks);
+        Color  c   = color_of(piece_on(rsq));
+
+        if (count<KING>(c) == 1 && rank_of(square<KING>(c)) == relative_rank(c, RANK_1)
+            && rank_of(rsq) == relative_rank(c, RANK_1))
+            set_castling_right(c, rsq);
+    }
+
+    Square epSq  = Square(pp.stmEpSquare & 0x7F);
+    st->epSquare = epSq < SQUARE_NB && relative_rank(sideToMove, epSq) == RANK_6
+                        && en_passant_possible(epSq)
+                   ? epSq
+                   : SQ_NONE;
+
+    st->rule50 = pp.halfmoveClock;
+    gamePly    = std::max(2 * (pp.fullmoveNumber - 1), 0) + (sideToMove == BLACK);
+
+    chess960 = isChess960;
+    set_state();
+
+    assert(pos_is_ok());
+
+    return *this;
+}
+
+
+namespace {
+
+// The counts of the pieces of a board of Pieces, as for Position::is_valid_fen()
+bool is_valid_board(const std::array<Piece, SQUARE_NB>& board) {
+    int pieces[COLOR_NB]{}, pawns[COLOR_NB]{}, kings[COLOR_NB]{};
+
+    for (Square s = SQ_A1; s <= SQ_H8; ++s)
+        if (Piece pc = board[s]; pc != NO_PIECE)
+        {
+            const Color c = color_of(pc);
+            ++pieces[c];
+            kings[c] += type_of(pc) == KING;
+
+            if (type_of(pc) == PAWN)
+            {
+                ++pawns[c];
+                if (rank_of(s) == RANK_1 || rank_of(s) == RANK_8)
+                    return false;
+            }
+        }
+
+    for (Color c : {WHITE, BLACK})
+        if (kings[c] != 1 || pieces[c] > 16 || pawns[c] > 8)
+            return false;
+
+    return true;
+}
+
+}
+
+bool Position::is_valid_fen(std::string_view fenStr) {
+
+    std::array<Piece, SQUARE_NB> board;
+    board.fill(NO_PIECE);
+
+    size_t i    = 0;
+    int    rank = 7, file = 0;
+
+    // 1. Piece placement, which must fill each of the 8 ranks
+    for (; i < fenStr.size() && fenStr[i] != ' '; ++i)
+    {
+        const char   token = fenStr[i];
+        const size_t idx   = PieceToChar.find(token);
+
+        if (token >= '1' && token <= '8')
+            file += token - '0';
+        else if (token == '/' && file == 8 && rank > 0)
+            --rank, file = 0;
+        else if (idx != string::npos && file < 8)
+            board[make_square(File(file++), Rank(rank))] = Piece(idx);
+        else
+            return false;
+
+        if (file > 8)
+            return false;
+    }
+
+    if (rank != 0 || file != 8 || !is_valid_board(board))
+        return false;
+
+    // The other fields, of which only the active color is required
+    std::string_view fields[5];
+    for (auto& field : fields)
+    {
+        while (i < fenStr.size() && fenStr[i] == ' ')
+            ++i;
+        const size_t end = std::min(fenStr.find(' ', i), fenStr.size());
+        field            = fenStr.substr(i, end - i);
+        i                = end;
+    }
+
+    // Nothing may follow, so the FEN can be put in a command
+    if (fenStr.find_first_not_of(' ', i) != std::string_view::npos)
+        return false;
+
+    if (fields[0] != "w" && fields[0] != "b")
+        return false;
+
+    // 3. Castling, with the king on its first rank and a rook on the side it names
+    for (char token : fields[1] == "-" ? std::string_view() : fields[1])
+    {
+        const Color c    = islower(token) ? BLACK : WHITE;
+        const Rank  r    = relative_rank(c, RANK_1);
+        const char  t    = char(toupper(token));
+        const Piece rook = make_piece(c, ROOK);
+        const auto  ksq  = Square(
+          std::find(board.begin(), board.end(), make_piece(c, KING)) - board.begin());
+
+        if (rank_of(ksq) != r || (t != 'K' && t != 'Q' && (t < 'A' || t > 'H')))
+            return false;
+
+        bool found = false;
+        for (File f = FILE_A; f <= FILE_H; ++f)
+            if (board[make_square(f, r)] == rook)
+                found |= t == 'K' ? f > file_of(ksq) : t == 'Q' ? f < file_of(ksq) : f == t - 'A';
+
+        if (!found)
+            return false;
+    }
+
+    // 4. En passant square
+    if (!fields[2].empty() && fields[2] != "-"
+        && (fields[2].size() != 2 || fields[2][0] < 'a' || fields[2][0] > 'h'
+            || fields[2][1] != (fields[0] == "w" ? '6' : '3')))
+        return false;
+
+    // 5-6. Halfmove clock and fullmove number
+    for (int f = 3; f < 5; ++f)
+        if (!std::all_of(fields[f].begin(), fields[f].end(),
+                         [](char ch) { return ch >= '0' && ch <= '9'; }))
+            return false;
+
+    // The side to move must not be able to take the king
+    Position  pos;
+    StateInfo st;
+    pos.set(fenStr, false, &st);
+
+    const Color us = pos.side_to_move();
+    return !(pos.attackers_to(pos.square<KING>(~us)) & pos.pieces(us));
+}
+
+bool Position::is_valid(const PackedPosition& pp) {
+
+    if (popcount(pp.occupancy) > 32)
+        return false;
+
+    std::array<Piece, SQUARE_NB> board;
+    board.fill(NO_PIECE);
+
+    Bitboard b = pp.occupancy;
+    for (int i = 0; b; ++i)
+    {
+        const Square s    = pop_lsb(b);
+        const int    code = (pp.pieces[i / 2] >> (i % 2 * 4)) & 0xF;
+        const Color  c    = code & 8 ? BLACK : WHITE;
+
+        // A rook that can castle is 6, as in set()
+        if ((code & 7) <= 6)
+            board[s] = make_piece(c, (code & 7) == 6 ? ROOK : PieceType(PAWN + (code & 7)));
+    }
+
+    if (!is_valid_board(board))
+        return false;
+
+    // The side to move must not be able to take the king, as for is_valid_fen()
+    Position  pos;
+    StateInfo st;
+    pos.set(pp, false, &st);
+
+    const Color us = pos.side_to_move();
+    return !(pos.attackers_to(pos.square<KING>(~us)) & pos.pieces(us));
+}
+
 // Returns a FEN representation of the position. In case of
 // Chess960 the Shredder-FEN notation is used. This is mainly a debugging function.
 string Position::fen() const {
@@ -457,6 +693,38 @@ string Position::fen() const {
     return ss.str();
 }
 
+// Returns the position as a PackedPosition, with an eval and a wdl of zero
+PackedPosition Position::pack() const {
+
+    PackedPosition pp{};
+    Bitboard       castlingRooks = 0;
+    int            i             = 0;
+
+    for (CastlingRights cr : {WHITE_OO, WHITE_OOO, BLACK_OO, BLACK_OOO})
+        if (can_castle(cr))
+            castlingRooks |= castling_rook_square(cr);
+
+    pp.occupancy = pieces();
+
+    for (Bitboard b = pieces(); b; ++i)
+    {
+        Square s  = pop_lsb(b);
+        Piece  pc = piece_on(s);
+
+        uint8_t code = castlingRooks & s ? 6 : type_of(pc) - PAWN;
+        code |= color_of(pc) == BLACK ? 8 : 0;
+
+        pp.pieces[i / 2] |= code << (i % 2 * 4);
+    }
+
+    pp.stmEpSquare    = uint8_t((sideToMove == BLACK ? 0x80 : 0)
+                                | (ep_square() == SQ_NONE ? 64 : ep_square()));
+    pp.halfmoveClock  = uint8_t(std::min(st->rule50, 255));
+    pp.fullmoveNumber = uint16_t(1 + (gamePly - (sideToMove == BLACK)) / 2);
+
+    return pp;
+}
+
 // Calculates st->blockersForKing[c] and st->pinners[~c],
 // which store respectively the pieces preventing king of color c from being in check
 // and the slider pieces of color ~c pinning pieces of color c to the king.
@@ -689,6 +957,38 @@ bool Position::gives_check(Move m) const {
 }
 
 
+// Computes the hash key of the position after the given pseudo-legal move, as
+// used to index the TT, without doing the move. It is meant for prefetching:
+// castling moves and en passant captures are only approximated, which at worst
+// prefetches a cluster that isn't probed.
+Key Position::key_after(Move m) const {
+
+    const Square from     = m.from_sq();
+    const Square to       = m.to_sq();
+    const Piece  pc       = piece_on(from);
+    const Piece  captured = m.type_of() == CASTLING ? NO_PIECE : piece_on(to);
+
+    Key k = st->key ^ Zobrist::side ^ Zobrist::psq[pc][from] ^ Zobrist::psq[pc][to];
+
+    if (captured)
+        k ^= Zobrist::psq[captured][to];
+
+    // Zobrist::psq[pc][to] is zero for a pawn on the last rank
+    if (m.type_of() == PROMOTION)
+        k ^= Zobrist::psq[make_piece(sideToMove, m.promotion_type())][to];
+
+    if (st->epSquare != SQ_NONE)
+        k ^= Zobrist::enpassant[file_of(st->epSquare)];
+
+    if (int cr = castlingRightsMask[from] | castlingRightsMask[to]; st->castlingRights & cr)
+        k ^= Zobrist::castling[st->castlingRights] ^ Zobrist::castling[st->castlingRights & ~cr];
+
+    const int rule50 = captured || type_of(pc) == PAWN ? 0 : st->rule50 + 1;
+
+    return rule50 < 14 ? k : k ^ make_key((rule50 - 14) / 8);
+}
+
+
 // Makes a move, and saves all information necessary
 // to a StateInfo object. The move is assumed to be legal. Pseudo-legal
 // moves should be filtered out before this function is called.
@@ -714,6 +1014,14 @@ void Position::do_move(Move                      m,
     newSt.previous = st;
     st             = &newSt;
 
+#ifdef COPY_MAKE
+    BoardState& saved = newSt.parentBoard;
+    saved.board       = board;
+    saved.byTypeBB    = byTypeBB;
+    saved.byColorBB   = byColorBB;
+    std::memcpy(saved.pieceCount, pieceCount, sizeof(pieceCount));
+#endif
+
     // Increment ply counters. In particular, rule50 will be reset to zero later on
     // in case of a capture or a pawn move.
     ++gamePly;
@@ -727,6 +1035,13 @@ void Position::do_move(Move                      m,
     Piece  pc       = piece_on(from);
     Piece  captured = m.type_of() == EN_PASSANT ? make_piece(them, PAWN) : piece_on(to);
 
+    const Bitboard occupiedBefore = pieces();
+    const int      moved          = attack_bit(us, type_of(pc))
+                         | (m.type_of() == CASTLING ? attack_bit(us, ROOK)
+                            : captured              ? attack_bit(them, type_of(captured))
+                                                    : 0)
+                         | (m.type_of() == PROMOTION ? attack_bit(us, m.promotion_type()) : 0);
+
     bool checkEP = false;
 
     dp.pc             = pc;
@@ -895,6 +1210,11 @@ void Position::do_move(Move                      m,
     // Set capture piece
     st->capturedPiece = captured;
 
+    // Record what changed, for the attacks of later states, see attacks_by()
+    st->attacksKnown   = 0;
+    st->changedSquares = occupiedBefore ^ pieces();
+    st->movedPieces    = moved;
+
     // Calculate checkers bitboard (if move gives check)
     st->checkersBB = givesCheck ? attackers_to(square<KING>(them)) & pieces(us) : 0;
 
@@ -998,6 +1318,20 @@ void Position::undo_move(Move m) {
 
     sideToMove = ~sideToMove;
 
+#ifdef COPY_MAKE
+    const BoardState& saved = st->parentBoard;
+    board                   = saved.board;
+    byTypeBB                = saved.byTypeBB;
+    byColorBB               = saved.byColorBB;
+    std::memcpy(pieceCount, saved.pieceCount, sizeof(pieceCount));
+
+    st = st->previous;
+    --gamePly;
+
+    assert(pos_is_ok());
+    return;
+#endif
+
     Color  us   = sideToMove;
     Square from = m.from_sq();
     Square to   = m.to_sq();
@@ -1251,8 +1585,10 @@ void Position::do_null_move(StateInfo& newSt, const TranspositionTable& tt) {
 
     std::memcpy(&newSt, st, sizeof(StateInfo));
 
-    newSt.previous = st;
-    st             = &newSt;
+    newSt.previous       = st;
+    newSt.changedSquares = 0;  // The attacks stay as well
+    newSt.movedPieces    = 0;
+    st                   = &newSt;
 
     if (st->epSquare != SQ_NONE)
     {
@@ -1288,7 +1624,17 @@ void Position::undo_null_move() {
 // Tests if the SEE (Static Exchange Evaluation)
 // value of move is greater or equal to the given threshold. We'll use an
 // algorithm similar to alpha-beta pruning with a null window.
-bool Position::see_ge(Move m, int threshold) const {
+bool Position::see_ge(Move m, int threshold) const { return exchange_ge(m, threshold, nullptr); }
+
+// The same with the attackers of the target square taken from the cache. Only the
+// sliders behind the moved piece are then looked up for each move.
+bool Position::see_ge(Move m, int threshold, SeeCache& cache) const {
+    return exchange_ge(m, threshold, &cache);
+}
+
+bool Position::exchange_ge(Move m, int threshold, SeeCache* cache) const {
+
+    Profiler::ScopedPhase timer(Profiler::SEE);
 
     assert(m.is_ok());
 
@@ -1309,10 +1655,38 @@ bool Position::see_ge(Move m, int threshold) const {
         return true;
 
     assert(color_of(piece_on(from)) == sideToMove);
-    Bitboard occupied  = pieces() ^ from ^ to;  // xoring to is important for pinned piece logic
-    Color    stm       = sideToMove;
-    Bitboard attackers = attackers_to(to, occupied);
-    Bitboard stmAttackers, bb;
+
+    // Without an attacker of the square, not even one behind the moved piece, the
+    // move stands. Only tried when the attacks are known already, see attacks_by().
+    const Color them  = ~sideToMove;
+    const int   known = attack_bit(them, KNIGHT) | attack_bit(them, BISHOP)
+                    | attack_bit(them, ROOK) | attack_bit(them, QUEEN);
+    if ((st->attacksKnown & known) == known
+        && !((attacks_by<BISHOP>(them) | attacks_by<ROOK>(them) | attacks_by<QUEEN>(them)) & from)
+        && !(attacks_by(them) & to))
+        return true;
+
+    Bitboard occupied = pieces() ^ from ^ to;  // xoring to is important for pinned piece logic
+    Color    stm      = sideToMove;
+    Bitboard attackers, stmAttackers, bb;
+
+    if (!cache)
+        attackers = attackers_to(to, occupied);
+    else
+    {
+        if (!(cache->known & to))
+        {
+            cache->attackers[to] = attackers_to(to);
+            cache->known |= to;
+        }
+
+        // Taking the moved piece off the board can only uncover sliders on its line
+        attackers = cache->attackers[to];
+        if (PseudoAttacks[ROOK][to] & from)
+            attackers |= attacks_bb<ROOK>(to, occupied) & pieces(ROOK, QUEEN);
+        else if (PseudoAttacks[BISHOP][to] & from)
+            attackers |= attacks_bb<BISHOP>(to, occupied) & pieces(BISHOP, QUEEN);
+    }
     int      res = 1;
 
     while (true)
@@ -21,11 +21,13 @@
 
 #include <array>
 #include <cassert>
+#include <cstdint>
 #include <deque>
 #include <iosfwd>
 #include <memory>
 #include <new>
 #include <string>
+#include <string_view>
 
 #include "bitboard.h"
 #include "types.h"
@@ -35,6 +37,17 @@ namespace Stockfish {
 class TranspositionTable;
 struct SharedHistories;
 
+// The part of a Position that do_move() changes, other than its StateInfo. When
+// compiled with -DCOPY_MAKE, do_move() saves it in the new StateInfo, and
+// undo_move() restores it with one copy and pops the state, rather than taking
+// the move back piece by piece.
+struct BoardState {
+    std::array<Piece, SQUARE_NB>        board;
+    std::array<Bitboard, PIECE_TYPE_NB> byTypeBB;
+    std::array<Bitboard, COLOR_NB>      byColorBB;
+    int                                 pieceCount[PIECE_NB];
+};
+
 // StateInfo struct stores information needed to restore a Position object to
 // its previous state when we retract a move. Whenever a move is made on the
 // board (by calling Position::do_move), a StateInfo object must be passed.
@@ -61,6 +74,17 @@ struct StateInfo {
     Bitboard   checkSquares[PIECE_TYPE_NB];
     Piece      capturedPiece;
     int        repetition;
+
+    // The attacks by color and piece type, set on first use, see attacks_by(), and
+    // what the move to this state changed, to reuse the attacks of earlier states
+    Bitboard attacks[COLOR_NB][PIECE_TYPE_NB];
+    Bitboard changedSquares;  // Whose occupancy changed
+    int      attacksKnown;    // One attack_bit() each
+    int      movedPieces;
+
+#ifdef COPY_MAKE
+    BoardState parentBoard;  // The board before the move, see BoardState
+#endif
 };
 
 
@@ -70,6 +94,33 @@ struct StateInfo {
 // elements are not invalidated upon list resizing.
 using StateListPtr = std::unique_ptr<std::deque<StateInfo>>;
 
+// A position in 32 bytes, in the marlinformat read by the usual NNUE trainers.
+// Pieces are listed in the order of their squares in the occupancy, one nibble
+// each, low nibble first: the piece type from 0 for a pawn to 5 for a king, or 6
+// for a rook that can still castle, plus 8 for black. Files of them are written
+// in the byte order of the machine, which is little endian for the trainers.
+struct PackedPosition {
+    uint64_t occupancy;
+    uint8_t  pieces[16];
+    uint8_t  stmEpSquare;  // Bit 7 is set when black is to move, 64 means no en passant
+    uint8_t  halfmoveClock;
+    uint16_t fullmoveNumber;
+    int16_t  eval;  // In centipawns from White's point of view
+    uint8_t  wdl;   // 0 when black wins, 1 for a draw and 2 when white wins
+    uint8_t  extra;
+
+    static constexpr uint8_t WdlUnknown = 3;  // A wdl for positions without a known result
+};
+
+static_assert(sizeof(PackedPosition) == 32);
+
+// The attackers of the target squares of the moves of one node, with the board as
+// it is, found by see_ge() on first use and kept for the other moves to the square
+struct SeeCache {
+    Bitboard attackers[SQUARE_NB];
+    Bitboard known = 0;
+};
+
 // Position class stores information regarding the board representation as
 // pieces, side to move, hash keys, castling info, etc. Important methods are
 // do_move() and undo_move(), used by the search to update node info when
@@ -83,10 +134,21 @@ class Position {
     Position& operator=(const Position&) = delete;
 
     // FEN string input/output
-    Position&   set(const std::string& fenStr, bool isChess960, StateInfo* si);
+    Position&   set(std::string_view fenStr, bool isChess960, StateInfo* si);
     Position&   set(const std::string& code, Color c, StateInfo* si);
     std::string fen() const;
 
+    // PackedPosition input/output, the eval and wdl are left to the caller
+    Position&      set(const PackedPosition& pp, bool isChess960, StateInfo* si);
+    PackedPosition pack() const;
+
+    // Whether the input can be given to set() from outside, as from the network
+    // or a file: one king, at most 16 pieces and 8 pawns a side, no pawn on the
+    // first or last rank, castling rights with a rook to castle with, and the side
+    // not to move not in check
+    static bool is_valid_fen(std::string_view fenStr);
+    static bool is_valid(const PackedPosition& pp);
+
     // Position representation
     Bitboard pieces() const;  // All pieces
     template<typename... PieceTypes>
@@ -123,6 +185,7 @@ class Position {
     void     update_slider_blockers(Color c) const;
     template<PieceType Pt>
     Bitboard attacks_by(Color c) const;
+    Bitboard attacks_by(Color c) const;
 
     // Properties of moves
     bool  legal(Move m) const;
@@ -148,9 +211,12 @@ class Position {
 
     // Static Exchange Evaluation
     bool see_ge(Move m, int threshold = 0) const;
+    bool see_ge(Move m, int threshold, SeeCache& cache) const;
 
     // Accessing hash keys
     Key key() const;
+    Key raw_key() const;  // Without the halfmove clock part of key()
+    Key key_after(Move m) const;
     Key material_key() const;
     Key pawn_key() const;
     Key minor_piece_key() const;
@@ -182,6 +248,7 @@ class Position {
    private:
     // Initialization helpers (used while setting up a position)
     void set_castling_right(Color c, Square rfrom);
+    bool en_passant_possible(Square epSq) const;
     Key  compute_material_key() const;
     void set_state() const;
     void set_check_info() const;
@@ -202,6 +269,7 @@ class Position {
                      DirtyThreats* const dts = nullptr,
                      DirtyPiece* const   dp  = nullptr);
     Key  adjust_key50(Key k) const;
+    bool exchange_ge(Move m, int threshold, SeeCache* cache) const;
 
     // Data members
     std::array<Piece, SQUARE_NB>        board;
@@ -281,22 +349,65 @@ inline Square Position::castling_rook_square(CastlingRights cr) const {
 
 inline Bitboard Position::attackers_to(Square s) const { return attackers_to(s, pieces()); }
 
+// The bit of a color and piece type in StateInfo::attacksKnown and movedPieces
+constexpr int attack_bit(Color c, PieceType pt) { return 1 << (c * 8 + pt); }
+
+// The attacks of the pieces other than pawns and kings are kept in the state once
+// computed. They are taken from the state of one or two moves before when no piece
+// of the kind has moved since, and for sliders, no square they attack has changed.
 template<PieceType Pt>
 inline Bitboard Position::attacks_by(Color c) const {
 
     if constexpr (Pt == PAWN)
         return c == WHITE ? pawn_attacks_bb<WHITE>(pieces(WHITE, PAWN))
                           : pawn_attacks_bb<BLACK>(pieces(BLACK, PAWN));
+    else if constexpr (Pt == KING)
+        return attacks_bb<KING>(square<KING>(c));
     else
     {
-        Bitboard threats   = 0;
-        Bitboard attackers = pieces(c, Pt);
-        while (attackers)
-            threats |= attacks_bb<Pt>(pop_lsb(attackers), pieces());
+        const int bit = attack_bit(c, Pt);
+
+        if (st->attacksKnown & bit)
+            return st->attacks[c][Pt];
+
+        Bitboard         threats = 0, changed = 0;
+        int              moved   = 0;
+        bool             reused  = false;
+        const StateInfo* s       = st;
+
+        for (int i = 0; i < 2 && s->previous && !(moved & bit); ++i)
+        {
+            changed |= s->changedSquares;
+            moved |= s->movedPieces;
+            s = s->previous;
+
+            if (!(moved & bit) && (s->attacksKnown & bit))
+            {
+                reused  = Pt == KNIGHT || !(changed & s->attacks[c][Pt]);
+                threats = s->attacks[c][Pt];
+                break;
+            }
+        }
+
+        if (!reused)
+        {
+            threats            = 0;
+            Bitboard attackers = pieces(c, Pt);
+            while (attackers)
+                threats |= attacks_bb<Pt>(pop_lsb(attackers), pieces());
+        }
+
+        st->attacks[c][Pt] = threats;
+        st->attacksKnown |= bit;
         return threats;
     }
 }
 
+inline Bitboard Position::attacks_by(Color c) const {
+    return attacks_by<PAWN>(c) | attacks_by<KNIGHT>(c) | attacks_by<BISHOP>(c)
+         | attacks_by<ROOK>(c) | attacks_by<QUEEN>(c) | attacks_by<KING>(c);
+}
+
 inline Bitboard Position::checkers() const { return st->checkersBB; }
 
 inline Bitboard Position::blockers_for_king(Color c) const { return st->blockersForKing[c]; }
@@ -307,6 +418,8 @@ inline Bitboard Position::check_squares(PieceType pt) const { return st->checkSq
 
 inline Key Position::key() const { return adjust_key50(st->key); }
 
+inline Key Position::raw_key() const { return st->key; }
+
 inline Key Position::adjust_key50(Key k) const {
     return st->rule50 < 14 ? k : k ^ make_key((st->rule50 - 14) / 8);
 }
@@ -0,0 +1,164 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROFILER_H_INCLUDED
+#define PROFILER_H_INCLUDED
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#if defined(PHASE_PROFILER) && defined(_MSC_VER) && defined(_M_X64)
+    #include <intrin.h>
+#elif defined(PHASE_PROFILER) && defined(__x86_64__)
+    #include <x86intrin.h>
+#endif
+
+// Optional timers of the phases of a search, compiled in with -DPHASE_PROFILER and
+// switched on with the "Phase Profiler" option. Without the flag Enabled is false
+// and every ScopedPhase is discarded at compile time.
+namespace Stockfish::Profiler {
+
+#ifdef PHASE_PROFILER
+constexpr bool Enabled = true;
+#else
+constexpr bool Enabled = false;
+#endif
+
+enum Phase {
+    Search,  // Whatever is not in one of the phases below
+    Evaluation,
+    AccumulatorUpdates,
+    MoveGeneration,
+    TTProbes,
+    TBProbes,
+    SEE,
+    PHASE_NB
+};
+
+constexpr const char* PhaseNames[PHASE_NB] = {
+  "search", "nnue evaluation", "accumulator updates", "move generation and scoring",
+  "tt probes", "tb probes", "see"};
+
+// Ticks spent in each phase by one thread. On x86 these are TSC ticks, elsewhere ns.
+struct PhaseTimes {
+    std::array<uint64_t, PHASE_NB> ticks{}, calls{};
+
+    void add(const PhaseTimes& other) {
+        for (int i = 0; i < PHASE_NB; ++i)
+        {
+            ticks[i] += other.ticks[i];
+            calls[i] += other.calls[i];
+        }
+    }
+};
+
+inline uint64_t timestamp() {
+#if defined(PHASE_PROFILER) && (defined(__x86_64__) || defined(_M_X64))
+    return __rdtsc();
+#else
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count());
+#endif
+}
+
+// The times of the running search on this thread, null when not profiling
+inline thread_local PhaseTimes* times = nullptr;
+inline thread_local Phase       phase = Search;
+inline thread_local uint64_t    phaseStart;
+
+// Charges the ticks since the last switch to the running phase, and runs the next
+inline void switch_to(Phase next) {
+    uint64_t now = timestamp();
+    times->ticks[phase] += now - phaseStart;
+    phaseStart = now;
+    phase      = next;
+}
+
+inline void start(PhaseTimes& t) {
+    if constexpr (Enabled)
+    {
+        t          = PhaseTimes();
+        times      = &t;
+        phase      = Search;
+        phaseStart = timestamp();
+    }
+}
+
+inline void stop() {
+    if constexpr (Enabled)
+        if (times)
+        {
+            switch_to(Search);
+            times = nullptr;
+        }
+}
+
+// Times its scope as the given phase. A phase inside another, as the accumulator
+// updates are inside the evaluation, is taken out of the outer one, so that the
+// phases add up to the whole search.
+class ScopedPhase {
+   public:
+    explicit ScopedPhase(Phase p) {
+        if constexpr (Enabled)
+            if (times)
+            {
+                outer = phase;
+                ++times->calls[p];
+                switch_to(p);
+            }
+    }
+
+    ~ScopedPhase() {
+        if constexpr (Enabled)
+            if (times)
+                switch_to(outer);
+    }
+
+    ScopedPhase(const ScopedPhase&)            = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+   private:
+    Phase outer = Search;
+};
+
+// One line per phase with its share of the total and the number of calls
+inline std::string format(const PhaseTimes& t) {
+    uint64_t total = 0;
+    for (uint64_t ticks : t.ticks)
+        total += ticks;
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    for (int i = 0; i < PHASE_NB; ++i)
+    {
+        ss << (i ? "\n" : "") << "info string phase " << PhaseNames[i] << " "
+           << (total ? 100.0 * t.ticks[i] / total : 0.0) << "%";
+        if (i != Search)
+            ss << " calls " << t.calls[i];
+    }
+    return ss.str();
+}
+
+}  // namespace Stockfish::Profiler
+
+#endif  // #ifndef PROFILER_H_INCLUDED
@@ -27,9 +27,11 @@
 #include <cstdint>
 #include <cstdlib>
 #include <initializer_list>
+#include <iomanip>
 #include <iostream>
 #include <list>
 #include <ratio>
+#include <sstream>
 #include <string>
 #include <utility>
 
@@ -125,6 +127,13 @@ void update_correction_history(const Position& pos,
 
 // Add a small random component to draw evaluations to avoid 3-fold blindness
 Value value_draw(size_t nodes) { return VALUE_DRAW - 1 + Value(nodes & 0x2); }
+
+// Probes the TT, timed as its own phase by the phase profiler
+auto probe_tt(const TranspositionTable& tt, Key key) {
+    Profiler::ScopedPhase timer(Profiler::TTProbes);
+    return tt.probe(key);
+}
+
 Value value_to_tt(Value v, int ply);
 Value value_from_tt(Value v, int ply, int r50c);
 void  update_pv(Move* pv, Move move, const Move* childPv);
@@ -171,7 +180,9 @@ Search::Worker::Worker(SharedState&                    sharedState,
     tt(sharedState.tt),
     networks(sharedState.networks),
     refreshTable(networks[token]) {
-    clear();
+    // The shared histories are cleared by the pool, which keeps those of a node
+    // whose threads were only added to
+    clear(false);
 }
 
 void Search::Worker::ensure_network_replicated() {
@@ -182,18 +193,47 @@ void Search::Worker::ensure_network_replicated() {
 
 void Search::Worker::start_searching() {
 
+    startPending = true;
+
     accumulatorStack.reset();
+    evalCache.resize(size_t(int(options["Eval Cache"])));
+    netChoice.speculate = bool(options["Eval Speculation"]);
+    netChoice.smallOnly = bool(options["Small Net Only"]);
+    legalMovePicker     = bool(options["Legal Move Picker"]);
+
+    bool profile = false;
+    if constexpr (Profiler::Enabled)
+        profile = bool(options["Phase Profiler"]);
+
+    if (profile)
+        Profiler::start(phaseTimes);
 
     // Non-main threads go directly to iterative_deepening()
     if (!is_mainthread())
     {
         iterative_deepening();
+        Profiler::stop();
+        tbCacheCounts = Tablebases::cache_counts();
         return;
     }
 
     main_manager()->tm.init(limits, rootPos.side_to_move(), rootPos.game_ply(), options,
                             main_manager()->originalTimeAdjust);
-    tt.new_search();
+    if (threads.ownsTT)
+        tt.new_search();
+
+    if (main_manager()->tm.overhead_changed())
+        async_cout("info string Move Overhead set to "
+                   + std::to_string(main_manager()->tm.move_overhead())
+                   + " ms from the measured latency");
+
+    main_manager()->totBestMoveChanges = 0;
+    main_manager()->lastMetricsTime    = 0;
+    main_manager()->lastMetricsCounts.clear();
+
+    main_manager()->lastPvTime = 0;
+    main_manager()->pvPending  = false;
+    main_manager()->lastPvLines.clear();
 
     if (rootMoves.empty())
     {
@@ -207,6 +247,9 @@ void Search::Worker::start_searching() {
         iterative_deepening();      // main thread start searching
     }
 
+    Profiler::stop();
+    tbCacheCounts = Tablebases::cache_counts();
+
     // When we reach the maximum depth, we can arrive here without a raise of
     // threads.stop. However, if we are pondering or in an infinite search,
     // the UCI protocol states that we shouldn't print the best move before the
@@ -217,10 +260,20 @@ void Search::Worker::start_searching() {
 
     // Stop the threads if not already stopped (also raise the stop if
     // "ponderhit" just reset threads.ponder)
-    threads.stop = true;
+    threads.stop         = true;
+    const auto stopStart = std::chrono::steady_clock::now();
 
     // Wait until all threads have finished
     threads.wait_for_search_finished();
+    threads.record_stop_latency(stopStart);
+
+    if (profile)
+    {
+        Profiler::PhaseTimes total;
+        for (auto&& th : threads)
+            total.add(th->worker->phaseTimes);
+        sync_cout << Profiler::format(total) << sync_endl;
+    }
 
     // When playing in 'nodes as time' mode, subtract the searched nodes from
     // the available ones before exiting.
@@ -239,9 +292,9 @@ void Search::Worker::start_searching() {
     main_manager()->bestPreviousScore        = bestThread->rootMoves[0].score;
     main_manager()->bestPreviousAverageScore = bestThread->rootMoves[0].averageScore;
 
-    // Send again PV info if we have a new best thread
-    if (bestThread != this)
-        main_manager()->pv(*bestThread, threads, tt, bestThread->completedDepth);
+    // Send again PV info if we have a new best thread, or if the last one was held back
+    if (bestThread != this || main_manager()->pvPending)
+        main_manager()->pv(*bestThread, threads, tt, bestThread->completedDepth, true);
 
     std::string ponder;
 
@@ -250,6 +303,7 @@ void Search::Worker::start_searching() {
         ponder = UCIEngine::move(bestThread->rootMoves[0].pv[1], rootPos.is_chess960());
 
     auto bestmove = UCIEngine::move(bestThread->rootMoves[0].pv[0], rootPos.is_chess960());
+    main_manager()->tm.record_move();
     main_manager()->updates.onBestmove(bestmove, ponder);
 }
 
@@ -309,6 +363,12 @@ void Search::Worker::iterative_deepening() {
 
     multiPV = std::min(multiPV, rootMoves.size());
 
+    // Each thread searches one line, and the lines without threads of their own
+    // would be missing, so this needs at least as many threads as lines
+    const bool splitLines = multiPV > 1 && options["MultiPV Split"] && !skill.enabled()
+                         && !tbConfig.rootInTB && threads.size() >= multiPV;
+    const size_t myLine = splitLines ? threadIdx % multiPV : 0;
+
     int searchAgainCounter = 0;
 
     lowPlyHistory.fill(97);
@@ -318,6 +378,20 @@ void Search::Worker::iterative_deepening() {
             mainHistory[c][i] =
               (mainHistory[c][i] - mainHistoryDefault) * 3 / 4 + mainHistoryDefault;
 
+    // Search the first iterations with the threads together, see RootSplit
+    const Depth splitDepth = threads.size() > 1 && multiPV == 1 && !skill.enabled()
+                                && !tbConfig.rootInTB && rootMoves.size() > 1
+                             ? int(options["Root Split Depth"])
+                             : 0;
+    if (splitDepth)
+    {
+        split_iterations(ss, splitDepth);
+
+        lastBestPV        = rootMoves[0].pv;
+        lastBestScore     = rootMoves[0].score;
+        lastBestMoveDepth = completedDepth;
+    }
+
     // Iterative deepening loop until requested to stop or the target depth is reached
     while (++rootDepth < MAX_PLY && !threads.stop
            && !(limits.depth && mainThread && rootDepth > limits.depth))
@@ -337,6 +411,10 @@ void Search::Worker::iterative_deepening() {
         if (!threads.increaseDepth)
             searchAgainCounter++;
 
+        // Leave the moves of the lines above our own to their threads
+        if (splitLines)
+            threads.multiPVLines.arrange(rootMoves, 0, myLine, false);
+
         // MultiPV loop. We perform a full root search for each PV line
         for (pvIdx = 0; pvIdx < multiPV; ++pvIdx)
         {
@@ -348,6 +426,9 @@ void Search::Worker::iterative_deepening() {
                         break;
             }
 
+            if (splitLines && pvIdx != myLine)
+                continue;
+
             // Reset UCI info selDepth for each depth and each PV line
             selDepth = 0;
 
@@ -420,11 +501,21 @@ void Search::Worker::iterative_deepening() {
                 assert(alpha >= -VALUE_INFINITE && beta <= VALUE_INFINITE);
             }
 
-            // Sort the PV lines searched so far and update the GUI
-            std::stable_sort(rootMoves.begin() + pvFirst, rootMoves.begin() + pvIdx + 1);
+            // Sort the PV lines searched so far and update the GUI. With split
+            // lines, those above ours are kept in the order of their threads.
+            if (!splitLines)
+                std::stable_sort(rootMoves.begin() + pvFirst, rootMoves.begin() + pvIdx + 1);
+            else
+            {
+                if (!threads.stop)
+                    threads.multiPVLines.publish(pvIdx, rootDepth, rootMoves[pvIdx]);
+
+                if (mainThread)
+                    threads.multiPVLines.arrange(rootMoves, 1, multiPV, true);
+            }
 
             if (mainThread
-                && (threads.stop || pvIdx + 1 == multiPV || nodes > 10000000)
+                && (threads.stop || pvIdx + 1 == multiPV || splitLines || nodes > 10000000)
                 // A thread that aborted search can have mated-in/TB-loss PV and
                 // score that cannot be trusted, i.e. it can be delayed or refuted
                 // if we would have had time to fully search other root-moves. Thus
@@ -481,6 +572,8 @@ void Search::Worker::iterative_deepening() {
             th->worker->bestMoveChanges = 0;
         }
 
+        mainThread->totBestMoveChanges = totBestMoveChanges;
+
         // Do we have time for the next iteration? Can we stop searching now?
         if (limits.use_time_management() && !threads.stop && !mainThread->stopOnPonderhit)
         {
@@ -531,6 +624,9 @@ void Search::Worker::iterative_deepening() {
         iterIdx                        = (iterIdx + 1) & 3;
     }
 
+    // The totals are exact once all threads have finished
+    flush_counts();
+
     if (!mainThread)
         return;
 
@@ -543,6 +639,74 @@ void Search::Worker::iterative_deepening() {
                              skill.best ? skill.best : skill.pick_best(rootMoves, multiPV)));
 }
 
+// Searches the iterations up to 'lastDepth' with all the threads together, see
+// RootSplit. Each is a single full window root search, which the main thread
+// leads, deciding when to go on, and which the other threads follow.
+void Search::Worker::split_iterations(Stack* ss, Depth lastDepth) {
+
+    RootSplit& split = threads.rootSplit;
+    uint64_t   seen  = 0;
+    Color      us    = rootPos.side_to_move();
+
+    splitRoot = true;
+
+    while (true)
+    {
+        if (is_mainthread())
+        {
+            if (++rootDepth > lastDepth || threads.stop
+                || (limits.depth && rootDepth > limits.depth))
+                break;
+
+            for (RootMove& rm : rootMoves)
+                rm.previousScore = rm.score;
+
+            split.open(rootDepth, rootMoves, threads.size());
+        }
+        else if (!(rootDepth = split.wait_open(seen, rootMoves, completedDepth)))
+            break;
+        else
+            split.wait_pv();
+
+        selDepth = 0;
+        pvIdx    = 0;
+        pvLast   = rootMoves.size();
+
+        Value avg     = rootMoves[0].averageScore;
+        optimism[us]  = 142 * avg / (std::abs(avg) + 91);
+        optimism[~us] = -optimism[us];
+
+        rootDelta = 2 * VALUE_INFINITE;
+        search<Root>(rootPos, ss, -VALUE_INFINITE, VALUE_INFINITE, rootDepth, false);
+
+        split.finish(rootMoves, threadIdx);
+
+        if (!is_mainthread())
+            continue;
+
+        // Keep watching the clock while the other threads finish their moves
+        while (!split.collect(rootMoves, std::chrono::milliseconds(1)))
+        {
+            main_manager()->callsCnt = 0;
+            main_manager()->check_time(*this);
+        }
+
+        std::stable_sort(rootMoves.begin(), rootMoves.end());
+
+        if (threads.stop)
+            break;
+
+        completedDepth = rootDepth;
+        main_manager()->pv(*this, threads, tt, rootDepth);
+    }
+
+    if (is_mainthread())
+        split.close(rootMoves, completedDepth);
+
+    rootDepth = completedDepth;
+    splitRoot = false;
+}
+
 
 void Search::Worker::do_move(Position& pos, const Move move, StateInfo& st, Stack* const ss) {
     do_move(pos, move, st, pos.gives_check(move), ss);
@@ -552,7 +716,11 @@ void Search::Worker::do_move(
   Position& pos, const Move move, StateInfo& st, const bool givesCheck, Stack* const ss) {
     bool capture = pos.capture_stage(move);
     // Preferable over fetch_add to avoid locking instructions
-    nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    const uint64_t n = nodes.load(std::memory_order_relaxed) + 1;
+    nodes.store(n, std::memory_order_relaxed);
+
+    if (!(n & (CountBatch - 1)))
+        flush_counts();
 
     auto [dirtyPiece, dirtyThreats] = accumulatorStack.push();
     pos.do_move(move, st, givesCheck, dirtyPiece, dirtyThreats, &tt, &sharedHistory);
@@ -583,13 +751,16 @@ void Search::Worker::undo_null_move(Position& pos) { pos.undo_null_move(); }
 
 
 // Reset histories, usually before a new game
-void Search::Worker::clear() {
+void Search::Worker::clear(bool shared) {
     mainHistory.fill(mainHistoryDefault);
     captureHistory.fill(-689);
 
     // Each thread is responsible for clearing their part of shared history
-    sharedHistory.correctionHistory.clear_range(0, numaThreadIdx, numaTotal);
-    sharedHistory.pawnHistory.clear_range(-1238, numaThreadIdx, numaTotal);
+    if (shared)
+    {
+        sharedHistory.correctionHistory.clear_range(0, numaThreadIdx, numaTotal);
+        sharedHistory.pawnHistory.clear_range(-1238, numaThreadIdx, numaTotal);
+    }
 
     ttMoveHistory = 0;
 
@@ -607,6 +778,7 @@ void Search::Worker::clear() {
         reductions[i] = int(2747 / 128.0 * std::log(i));
 
     refreshTable.clear(networks[numaAccessToken]);
+    evalCache.clear();
 }
 
 
@@ -623,6 +795,13 @@ Value Search::Worker::search(
     if (depth <= 0)
         return qsearch<PvNode ? PV : NonPV>(pos, ss, alpha, beta);
 
+    // The start latency of the thread runs up to its first node
+    if (rootNode && startPending)
+    {
+        startPending = false;
+        threads.record_start_latency();
+    }
+
     // Limit the depth if extensions made it too large
     depth = std::min(depth, MAX_PLY - 1);
 
@@ -661,6 +840,7 @@ Value Search::Worker::search(
     ss->moveCount = 0;
     bestValue     = -VALUE_INFINITE;
     maxValue      = VALUE_INFINITE;
+    count(MainNodes);
 
     // Check for the available remaining time
     if (is_mainthread())
@@ -701,7 +881,9 @@ Value Search::Worker::search(
     // Step 4. Transposition table lookup
     excludedMove                   = ss->excludedMove;
     posKey                         = pos.key();
-    auto [ttHit, ttData, ttWriter] = tt.probe(posKey);
+    auto [ttHit, ttData, ttWriter] = probe_tt(tt, posKey);
+    ++ttProbes;
+    ttHits += ttHit;
     // Need further processing of the saved data
     ss->ttHit    = ttHit;
     ttData.move  = rootNode ? rootMoves[pvIdx].pv[0] : ttHit ? ttData.move : Move::none();
@@ -757,11 +939,20 @@ Value Search::Worker::search(
         depth--;
 
     // At non-PV nodes we check for an early TT cutoff
+    if (!PvNode && !excludedMove)
+        count(TTCutoffTriesByDepth, depth);
+
     if (!PvNode && !excludedMove && ttData.depth > depth - (ttData.value <= beta)
         && is_valid(ttData.value)  // Can happen when !ttHit or when access race in probe()
         && (ttData.bound & (ttData.value >= beta ? BOUND_LOWER : BOUND_UPPER))
         && (cutNode == (ttData.value >= beta) || depth > 5))
     {
+        auto tt_cutoff = [&]() {
+            count(TTCutoffs);
+            count(TTCutoffsByDepth, depth);
+            return ttData.value;
+        };
+
         // If ttMove is quiet, update move sorting heuristics on TT hit
         if (ttData.move && ttData.value >= beta)
         {
@@ -789,13 +980,13 @@ Value Search::Worker::search(
 
                 // Check that the ttValue after the tt move would also trigger a cutoff
                 if (!is_valid(ttDataNext.value))
-                    return ttData.value;
+                    return tt_cutoff();
 
                 if ((ttData.value >= beta) == (-ttDataNext.value >= beta))
-                    return ttData.value;
+                    return tt_cutoff();
             }
             else
-                return ttData.value;
+                return tt_cutoff();
         }
     }
 
@@ -809,7 +1000,11 @@ Value Search::Worker::search(
             && pos.rule50_count() == 0 && !pos.can_castle(ANY_CASTLING))
         {
             TB::ProbeState err;
-            TB::WDLScore   wdl = Tablebases::probe_wdl(pos, &err);
+            TB::WDLScore   wdl;
+            {
+                Profiler::ScopedPhase timer(Profiler::TBProbes);
+                wdl = Tablebases::probe_wdl(pos, &err, tbConfig.nonBlocking);
+            }
 
             // Force check of time on the next occasion
             if (is_mainthread())
@@ -871,7 +1066,10 @@ Value Search::Worker::search(
     // If eval is really low, skip search entirely and return the qsearch value.
     // For PvNodes, we must have a guard against mates being returned.
     if (!PvNode && eval < alpha - 485 - 281 * depth * depth)
+    {
+        count(Razorings);
         return qsearch<NonPV>(pos, ss, alpha, beta);
+    }
 
     // Step 8. Futility pruning: child node
     // The depth condition is important for mate finding.
@@ -886,7 +1084,10 @@ Value Search::Worker::search(
 
         if (!ss->ttPv && depth < 14 && eval - futility_margin(depth) >= beta && eval >= beta
             && (!ttData.move || ttCapture) && !is_loss(beta) && !is_win(eval))
+        {
+            count(FutilityPrunings);
             return (2 * beta + eval) / 3;
+        }
     }
 
     // Step 9. Null move search with verification search
@@ -895,6 +1096,8 @@ Value Search::Worker::search(
     {
         assert((ss - 1)->currentMove != Move::null());
 
+        count(NullMoveTries);
+
         // Null move dynamic reduction based on depth
         Depth R = 7 + depth / 3;
         do_null_move(pos, st, ss);
@@ -907,7 +1110,10 @@ Value Search::Worker::search(
         if (nullValue >= beta && !is_win(nullValue))
         {
             if (nmpMinPly || depth < 16)
+            {
+                count(NullMoveCutoffs);
                 return nullValue;
+            }
 
             assert(!nmpMinPly);  // Recursive verification is not allowed
 
@@ -920,7 +1126,10 @@ Value Search::Worker::search(
             nmpMinPly = 0;
 
             if (v >= beta)
+            {
+                count(NullMoveCutoffs);
                 return nullValue;
+            }
         }
     }
 
@@ -947,6 +1156,8 @@ Value Search::Worker::search(
         MovePicker mp(pos, ttData.move, probCutBeta - ss->staticEval, &captureHistory);
         Depth      probCutDepth = std::clamp(depth - 5 - (ss->staticEval - beta) / 315, 0, depth);
 
+        count(ProbCutTries);
+
         while ((move = mp.next_move()) != Move::none())
         {
             assert(move.is_ok());
@@ -975,7 +1186,10 @@ Value Search::Worker::search(
                                probCutDepth + 1, move, unadjustedStaticEval, tt.generation());
 
                 if (!is_decisive(value))
+                {
+                    count(ProbCutCutoffs);
                     return value - (probCutBeta - beta);
+                }
             }
         }
     }
@@ -994,7 +1208,7 @@ moves_loop:  // When in check, search starts here
 
 
     MovePicker mp(pos, ttData.move, depth, &mainHistory, &lowPlyHistory, &captureHistory, contHist,
-                  &sharedHistory, ss->ply);
+                  &sharedHistory, ss->ply, &tt, legalMovePicker);
 
     value = bestValue;
 
@@ -1009,8 +1223,8 @@ moves_loop:  // When in check, search starts here
         if (move == excludedMove)
             continue;
 
-        // Check for legality
-        if (!pos.legal(move))
+        // Check for legality, unless the move picker only gives legal moves
+        if (!legalMovePicker && !pos.legal(move))
             continue;
 
         // At root obey the "searchmoves" option and skip moves not listed in Root
@@ -1019,6 +1233,16 @@ moves_loop:  // When in check, search starts here
         if (rootNode && !std::count(rootMoves.begin() + pvIdx, rootMoves.begin() + pvLast, move))
             continue;
 
+        // In a split iteration leave the moves taken by other threads to them,
+        // and search ours with the best score of all the threads as alpha.
+        if (rootNode && splitRoot)
+        {
+            if (!threads.rootSplit.claim(move, threadIdx))
+                continue;
+
+            alpha = std::max(alpha, threads.rootSplit.alpha());
+        }
+
         ss->moveCount = ++moveCount;
 
         if (rootNode && is_mainthread() && nodes > 10000000)
@@ -1132,6 +1356,7 @@ moves_loop:  // When in check, search starts here
         {
             Value singularBeta  = ttData.value - (53 + 75 * (ss->ttPv && !PvNode)) * depth / 60;
             Depth singularDepth = newDepth / 2;
+            count(SingularTries);
 
             ss->excludedMove = move;
             value = search<NonPV>(pos, ss, singularBeta - 1, singularBeta, singularDepth, cutNode);
@@ -1149,6 +1374,7 @@ moves_loop:  // When in check, search starts here
                   1 + (value < singularBeta - doubleMargin) + (value < singularBeta - tripleMargin);
 
                 depth++;
+                count(SingularExtensions);
             }
 
             // Multi-cut pruning
@@ -1159,6 +1385,7 @@ moves_loop:  // When in check, search starts here
             // subtree by returning a softbound.
             else if (value >= beta && !is_decisive(value))
             {
+                count(MultiCuts);
                 ttMoveHistory << std::max(-400 - 100 * depth, -4000);
                 return value;
             }
@@ -1241,6 +1468,7 @@ moves_loop:  // When in check, search starts here
             ss->reduction = newDepth - d;
             value         = -search<NonPV>(pos, ss + 1, -(alpha + 1), -alpha, d, true);
             ss->reduction = 0;
+            count(LmrSearches);
 
             // Do a full-depth search when reduced LMR search fails high
             // (*Scaler) Shallower searches here don't scale well
@@ -1254,7 +1482,10 @@ moves_loop:  // When in check, search starts here
                 newDepth += doDeeperSearch - doShallowerSearch;
 
                 if (newDepth > d)
+                {
+                    count(LmrResearches);
                     value = -search<NonPV>(pos, ss + 1, -(alpha + 1), -alpha, newDepth, !cutNode);
+                }
 
                 // Post LMR continuation history updates
                 update_continuation_histories(ss, movedPiece, move.to_sq(), 1365);
@@ -1340,6 +1571,9 @@ moves_loop:  // When in check, search starts here
                 for (Move* m = (ss + 1)->pv; *m != Move::none(); ++m)
                     rm.pv.push_back(*m);
 
+                if (splitRoot)
+                    threads.rootSplit.raise_alpha(value);
+
                 // We record how often the best move has been changed in each iteration.
                 // This information is used for time management. In MultiPV mode,
                 // we must take care to only do this for the first PV line.
@@ -1373,6 +1607,8 @@ moves_loop:  // When in check, search starts here
                 {
                     // (*Scaler) Infrequent and small updates scale well
                     ss->cutoffCnt += (extension < 2) || PvNode;
+                    count(BetaCutoffs);
+                    count(CutoffMoveNumber, moveCount);
                     assert(value >= beta);  // Fail high
                     break;
                 }
@@ -1402,6 +1638,11 @@ moves_loop:  // When in check, search starts here
     // must be a mate or a stalemate. If we are in a singular extension search then
     // return a fail low score.
 
+    // In a split iteration the other moves were searched by other threads, so
+    // the result is only that of ours, and is neither learned from nor stored.
+    if (rootNode && splitRoot)
+        return moveCount ? bestValue : alpha;
+
     assert(moveCount || !ss->inCheck || excludedMove || !MoveList<LEGAL>(pos).size());
 
     // Adjust best value for fail high cases
@@ -1529,6 +1770,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
     bestMove    = Move::none();
     ss->inCheck = pos.checkers();
     moveCount   = 0;
+    count(QsearchNodes);
 
     // Used to send selDepth info to GUI (selDepth counts from 1, ply from 0)
     if (PvNode && selDepth < ss->ply + 1)
@@ -1542,7 +1784,9 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
 
     // Step 3. Transposition table lookup
     posKey                         = pos.key();
-    auto [ttHit, ttData, ttWriter] = tt.probe(posKey);
+    auto [ttHit, ttData, ttWriter] = probe_tt(tt, posKey);
+    ++ttProbes;
+    ttHits += ttHit;
     // Need further processing of the saved data
     ss->ttHit    = ttHit;
     ttData.move  = ttHit ? ttData.move : Move::none();
@@ -1553,7 +1797,10 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
     if (!PvNode && ttData.depth >= DEPTH_QS
         && is_valid(ttData.value)  // Can happen when !ttHit or when access race in probe()
         && (ttData.bound & (ttData.value >= beta ? BOUND_LOWER : BOUND_UPPER)))
+    {
+        count(QsearchTTCutoffs);
         return ttData.value;
+    }
 
     // Step 4. Static evaluation of the position
     Value unadjustedStaticEval = VALUE_NONE;
@@ -1613,7 +1860,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
     // the moves. We presently use two stages of move generator in quiescence search:
     // captures, or evasions only when in check.
     MovePicker mp(pos, ttData.move, DEPTH_QS, &mainHistory, &lowPlyHistory, &captureHistory,
-                  contHist, &sharedHistory, ss->ply);
+                  contHist, &sharedHistory, ss->ply, &tt, legalMovePicker);
 
     // Step 5. Loop through all pseudo-legal moves until no moves remain or a beta
     // cutoff occurs.
@@ -1621,7 +1868,7 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
     {
         assert(move.is_ok());
 
-        if (!pos.legal(move))
+        if (!legalMovePicker && !pos.legal(move))
             continue;
 
         givesCheck = pos.gives_check(move);
@@ -1754,7 +2001,7 @@ TimePoint Search::Worker::elapsed_time() const { return main_manager()->tm.elaps
 
 Value Search::Worker::evaluate(const Position& pos) {
     return Eval::evaluate(networks[numaAccessToken], pos, accumulatorStack, refreshTable,
-                          optimism[pos.side_to_move()]);
+                          evalCache, netChoice, optimism[pos.side_to_move()]);
 }
 
 namespace {
@@ -1950,6 +2197,17 @@ void SearchManager::check_time(Search::Worker& worker) {
 
     static TimePoint lastInfoTime = now();
 
+    if (nextLimitsSet.exchange(false, std::memory_order_acquire))
+    {
+        worker.limits = nextLimits;
+        tm.init(worker.limits, worker.rootPos.side_to_move(), worker.rootPos.game_ply(),
+                worker.options, originalTimeAdjust);
+
+        // The iterations may be past the depth asked already
+        if (worker.limits.depth && worker.completedDepth >= worker.limits.depth)
+            worker.threads.stop = worker.threads.abortedSearch = true;
+    }
+
     TimePoint elapsed = tm.elapsed([&worker]() { return worker.threads.nodes_searched(); });
     TimePoint tick    = worker.limits.startTime + elapsed;
 
@@ -1959,6 +2217,10 @@ void SearchManager::check_time(Search::Worker& worker) {
         dbg_print();
     }
 
+    if (const int interval = worker.options["Metrics Interval"]; interval && updates.onMetrics)
+        if (const TimePoint time = tm.elapsed_time(); time - lastMetricsTime >= interval)
+            metrics(worker, time);
+
     // We should not stop pondering until told so by the GUI
     if (ponder)
         return;
@@ -1973,6 +2235,12 @@ void SearchManager::check_time(Search::Worker& worker) {
         worker.threads.stop = worker.threads.abortedSearch = true;
 }
 
+void SearchManager::continue_with(const LimitsType& limits) {
+    nextLimits = limits;
+    nextLimitsSet.store(true, std::memory_order_release);
+    ponder = false;
+}
+
 // Used to correct and extend PVs for moves that have a TB (but not a mate) score.
 // Keeps the search based PV for as long as it is verified to maintain the game
 // outcome, truncates afterwards. Finally, extends to mate the PV, providing a
@@ -2114,14 +2382,30 @@ void syzygy_extend_pv(const OptionsMap&         options,
 void SearchManager::pv(Search::Worker&           worker,
                        const ThreadPool&         threads,
                        const TranspositionTable& tt,
-                       Depth                     depth) {
+                       Depth                     depth,
+                       bool                      final) {
+
+    TimePoint time     = std::max(TimePoint(1), tm.elapsed_time());
+    TimePoint interval = TimePoint(worker.options["PV Interval"]);
+
+    if (!final && interval && lastPvTime && time - lastPvTime < interval)
+    {
+        pvPending = true;
+        return;
+    }
 
-    const auto nodes     = threads.nodes_searched();
-    auto&      rootMoves = worker.rootMoves;
-    auto&      pos       = worker.rootPos;
-    size_t     pvIdx     = worker.pvIdx;
-    size_t     multiPV   = std::min(size_t(worker.options["MultiPV"]), rootMoves.size());
-    uint64_t   tbHits    = threads.tb_hits() + (worker.tbConfig.rootInTB ? rootMoves.size() : 0);
+    lastPvTime = time;
+    pvPending  = false;
+
+    const auto nodes       = threads.nodes_searched();
+    auto&      rootMoves   = worker.rootMoves;
+    auto&      pos         = worker.rootPos;
+    size_t     pvIdx       = worker.pvIdx;
+    size_t     multiPV     = std::min(size_t(worker.options["MultiPV"]), rootMoves.size());
+    uint64_t   tbHits      = threads.tb_hits() + (worker.tbConfig.rootInTB ? rootMoves.size() : 0);
+    bool       changesOnly = !final && worker.options["PV Changes Only"];
+
+    lastPvLines.resize(multiPV, 0);
 
     for (size_t i = 0; i < multiPV; ++i)
     {
@@ -2130,7 +2414,9 @@ void SearchManager::pv(Search::Worker&           worker,
         if (depth == 1 && !updated && i > 0)
             continue;
 
-        Depth d = updated ? depth : std::max(1, depth - 1);
+        Depth d = rootMoves[i].lineDepth ? rootMoves[i].lineDepth
+                : updated                ? depth
+                                         : std::max(1, depth - 1);
         Value v = updated ? rootMoves[i].uciScore : rootMoves[i].previousScore;
 
         if (v == -VALUE_INFINITE)
@@ -2141,6 +2427,18 @@ void SearchManager::pv(Search::Worker&           worker,
 
         bool isExact = i != pvIdx || tb || !updated;  // tablebase- and previous-scores are exact
 
+        // A line is sent again only when its depth, score, bound or moves change
+        uint64_t key = (uint64_t(d) << 32 | uint32_t(v)) ^ uint64_t(isExact) << 63
+                     ^ uint64_t(rootMoves[i].scoreLowerbound) << 62
+                     ^ uint64_t(rootMoves[i].scoreUpperbound) << 61;
+        for (Move m : rootMoves[i].pv)
+            key = (key ^ m.raw()) * 0x100000001B3ULL;
+
+        if (changesOnly && key == lastPvLines[i])
+            continue;
+
+        lastPvLines[i] = key;
+
         // Potentially correct and extend the PV, and in exceptional cases v
         if (is_decisive(v) && std::abs(v) < VALUE_MATE_IN_MAX_PLY
             && ((!rootMoves[i].scoreLowerbound && !rootMoves[i].scoreUpperbound) || isExact))
@@ -2170,18 +2468,66 @@ void SearchManager::pv(Search::Worker&           worker,
         if (!isExact)
             info.bound = bound;
 
-        TimePoint time = std::max(TimePoint(1), tm.elapsed_time());
-        info.timeMs    = time;
-        info.nodes     = nodes;
-        info.nps       = nodes * 1000 / time;
-        info.tbHits    = tbHits;
-        info.pv        = pv;
-        info.hashfull  = tt.hashfull();
+        info.timeMs   = time;
+        info.nodes    = nodes;
+        info.nps      = nodes * 1000 / time;
+        info.tbHits   = tbHits;
+        info.pv       = pv;
+        info.pvMoves  = rootMoves[i].pv.data();
+        info.pvLength = rootMoves[i].pv.size();
+        info.hashfull = tt.hashfull();
 
         updates.onUpdateFull(info);
     }
 }
 
+// The statistics of the search so far, with the speed of each NUMA node since the
+// last line, to tell a throttled or misbound node from the others
+void SearchManager::metrics(Search::Worker& worker, TimePoint elapsed) {
+
+    const ThreadPool& threads = worker.threads;
+    const auto        counts  = threads.node_counts();
+    const auto        bound   = threads.get_bound_thread_count_by_numa_node();
+    const TimePoint   time    = std::max(TimePoint(1), elapsed);
+    const TimePoint   span    = std::max(TimePoint(1), elapsed - lastMetricsTime);
+    const uint64_t    nodes   = threads.nodes_searched();
+
+    NodeCounts total;
+    for (const NodeCounts& c : counts)
+    {
+        total.ttProbes += c.ttProbes;
+        total.ttHits += c.ttHits;
+        total.evals += c.evals;
+    }
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(4) << "{\"time\":" << time << ",\"nodes\":" << nodes
+       << ",\"nps\":" << nodes * 1000 / time << ",\"depth\":" << worker.completedDepth
+       << ",\"hashfull\":" << worker.tt.hashfull() << ",\"ttprobes\":" << total.ttProbes
+       << ",\"tthits\":" << total.ttHits << ",\"tthitrate\":"
+       << (total.ttProbes ? double(total.ttHits) / total.ttProbes : 0.0)
+       << ",\"tbhits\":" << threads.tb_hits() << ",\"evals\":" << total.evals
+       << ",\"bestmovechanges\":" << totBestMoveChanges << ",\"numa\":[";
+
+    lastMetricsCounts.resize(counts.size());
+
+    for (size_t n = 0; n < counts.size(); ++n)
+    {
+        const uint64_t delta = counts[n].nodes - lastMetricsCounts[n].nodes;
+
+        ss << (n ? "," : "") << "{\"node\":" << n << ",\"threads\":"
+           << (bound.empty() ? threads.size() : n < bound.size() ? bound[n] : 0)
+           << ",\"nodes\":" << counts[n].nodes << ",\"nps\":" << delta * 1000 / span
+           << ",\"evals\":" << counts[n].evals << "}";
+    }
+
+    ss << "]}";
+
+    lastMetricsTime   = elapsed;
+    lastMetricsCounts = counts;
+    updates.onMetrics(ss.str());
+}
+
 // Called in case we have no ponder move before exiting the search,
 // for instance, in case we stop the search during a fail high at root.
 // We try hard to have a ponder move to return to the GUI,
@@ -2207,5 +2553,203 @@ bool RootMove::extract_ponder_from_tt(const TranspositionTable& tt, Position& po
     return pv.size() > 1;
 }
 
+void Search::MultiPVLines::clear() {
+    std::scoped_lock lock(mutex);
+    lines.clear();
+}
+
+// Keeps the deepest result of each line
+void Search::MultiPVLines::publish(size_t line, Depth depth, const RootMove& rm) {
+    std::scoped_lock lock(mutex);
+
+    if (lines.size() <= line)
+        lines.resize(line + 1, RootMove(Move::none()));
+
+    if (depth >= lines[line].lineDepth)
+    {
+        lines[line]           = rm;
+        lines[line].lineDepth = depth;
+    }
+}
+
+// A line whose move is already on an earlier line, because the lines were
+// published at different times, or which has not been published yet, is left
+// as the caller has it.
+void Search::MultiPVLines::arrange(RootMoves& rootMoves, size_t first, size_t last, bool copy) {
+    std::scoped_lock lock(mutex);
+
+    for (size_t i = 0; i < first && copy; ++i)
+        rootMoves[i].lineDepth = 0;
+
+    for (size_t i = first; i < last && i < lines.size(); ++i)
+    {
+        if (lines[i].pv[0] == Move::none())
+            continue;
+
+        auto it = std::find(rootMoves.begin() + i, rootMoves.end(), lines[i].pv[0]);
+        if (it == rootMoves.end())
+            continue;
+
+        std::rotate(rootMoves.begin() + i, it, it + 1);
+
+        if (copy)
+            rootMoves[i] = lines[i];
+    }
+}
+
+void Search::RootSplit::clear() {
+    std::scoped_lock lock(mutex);
+    iteration = 0;
+    depth = lastCompleted = 0;
+}
+
+void Search::RootSplit::open(Depth d, const RootMoves& rootMoves, size_t threadCount) {
+    std::scoped_lock lock(mutex);
+
+    for (size_t i = 0; i < rootMoves.size(); ++i)
+        owner[i] = -1;
+
+    moves = results = rootMoves;
+    depth           = d;
+    running         = threadCount;
+    pvDone          = false;
+    bestValue       = -VALUE_INFINITE;
+    ++iteration;
+    cv.notify_all();
+}
+
+// The moves not taken, as when the search stopped, keep their previous results
+bool Search::RootSplit::collect(RootMoves& rootMoves, std::chrono::milliseconds timeout) {
+    std::unique_lock lock(mutex);
+
+    if (!cv.wait_for(lock, timeout, [&] { return !running; }))
+        return false;
+
+    rootMoves = results;
+    return true;
+}
+
+void Search::RootSplit::close(const RootMoves& rootMoves, Depth completedDepth) {
+    std::scoped_lock lock(mutex);
+    results       = rootMoves;
+    depth         = 0;
+    lastCompleted = completedDepth;
+    ++iteration;
+    cv.notify_all();
+}
+
+Depth Search::RootSplit::wait_open(uint64_t& seen, RootMoves& rootMoves, Depth& completedDepth) {
+    std::unique_lock lock(mutex);
+    cv.wait(lock, [&] { return iteration > seen; });
+
+    seen           = iteration;
+    rootMoves      = depth ? moves : results;
+    completedDepth = depth ? depth - 1 : lastCompleted;
+    return depth;
+}
+
+void Search::RootSplit::wait_pv() {
+    std::unique_lock lock(mutex);
+    cv.wait(lock, [&] { return pvDone.load(); });
+}
+
+// The moves are claimed in the order of each thread's move picker, so the
+// list is searched for the move rather than walked with a shared index
+bool Search::RootSplit::claim(Move m, size_t threadIdx) {
+    auto it = std::find(moves.begin(), moves.end(), m);
+    int  none = -1;
+    return it != moves.end()
+        && owner[it - moves.begin()].compare_exchange_strong(none, int(threadIdx));
+}
+
+void Search::RootSplit::raise_alpha(Value v) {
+    Value current = bestValue.load(std::memory_order_relaxed);
+    while (v > current && !bestValue.compare_exchange_weak(current, v))
+    {}
+
+    if (!pvDone)
+    {
+        std::scoped_lock lock(mutex);
+        pvDone = true;
+        cv.notify_all();
+    }
+}
+
+void Search::RootSplit::finish(const RootMoves& rootMoves, size_t threadIdx) {
+    std::scoped_lock lock(mutex);
+
+    for (size_t i = 0; i < moves.size(); ++i)
+        if (owner[i] == int(threadIdx))
+            results[i] = *std::find(rootMoves.begin(), rootMoves.end(), moves[i].pv[0]);
+
+    // The main thread may have stopped before the PV move was searched
+    pvDone = true;
+    --running;
+    cv.notify_all();
+}
+
+#ifdef SEARCH_COUNTERS
+// Formats the counters as a table, giving each count also as a percentage of
+// the count it is a subset of, and the histograms as one line per bucket.
+std::string Search::format_counters(const Counters& counters) {
+
+    struct Row {
+        const char* name;
+        Counter     counter;
+        Counter     base;
+    };
+
+    constexpr Row Rows[] = {{"Main nodes", MainNodes, COUNTER_NB},
+                            {"Qsearch nodes", QsearchNodes, COUNTER_NB},
+                            {"TT cutoffs", TTCutoffs, MainNodes},
+                            {"Qsearch TT cutoffs", QsearchTTCutoffs, QsearchNodes},
+                            {"Razorings", Razorings, MainNodes},
+                            {"Futility prunings", FutilityPrunings, MainNodes},
+                            {"Null move tries", NullMoveTries, MainNodes},
+                            {"Null move cutoffs", NullMoveCutoffs, NullMoveTries},
+                            {"ProbCut tries", ProbCutTries, MainNodes},
+                            {"ProbCut cutoffs", ProbCutCutoffs, ProbCutTries},
+                            {"Singular tries", SingularTries, MainNodes},
+                            {"Singular extensions", SingularExtensions, SingularTries},
+                            {"Multi-cuts", MultiCuts, SingularTries},
+                            {"LMR searches", LmrSearches, COUNTER_NB},
+                            {"LMR re-searches", LmrResearches, LmrSearches},
+                            {"Beta cutoffs", BetaCutoffs, MainNodes}};
+
+    const auto& c = counters.counts;
+    const auto& h = counters.histograms;
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2) << "Search counters\n";
+
+    for (const Row& row : Rows)
+    {
+        ss << std::left << std::setw(22) << row.name << std::right << std::setw(14)
+           << c[row.counter];
+
+        if (row.base != COUNTER_NB && c[row.base])
+            ss << std::setw(8) << 100.0 * c[row.counter] / c[row.base] << "%";
+
+        ss << "\n";
+    }
+
+    ss << "\nDepth        TT tries    TT cutoffs    Rate\n";
+    for (int d = 0; d < Counters::Buckets; ++d)
+        if (const uint64_t tries = h[TTCutoffTriesByDepth][d])
+            ss << std::setw(5) << d << std::setw(16) << tries << std::setw(14)
+               << h[TTCutoffsByDepth][d] << std::setw(7)
+               << 100.0 * h[TTCutoffsByDepth][d] / tries << "%\n";
+
+    ss << "\nCutoff move    Cutoffs    Share\n";
+    for (int n = 1; n < Counters::Buckets; ++n)
+        if (const uint64_t cutoffs = h[CutoffMoveNumber][n])
+            ss << std::setw(11) << n << std::setw(11) << cutoffs << std::setw(8)
+               << 100.0 * cutoffs / c[BetaCutoffs] << "%\n";
+
+    ss << "\nThe last depth and move number also count all larger ones.";
+    return ss.str();
+}
+#endif
+
 
 }  // namespace Stockfish
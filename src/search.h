@@ -23,21 +23,26 @@
 #include <array>
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <string_view>
 #include <vector>
 
+#include "evaluate.h"
 #include "history.h"
 #include "misc.h"
 #include "nnue/network.h"
 #include "nnue/nnue_accumulator.h"
 #include "numa.h"
 #include "position.h"
+#include "profiler.h"
 #include "score.h"
 #include "syzygy/tbprobe.h"
 #include "timeman.h"
@@ -102,6 +107,7 @@ struct RootMove {
     bool              scoreLowerbound  = false;
     bool              scoreUpperbound  = false;
     int               selDepth         = 0;
+    Depth             lineDepth        = 0;  // Set on the lines taken from MultiPVLines
     int               tbRank           = 0;
     Value             tbScore;
     std::vector<Move> pv;
@@ -110,6 +116,67 @@ struct RootMove {
 using RootMoves = std::vector<RootMove>;
 
 
+// With "MultiPV Split", each thread searches only one of the PV lines, so that
+// the lines are searched side by side rather than one after another. The
+// threads publish their results here. The thread of line k takes the moves of
+// lines 0 to k - 1 from here to exclude them, and the main thread, which
+// searches line 0, shows the other lines as published.
+class MultiPVLines {
+   public:
+    void clear();
+    void publish(size_t line, Depth depth, const RootMove& rm);
+    // Brings the moves of lines 'first' to 'last' - 1 to their places in
+    // 'rootMoves'. If 'copy', also replaces these root moves by the published ones.
+    void arrange(RootMoves& rootMoves, size_t first, size_t last, bool copy);
+
+   private:
+    std::mutex            mutex;
+    std::vector<RootMove> lines;
+};
+
+
+// With "Root Split Depth", the iterations up to that depth are searched by the
+// threads together rather than each on its own, as Lazy SMP scales poorly in
+// short searches. In each of them the main thread searches the PV move first.
+// Then every thread takes the root moves left one at a time, whenever it is
+// free, and the root searches share their best score as alpha. The main thread
+// merges the results into the root moves of the next iteration.
+class RootSplit {
+   public:
+    void clear();
+
+    // Main thread, opens an iteration on its root moves
+    void open(Depth depth, const RootMoves& rootMoves, size_t threadCount);
+    // Main thread, true once all the threads have finished the iteration, with
+    // the merged results in 'rootMoves'
+    bool collect(RootMoves& rootMoves, std::chrono::milliseconds timeout);
+    // Main thread, ends the split iterations
+    void close(const RootMoves& rootMoves, Depth completedDepth);
+
+    // Other threads, wait for an iteration newer than 'seen' and return its
+    // depth with its root moves, or 0 with the final ones once closed
+    Depth wait_open(uint64_t& seen, RootMoves& rootMoves, Depth& completedDepth);
+    // Other threads, wait for the PV move to be searched
+    void wait_pv();
+
+    bool  claim(Move m, size_t threadIdx);
+    Value alpha() const { return bestValue.load(std::memory_order_relaxed); }
+    void  raise_alpha(Value v);
+    void  finish(const RootMoves& rootMoves, size_t threadIdx);
+
+   private:
+    std::mutex              mutex;
+    std::condition_variable cv;
+    uint64_t                iteration = 0;
+    Depth                   depth = 0, lastCompleted = 0;
+    size_t                  running = 0;
+    std::atomic<bool>       pvDone{false};
+    std::atomic<Value>      bestValue{-VALUE_INFINITE};
+    RootMoves               moves, results;
+    std::atomic<int>        owner[MAX_MOVES];
+};
+
+
 // LimitsType struct stores information sent by the caller about the analysis required.
 struct LimitsType {
 
@@ -117,6 +184,8 @@ struct LimitsType {
     LimitsType() {
         time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] = npmsec = movetime = TimePoint(0);
         movestogo = depth = mate = perft = infinite = 0;
+        perftThreads                                = 1;
+        perftHash                                   = 0;
         nodes                                       = 0;
         ponderMode                                  = false;
     }
@@ -126,11 +195,83 @@ struct LimitsType {
     std::vector<std::string> searchmoves;
     TimePoint                time[COLOR_NB], inc[COLOR_NB], npmsec, movetime, startTime;
     int                      movestogo, depth, mate, perft, infinite;
+    int                      perftThreads, perftHash;  // Threads and hash MB for perft
     uint64_t                 nodes;
     bool                     ponderMode;
 };
 
 
+// Optional counters of search events, compiled in with -DSEARCH_COUNTERS. Without
+// it the workers have no counters and all the counting is discarded.
+
+// Events counted by Counters, see their names in search.cpp
+enum Counter {
+    MainNodes,
+    QsearchNodes,
+    TTCutoffs,
+    QsearchTTCutoffs,
+    Razorings,
+    FutilityPrunings,
+    NullMoveTries,
+    NullMoveCutoffs,
+    ProbCutTries,
+    ProbCutCutoffs,
+    SingularTries,
+    SingularExtensions,
+    MultiCuts,
+    LmrSearches,
+    LmrResearches,
+    BetaCutoffs,
+    COUNTER_NB
+};
+
+// Distributions counted by Counters, bucketed by depth or move number
+enum Histogram {
+    TTCutoffTriesByDepth,
+    TTCutoffsByDepth,
+    CutoffMoveNumber,
+    HISTOGRAM_NB
+};
+
+#ifdef SEARCH_COUNTERS
+// Per thread counts of search events, to tie changes in speed and depth to the
+// pruning behind them
+struct Counters {
+    static constexpr int Buckets = 32;
+
+    void count(Counter c) { ++counts[c]; }
+
+    void count(Histogram h, int bucket) { ++histograms[h][std::clamp(bucket, 0, Buckets - 1)]; }
+
+    void add(const Counters& other) {
+        for (int i = 0; i < COUNTER_NB; ++i)
+            counts[i] += other.counts[i];
+        for (int i = 0; i < HISTOGRAM_NB; ++i)
+            for (int j = 0; j < Buckets; ++j)
+                histograms[i][j] += other.histograms[i][j];
+    }
+
+    std::array<uint64_t, COUNTER_NB>                        counts{};
+    std::array<std::array<uint64_t, Buckets>, HISTOGRAM_NB> histograms{};
+};
+
+std::string format_counters(const Counters& counters);
+#endif
+
+
+// Node and TB hit totals of the threads on one NUMA node. The threads add their
+// counts in batches, so that reading the totals touches one cache line per node
+// rather than one per thread, and the lines mostly stay on their own socket.
+struct alignas(64) NodeCounter {
+    std::atomic<uint64_t> nodes{0}, tbHits{0}, ttProbes{0}, ttHits{0}, evals{0};
+};
+
+// What a NodeCounter held when read
+struct NodeCounts {
+    uint64_t nodes = 0, tbHits = 0, ttProbes = 0, ttHits = 0, evals = 0;
+};
+
+
 // The UCI stores the uci options, thread pool, and transposition table.
 // This struct is used to easily forward data to the Search::Worker class.
 struct SharedState {
@@ -138,18 +279,21 @@ struct SharedState {
                 ThreadPool&                                               threadPool,
                 TranspositionTable&                                       transpositionTable,
                 std::map<NumaIndex, SharedHistories>&                     sharedHists,
-                const LazyNumaReplicatedSystemWide<Eval::NNUE::Networks>& nets) :
+                const LazyNumaReplicatedSystemWide<Eval::NNUE::Networks>& nets,
+                const NumaReplicated<Tablebases::PinnedTables>*           pinned = nullptr) :
         options(optionsMap),
         threads(threadPool),
         tt(transpositionTable),
         sharedHistories(sharedHists),
-        networks(nets) {}
+        networks(nets),
+        pinnedTables(pinned) {}
 
     const OptionsMap&                                         options;
     ThreadPool&                                               threads;
     TranspositionTable&                                       tt;
     std::map<NumaIndex, SharedHistories>&                     sharedHistories;
     const LazyNumaReplicatedSystemWide<Eval::NNUE::Networks>& networks;
+    const NumaReplicated<Tablebases::PinnedTables>*           pinnedTables;  // Of the host
 };
 
 class Worker;
@@ -177,6 +321,8 @@ struct InfoFull: InfoShort {
     size_t           nps;
     size_t           tbHits;
     std::string_view pv;
+    const Move*      pvMoves;  // The moves of pv, pvLength of them
+    size_t           pvLength;
     int              hashfull;
 };
 
@@ -222,12 +368,14 @@ class SearchManager: public ISearchManager {
     using UpdateFull     = std::function<void(const InfoFull&)>;
     using UpdateIter     = std::function<void(const InfoIteration&)>;
     using UpdateBestmove = std::function<void(std::string_view, std::string_view)>;
+    using UpdateMetrics  = std::function<void(std::string_view)>;
 
     struct UpdateContext {
         UpdateShort    onUpdateNoMoves;
         UpdateFull     onUpdateFull;
         UpdateIter     onIter;
         UpdateBestmove onBestmove;
+        UpdateMetrics  onMetrics;  // May be empty
     };
 
 
@@ -236,15 +384,24 @@ class SearchManager: public ISearchManager {
 
     void check_time(Search::Worker& worker) override;
 
+    // Ends a ponder search, which goes on with the limits of a new 'go'. They are
+    // taken by the main thread at its next check_time().
+    void continue_with(const LimitsType& limits);
+
+    // Reports the PV lines, unless held back by "PV Interval" or "PV Changes Only".
+    // The final report of a search is always sent in full.
     void pv(Search::Worker&           worker,
             const ThreadPool&         threads,
             const TranspositionTable& tt,
-            Depth                     depth);
+            Depth                     depth,
+            bool                      final = false);
 
     Stockfish::TimeManagement tm;
     double                    originalTimeAdjust;
     int                       callsCnt;
     std::atomic_bool          ponder;
+    LimitsType                nextLimits;
+    std::atomic_bool          nextLimitsSet = false;
 
     std::array<Value, 4> iterValue;
     double               previousTimeReduction;
@@ -254,6 +411,18 @@ class SearchManager: public ISearchManager {
 
     size_t id;
 
+    // With "Metrics Interval", the search statistics are written as one line of
+    // JSON that often, see SearchManager::metrics()
+    void metrics(Search::Worker& worker, TimePoint elapsed);
+
+    double                  totBestMoveChanges;  // As weighed by the time management
+    TimePoint               lastMetricsTime;
+    std::vector<NodeCounts> lastMetricsCounts;  // By NUMA node
+
+    TimePoint             lastPvTime;   // Of the last report, zero before the first
+    bool                  pvPending;    // An update was held back since then
+    std::vector<uint64_t> lastPvLines;  // Keys of the lines as last reported
+
     const UpdateContext& updates;
 };
 
@@ -275,8 +444,9 @@ class Worker {
            NumaReplicatedAccessToken);
 
     // Called at instantiation to initialize reductions tables.
-    // Reset histories, usually before a new game.
-    void clear();
+    // Reset histories, usually before a new game. The thread's part of the shared
+    // histories of its NUMA node too, unless shared is false.
+    void clear(bool shared = true);
 
     // Called when the program receives the UCI 'go' command.
     // It searches from the root position and outputs the "bestmove".
@@ -286,6 +456,11 @@ class Worker {
 
     void ensure_network_replicated();
 
+    // The NNUE state kept in the worker and its eval cache, for the memory report
+    const Eval::NNUE::AccumulatorStack&  accumulator_stack() const { return accumulatorStack; }
+    const Eval::NNUE::AccumulatorCaches& accumulator_caches() const { return refreshTable; }
+    const Eval::EvalCache&               eval_cache() const { return evalCache; }
+
     // Public because they need to be updatable by the stats
     ButterflyHistory mainHistory;
     LowPlyHistory    lowPlyHistory;
@@ -299,6 +474,7 @@ class Worker {
 
    private:
     void iterative_deepening();
+    void split_iterations(Stack* ss, Depth lastDepth);
 
     void do_move(Position& pos, const Move move, StateInfo& st, Stack* const ss);
     void
@@ -328,10 +504,45 @@ class Worker {
 
     Value evaluate(const Position&);
 
+    // Count a search event, or do nothing without -DSEARCH_COUNTERS
+    void count([[maybe_unused]] Counter c) {
+#ifdef SEARCH_COUNTERS
+        counters.count(c);
+#endif
+    }
+    void count([[maybe_unused]] Histogram h, [[maybe_unused]] int bucket) {
+#ifdef SEARCH_COUNTERS
+        counters.count(h, bucket);
+#endif
+    }
+
     LimitsType limits;
 
+    // Adds the counts since the last flush to the NUMA node counter
+    void flush_counts() {
+        const uint64_t n = nodes.load(std::memory_order_relaxed);
+        const uint64_t t = tbHits.load(std::memory_order_relaxed);
+        const uint64_t e = netChoice.smallEvals + netChoice.bigEvals - netChoice.doubleEvals;
+        nodeCounter->nodes.fetch_add(n - flushedNodes, std::memory_order_relaxed);
+        nodeCounter->tbHits.fetch_add(t - flushedTbHits, std::memory_order_relaxed);
+        nodeCounter->ttProbes.fetch_add(ttProbes, std::memory_order_relaxed);
+        nodeCounter->ttHits.fetch_add(ttHits, std::memory_order_relaxed);
+        nodeCounter->evals.fetch_add(e - flushedEvals, std::memory_order_relaxed);
+        flushedNodes.store(n, std::memory_order_relaxed);
+        flushedTbHits = t;
+        flushedEvals  = e;
+        ttProbes = ttHits = 0;
+    }
+
+    static constexpr uint64_t CountBatch = 1024;  // Nodes between flushes, a power of two
+
     size_t                pvIdx, pvLast;
     std::atomic<uint64_t> nodes, tbHits, bestMoveChanges;
+    NodeCounter*          nodeCounter = nullptr;
+    std::atomic<uint64_t> flushedNodes{0};
+    uint64_t              flushedTbHits = 0;
+    uint64_t              flushedEvals  = 0;
+    uint64_t              ttProbes = 0, ttHits = 0;  // Of the search, since the last flush
     int                   selDepth, nmpMinPly;
 
     Value optimism[COLOR_NB];
@@ -361,6 +572,16 @@ class Worker {
     // Used by NNUE
     Eval::NNUE::AccumulatorStack  accumulatorStack;
     Eval::NNUE::AccumulatorCaches refreshTable;
+    Eval::EvalCache               evalCache;
+    Eval::NetChoice               netChoice;
+    bool                          legalMovePicker = false;  // The "Legal Move Picker" option
+    bool                          splitRoot       = false;  // In an iteration of RootSplit
+    bool                          startPending    = false;  // Until the first node of a search
+#ifdef SEARCH_COUNTERS
+    Counters counters;
+#endif
+    Profiler::PhaseTimes          phaseTimes;
+    Tablebases::CacheCounts       tbCacheCounts;  // Of this thread, as of its last search
 
     friend class Stockfish::ThreadPool;
     friend class SearchManager;
@@ -204,10 +204,10 @@ class SharedMemoryBackend {
     SharedMemoryBackend() :
         status(Status::NotInitialized) {};
 
-    SharedMemoryBackend(const std::string& shm_name, const T& value) :
+    SharedMemoryBackend(const std::string& shm_name, const T& value, size_t count = 1) :
         status(Status::NotInitialized) {
 
-        initialize(shm_name, value);
+        initialize(shm_name, value, count);
     }
 
     bool is_valid() const { return status == Status::Success; }
@@ -276,8 +276,9 @@ class SharedMemoryBackend {
     }
 
    private:
-    void initialize(const std::string& shm_name, const T& value) {
-        const size_t total_size = sizeof(T) + sizeof(IS_INITIALIZED_VALUE);
+    void initialize(const std::string& shm_name, const T& value, size_t count) {
+        const size_t data_size  = sizeof(T) * count;
+        const size_t total_size = data_size + sizeof(IS_INITIALIZED_VALUE);
 
         // Try allocating with large pages first.
         hMapFile = windows_try_with_large_page_priviliges(
@@ -302,8 +303,16 @@ class SharedMemoryBackend {
         // Fallback to normal allocation if no large pages available.
         if (!hMapFile)
         {
-            hMapFile = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
-                                          static_cast<DWORD>(total_size), shm_name.c_str());
+    #if defined(_WIN64)
+            DWORD total_size_low  = total_size & 0xFFFFFFFFu;
+            DWORD total_size_high = total_size >> 32u;
+    #else
+            DWORD total_size_low  = total_size;
+            DWORD total_size_high = 0;
+    #endif
+
+            hMapFile = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                          total_size_high, total_size_low, shm_name.c_str());
         }
 
         if (!hMapFile)
@@ -349,13 +358,13 @@ class SharedMemoryBackend {
 
         // Crucially, we place the object first to ensure alignment.
         volatile DWORD* is_initialized =
-          std::launder(reinterpret_cast<DWORD*>(reinterpret_cast<char*>(pMap) + sizeof(T)));
+          std::launder(reinterpret_cast<DWORD*>(reinterpret_cast<char*>(pMap) + data_size));
         T* object = std::launder(reinterpret_cast<T*>(pMap));
 
         if (*is_initialized != IS_INITIALIZED_VALUE)
         {
             // First time initialization, message for debug purposes
-            new (object) T{value};
+            std::uninitialized_fill_n(object, count, value);
             *is_initialized = IS_INITIALIZED_VALUE;
         }
 
@@ -413,8 +422,8 @@ class SharedMemoryBackend {
    public:
     SharedMemoryBackend() = default;
 
-    SharedMemoryBackend(const std::string& shm_name, const T& value) :
-        shm1(shm::create_shared<T>(shm_name, value)) {}
+    SharedMemoryBackend(const std::string& shm_name, const T& value, size_t count = 1) :
+        shm1(shm::create_shared<T>(shm_name, value, count)) {}
 
     void* get() const {
         const T* ptr = &shm1->get();
@@ -456,7 +465,8 @@ class SharedMemoryBackend {
     SharedMemoryBackend() = default;
 
     SharedMemoryBackend([[maybe_unused]] const std::string& shm_name,
-                        [[maybe_unused]] const T&           value) {}
+                        [[maybe_unused]] const T&           value,
+                        [[maybe_unused]] size_t             count = 1) {}
 
     void* get() const { return nullptr; }
 
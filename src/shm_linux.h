@@ -26,6 +26,7 @@
 #include <cstring>
 #include <cstdio>
 #include <dirent.h>
+#include <memory>
 #include <mutex>
 #include <new>
 #include <optional>
@@ -157,6 +158,7 @@ class SharedMemory: public detail::SharedMemoryBase {
 
    private:
     std::string        name_;
+    size_t             count_      = 1;
     int                fd_         = -1;
     void*              mapped_ptr_ = nullptr;
     T*                 data_ptr_   = nullptr;
@@ -165,8 +167,14 @@ class SharedMemory: public detail::SharedMemoryBase {
     std::string        sentinel_base_;
     std::string        sentinel_path_;
 
-    static constexpr size_t calculate_total_size() noexcept {
-        return sizeof(T) + sizeof(detail::ShmHeader);
+    // The header follows the objects, rounded up so that it stays properly aligned
+    static constexpr size_t calculate_data_size(size_t count) noexcept {
+        constexpr size_t align = alignof(detail::ShmHeader);
+        return (sizeof(T) * count + align - 1) / align * align;
+    }
+
+    static constexpr size_t calculate_total_size(size_t count) noexcept {
+        return calculate_data_size(count) + sizeof(detail::ShmHeader);
     }
 
     static std::string make_sentinel_base(const std::string& name) {
@@ -177,9 +185,10 @@ class SharedMemory: public detail::SharedMemoryBase {
     }
 
    public:
-    explicit SharedMemory(const std::string& name) noexcept :
+    explicit SharedMemory(const std::string& name, size_t count = 1) noexcept :
         name_(name),
-        total_size_(calculate_total_size()),
+        count_(count),
+        total_size_(calculate_total_size(count)),
         sentinel_base_(make_sentinel_base(name)) {}
 
     ~SharedMemory() noexcept override {
@@ -192,6 +201,7 @@ class SharedMemory: public detail::SharedMemoryBase {
 
     SharedMemory(SharedMemory&& other) noexcept :
         name_(std::move(other.name_)),
+        count_(other.count_),
         fd_(other.fd_),
         mapped_ptr_(other.mapped_ptr_),
         data_ptr_(other.data_ptr_),
@@ -212,6 +222,7 @@ class SharedMemory: public detail::SharedMemoryBase {
             close();
 
             name_          = std::move(other.name_);
+            count_         = other.count_;
             fd_            = other.fd_;
             mapped_ptr_    = other.mapped_ptr_;
             data_ptr_      = other.data_ptr_;
@@ -595,12 +606,12 @@ class SharedMemory: public detail::SharedMemoryBase {
             return false;
         }
 
-        data_ptr_ = static_cast<T*>(mapped_ptr_);
-        header_ptr_ =
-          reinterpret_cast<detail::ShmHeader*>(static_cast<char*>(mapped_ptr_) + sizeof(T));
+        data_ptr_   = static_cast<T*>(mapped_ptr_);
+        header_ptr_ = reinterpret_cast<detail::ShmHeader*>(static_cast<char*>(mapped_ptr_)
+                                                           + calculate_data_size(count_));
 
         new (header_ptr_) detail::ShmHeader{};
-        new (data_ptr_) T{initial_value};
+        std::uninitialized_fill_n(data_ptr_, count_, initial_value);
 
         if (!initialize_shared_mutex())
             return false;
@@ -629,8 +640,8 @@ class SharedMemory: public detail::SharedMemoryBase {
         }
 
         data_ptr_   = static_cast<T*>(mapped_ptr_);
-        header_ptr_ = std::launder(
-          reinterpret_cast<detail::ShmHeader*>(static_cast<char*>(mapped_ptr_) + sizeof(T)));
+        header_ptr_ = std::launder(reinterpret_cast<detail::ShmHeader*>(
+          static_cast<char*>(mapped_ptr_) + calculate_data_size(count_)));
 
         if (!header_ptr_->initialized.load(std::memory_order_acquire)
             || header_ptr_->magic != detail::ShmHeader::SHM_MAGIC)
@@ -645,9 +656,9 @@ class SharedMemory: public detail::SharedMemoryBase {
 };
 
 template<typename T>
-[[nodiscard]] std::optional<SharedMemory<T>> create_shared(const std::string& name,
-                                                           const T& initial_value) noexcept {
-    SharedMemory<T> shm(name);
+[[nodiscard]] std::optional<SharedMemory<T>>
+create_shared(const std::string& name, const T& initial_value, size_t count = 1) noexcept {
+    SharedMemory<T> shm(name, count);
     if (shm.open(initial_value))
         return shm;
     return std::nullopt;
@@ -21,6 +21,7 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <cctype>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
@@ -28,18 +29,23 @@
 #include <fstream>
 #include <initializer_list>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <string_view>
 #include <sys/stat.h>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include <array>
 
 #include "../bitboard.h"
+#include "../memory.h"
 #include "../misc.h"
 #include "../movegen.h"
+#include "../numa.h"
 #include "../position.h"
 #include "../search.h"
 #include "../types.h"
@@ -202,6 +208,8 @@ class TBFile: public std::ifstream {
     // C:\tb\wdl345;C:\tb\wdl6;D:\tb\dtz345;D:\tb\dtz6
     static std::string Paths;
 
+    static constexpr uint8_t Magics[][4] = {{0xD7, 0x66, 0x0C, 0xA5}, {0x71, 0xE8, 0x23, 0x5D}};
+
     TBFile(const std::string& f) {
 
 #ifndef _WIN32
@@ -291,8 +299,6 @@ class TBFile: public std::ifstream {
 #endif
         uint8_t* data = (uint8_t*) *baseAddress;
 
-        constexpr uint8_t Magics[][4] = {{0xD7, 0x66, 0x0C, 0xA5}, {0x71, 0xE8, 0x23, 0x5D}};
-
         if (memcmp(data, Magics[type == WDL], 4))
         {
             std::cerr << "Corrupted table in file " << fname << std::endl;
@@ -303,6 +309,9 @@ class TBFile: public std::ifstream {
         return data + 4;  // Skip Magics's header
     }
 
+    // The path of the file, if it is open
+    const std::string& name() const { return fname; }
+
     static void unmap(void* baseAddress, uint64_t mapping) {
 
 #ifndef _WIN32
@@ -316,6 +325,85 @@ class TBFile: public std::ifstream {
 
 std::string TBFile::Paths;
 
+// Set while a thread probes without waiting for the disk, see probe_wdl(), and
+// raised when the probe needed data that is not in memory
+thread_local bool NonBlocking = false;
+thread_local bool NotResident = false;
+
+// The 4 KiB pages that the non-blocking probes of this thread found resident, by
+// their number modulo the size of the table, so that most probes need no mincore()
+// call. The table is cleared every ResidentChecks checks, as the kernel may have
+// dropped the pages since.
+constexpr size_t ResidentPageShift = 12, ResidentPagesSize = 256, ResidentChecks = 1 << 16;
+
+thread_local std::array<uintptr_t, ResidentPagesSize> ResidentPages{};
+thread_local size_t                                   ResidentChecksLeft = ResidentChecks;
+
+bool is_resident(const void* p, size_t size) {
+
+    const uintptr_t first = uintptr_t(p) >> ResidentPageShift;
+    const uintptr_t last  = (uintptr_t(p) + size - 1) >> ResidentPageShift;
+
+    if (!--ResidentChecksLeft)
+    {
+        ResidentPages.fill(0);
+        ResidentChecksLeft = ResidentChecks;
+    }
+
+    bool known = true;
+    for (uintptr_t page = first; known && page <= last; ++page)
+        known = ResidentPages[page % ResidentPagesSize] == page;
+
+    if (known)
+        return true;
+
+    if (!is_resident_or_read_ahead(p, size))
+        return false;
+
+    for (uintptr_t page = first; page <= last; ++page)
+        ResidentPages[page % ResidentPagesSize] = page;
+
+    return true;
+}
+
+// Whether the probe may read [p, p + size) of a mapped file. A non-blocking probe
+// may not when it is not resident, and the file is then read in the background.
+bool available(const void* p, size_t size) {
+    if (NonBlocking && !NotResident && !is_resident(p, size))
+        NotResident = true;
+
+    return !NotResident;
+}
+
+// Reads a mapped file into memory ahead of its first probes, by hinting the
+// kernel and then touching every page. Returns false when aborted on the way.
+bool prefault(void* baseAddress, size_t size, bool hugePages, const std::atomic_bool& abort) {
+#ifndef _WIN32
+    #if defined(MADV_HUGEPAGE)
+    if (hugePages)
+        madvise(baseAddress, size, MADV_HUGEPAGE);  // Only for filesystems that support it
+    #endif
+    #if defined(MADV_WILLNEED)
+    madvise(baseAddress, size, MADV_WILLNEED);
+    #endif
+#endif
+    (void) hugePages;
+
+    constexpr size_t        Page = 4096, Chunk = 2 * 1024 * 1024;
+    const volatile uint8_t* data = static_cast<const volatile uint8_t*>(baseAddress);
+
+    for (size_t chunk = 0; chunk < size; chunk += Chunk)
+    {
+        if (abort.load(std::memory_order_relaxed))
+            return false;
+
+        for (size_t i = chunk; i < std::min(chunk + Chunk, size); i += Page)
+            (void) data[i];
+    }
+
+    return true;
+}
+
 // struct PairsData contains low-level indexing information to access TB data.
 // There are 8, 4, or 2 PairsData records for each TBTable, according to the type
 // of table and if positions have pawns or not. It is populated at first access.
@@ -354,6 +442,7 @@ struct TBTable {
     static constexpr int Sides = Type == WDL ? 2 : 1;
 
     std::atomic_bool ready;
+    std::mutex       mutex;  // Taken by the threads mapping the file, see mapped()
     void*            baseAddress;
     uint8_t*         map;
     uint64_t         mapping;
@@ -377,6 +466,15 @@ struct TBTable {
         if (baseAddress)
             TBFile::unmap(baseAddress, mapping);
     }
+
+    size_t mapped_size() const {
+#ifndef _WIN32
+        return size_t(mapping);
+#else
+        MEMORY_BASIC_INFORMATION info;
+        return VirtualQuery(baseAddress, &info, sizeof(info)) ? size_t(info.RegionSize) : 0;
+#endif
+    }
 };
 
 template<>
@@ -444,6 +542,7 @@ class TBTables {
 
     std::deque<TBTable<WDL>> wdlTable;
     std::deque<TBTable<DTZ>> dtzTable;
+    std::vector<std::string> codes;  // Of the files of each table, as KRvK
     size_t                   foundDTZFiles = 0;
     size_t                   foundWDLFiles = 0;
 
@@ -489,6 +588,7 @@ class TBTables {
         memset(hashTable, 0, sizeof(hashTable));
         wdlTable.clear();
         dtzTable.clear();
+        codes.clear();
         foundDTZFiles = 0;
         foundWDLFiles = 0;
     }
@@ -499,10 +599,123 @@ class TBTables {
     }
 
     void add(const std::vector<PieceType>& pieces);
+
+    size_t             size() const { return wdlTable.size(); }
+    const std::string& code(size_t idx) const { return codes[idx]; }
+    TBTable<WDL>&      wdl(size_t idx) { return wdlTable[idx]; }
+    TBTable<DTZ>&      dtz(size_t idx) { return dtzTable[idx]; }
+
+    // The address and size of each file mapped so far, files are mapped on first probe
+    std::vector<std::pair<const void*, size_t>> mapped_files() const {
+        std::vector<std::pair<const void*, size_t>> files;
+
+        auto collect = [&](const auto& tables) {
+            for (const auto& e : tables)
+                if (e.ready.load(std::memory_order_acquire) && e.baseAddress)
+                    files.emplace_back(e.baseAddress, e.mapped_size());
+        };
+
+        collect(wdlTable);
+        collect(dtzTable);
+        return files;
+    }
 };
 
 TBTables TBTables;
 
+// The background thread of Tablebases::preload(), stopped before the tables change
+struct Preloader {
+    std::thread      thread;
+    std::atomic_bool abort{false};
+
+    void stop() {
+        abort = true;
+        if (thread.joinable())
+            thread.join();
+        abort = false;
+    }
+
+    ~Preloader() { stop(); }
+};
+
+Preloader Preload;
+
+// The indices in TBTables of the tables of a selection, see Tablebases::preload()
+std::vector<size_t> select_tables(const std::string& selection) {
+
+    std::string list(selection);
+    std::replace(list.begin(), list.end(), ',', ' ');
+
+    std::istringstream       ss(list);
+    std::vector<std::string> names;
+    for (std::string name; ss >> name;)
+        names.push_back(name.substr(0, name.find('.')));  // Also takes KQvK.rtbw
+
+    std::vector<size_t> selected;
+    const bool          byCount = names.size() == 1 && names[0].size() <= 2
+                       && std::all_of(names[0].begin(), names[0].end(),
+                                      [](unsigned char c) { return std::isdigit(c); });
+
+    for (size_t i = 0; i < TBTables.size(); ++i)
+        if (byCount ? TBTables.wdl(i).pieceCount <= std::stoi(names[0])
+                    : std::find(names.begin(), names.end(), TBTables.code(i)) != names.end())
+            selected.push_back(i);
+
+    return selected;
+}
+
+// class ProbeCache keeps the results of probe_wdl() and probe_dtz(), shared by all
+// threads. It is lock-free: an entry is a single word holding the upper half of
+// the position key, the value and the probe state, so that a reader sees either
+// a whole result or one that does not match its key. Failed probes are not kept.
+class ProbeCache {
+
+    static constexpr size_t Size = 1 << 20;  // Entries, 8 MB
+
+    std::unique_ptr<std::atomic<uint64_t>[]> table;
+
+    static size_t index(Key key, TBType type) { return (size_t(key) * 2 + type) & (Size - 1); }
+
+   public:
+    void resize(bool enabled) {
+        table = enabled ? std::make_unique<std::atomic<uint64_t>[]>(Size) : nullptr;
+    }
+
+    bool probe(Key key, TBType type, int* value, ProbeState* result) const {
+        if (!table)
+            return false;
+
+        ++Counts.probes;
+        const uint64_t data = table[index(key, type)].load(std::memory_order_relaxed);
+
+        // The state is stored plus two, so that an empty entry never matches
+        if (uint32_t(data >> 32) != uint32_t(key >> 32) || !(data & 0xFF))
+            return false;
+
+        ++Counts.hits;
+        *value  = int16_t(uint16_t(data >> 16));
+        *result = ProbeState(int(data & 0xFF) - 2);
+        return true;
+    }
+
+    void save(Key key, TBType type, int value, ProbeState result) {
+        if (!table || result == FAIL)
+            return;
+
+        const uint64_t data = (key >> 32 << 32) | uint64_t(uint16_t(int16_t(value))) << 16
+                            | uint64_t(result + 2);
+        table[index(key, type)].store(data, std::memory_order_relaxed);
+    }
+
+    static thread_local CacheCounts Counts;
+};
+
+thread_local CacheCounts ProbeCache::Counts;
+
+ProbeCache ProbeCache;
+
+int probe_dtz_uncached(Position& pos, ProbeState* result);  // See Tablebases::probe_dtz()
+
 // If the corresponding file exists two new objects TBTable<WDL> and TBTable<DTZ>
 // are created and added to the lists and hash table. Called at init time.
 void TBTables::add(const std::vector<PieceType>& pieces) {
@@ -532,6 +745,7 @@ void TBTables::add(const std::vector<PieceType>& pieces) {
 
     wdlTable.emplace_back(code);
     dtzTable.emplace_back(wdlTable.back());
+    codes.push_back(code);
 
     // Insert into the hash keys for both colors: KRvK with KR white and black
     insert(wdlTable.back().key, &wdlTable.back(), &dtzTable.back());
@@ -577,6 +791,9 @@ int decompress_pairs(PairsData* d, uint64_t idx) {
     uint32_t k = uint32_t(idx / d->span);
 
     // Then we read the corresponding SparseIndex[] entry
+    if (!available(&d->sparseIndex[k], sizeof(SparseEntry)))
+        return 0;
+
     uint32_t block  = number<uint32_t, LittleEndian>(&d->sparseIndex[k].block);
     int      offset = number<uint16_t, LittleEndian>(&d->sparseIndex[k].offset);
 
@@ -590,17 +807,34 @@ int decompress_pairs(PairsData* d, uint64_t idx) {
     // Sum the above to offset to find the offset corresponding to our idx
     offset += diff;
 
+    if (!available(&d->blockLength[block], sizeof(uint16_t)))
+        return 0;
+
     // Move to the previous/next block, until we reach the correct block that contains idx,
-    // that is when 0 <= offset <= d->blockLength[block]
+    // that is when 0 <= offset <= d->blockLength[block]. Each entry is checked before
+    // it is read, as the walk may cross into another page.
     while (offset < 0)
+    {
+        if (!available(&d->blockLength[block - 1], sizeof(uint16_t)))
+            return 0;
+
         offset += d->blockLength[--block] + 1;
+    }
 
     while (offset > d->blockLength[block])
+    {
         offset -= d->blockLength[block++] + 1;
 
+        if (!available(&d->blockLength[block], sizeof(uint16_t)))
+            return 0;
+    }
+
     // Finally, we find the start address of our block of canonical Huffman symbols
     uint32_t* ptr = (uint32_t*) (d->data + (uint64_t(block) * d->sizeofBlock));
 
+    if (!available(ptr, d->sizeofBlock))
+        return 0;
+
     // Read the first 64 bits in our block, this is a (truncated) sequence of
     // unknown number of symbols of unknown length but we know the first one
     // is at the beginning of this 64-bit sequence.
@@ -1210,11 +1444,12 @@ void set(T& e, uint8_t* data) {
 // If the TB file corresponding to the given position is already memory-mapped
 // then return its base address, otherwise, try to memory map and init it. Called
 // at every probe, memory map, and init only at first access. Function is thread
-// safe and can be called concurrently.
+// safe and can be called concurrently. The lock is that of the table, so threads
+// opening different tables do not wait for each other, and a non-blocking probe
+// does not wait for the thread opening its table.
 template<TBType Type>
 void* mapped(TBTable<Type>& e, const Position& pos) {
 
-    static std::mutex mutex;
     // Because TB is the only usage of materialKey, check it here in debug mode
     assert(pos.material_key_is_ok());
 
@@ -1223,7 +1458,12 @@ void* mapped(TBTable<Type>& e, const Position& pos) {
     if (e.ready.load(std::memory_order_acquire))
         return e.baseAddress;  // Could be nullptr if file does not exist
 
-    std::scoped_lock<std::mutex> lk(mutex);
+    std::unique_lock<std::mutex> lk(e.mutex, std::defer_lock);
+
+    if (!NonBlocking)
+        lk.lock();
+    else if (!lk.try_lock())
+        return nullptr;
 
     if (e.ready.load(std::memory_order_relaxed))  // Recheck under lock
         return e.baseAddress;
@@ -1248,18 +1488,94 @@ void* mapped(TBTable<Type>& e, const Position& pos) {
     return e.baseAddress;
 }
 
+}  // namespace
+
+// The pinned WDL tables of one NUMA node, each in its own allocation read whole
+// from the file. Their TBTable objects are set up as a mapped table is, but have
+// no baseAddress to unmap.
+struct Tablebases::PinnedTables::Impl {
+    struct File {
+        std::string code;
+        void*       memory;
+        size_t      size;
+    };
+
+    std::vector<File>                      files;
+    std::deque<TBTable<WDL>>               tables;
+    std::unordered_map<Key, TBTable<WDL>*> byKey;  // By the key of either color
+
+    Impl() = default;
+    Impl(const Impl& other) {
+        for (const File& f : other.files)
+            add(f.code, f.size, [&](void* mem) {
+                std::memcpy(mem, f.memory, f.size);
+                return true;
+            });
+    }
+    Impl& operator=(const Impl&) = delete;
+
+    ~Impl() {
+        for (const File& f : files)
+            aligned_large_pages_free(f.memory);
+    }
+
+    // Allocates the memory of a file, which fill() writes and checks
+    template<typename Fill>
+    bool add(const std::string& code, size_t size, Fill fill) {
+        void* mem = aligned_large_pages_alloc(size);
+
+        if (!mem || !fill(mem))
+        {
+            aligned_large_pages_free(mem);
+            return false;
+        }
+
+        files.push_back({code, mem, size});
+        TBTable<WDL>& e = tables.emplace_back(code);
+        set(e, static_cast<uint8_t*>(mem) + 4);  // Skip Magics's header
+        e.ready.store(true, std::memory_order_release);
+        byKey[e.key] = byKey[e.key2] = &e;
+        return true;
+    }
+
+    TBTable<WDL>* get(Key key) const {
+        auto it = byKey.find(key);
+        return it != byKey.end() ? it->second : nullptr;
+    }
+};
+
+namespace {
+
+// Those of the engine of the calling thread, and its node, see set_numa_access_token()
+thread_local const NumaReplicated<PinnedTables>* Pinned = nullptr;
+thread_local NumaReplicatedAccessToken LocalToken;
+
+TBTable<WDL>* pinned_table(Key key) {
+    const PinnedTables::Impl* impl = Pinned ? (*Pinned)[LocalToken].details() : nullptr;
+    return impl ? impl->get(key) : nullptr;
+}
+
 template<TBType Type, typename Ret = typename TBTable<Type>::Ret>
 Ret probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw) {
 
     if (pos.count<ALL_PIECES>() == 2)  // KvK
         return Ret(WDLDraw);
 
+    if constexpr (Type == WDL)
+        if (TBTable<WDL>* entry = pinned_table(pos.material_key()))
+            return do_probe_table(pos, entry, wdl, result);
+
     TBTable<Type>* entry = TBTables.get<Type>(pos.material_key());
 
     if (!entry || !mapped(*entry, pos))
         return *result = FAIL, Ret();
 
-    return do_probe_table(pos, entry, wdl, result);
+    Ret value = do_probe_table(pos, entry, wdl, result);
+
+    if (NotResident)
+        *result = FAIL;
+
+    return value;
 }
 
 // For a position where the side to move has a winning capture it is not necessary
@@ -1338,12 +1654,137 @@ WDLScore search(Position& pos, ProbeState* result) {
 }  // namespace
 
 
+std::vector<std::pair<const void*, size_t>> Tablebases::mapped_files() {
+    return TBTables.mapped_files();
+}
+
+CacheCounts Tablebases::cache_counts() { return ProbeCache::Counts; }
+
+Tablebases::PinnedTables::PinnedTables() = default;
+Tablebases::PinnedTables::PinnedTables(const PinnedTables& other) :
+    impl(other.impl ? std::make_unique<Impl>(*other.impl) : nullptr) {}
+Tablebases::PinnedTables::PinnedTables(PinnedTables&& other) noexcept = default;
+Tablebases::PinnedTables::~PinnedTables()                             = default;
+
+size_t Tablebases::PinnedTables::tables() const { return impl ? impl->tables.size() : 0; }
+
+std::vector<std::pair<const void*, size_t>> Tablebases::PinnedTables::memory() const {
+    std::vector<std::pair<const void*, size_t>> parts;
+
+    if (impl)
+        for (const auto& f : impl->files)
+            parts.emplace_back(f.memory, f.size);
+
+    return parts;
+}
+
+// Reads the WDL files of the selected tables whole into memory, where probes find
+// them before the mapped files. The DTZ files, probed only at the root, are left
+// to the mappings. Files that are missing or fail their checks are skipped.
+Tablebases::PinnedTables Tablebases::PinnedTables::load(const std::string& selection) {
+
+    PinnedTables pinned;
+
+    for (size_t idx : select_tables(selection))
+    {
+        const std::string& code = TBTables.code(idx);
+        TBFile             file(code + ".rtbw");
+
+        if (!file.is_open())
+            continue;
+
+        std::ifstream in(file.name(), std::ios::binary | std::ios::ate);
+        const size_t  size = size_t(in.tellg());
+        in.seekg(0);
+
+        if (!in || size % 64 != 16)
+        {
+            sync_cout << "info string Corrupt tablebase file " << file.name() << sync_endl;
+            continue;
+        }
+
+        if (!pinned.impl)
+            pinned.impl = std::make_unique<Impl>();
+
+        if (!pinned.impl->add(code, size, [&](void* mem) {
+                return in.read(static_cast<char*>(mem), std::streamsize(size))
+                    && !std::memcmp(mem, TBFile::Magics[1], 4);
+            }))
+            sync_cout << "info string Could not pin tablebase file " << file.name() << sync_endl;
+    }
+
+    return pinned;
+}
+
+void Tablebases::set_pinned(const NumaReplicated<PinnedTables>* pinned) { Pinned = pinned; }
+
+void Tablebases::set_numa_access_token(NumaReplicatedAccessToken token) { LocalToken = token; }
+
+// Maps the selected tables and reads them into memory in the background, so that
+// their first probes in a search do not wait for the disk. The selection is a
+// number of pieces, as 5 for the tables of up to 5 pieces, or a list of files
+// such as "KQvK, KRPvKR", and the empty string for none.
+void Tablebases::preload(const std::string& selection, bool hugePages) {
+
+    Preload.stop();
+
+    const std::vector<size_t> selected = select_tables(selection);
+
+    if (selected.empty())
+        return;
+
+    Preload.thread = std::thread([selected, hugePages]() {
+        const TimePoint                             start = now();
+        std::vector<std::pair<const void*, size_t>> files;
+        size_t                                      done = 0;
+
+        auto load = [&](auto& e, const Position& pos) {
+            if (void* base = mapped(e, pos))
+            {
+                files.emplace_back(base, e.mapped_size());
+                return prefault(base, e.mapped_size(), hugePages, Preload.abort);
+            }
+            return true;
+        };
+
+        for (size_t idx : selected)
+        {
+            StateInfo st;
+            Position  pos;
+            pos.set(TBTables.code(idx), WHITE, &st);
+
+            if (!load(TBTables.wdl(idx), pos) || !load(TBTables.dtz(idx), pos))
+                return;
+
+            // Progress at every tenth of the tables
+            const size_t step = std::max<size_t>(1, selected.size() / 10);
+            if (++done % step == 0 && done < selected.size())
+                sync_cout << "info string Preloaded " << done << " of " << selected.size()
+                          << " tablebases" << sync_endl;
+        }
+
+        size_t mapped = 0, resident = 0;
+        for (const auto& [base, size] : files)
+        {
+            mapped += size;
+            resident += residency(base, size).resident;
+        }
+
+        sync_cout << "info string Preloaded " << selected.size() << " tablebases, "
+                  << files.size() << " files, " << mapped / (1024 * 1024) << " MB of which "
+                  << resident / (1024 * 1024) << " MB resident, in " << now() - start << " ms"
+                  << sync_endl;
+    });
+}
+
 // Called at startup and after every change to
 // "SyzygyPath" UCI option to (re)create the various tables. It is not thread
 // safe, nor it needs to be.
 void Tablebases::init(const std::string& paths) {
 
+    Preload.stop();
     TBTables.clear();
+    ProbeCache.resize(!paths.empty());
     MaxCardinality = 0;
     TBFile::Paths  = paths;
 
@@ -1498,10 +1939,24 @@ void Tablebases::init(const std::string& paths) {
 //  0 : draw
 //  1 : win, but draw under 50-move rule
 //  2 : win
-WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result) {
+//
+// A non-blocking probe fails instead of waiting for table data that is not in
+// memory, and has the data read in the background for the next probes.
+WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result, bool nonBlocking) {
+
+    if (int value; ProbeCache.probe(pos.key(), WDL, &value, result))
+        return WDLScore(value);
+
+    NonBlocking = nonBlocking;
+    NotResident = false;
+
+    *result      = OK;
+    WDLScore wdl = search<false>(pos, result);
 
-    *result = OK;
-    return search<false>(pos, result);
+    NonBlocking = false;
+
+    ProbeCache.save(pos.key(), WDL, wdl, *result);
+    return wdl;
 }
 
 // Probe the DTZ table for a particular position.
@@ -1532,6 +1987,19 @@ WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result) {
 // then do not accept moves leading to dtz + 50-move-counter == 100.
 int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
 
+    if (int value; ProbeCache.probe(pos.key(), DTZ, &value, result))
+        return value;
+
+    const int dtz = probe_dtz_uncached(pos, result);
+
+    ProbeCache.save(pos.key(), DTZ, dtz, *result);
+    return dtz;
+}
+
+namespace {
+
+int probe_dtz_uncached(Position& pos, ProbeState* result) {
+
     *result      = OK;
     WDLScore wdl = search<true>(pos, result);
 
@@ -1591,6 +2059,8 @@ int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
     return minDTZ == 0xFFFF ? -1 : minDTZ;
 }
 
+}  // namespace
+
 
 // Use the DTZ tables to rank root moves.
 //
@@ -1599,10 +2069,10 @@ bool Tablebases::root_probe(Position&                    pos,
                             Search::RootMoves&           rootMoves,
                             bool                         rule50,
                             bool                         rankDTZ,
-                            const std::function<bool()>& time_abort) {
+                            const std::function<bool()>& time_abort,
+                            const RunJobs&               run) {
 
-    ProbeState result = OK;
-    StateInfo  st;
+    StateInfo st;
 
     // Obtain 50-move counter for the root position
     int cnt50 = pos.rule50_count();
@@ -1610,43 +2080,79 @@ bool Tablebases::root_probe(Position&                    pos,
     // Check whether a position was repeated since the last zeroing move.
     bool rep = pos.has_repeated();
 
-    int dtz, bound = rule50 ? (MAX_DTZ / 2 - 100) : 1;
+    int bound = rule50 ? (MAX_DTZ / 2 - 100) : 1;
+
+    struct Probe {
+        std::string fen;  // Of the position after the move, empty when not probed
+        bool        zeroing = false, mates = false;
+        int         dtz     = 0;
+        ProbeState  result  = OK;
+    };
+
+    std::vector<Probe> probes(rootMoves.size());
+    Jobs               jobs;
 
-    // Probe and rank each move
-    for (auto& m : rootMoves)
+    // Find the moves whose positions need a probe. The probes do not need the
+    // history of the game, which only matters for the draws found here, so they
+    // can run on other threads from the FEN.
+    for (size_t i = 0; i < rootMoves.size(); ++i)
     {
-        pos.do_move(m.pv[0], st);
+        Probe& p = probes[i];
 
-        // Calculate dtz for the current move counting from the root position
-        if (pos.rule50_count() == 0)
-        {
-            // In case of a zeroing move, dtz is one of -101/-1/0/1/101
-            WDLScore wdl = -probe_wdl(pos, &result);
-            dtz          = dtz_before_zeroing(wdl);
-        }
-        else if ((rule50 && pos.is_draw(1)) || pos.is_repetition(1))
-        {
-            // In case a root move leads to a draw by repetition or 50-move rule,
-            // we set dtz to zero. Note: since we are only 1 ply from the root,
-            // this must be a true 3-fold repetition inside the game history.
-            dtz = 0;
-        }
-        else
-        {
-            // Otherwise, take dtz for the new position and correct by 1 ply
-            dtz = -probe_dtz(pos, &result);
-            dtz = dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : dtz;
-        }
+        pos.do_move(rootMoves[i].pv[0], st);
 
-        // Make sure that a mating move is assigned a dtz value of 1
-        if (pos.checkers() && dtz == 2 && MoveList<LEGAL>(pos).size() == 0)
-            dtz = 1;
+        // In case a root move leads to a draw by repetition or 50-move rule,
+        // we set dtz to zero. Note: since we are only 1 ply from the root,
+        // this must be a true 3-fold repetition inside the game history.
+        p.zeroing = pos.rule50_count() == 0;
+        if (p.zeroing || !((rule50 && pos.is_draw(1)) || pos.is_repetition(1)))
+            p.fen = pos.fen();
+
+        p.mates = pos.checkers() && MoveList<LEGAL>(pos).size() == 0;
+
+        pos.undo_move(rootMoves[i].pv[0]);
+
+        if (!p.fen.empty())
+            jobs.emplace_back([&p, chess960 = pos.is_chess960()]() {
+                StateInfo si;
+                Position  child;
+                child.set(p.fen, chess960, &si);
+
+                // Calculate dtz for the current move counting from the root position
+                if (p.zeroing)
+                    // In case of a zeroing move, dtz is one of -101/-1/0/1/101
+                    p.dtz = dtz_before_zeroing(-probe_wdl(child, &p.result));
+                else
+                {
+                    // Otherwise, take dtz for the new position and correct by 1 ply
+                    p.dtz = -probe_dtz(child, &p.result);
+                    p.dtz = p.dtz > 0 ? p.dtz + 1 : p.dtz < 0 ? p.dtz - 1 : p.dtz;
+                }
+            });
+    }
+
+    if (run)
+        run(jobs);
+    else
+        for (const auto& job : jobs)
+            job();
 
-        pos.undo_move(m.pv[0]);
+    if (time_abort())
+        return false;
 
-        if (time_abort() || result == FAIL)
+    // Rank each move
+    for (size_t i = 0; i < rootMoves.size(); ++i)
+    {
+        auto& m   = rootMoves[i];
+        int   dtz = probes[i].dtz;
+
+        if (probes[i].result == FAIL)
             return false;
 
+        // Make sure that a mating move is assigned a dtz value of 1
+        if (probes[i].mates && dtz == 2)
+            dtz = 1;
+
         // Better moves are ranked higher. Certain wins are ranked equally.
         // Losing moves are ranked equally unless a 50-move draw is in sight.
         int r    = dtz > 0 ? (dtz + cnt50 <= 99 && !rep ? MAX_DTZ - (rankDTZ ? dtz : 0)
@@ -1675,28 +2181,58 @@ bool Tablebases::root_probe(Position&                    pos,
 // This is a fallback for the case that some or all DTZ tables are missing.
 //
 // A return value false indicates that not all probes were successful.
-bool Tablebases::root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, bool rule50) {
+bool Tablebases::root_probe_wdl(Position&          pos,
+                                Search::RootMoves& rootMoves,
+                                bool               rule50,
+                                const RunJobs&     run) {
 
     static const int WDL_to_rank[] = {-MAX_DTZ, -MAX_DTZ + 101, 0, MAX_DTZ - 101, MAX_DTZ};
 
-    ProbeState result = OK;
-    StateInfo  st;
-    WDLScore   wdl;
+    StateInfo st;
 
+    struct Probe {
+        std::string fen;  // Of the position after the move, empty when drawn
+        WDLScore    wdl    = WDLDraw;
+        ProbeState  result = OK;
+    };
 
-    // Probe and rank each move
-    for (auto& m : rootMoves)
+    std::vector<Probe> probes(rootMoves.size());
+    Jobs               jobs;
+
+    // Probe each move, from the FEN so that it can be on another thread
+    for (size_t i = 0; i < rootMoves.size(); ++i)
     {
-        pos.do_move(m.pv[0], st);
+        Probe& p = probes[i];
 
-        if (pos.is_draw(1))
-            wdl = WDLDraw;
-        else
-            wdl = -probe_wdl(pos, &result);
+        pos.do_move(rootMoves[i].pv[0], st);
+
+        if (!pos.is_draw(1))
+            p.fen = pos.fen();
 
-        pos.undo_move(m.pv[0]);
+        pos.undo_move(rootMoves[i].pv[0]);
+
+        if (!p.fen.empty())
+            jobs.emplace_back([&p, chess960 = pos.is_chess960()]() {
+                StateInfo si;
+                Position  child;
+                child.set(p.fen, chess960, &si);
+                p.wdl = -probe_wdl(child, &p.result);
+            });
+    }
+
+    if (run)
+        run(jobs);
+    else
+        for (const auto& job : jobs)
+            job();
+
+    // Rank each move
+    for (size_t i = 0; i < rootMoves.size(); ++i)
+    {
+        auto&    m   = rootMoves[i];
+        WDLScore wdl = probes[i].wdl;
 
-        if (result == FAIL)
+        if (probes[i].result == FAIL)
             return false;
 
         m.tbRank = WDL_to_rank[wdl + 2];
@@ -1713,7 +2249,8 @@ Config Tablebases::rank_root_moves(const OptionsMap&            options,
                                    Position&                    pos,
                                    Search::RootMoves&           rootMoves,
                                    bool                         rankDTZ,
-                                   const std::function<bool()>& time_abort) {
+                                   const std::function<bool()>& time_abort,
+                                   const RunJobs&               run) {
     Config config;
 
     if (rootMoves.empty())
@@ -1723,6 +2260,7 @@ Config Tablebases::rank_root_moves(const OptionsMap&            options,
     config.useRule50   = bool(options["Syzygy50MoveRule"]);
     config.probeDepth  = int(options["SyzygyProbeDepth"]);
     config.cardinality = int(options["SyzygyProbeLimit"]);
+    config.nonBlocking = bool(options["SyzygyNonBlocking"]);
 
     bool dtz_available = true;
 
@@ -1738,13 +2276,13 @@ Config Tablebases::rank_root_moves(const OptionsMap&            options,
     {
         // Rank moves using DTZ tables, bail out if time_abort flags zeitnot
         config.rootInTB =
-          root_probe(pos, rootMoves, options["Syzygy50MoveRule"], rankDTZ, time_abort);
+          root_probe(pos, rootMoves, options["Syzygy50MoveRule"], rankDTZ, time_abort, run);
 
         if (!config.rootInTB && !time_abort())
         {
             // DTZ tables are missing; try to rank moves using WDL tables
             dtz_available   = false;
-            config.rootInTB = root_probe_wdl(pos, rootMoves, options["Syzygy50MoveRule"]);
+            config.rootInTB = root_probe_wdl(pos, rootMoves, options["Syzygy50MoveRule"], run);
         }
     }
 
@@ -19,14 +19,21 @@
 #ifndef TBPROBE_H
 #define TBPROBE_H
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 
 namespace Stockfish {
 class Position;
 class OptionsMap;
+class NumaReplicatedAccessToken;
+template<typename T>
+class NumaReplicated;
 
 using Depth = int;
 
@@ -43,6 +50,7 @@ struct Config {
     bool  rootInTB    = false;
     bool  useRule50   = false;
     Depth probeDepth  = 0;
+    bool  nonBlocking = false;
 };
 
 enum WDLScore {
@@ -61,24 +69,74 @@ enum ProbeState {
     ZEROING_BEST_MOVE = 2    // Best move zeroes DTZ (capture or pawn move)
 };
 
+// Probes of the cache of probe_wdl() and probe_dtz() results by one thread
+struct CacheCounts {
+    uint64_t probes = 0, hits = 0;
+};
+
+// Runs the jobs, possibly at once on other threads, and returns when all are done.
+// When empty, the root probes run one after the other on the calling thread.
+using Jobs    = std::vector<std::function<void()>>;
+using RunJobs = std::function<void(const Jobs&)>;
+
+// WDL tables held whole in anonymous memory, in large pages when available,
+// rather than in mapped files left to the page cache. A copy copies the memory
+// from the calling thread, so that NumaReplicated gives each node its own.
+class PinnedTables {
+   public:
+    struct Impl;
+
+    PinnedTables();
+    PinnedTables(const PinnedTables& other);
+    PinnedTables(PinnedTables&& other) noexcept;
+    PinnedTables& operator=(const PinnedTables&) = delete;
+    ~PinnedTables();
+
+    // Reads the WDL files of the selection, as for preload(), from SyzygyPath
+    static PinnedTables load(const std::string& selection);
+
+    const Impl* details() const { return impl.get(); }
+    size_t      tables() const;
+    // The address and size of the memory of each table
+    std::vector<std::pair<const void*, size_t>> memory() const;
+
+   private:
+    std::unique_ptr<Impl> impl;
+};
+
 extern int MaxCardinality;
 
 
 void     init(const std::string& paths);
-WDLScore probe_wdl(Position& pos, ProbeState* result);
+// The address and size of the mapped files, for the memory report
+std::vector<std::pair<const void*, size_t>> mapped_files();
+// The probes of the calling thread use the copy of these pinned tables on the node
+// of its token, so that the engines of each host probe their own
+void set_pinned(const NumaReplicated<PinnedTables>* pinned);
+void set_numa_access_token(NumaReplicatedAccessToken token);
+// The counts of the calling thread since it started
+CacheCounts cache_counts();
+// Reads the selected tables into memory in the background, see its definition
+void     preload(const std::string& selection, bool hugePages);
+WDLScore probe_wdl(Position& pos, ProbeState* result, bool nonBlocking = false);
 int      probe_dtz(Position& pos, ProbeState* result);
 bool     root_probe(Position&                    pos,
                     Search::RootMoves&           rootMoves,
                     bool                         rule50,
                     bool                         rankDTZ,
-                    const std::function<bool()>& time_abort);
-bool     root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, bool rule50);
+                    const std::function<bool()>& time_abort,
+                    const RunJobs&               run = {});
+bool     root_probe_wdl(Position&          pos,
+                        Search::RootMoves& rootMoves,
+                        bool               rule50,
+                        const RunJobs&     run = {});
 Config   rank_root_moves(
     const OptionsMap&            options,
     Position&                    pos,
     Search::RootMoves&           rootMoves,
     bool                         rankDTZ    = false,
-    const std::function<bool()>& time_abort = []() { return false; });
+    const std::function<bool()>& time_abort = []() { return false; },
+    const RunJobs&               run        = {});
 
 }  // namespace Stockfish::Tablebases
 
@@ -20,26 +20,72 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <deque>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <immintrin.h>
+#endif
+
 #include "bitboard.h"
+#include "book.h"
 #include "history.h"
 #include "memory.h"
 #include "movegen.h"
 #include "search.h"
 #include "syzygy/tbprobe.h"
 #include "timeman.h"
+#include "tt.h"
 #include "types.h"
 #include "uci.h"
 #include "ucioption.h"
 
 namespace Stockfish {
 
+namespace {
+
+// Hints the core that this is a spin-wait loop
+inline void cpu_pause() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Spins until done() returns true or the given microseconds have passed. It
+// pauses between the first checks and then yields the core, so that a long
+// wait does not starve other threads. Returns the last value of done().
+template<typename Done>
+bool spin_until(Done done, int micros) {
+
+    const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(micros);
+
+    for (int i = 0;; ++i)
+    {
+        if (done())
+            return true;
+
+        if ((i & 63) == 63 && std::chrono::steady_clock::now() >= end)
+            return done();
+
+        if (i < 256)
+            cpu_pause();
+        else
+            std::this_thread::yield();
+    }
+}
+
+}  // namespace
+
 // Constructor launches the thread and waits until it goes to sleep
 // in idle_loop(). Note that 'searching' and 'exit' should be already set.
 Thread::Thread(Search::SharedState&                    sharedState,
@@ -61,6 +107,8 @@ Thread::Thread(Search::SharedState&                    sharedState,
         // the Worker allocation. Ideally we would also allocate the SearchManager
         // here, but that's minor.
         this->numaAccessToken = binder();
+        Tablebases::set_numa_access_token(this->numaAccessToken);
+        Tablebases::set_pinned(sharedState.pinnedTables);
         this->worker          = make_unique_large_page<Search::Worker>(
           sharedState, std::move(sm), n, idxInNuma, totalNuma, this->numaAccessToken);
     });
@@ -86,15 +134,13 @@ void Thread::start_searching() {
     run_custom_job([this]() { worker->start_searching(); });
 }
 
-// Clears the histories for the thread worker (usually before a new game)
-void Thread::clear_worker() {
-    assert(worker != nullptr);
-    run_custom_job([this]() { worker->clear(); });
-}
-
 // Blocks on the condition variable until the thread has finished searching
 void Thread::wait_for_search_finished() {
 
+    if (const int micros = spinMicros.load(std::memory_order_relaxed))
+        if (spin_until([&] { return !searching; }, micros))
+            return;
+
     std::unique_lock<std::mutex> lk(mutex);
     cv.wait(lk, [&] { return !searching; });
 }
@@ -113,7 +159,8 @@ void Thread::run_custom_job(std::function<void()> f) {
 void Thread::ensure_network_replicated() { worker->ensure_network_replicated(); }
 
 // Thread gets parked here, blocked on the condition variable
-// when the thread has no work to do.
+// when the thread has no work to do. With an idle spin window it
+// first spins, so that a job given soon after is picked up at once.
 
 void Thread::idle_loop() {
     while (true)
@@ -121,7 +168,15 @@ void Thread::idle_loop() {
         std::unique_lock<std::mutex> lk(mutex);
         searching = false;
         cv.notify_one();  // Wake up anyone waiting for search finished
-        cv.wait(lk, [&] { return searching; });
+
+        if (const int micros = spinMicros.load(std::memory_order_relaxed))
+        {
+            lk.unlock();
+            spin_until([&] { return bool(searching); }, micros);
+            lk.lock();
+        }
+
+        cv.wait(lk, [&] { return bool(searching); });
 
         if (exit)
             return;
@@ -138,113 +193,315 @@ void Thread::idle_loop() {
 
 Search::SearchManager* ThreadPool::main_manager() { return main_thread()->worker->main_manager(); }
 
-uint64_t ThreadPool::nodes_searched() const { return accumulate(&Search::Worker::nodes); }
-uint64_t ThreadPool::tb_hits() const { return accumulate(&Search::Worker::tbHits); }
+// The totals of the NUMA node counters, which lag behind by the last batch of
+// each thread, except for the main thread whose own count is taken exactly. So
+// a single thread search stops at exactly the node limit.
+uint64_t ThreadPool::nodes_searched() const {
+
+    const Search::Worker& main = *main_thread()->worker;
+
+    uint64_t sum = main.nodes.load(std::memory_order_relaxed)
+                 - main.flushedNodes.load(std::memory_order_relaxed)
+                 + externalNodes.load(std::memory_order_relaxed);
+
+    for (auto&& counter : nodeCounters)
+        sum += counter->nodes.load(std::memory_order_relaxed);
+    return sum;
+}
+
+uint64_t ThreadPool::tb_hits() const {
+
+    uint64_t sum = 0;
+    for (auto&& counter : nodeCounters)
+        sum += counter->tbHits.load(std::memory_order_relaxed);
+    return sum;
+}
+
+// The totals of each NUMA node, taken during the search in their batches
+std::vector<Search::NodeCounts> ThreadPool::node_counts() const {
+
+    std::vector<Search::NodeCounts> counts;
+    for (auto&& counter : nodeCounters)
+        counts.push_back({counter->nodes.load(std::memory_order_relaxed),
+                          counter->tbHits.load(std::memory_order_relaxed),
+                          counter->ttProbes.load(std::memory_order_relaxed),
+                          counter->ttHits.load(std::memory_order_relaxed),
+                          counter->evals.load(std::memory_order_relaxed)});
+    return counts;
+}
+
+// Hits and probes of the eval caches of all threads, only read between searches
+std::pair<uint64_t, uint64_t> ThreadPool::eval_cache_stats() const {
+
+    uint64_t hits = 0, probes = 0;
+    for (auto&& th : threads)
+    {
+        hits += th->worker->evalCache.hits;
+        probes += th->worker->evalCache.probes;
+    }
+    return {hits, probes};
+}
+
+// Hits and probes of the tablebase probe cache by all threads, and by the callers
+// of start_thinking() at the root, only read between searches
+std::pair<uint64_t, uint64_t> ThreadPool::tb_cache_stats() const {
+
+    uint64_t hits = rootTbCacheCounts.hits, probes = rootTbCacheCounts.probes;
+    for (auto&& th : threads)
+    {
+        hits += th->worker->tbCacheCounts.hits;
+        probes += th->worker->tbCacheCounts.probes;
+    }
+    return {hits, probes};
+}
+
+// Network choice counters of all threads, only read between searches
+Eval::NetChoice ThreadPool::net_choice_stats() const {
+
+    Eval::NetChoice total;
+    for (auto&& th : threads)
+    {
+        const Eval::NetChoice& nc = th->worker->netChoice;
+        total.smallEvals += nc.smallEvals;
+        total.bigEvals += nc.bigEvals;
+        total.doubleEvals += nc.doubleEvals;
+        total.speculated += nc.speculated;
+    }
+    return total;
+}
+
+#ifdef SEARCH_COUNTERS
+Search::Counters ThreadPool::search_counters() const {
+
+    Search::Counters total;
+    for (auto&& th : threads)
+        total.add(th->worker->counters);
+    return total;
+}
+
+void ThreadPool::clear_search_counters() {
+    for (auto&& th : threads)
+        th->worker->counters = Search::Counters();
+}
+#endif
+
+// Called by each thread at the first node of its search
+void ThreadPool::record_start_latency() {
+    startLatency += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count()
+                  - thinkingStart;
+    ++starts;
+}
+
+// Called by the main thread once all threads have finished after raising stop at t
+void ThreadPool::record_stop_latency(std::chrono::steady_clock::time_point t) {
+    stopLatency +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t)
+        .count();
+    ++stops;
+}
 
 static size_t next_power_of_two(uint64_t count) { return count > 1 ? (2ULL << msb(count - 1)) : 1; }
 
+// Number of units of a shared history on a NUMA node with the given thread count.
+// When the size option is 0 it scales with the threads, otherwise it is the largest
+// power of two that fits in the requested MB, and at least one.
+static size_t shared_history_units(size_t mb, size_t unitBytes, uint64_t threadCount) {
+    if (mb == 0)
+        return next_power_of_two(threadCount);
+
+    const uint64_t units = mb * 1024 * 1024 / unitBytes;
+    return units > 1 ? (1ULL << msb(units)) : 1;
+}
+
 // Creates/destroys threads to match the requested number.
 // Created and launched threads will immediately go to sleep in idle_loop.
-// Upon resizing, threads are recreated to allow for binding if necessary.
-void ThreadPool::set(const NumaConfig&                           numaConfig,
-                     Search::SharedState                         sharedState,
-                     const Search::SearchManager::UpdateContext& updateContext) {
+// The threads from the first one whose NUMA binding changes are recreated, the
+// ones before are kept with their histories, as are the shared histories of the
+// NUMA nodes still in use. Returns the number of threads kept.
+// A pool that is one of several searching side by side passes the number of
+// threads before its own, so that it is bound like the next slice of a single
+// larger pool rather than on top of the others.
+size_t ThreadPool::set(const NumaConfig&                           numaConfig,
+                       Search::SharedState                         sharedState,
+                       const Search::SearchManager::UpdateContext& updateContext,
+                       size_t                                      requested,
+                       size_t                                      firstThread) {
+
+    if (threads.size() > 0)
+        main_thread()->wait_for_search_finished();
 
-    if (threads.size() > 0)  // destroy any existing thread(s)
+    // Binding threads may be problematic when there's multiple NUMA nodes and
+    // multiple Stockfish instances running. In particular, if each instance
+    // runs a single thread then they would all be mapped to the first NUMA node.
+    // This is undesirable, and so the default behaviour (i.e. when the user does not
+    // change the NumaConfig UCI setting) is to not bind the threads to processors
+    // unless we know for sure that we span NUMA nodes and replication is required.
+    const std::string numaPolicy(sharedState.options["NumaPolicy"]);
+    const bool        doBindThreads = [&]() {
+        if (numaPolicy == "none")
+            return false;
+
+        if (numaPolicy == "auto")
+            return numaConfig.suggests_binding_threads(firstThread + requested);
+
+        // numaPolicy == "system", or explicitly set by the user
+        return true;
+    }();
+
+    std::vector<NumaIndex> bound =
+      doBindThreads && requested
+        ? numaConfig.distribute_threads_among_numa_nodes(firstThread + requested)
+        : std::vector<NumaIndex>{};
+
+    if (!bound.empty())
+        bound.erase(bound.begin(), bound.begin() + firstThread);
+
+    // Keep the threads up to the first one bound elsewhere than before
+    const std::string configString = numaConfig.to_string();
+    size_t            kept         = 0;
+
+    if (configString == numaConfigString && context == &updateContext
+        && bound.empty() == boundThreadToNumaNode.empty())
+        while (kept < std::min(threads.size(), requested)
+               && (bound.empty() || bound[kept] == boundThreadToNumaNode[kept]))
+            ++kept;
+
+    threads.resize(kept);  // destroy the other thread(s)
+
+    boundThreadToNumaNode = bound;
+    numaConfigString      = configString;
+    context               = &updateContext;
+
+    if (!kept)
     {
-        main_thread()->wait_for_search_finished();
+        sharedState.sharedHistories.clear();
+        nodeCounters.clear();
+    }
+
+    if (requested == 0)
+        return 0;
 
-        threads.clear();
+    std::map<NumaIndex, size_t> counts;
 
-        boundThreadToNumaNode.clear();
+    if (boundThreadToNumaNode.empty())
+        counts[0] = requested;  // Pretend all threads are part of numa node 0
+    else
+    {
+        for (size_t i = 0; i < boundThreadToNumaNode.size(); ++i)
+            counts[boundThreadToNumaNode[i]]++;
     }
 
-    const size_t requested = sharedState.options["Threads"];
+    const size_t corrHistMB = size_t(int(sharedState.options["CorrectionHistorySize"]));
+    const size_t pawnHistMB = size_t(int(sharedState.options["PawnHistorySize"]));
 
-    if (requested > 0)  // create new thread(s)
-    {
-        // Binding threads may be problematic when there's multiple NUMA nodes and
-        // multiple Stockfish instances running. In particular, if each instance
-        // runs a single thread then they would all be mapped to the first NUMA node.
-        // This is undesirable, and so the default behaviour (i.e. when the user does not
-        // change the NumaConfig UCI setting) is to not bind the threads to processors
-        // unless we know for sure that we span NUMA nodes and replication is required.
-        const std::string numaPolicy(sharedState.options["NumaPolicy"]);
-        const bool        doBindThreads = [&]() {
-            if (numaPolicy == "none")
-                return false;
-
-            if (numaPolicy == "auto")
-                return numaConfig.suggests_binding_threads(requested);
-
-            // numaPolicy == "system", or explicitly set by the user
-            return true;
-        }();
+    // The nodes that are no longer used have no kept threads
+    for (auto it = sharedState.sharedHistories.begin(); it != sharedState.sharedHistories.end();)
+        it = counts.count(it->first) ? std::next(it) : sharedState.sharedHistories.erase(it);
 
-        std::map<NumaIndex, size_t> counts;
-        boundThreadToNumaNode = doBindThreads
-                                ? numaConfig.distribute_threads_among_numa_nodes(requested)
-                                : std::vector<NumaIndex>{};
+    std::vector<NumaIndex> newNodes;  // Whose shared histories are still to be cleared
 
-        if (boundThreadToNumaNode.empty())
-            counts[0] = requested;  // Pretend all threads are part of numa node 0
+    for (auto pair : counts)
+    {
+        NumaIndex numaIndex = pair.first;
+        uint64_t  count     = pair.second;
+        auto      f         = [&]() {
+            const size_t corrUnits =
+              shared_history_units(corrHistMB, UnifiedCorrectionHistory::UnitBytes, count);
+            const size_t pawnUnits =
+              shared_history_units(pawnHistMB, PawnHistory::UnitBytes, count);
+
+            auto it = sharedState.sharedHistories.find(numaIndex);
+            if (it != sharedState.sharedHistories.end())
+                it->second.resize(corrUnits, pawnUnits);
+            else
+            {
+                sharedState.sharedHistories.try_emplace(numaIndex, corrUnits, pawnUnits);
+                newNodes.push_back(numaIndex);
+            }
+
+            if (nodeCounters.size() <= numaIndex)
+                nodeCounters.resize(numaIndex + 1);
+            if (!nodeCounters[numaIndex])
+                nodeCounters[numaIndex] = std::make_unique<Search::NodeCounter>();
+        };
+        if (doBindThreads)
+            numaConfig.execute_on_numa_node(numaIndex, f);
         else
-        {
-            for (size_t i = 0; i < boundThreadToNumaNode.size(); ++i)
-                counts[boundThreadToNumaNode[i]]++;
-        }
+            f();
+    }
 
-        sharedState.sharedHistories.clear();
-        for (auto pair : counts)
-        {
-            NumaIndex numaIndex = pair.first;
-            uint64_t  count     = pair.second;
-            auto      f         = [&]() {
-                sharedState.sharedHistories.try_emplace(numaIndex, next_power_of_two(count));
-            };
-            if (doBindThreads)
-                numaConfig.execute_on_numa_node(numaIndex, f);
-            else
-                f();
-        }
+    auto threadsPerNode = counts;
+    counts.clear();
+
+    // The kept threads share their node with a different number of threads now
+    for (auto&& th : threads)
+    {
+        const NumaIndex numaId    = doBindThreads ? boundThreadToNumaNode[th->id()] : 0;
+        th->worker->numaThreadIdx = counts[numaId]++;
+        th->worker->numaTotal     = threadsPerNode[numaId];
+    }
 
-        auto threadsPerNode = counts;
-        counts.clear();
+    while (threads.size() < requested)
+    {
+        const size_t    threadId = threads.size();
+        const NumaIndex numaId   = doBindThreads ? boundThreadToNumaNode[threadId] : 0;
+        auto            manager  = threadId == 0 ? std::unique_ptr<Search::ISearchManager>(
+                                         std::make_unique<Search::SearchManager>(updateContext))
+                                                 : std::make_unique<Search::NullSearchManager>();
+
+        // When not binding threads we want to force all access to happen
+        // from the same NUMA node, because in case of NUMA replicated memory
+        // accesses we don't want to trash cache in case the threads get scheduled
+        // on the same NUMA node.
+        auto binder = doBindThreads ? OptionalThreadToNumaNodeBinder(numaConfig, numaId)
+                                    : OptionalThreadToNumaNodeBinder(numaId);
+
+        threads.emplace_back(std::make_unique<Thread>(sharedState, std::move(manager), threadId,
+                                                      counts[numaId]++, threadsPerNode[numaId],
+                                                      binder));
+        threads.back()->worker->nodeCounter = nodeCounters[numaId].get();
+    }
 
-        while (threads.size() < requested)
+    if (!kept)
+        clear();
+    else
+    {
+        // All the threads of a new node are new, each clears its part
+        for (auto&& th : threads)
         {
-            const size_t    threadId = threads.size();
-            const NumaIndex numaId   = doBindThreads ? boundThreadToNumaNode[threadId] : 0;
-            auto            manager  = threadId == 0 ? std::unique_ptr<Search::ISearchManager>(
-                                             std::make_unique<Search::SearchManager>(updateContext))
-                                                     : std::make_unique<Search::NullSearchManager>();
-
-            // When not binding threads we want to force all access to happen
-            // from the same NUMA node, because in case of NUMA replicated memory
-            // accesses we don't want to trash cache in case the threads get scheduled
-            // on the same NUMA node.
-            auto binder = doBindThreads ? OptionalThreadToNumaNodeBinder(numaConfig, numaId)
-                                        : OptionalThreadToNumaNodeBinder(numaId);
-
-            threads.emplace_back(std::make_unique<Thread>(sharedState, std::move(manager), threadId,
-                                                          counts[numaId]++, threadsPerNode[numaId],
-                                                          binder));
+            const NumaIndex numaId = doBindThreads ? boundThreadToNumaNode[th->id()] : 0;
+            if (std::find(newNodes.begin(), newNodes.end(), numaId) != newNodes.end())
+                th->run_custom_job([&th]() { th->worker->clear(); });
         }
 
-        clear();
-
-        main_thread()->wait_for_search_finished();
+        for (auto&& th : threads)
+            th->wait_for_search_finished();
     }
+
+    main_thread()->wait_for_search_finished();
+
+    return kept;
 }
 
 
 // Sets threadPool data to initial values
-void ThreadPool::clear() {
+// Clears the histories of the workers, usually before a new game, and zeroes the
+// given TT along with them. Each thread does its share of both in a single job on
+// its own NUMA node, so that nothing waits on a slower part in between.
+void ThreadPool::clear(TranspositionTable* tt) {
     if (threads.size() == 0)
         return;
 
-    for (auto&& th : threads)
-        th->clear_worker();
+    const bool zeroTT = tt && tt->begin_clear();
+
+    for (size_t i = 0; i < threads.size(); ++i)
+        threads[i]->run_custom_job([this, tt, zeroTT, i]() {
+            threads[i]->worker->clear();
+            if (zeroTT)
+                tt->clear_part(*this, i);
+        });
 
     for (auto&& th : threads)
         th->wait_for_search_finished();
@@ -279,10 +536,20 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
                                 StateListPtr&      states,
                                 Search::LimitsType limits) {
 
+    thinkingStart = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+
+    for (auto&& th : threads)
+        th->spinMicros = int(options["Idle Spin"]);
+
     main_thread()->wait_for_search_finished();
 
     main_manager()->stopOnPonderhit = stop = abortedSearch = false;
     main_manager()->ponder                                 = limits.ponderMode;
+    main_manager()->nextLimitsSet                          = false;
+    multiPVLines.clear();
+    rootSplit.clear();
 
     increaseDepth = true;
 
@@ -301,7 +568,35 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
         for (const auto& m : legalmoves)
             rootMoves.emplace_back(m);
 
-    Tablebases::Config tbConfig = Tablebases::rank_root_moves(options, pos, rootMoves);
+    // The threads are idle until the search starts, so the root moves are probed
+    // on all of them at once
+    auto runOnThreads = [this](const Tablebases::Jobs& jobs) {
+        std::atomic<size_t> next{0};
+
+        for (auto&& th : threads)
+            th->run_custom_job([&]() {
+                for (size_t i; (i = next.fetch_add(1)) < jobs.size();)
+                    jobs[i]();
+            });
+
+        for (auto&& th : threads)
+            th->wait_for_search_finished();
+    };
+
+    // The counts of this thread are its own, so what the root probes add to them is
+    // kept by the pool
+    const Tablebases::CacheCounts countsBefore = Tablebases::cache_counts();
+
+    Tablebases::Config tbConfig = Tablebases::rank_root_moves(
+      options, pos, rootMoves, false, []() { return false; }, runOnThreads);
+
+    const Tablebases::CacheCounts countsAfter = Tablebases::cache_counts();
+    rootTbCacheCounts.probes += countsAfter.probes - countsBefore.probes;
+    rootTbCacheCounts.hits += countsAfter.hits - countsBefore.hits;
+
+    // The book is for the openings a search was asked for from scratch
+    if (book && !tbConfig.rootInTB && limits.searchmoves.empty())
+        book->rank_root_moves(options, pos, rootMoves, limits);
 
     // After ownership transfer 'states' becomes empty, so if we stop the search
     // and call 'go' again without setting a new position states.get() == nullptr.
@@ -320,6 +615,11 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
         th->run_custom_job([&]() {
             th->worker->limits = limits;
             th->worker->nodes = th->worker->tbHits = th->worker->bestMoveChanges = 0;
+            th->worker->flushedNodes = th->worker->flushedTbHits = 0;
+            th->worker->ttProbes = th->worker->ttHits = 0;
+            th->worker->flushedEvals = th->worker->netChoice.smallEvals
+                                     + th->worker->netChoice.bigEvals
+                                     - th->worker->netChoice.doubleEvals;
             th->worker->nmpMinPly                                                = 0;
             th->worker->rootDepth = th->worker->completedDepth = 0;
             th->worker->rootMoves                              = rootMoves;
@@ -332,6 +632,9 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
     for (auto&& th : threads)
         th->wait_for_search_finished();
 
+    for (auto&& counter : nodeCounters)
+        counter->nodes = counter->tbHits = counter->ttProbes = counter->ttHits = counter->evals = 0;
+
     main_thread()->start_searching();
 }
 
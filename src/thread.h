@@ -20,14 +20,17 @@
 #define THREAD_H_INCLUDED
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <utility>
 #include <vector>
 
+#include "book.h"
 #include "memory.h"
 #include "numa.h"
 #include "position.h"
@@ -38,6 +41,7 @@ namespace Stockfish {
 
 
 class OptionsMap;
+class TranspositionTable;
 using Value = int;
 
 // Sometimes we don't want to actually bind the threads, but the recipient still
@@ -83,7 +87,6 @@ class Thread {
 
     void idle_loop();
     void start_searching();
-    void clear_worker();
     void run_custom_job(std::function<void()> f);
 
     void ensure_network_replicated();
@@ -96,6 +99,10 @@ class Thread {
     void   wait_for_search_finished();
     size_t id() const { return idx; }
 
+    // Microseconds to spin, instead of sleeping, when going idle or waiting for
+    // the thread, so that a wake up within the window costs no system call
+    std::atomic<int> spinMicros{0};
+
     LargePagePtr<Search::Worker> worker;
     std::function<void()>        jobFunc;
 
@@ -103,7 +110,8 @@ class Thread {
     std::mutex                mutex;
     std::condition_variable   cv;
     size_t                    idx, idxInNuma, totalNuma, nthreads;
-    bool                      exit = false, searching = true;  // Set before starting std::thread
+    bool                      exit = false;
+    std::atomic<bool>         searching{true};  // Set before starting std::thread
     NativeThread              stdThread;
     NumaReplicatedAccessToken numaAccessToken;
 };
@@ -136,25 +144,56 @@ class ThreadPool {
     void   run_on_thread(size_t threadId, std::function<void()> f);
     void   wait_on_thread(size_t threadId);
     size_t num_threads() const;
-    void   clear();
-    void   set(const NumaConfig& numaConfig,
+    void   clear(TranspositionTable* tt = nullptr);
+    size_t set(const NumaConfig& numaConfig,
                Search::SharedState,
-               const Search::SearchManager::UpdateContext&);
+               const Search::SearchManager::UpdateContext&,
+               size_t requested,
+               size_t firstThread = 0);
 
     Search::SearchManager* main_manager();
     Thread*                main_thread() const { return threads.front().get(); }
     uint64_t               nodes_searched() const;
     uint64_t               tb_hits() const;
+    std::vector<Search::NodeCounts> node_counts() const;  // By NUMA node
+    std::pair<uint64_t, uint64_t> eval_cache_stats() const;
+    std::pair<uint64_t, uint64_t> tb_cache_stats() const;
+    Eval::NetChoice               net_choice_stats() const;
+#ifdef SEARCH_COUNTERS
+    Search::Counters search_counters() const;
+    void             clear_search_counters();
+#endif
+    void                          record_start_latency();
+    void                          record_stop_latency(std::chrono::steady_clock::time_point t);
     Thread*                get_best_thread() const;
     void                   start_searching();
     void                   wait_for_search_finished() const;
 
-    std::vector<size_t> get_bound_thread_count_by_numa_node() const;
+    std::vector<size_t>           get_bound_thread_count_by_numa_node() const;
+    const std::vector<NumaIndex>& get_bound_thread_to_numa_node() const {
+        return boundThreadToNumaNode;
+    }
 
     void ensure_network_replicated();
 
     std::atomic_bool stop, abortedSearch, increaseDepth;
 
+    Search::MultiPVLines multiPVLines;
+    Search::RootSplit    rootSplit;
+
+    // Nanoseconds from start_thinking() to the first node of each thread, and
+    // from raising stop to all threads having finished, summed over searches
+    std::atomic<uint64_t> startLatency{0}, starts{0}, stopLatency{0}, stops{0};
+
+    // Nodes searched for this pool elsewhere, by the workers of a distributed search
+    std::atomic<uint64_t> externalNodes{0};
+
+    // Whether the searches start a new TT generation, not for a pool on the TT of another
+    bool ownsTT = true;
+
+    // Probed at the root when set, the book of the engine
+    const Book::Mapping* book = nullptr;
+
     auto cbegin() const noexcept { return threads.cbegin(); }
     auto begin() noexcept { return threads.begin(); }
     auto end() noexcept { return threads.end(); }
@@ -164,16 +203,17 @@ class ThreadPool {
 
    private:
     StateListPtr                         setupStates;
+    std::atomic<int64_t>                 thinkingStart{0};  // Steady clock ns, read by workers
+    Tablebases::CacheCounts              rootTbCacheCounts;  // Of the root probes by callers
     std::vector<std::unique_ptr<Thread>> threads;
     std::vector<NumaIndex>               boundThreadToNumaNode;
 
-    uint64_t accumulate(std::atomic<uint64_t> Search::Worker::* member) const {
+    // What the threads were made for, to tell which of them set() can keep
+    std::string                                 numaConfigString;
+    const Search::SearchManager::UpdateContext* context = nullptr;
 
-        uint64_t sum = 0;
-        for (auto&& th : threads)
-            sum += (th->worker.get()->*member).load(std::memory_order_relaxed);
-        return sum;
-    }
+    // One per NUMA node, see Search::NodeCounter
+    std::vector<std::unique_ptr<Search::NodeCounter>> nodeCounters;
 };
 
 }  // namespace Stockfish
@@ -33,6 +33,46 @@ TimePoint TimeManagement::maximum() const { return maximumTime; }
 
 void TimeManagement::clear() {
     availableNodes = -1;  // When in 'nodes as time' mode
+    lastClock[0] = lastClock[1] = -1;
+    worstLag[0]  = worstLag[1] = -1;
+}
+
+void TimeManagement::record_move() {
+    lastClock[side] = clockAtGo;
+    lastThink[side] = elapsed_time();
+}
+
+// What the GUI charged for our last move, beyond the time from reading 'go' to
+// writing 'bestmove', was lost to our output, the transport and the GUI itself.
+// Twice the worst such lag, slowly forgotten, is the overhead of the next moves,
+// within bounds. Each color has its own, as the same engine may play both sides
+// over links of their own. Until one is measured, the overhead is that of the
+// option.
+TimePoint
+TimeManagement::calibrate(const Search::LimitsType& limits, Color us, TimePoint fallback) {
+    constexpr TimePoint MinOverhead = 5, MaxOverhead = 5000;
+
+    const TimePoint clock    = limits.time[us];
+    const TimePoint previous = overhead;
+
+    // A clock that went up by more than the increment, as at a new time control,
+    // tells nothing about the last move
+    if (lastClock[us] >= 0 && clock <= lastClock[us] + limits.inc[us])
+    {
+        const TimePoint lag = lastClock[us] + limits.inc[us] - clock - lastThink[us];
+        worstLag[us] = std::max(double(std::max(lag, TimePoint(0))), worstLag[us] * 0.9);
+    }
+
+    // The GUI charges a ponder search from the ponderhit, not from 'go'
+    side          = us;
+    clockAtGo     = limits.ponderMode ? -1 : clock;
+    lastClock[us] = -1;
+
+    overhead        = worstLag[us] < 0 ? fallback
+                                       : std::clamp(TimePoint(2 * worstLag[us]) + MinOverhead,
+                                                    MinOverhead, MaxOverhead);
+    overheadChanged = overhead != previous && worstLag[us] >= 0;
+    return overhead;
 }
 
 void TimeManagement::advance_nodes_time(std::int64_t nodes) {
@@ -53,14 +93,20 @@ void TimeManagement::init(Search::LimitsType& limits,
 
     // If we have no time, we don't need to fully initialize TM.
     // startTime is used by movetime and useNodesTime is used in elapsed calls.
-    startTime    = limits.startTime;
-    useNodesTime = npmsec != 0;
+    startTime       = limits.startTime;
+    useNodesTime    = npmsec != 0;
+    side            = us;
+    clockAtGo       = -1;
+    overheadChanged = false;
 
     if (limits.time[us] == 0)
         return;
 
     TimePoint moveOverhead = TimePoint(options["Move Overhead"]);
 
+    if (options["Auto Move Overhead"] && !useNodesTime)
+        moveOverhead = calibrate(limits, us, moveOverhead);
+
     // optScale is a percentage of available time to use for the current move.
     // maxScale is a multiplier applied to optimumTime.
     double optScale, maxScale;
@@ -53,13 +53,31 @@ class TimeManagement {
     void clear();
     void advance_nodes_time(std::int64_t nodes);
 
+    // With "Auto Move Overhead", for the calibration of the next move from the
+    // clock the GUI will then send
+    void record_move();
+
+    // The overhead of the search in ms, and whether calibration has changed it
+    TimePoint move_overhead() const { return overhead; }
+    bool      overhead_changed() const { return overheadChanged; }
+
    private:
+    TimePoint calibrate(const Search::LimitsType& limits, Color us, TimePoint fallback);
+
     TimePoint startTime;
     TimePoint optimumTime;
     TimePoint maximumTime;
 
     std::int64_t availableNodes = -1;     // When in 'nodes as time' mode
     bool         useNodesTime   = false;  // True if we are in 'nodes as time' mode
+
+    TimePoint overhead        = 0;
+    bool      overheadChanged = false;
+    int       side            = 0;
+    TimePoint clockAtGo       = -1;        // Our time left at 'go', -1 when not measured
+    TimePoint lastClock[2]    = {-1, -1};  // The same for the last move of each color
+    TimePoint lastThink[2]    = {};        // From 'go' to 'bestmove' for that move
+    double    worstLag[2]     = {-1, -1};  // Slowly forgotten, -1 until measured
 };
 
 }  // namespace Stockfish
@@ -18,14 +18,37 @@
 
 #include "tt.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#if defined(TT_STATS) && defined(_MSC_VER) && defined(_M_X64)
+    #include <intrin.h>
+#elif defined(TT_STATS) && defined(__x86_64__)
+    #include <x86intrin.h>
+#endif
 
 #include "memory.h"
 #include "misc.h"
+#include "shm.h"
 #include "syzygy/tbprobe.h"
 #include "thread.h"
 
@@ -88,6 +111,55 @@ static constexpr int GENERATION_MASK = (0xFF << GENERATION_BITS) & 0xFF;
 // we sacrifice the ability to store depths greater than 1<<8 less the offset, as asserted in `save`.)
 bool TTEntry::is_occupied() const { return bool(depth8); }
 
+
+// Optional statistics of the probe and write paths, compiled in with -DTT_STATS.
+// Without it CollectStats is false and all the counting is discarded at compile time.
+#ifdef TT_STATS
+static constexpr bool CollectStats = true;
+#else
+static constexpr bool CollectStats = false;
+#endif
+
+// Depths are bucketed as qsearch (depth <= 0), then 1-4, 5-8, ..., with a last bucket of 33 and up
+static constexpr int StatsBuckets = 10;
+
+static constexpr int stats_bucket(int depth) {
+    return depth <= 0 ? 0 : std::min((depth - 1) / 4 + 1, StatsBuckets - 1);
+}
+
+// Timestamp used to measure the latency of the first load of a probed cluster. On x86
+// these are TSC ticks, read with rdtscp so that the load has completed; elsewhere ns.
+static inline uint64_t stats_timestamp() {
+#if defined(TT_STATS) && (defined(__x86_64__) || defined(_M_X64))
+    unsigned int aux;
+    return __rdtscp(&aux);
+#else
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count());
+#endif
+}
+
+// Counters are shared by all threads and updated with relaxed atomics, which costs
+// some NPS when compiled in. That is acceptable for a diagnostic build.
+struct TTStats {
+    void clear() {
+        probes        = 0;
+        keyMismatches = 0;
+        probeTicks    = 0;
+        for (int i = 0; i < StatsBuckets; ++i)
+            hits[i] = deeperReplaced[i] = ageEvicted[i] = 0;
+    }
+
+    std::atomic<uint64_t> probes, keyMismatches;  // Mismatches are misses in a full cluster
+    std::atomic<uint64_t> probeTicks;             // Summed latency of the first cluster load
+    std::atomic<uint64_t> hits[StatsBuckets];
+    std::atomic<uint64_t> deeperReplaced[StatsBuckets];
+    std::atomic<uint64_t> ageEvicted[StatsBuckets];
+};
+
+static TTStats ttStats;
+
 // Populates the TTEntry with a new node's data, possibly
 // overwriting an old position. The update is not atomic and can be racy.
 void TTEntry::save(
@@ -101,6 +173,17 @@ void TTEntry::save(
     if (b == BOUND_EXACT || uint16_t(k) != key16 || d - DEPTH_ENTRY_OFFSET + 2 * pv > depth8 - 4
         || relative_age(generation8))
     {
+        if constexpr (CollectStats)
+            if (uint16_t(k) != key16 && is_occupied())
+            {
+                const int bucket = stats_bucket(depth8 + DEPTH_ENTRY_OFFSET);
+
+                if (relative_age(generation8))
+                    ttStats.ageEvicted[bucket].fetch_add(1, std::memory_order_relaxed);
+                else if (depth8 + DEPTH_ENTRY_OFFSET > d)
+                    ttStats.deeperReplaced[bucket].fetch_add(1, std::memory_order_relaxed);
+            }
+
         assert(d > DEPTH_ENTRY_OFFSET);
         assert(d < 256 + DEPTH_ENTRY_OFFSET);
 
@@ -123,40 +206,261 @@ uint8_t TTEntry::relative_age(const uint8_t generation8) const {
 }
 
 
+// Ring of the recent deep writes, see TranspositionTable::set_export_depth(). The
+// writers only claim a slot with an atomic increment, so a slot being refilled
+// while it is drained gives a torn copy, which the check word detects.
+class TTExportQueue {
+   public:
+    static constexpr size_t Capacity = 1 << 14;
+
+    explicit TTExportQueue(Depth d) :
+        minDepth(d) {}
+
+    void push(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev) {
+        const uint64_t data = uint64_t(m.raw()) | uint64_t(uint16_t(v)) << 16
+                            | uint64_t(uint16_t(ev)) << 32 | uint64_t(uint8_t(d)) << 48
+                            | uint64_t(b) << 56 | uint64_t(pv) << 58;
+        Slot& s = slots[head.fetch_add(1, std::memory_order_relaxed) % Capacity];
+        s.key.store(k, std::memory_order_relaxed);
+        s.data.store(data, std::memory_order_relaxed);
+        s.check.store(k ^ data, std::memory_order_release);
+    }
+
+    size_t drain(std::vector<TTExchangeEntry>& out) {
+        const uint64_t end   = head.load(std::memory_order_acquire);
+        const size_t   first = out.size();
+
+        tail = std::max(tail, end > Capacity ? end - Capacity : 0);
+        for (; tail < end; ++tail)
+        {
+            const Slot&     s = slots[tail % Capacity];
+            TTExchangeEntry e{s.key.load(std::memory_order_relaxed),
+                              s.data.load(std::memory_order_relaxed),
+                              s.check.load(std::memory_order_acquire)};
+            if ((e.key ^ e.data) == e.check)
+                out.push_back(e);
+        }
+        return out.size() - first;
+    }
+
+    const Depth minDepth;
+
+   private:
+    struct Slot {
+        std::atomic<uint64_t> key{0}, data{0}, check{1};
+    };
+
+    std::atomic<uint64_t> head{0};
+    uint64_t              tail = 0;
+    Slot                  slots[Capacity];
+};
+
 // TTWriter is but a very thin wrapper around the pointer
-TTWriter::TTWriter(TTEntry* tte) :
-    entry(tte) {}
+TTWriter::TTWriter(TTEntry* tte, TTExportQueue* eq) :
+    entry(tte),
+    exports(eq) {}
 
 void TTWriter::write(
   Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, uint8_t generation8) {
     entry->save(k, v, pv, b, d, m, ev, generation8);
+
+    if (exports && d >= exports->minDepth)
+        exports->push(k, v, pv, b, d, m, ev);
 }
 
 
 // A TranspositionTable is an array of Cluster, of size clusterCount. Each cluster consists of ClusterSize number
 // of TTEntry. Each non-empty TTEntry contains information on exactly one position. The size of a Cluster should
 // divide the size of a cache line for best performance, as the cacheline is prefetched when possible.
+//
+// The number of entries can be chosen at compile time with -DTT_CLUSTER_SIZE=<n>. A cluster is
+// padded to the next power of two bytes, so 3 entries make the default 32 byte cluster, and 6
+// entries fill a whole 64 byte cache line. Larger clusters cost a few more key compares per probe
+// but collide less often.
+
+#ifndef TT_CLUSTER_SIZE
+    #define TT_CLUSTER_SIZE 3
+#endif
 
-static constexpr int ClusterSize = 3;
+static constexpr int ClusterSize = TT_CLUSTER_SIZE;
+
+static_assert(ClusterSize >= 1 && ClusterSize * sizeof(TTEntry) < 64,
+              "A cluster must fit in a 64 byte cache line");
+
+static constexpr size_t cluster_bytes(size_t bytes) {
+    size_t pow2 = 16;
+    while (pow2 <= bytes)
+        pow2 *= 2;
+    return pow2;
+}
 
 struct Cluster {
     TTEntry entry[ClusterSize];
-    char    padding[2];  // Pad to 32 bytes
+    char    padding[cluster_bytes(ClusterSize * sizeof(TTEntry)) - ClusterSize * sizeof(TTEntry)];
+};
+
+static_assert((sizeof(Cluster) & (sizeof(Cluster) - 1)) == 0, "Suboptimal Cluster size");
+
+
+// Header of a transposition table dump. The clusters follow immediately after it,
+// so the header size is kept a multiple of their alignment. Dumps are only meant
+// to be reloaded by a binary with the same TT layout, which is checked on load.
+struct TTFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t clusterBytes;
+    uint64_t clusterCount;
+    uint8_t  generation8;
+    uint8_t  clusterEntries;
+    char     padding[6];
 };
 
-static_assert(sizeof(Cluster) == 32, "Suboptimal Cluster size");
+static constexpr char     TTFileMagic[8] = {'S', 'F', 'T', 'T', 'D', 'U', 'M', 'P'};
+static constexpr uint32_t TTFileVersion  = 1;
+
+static_assert(sizeof(TTFileHeader) % alignof(Cluster) == 0, "Misaligned TT file header");
+
+
+// Returns the start and length of the contiguous chunk of clusters owned by
+// thread idx when the table is split evenly among threadCount threads.
+static std::pair<size_t, size_t>
+cluster_chunk(size_t clusterCount, size_t threadCount, size_t idx) {
+    const size_t stride = clusterCount / threadCount;
+    const size_t start  = stride * idx;
+    const size_t len    = idx + 1 != threadCount ? stride : clusterCount - start;
+
+    return {start, len};
+}
+
+
+// Splits the clusters [0, clusterCount) into one contiguous chunk per thread
+// and runs f(start, len) for each chunk on its thread.
+static void for_each_cluster_chunk(ThreadPool&                               threads,
+                                   size_t                                    clusterCount,
+                                   const std::function<void(size_t, size_t)>& f) {
+    const size_t threadCount = threads.num_threads();
+
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        threads.run_on_thread(i, [&f, i, threadCount, clusterCount]() {
+            const auto [start, len] = cluster_chunk(clusterCount, threadCount, i);
+            f(start, len);
+        });
+    }
+
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.wait_on_thread(i);
+}
+
+
+// Granularity of NUMA interleaving, one huge page of the table
+static constexpr size_t NumaPageClusters = 2 * 1024 * 1024 / sizeof(Cluster);
+
+// When interleaving, page p of the table is first touched by the node in
+// slot p % N, where N is the number of nodes that have threads, and the threads
+// of a node take turns over its pages. Returns the first page and the page
+// stride of thread idx.
+static std::pair<size_t, size_t> interleaved_pages(const std::vector<NumaIndex>& nodeOfThread,
+                                                   size_t                        idx) {
+    std::vector<NumaIndex> nodes(nodeOfThread);
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+
+    const size_t slot = std::lower_bound(nodes.begin(), nodes.end(), nodeOfThread[idx])
+                      - nodes.begin();
+
+    size_t rank = 0, count = 0;
+    for (size_t i = 0; i < nodeOfThread.size(); ++i)
+        if (nodeOfThread[i] == nodeOfThread[idx])
+        {
+            rank += i < idx;
+            ++count;
+        }
+
+    return {slot + nodes.size() * rank, nodes.size() * count};
+}
+
+
+// Name of the segment backing a shared table. The size is part of the name,
+// so that only processes using the same Hash value end up sharing a table.
+static std::string shared_table_name(const std::string& shmName, size_t mbSize) {
+#if defined(_WIN32)
+    std::string prefix = "Local\\sf_tt_";
+#else
+    std::string prefix = "/sf_tt_";
+#endif
+
+    return prefix + shmName + "$" + std::to_string(mbSize);
+}
+
+
+TranspositionTable::TranspositionTable() = default;
+TranspositionTable::~TranspositionTable() { free_table(); }
+
+
+void TranspositionTable::free_table() {
+    if (sharedTable)
+        sharedTable.reset();  // Unmaps the segment, other processes keep their view
+    else
+        aligned_large_pages_free(table);
+
+    table = nullptr;
+    sharedName.clear();
+}
 
 
 // Sets the size of the transposition table,
 // measured in megabytes. Transposition table consists
 // of clusters and each cluster consists of ClusterSize number of TTEntry.
-void TranspositionTable::resize(size_t mbSize, ThreadPool& threads) {
-    aligned_large_pages_free(table);
+// With a non-empty shmName the table lives in a named shared memory segment,
+// which is attached to by every process using the same name and size. If the
+// segment can't be mapped we fall back to a table local to this process.
+// When a local table is resized into another local table its entries are
+// rehashed into the new one, as far as memory allows to hold both at once.
+void TranspositionTable::resize(size_t mbSize, ThreadPool& threads, const std::string& shmName) {
+    const size_t newClusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
 
-    clusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
+    // Stay attached to an unchanged segment, as detaching might drop the last
+    // reference to it and with it everything searched so far.
+    if (sharedTable && !shmName.empty() && shmName == sharedName
+        && newClusterCount == clusterCount)
+        return;
+
+    Cluster*      oldTable        = sharedTable ? nullptr : std::exchange(table, nullptr);
+    const size_t  oldClusterCount = clusterCount;
+    const uint8_t oldGeneration   = generation8;
+
+    free_table();
+
+    clusterCount = newClusterCount;
+
+    if (!shmName.empty())
+    {
+        // A new segment is zero filled, an existing one is used as is
+        sharedTable = std::make_unique<SharedMemoryBackend<Cluster>>(
+          shared_table_name(shmName, mbSize), Cluster{}, clusterCount);
+
+        if (sharedTable->is_valid())
+        {
+            table       = static_cast<Cluster*>(sharedTable->get());
+            sharedName  = shmName;
+            generation8 = 0;
+            aligned_large_pages_free(oldTable);
+            return;
+        }
+
+        sharedTable.reset();
+    }
 
     table = static_cast<Cluster*>(aligned_large_pages_alloc(clusterCount * sizeof(Cluster)));
 
+    // Not enough memory for both tables, give up on the old entries
+    if (!table && oldTable)
+    {
+        aligned_large_pages_free(std::exchange(oldTable, nullptr));
+        table = static_cast<Cluster*>(aligned_large_pages_alloc(clusterCount * sizeof(Cluster)));
+    }
+
     if (!table)
     {
         std::cerr << "Failed to allocate " << mbSize << "MB for transposition table." << std::endl;
@@ -164,29 +468,314 @@ void TranspositionTable::resize(size_t mbSize, ThreadPool& threads) {
     }
 
     clear(threads);
+
+    if (oldTable)
+    {
+        generation8 = oldGeneration;
+        rehash(oldTable, oldClusterCount, threads);
+        aligned_large_pages_free(oldTable);
+    }
+}
+
+
+// Returns whether a * b < c * d, comparing the full 128-bit products
+static bool product_less(uint64_t a, uint64_t b, uint64_t c, uint64_t d) {
+    const uint64_t hi1 = mul_hi64(a, b), hi2 = mul_hi64(c, d);
+    return hi1 < hi2 || (hi1 == hi2 && a * b < c * d);
 }
 
 
+// Moves the entries of a table of oldClusterCount clusters into the current,
+// freshly cleared one. A key lands in cluster mul_hi64(key, count), so cluster
+// i of the old table holds keys of the fraction [i / oldCount, (i + 1) / oldCount)
+// of the key space, and every new cluster takes its entries from the old clusters
+// overlapping its own fraction. As only 16 bits of the key are stored, an entry
+// may be copied to several new clusters when growing; the copies that don't
+// match their real cluster are harmless and will be replaced over time. When
+// more entries compete for a cluster than it has room for, we keep those that
+// the replacement strategy in probe() values most, so recent and deep entries
+// survive. Each thread fills its own chunk of new clusters, so no races arise.
+void TranspositionTable::rehash(const Cluster* oldTable,
+                                size_t         oldClusterCount,
+                                ThreadPool&    threads) {
+
+    const size_t newClusterCount = clusterCount;
+
+    auto worth = [this](const TTEntry& tte) { return tte.depth8 - tte.relative_age(generation8); };
+
+    for_each_cluster_chunk(threads, newClusterCount, [&](size_t start, size_t len) {
+        // First old cluster overlapping new cluster `start`, found from an
+        // estimate that is then corrected with exact arithmetic.
+        size_t i = std::min(size_t(double(start) * oldClusterCount / newClusterCount),
+                            oldClusterCount - 1);
+        while (i > 0 && product_less(start, oldClusterCount, i, newClusterCount))
+            --i;
+
+        for (size_t j = start; j < start + len; ++j)
+        {
+            while (!product_less(j, oldClusterCount, i + 1, newClusterCount))
+                ++i;
+
+            TTEntry* const tte = table[j].entry;
+
+            // Old clusters k overlap new cluster j while k / oldCount < (j + 1) / newCount
+            for (size_t k = i; k < oldClusterCount
+                               && product_less(k, newClusterCount, j + 1, oldClusterCount);
+                 ++k)
+                for (const TTEntry& old : oldTable[k].entry)
+                {
+                    if (!old.is_occupied())
+                        continue;
+
+                    // Prefer a slot with the same key, then an empty one, then the least valuable
+                    TTEntry* replace = tte;
+                    for (int e = 0; e < ClusterSize; ++e)
+                    {
+                        if (tte[e].key16 == old.key16 && tte[e].is_occupied())
+                        {
+                            replace = &tte[e];
+                            break;
+                        }
+                        if (!tte[e].is_occupied())
+                        {
+                            if (replace->is_occupied())
+                                replace = &tte[e];
+                        }
+                        else if (replace->is_occupied() && worth(*replace) > worth(tte[e]))
+                            replace = &tte[e];
+                    }
+
+                    if (!replace->is_occupied() || worth(*replace) < worth(old))
+                        *replace = old;
+                }
+        }
+    });
+}
+
+
+bool TranspositionTable::is_shared() const { return sharedTable != nullptr; }
+
+size_t TranspositionTable::size_bytes() const { return clusterCount * sizeof(Cluster); }
+
+
 // Initializes the entire transposition table to zero,
-// in a multi-threaded way.
+// in a multi-threaded way. A shared table is left untouched,
+// since other processes may still be searching with it.
 void TranspositionTable::clear(ThreadPool& threads) {
-    generation8              = 0;
-    const size_t threadCount = threads.num_threads();
+    if (!begin_clear())
+        return;
 
-    for (size_t i = 0; i < threadCount; ++i)
+    for (size_t i = 0; i < threads.num_threads(); ++i)
+        threads.run_on_thread(i, [this, &threads, i]() { clear_part(threads, i); });
+
+    for (size_t i = 0; i < threads.num_threads(); ++i)
+        threads.wait_on_thread(i);
+}
+
+// A table in shared memory is zero filled when created and is never cleared
+// afterwards, as other processes may be searching with it.
+bool TranspositionTable::begin_clear() {
+    generation8 = 0;
+
+    if constexpr (CollectStats)
+        ttStats.clear();
+
+    return !sharedTable;
+}
+
+// Each thread zeroes its part of the hash table. Pages are placed on the NUMA
+// node of the thread touching them first, so on a freshly allocated table this
+// also decides where the table lives.
+void TranspositionTable::clear_part(const ThreadPool& threads, size_t idx) {
+    const std::vector<NumaIndex>& nodeOfThread = threads.get_bound_thread_to_numa_node();
+
+    if (!numaInterleave || nodeOfThread.empty())
     {
-        threads.run_on_thread(i, [this, i, threadCount]() {
-            // Each thread will zero its part of the hash table
-            const size_t stride = clusterCount / threadCount;
-            const size_t start  = stride * i;
-            const size_t len    = i + 1 != threadCount ? stride : clusterCount - start;
+        const auto [start, len] = cluster_chunk(clusterCount, threads.num_threads(), idx);
+        std::memset(&table[start], 0, len * sizeof(Cluster));
+        return;
+    }
 
-            std::memset(&table[start], 0, len * sizeof(Cluster));
-        });
+    const auto [first, step] = interleaved_pages(nodeOfThread, idx);
+
+    for (size_t page = first; page * NumaPageClusters < clusterCount; page += step)
+    {
+        const size_t start = page * NumaPageClusters;
+        const size_t len   = std::min(NumaPageClusters, clusterCount - start);
+        std::memset(&table[start], 0, len * sizeof(Cluster));
     }
+}
 
-    for (size_t i = 0; i < threadCount; ++i)
-        threads.wait_on_thread(i);
+
+// Returns how many bytes of the table were placed on each NUMA node by clear(),
+// indexed by node. Empty if the threads are not bound to NUMA nodes, since the
+// placement is then up to the OS, or if the table is shared.
+std::vector<size_t> TranspositionTable::numa_placement(const ThreadPool& threads) const {
+    const std::vector<NumaIndex>& nodeOfThread = threads.get_bound_thread_to_numa_node();
+    std::vector<size_t>           bytes;
+
+    if (sharedTable || nodeOfThread.empty())
+        return bytes;
+
+    bytes.resize(*std::max_element(nodeOfThread.begin(), nodeOfThread.end()) + 1, 0);
+
+    for (size_t i = 0; i < nodeOfThread.size(); ++i)
+    {
+        if (!numaInterleave)
+        {
+            bytes[nodeOfThread[i]] +=
+              cluster_chunk(clusterCount, nodeOfThread.size(), i).second * sizeof(Cluster);
+            continue;
+        }
+
+        const auto [first, step] = interleaved_pages(nodeOfThread, i);
+
+        for (size_t page = first; page * NumaPageClusters < clusterCount; page += step)
+            bytes[nodeOfThread[i]] +=
+              std::min(NumaPageClusters, clusterCount - page * NumaPageClusters) * sizeof(Cluster);
+    }
+
+    return bytes;
+}
+
+
+// Writes the whole table, preceded by a header recording its size and
+// current generation, to the given file. Returns false on failure.
+bool TranspositionTable::save(const std::string& filename) const {
+    TTFileHeader header{};
+    std::memcpy(header.magic, TTFileMagic, sizeof(TTFileMagic));
+    header.version        = TTFileVersion;
+    header.clusterBytes   = sizeof(Cluster);
+    header.clusterCount   = clusterCount;
+    header.generation8    = generation8;
+    header.clusterEntries = ClusterSize;
+
+    std::ofstream stream(filename, std::ios::binary);
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(reinterpret_cast<const char*>(table), clusterCount * sizeof(Cluster));
+
+    return bool(stream);
+}
+
+
+// Restores a table written by save(). The file is memory mapped where possible
+// and copied into the table by all threads. The dump must have been made with the
+// current Hash size, otherwise the table is left untouched and false is returned.
+bool TranspositionTable::load(const std::string& filename, ThreadPool& threads) {
+
+    TTFileHeader header;
+    auto         valid_header = [&](uint64_t fileSize) {
+        return fileSize >= sizeof(header) && !std::memcmp(header.magic, TTFileMagic, 8)
+            && header.version == TTFileVersion && header.clusterBytes == sizeof(Cluster)
+            && header.clusterEntries == ClusterSize && header.clusterCount == clusterCount
+            && fileSize == sizeof(header) + clusterCount * sizeof(Cluster);
+    };
+
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) == -1)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    const uint64_t fileSize = uint64_t(statbuf.st_size);
+
+    if (fileSize < sizeof(header) || ::read(fd, &header, sizeof(header)) != sizeof(header)
+        || !valid_header(fileSize))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    #if defined(MADV_SEQUENTIAL)
+    madvise(data, fileSize, MADV_SEQUENTIAL);
+    #endif
+
+    const Cluster* clusters =
+      reinterpret_cast<const Cluster*>(static_cast<const char*>(data) + sizeof(header));
+
+    for_each_cluster_chunk(threads, clusterCount, [this, clusters](size_t start, size_t len) {
+        std::memcpy(&table[start], &clusters[start], len * sizeof(Cluster));
+    });
+
+    munmap(data, fileSize);
+#else
+    std::ifstream stream(filename, std::ios::binary | std::ios::ate);
+    if (!stream)
+        return false;
+
+    const uint64_t fileSize = uint64_t(stream.tellg());
+    stream.seekg(0);
+    stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    if (!stream || !valid_header(fileSize))
+        return false;
+
+    stream.read(reinterpret_cast<char*>(table), clusterCount * sizeof(Cluster));
+    if (!stream)
+    {
+        clear(threads);
+        return false;
+    }
+#endif
+
+    generation8 = header.generation8;
+    return true;
+}
+
+
+// Reports the statistics gathered since the last clear, if compiled with TT_STATS
+std::string TranspositionTable::stats() const {
+    if constexpr (!CollectStats)
+        return "TT statistics are not compiled in, build with EXTRACXXFLAGS=-DTT_STATS";
+
+    auto percent = [](uint64_t part, uint64_t total) {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1) << (total ? 100.0 * part / total : 0.0) << "%";
+        return ss.str();
+    };
+
+    const uint64_t probes = ttStats.probes;
+    uint64_t       hits   = 0;
+    for (const auto& h : ttStats.hits)
+        hits += h;
+
+    std::stringstream ss;
+    ss << "TT statistics since the last clear\n"
+       << "Probes: " << probes << ", hits: " << hits << " (" << percent(hits, probes) << ")"
+       << ", misses: " << probes - hits << ", of which in a full cluster: " << ttStats.keyMismatches
+       << " (" << percent(ttStats.keyMismatches, probes - hits) << ")\n"
+       << "Average latency of the cluster load: " << (probes ? ttStats.probeTicks / probes : 0)
+#if defined(__x86_64__) || defined(_M_X64)
+       << " TSC ticks\n"
+#else
+       << " ns\n"
+#endif
+       << "\n Depth        Hits  Deeper replaced  Age evicted";
+
+    for (int i = 0; i < StatsBuckets; ++i)
+    {
+        const std::string depths = i == 0                ? "<=0"
+                                 : i == StatsBuckets - 1 ? std::to_string(4 * i - 3) + "+"
+                                                         : std::to_string(4 * i - 3) + "-"
+                                                             + std::to_string(4 * i);
+
+        ss << "\n" << std::setw(6) << depths << std::setw(12) << ttStats.hits[i] << std::setw(17)
+           << ttStats.deeperReplaced[i] << std::setw(13) << ttStats.ageEvicted[i];
+    }
+
+    return ss.str();
 }
 
 
@@ -225,11 +814,32 @@ std::tuple<bool, TTData, TTWriter> TranspositionTable::probe(const Key key) cons
     TTEntry* const tte   = first_entry(key);
     const uint16_t key16 = uint16_t(key);  // Use the low 16 bits as key inside the cluster
 
+    if constexpr (CollectStats)
+    {
+        // A cluster prefetched early enough is already in cache here, so the
+        // average shows how much of the memory latency the prefetches hide.
+        const uint64_t start = stats_timestamp();
+        static_cast<void>(*static_cast<const volatile uint16_t*>(&tte->key16));
+        ttStats.probeTicks.fetch_add(stats_timestamp() - start, std::memory_order_relaxed);
+        ttStats.probes.fetch_add(1, std::memory_order_relaxed);
+    }
+
     for (int i = 0; i < ClusterSize; ++i)
         if (tte[i].key16 == key16)
+        {
+            if constexpr (CollectStats)
+                if (tte[i].is_occupied())
+                    ttStats.hits[stats_bucket(tte[i].depth8 + DEPTH_ENTRY_OFFSET)].fetch_add(
+                      1, std::memory_order_relaxed);
+
             // This gap is the main place for read races.
             // After `read()` completes that copy is final, but may be self-inconsistent.
-            return {tte[i].is_occupied(), tte[i].read(), TTWriter(&tte[i])};
+            return {tte[i].is_occupied(), tte[i].read(), TTWriter(&tte[i], exports.get())};
+        }
+
+    if constexpr (CollectStats)
+        if (std::all_of(tte, tte + ClusterSize, [](const TTEntry& e) { return e.is_occupied(); }))
+            ttStats.keyMismatches.fetch_add(1, std::memory_order_relaxed);
 
     // Find an entry to be replaced according to the replacement strategy
     TTEntry* replace = tte;
@@ -240,7 +850,7 @@ std::tuple<bool, TTData, TTWriter> TranspositionTable::probe(const Key key) cons
 
     return {false,
             TTData{Move::none(), VALUE_NONE, VALUE_NONE, DEPTH_ENTRY_OFFSET, BOUND_NONE, false},
-            TTWriter(replace)};
+            TTWriter(replace, exports.get())};
 }
 
 
@@ -248,4 +858,50 @@ TTEntry* TranspositionTable::first_entry(const Key key) const {
     return &table[mul_hi64(key, clusterCount)].entry[0];
 }
 
+
+void TranspositionTable::set_export_depth(Depth d) {
+    exports = d > 0 ? std::make_unique<TTExportQueue>(d) : nullptr;
+}
+
+size_t TranspositionTable::drain_exports(std::vector<TTExchangeEntry>& out) {
+    return exports ? exports->drain(out) : 0;
+}
+
+// Stores entries received from another engine, unless this table already has a
+// deeper result for the position. They are not queued for export again.
+void TranspositionTable::import_entries(const std::vector<TTExchangeEntry>& entries) {
+    for (const TTExchangeEntry& e : entries)
+    {
+        if ((e.key ^ e.data) != e.check)
+            continue;
+
+        const Move  m(uint16_t(e.data));
+        const Value v  = int16_t(e.data >> 16);
+        const Value ev = int16_t(e.data >> 32);
+        const Depth d  = uint8_t(e.data >> 48);
+        const Bound b  = Bound((e.data >> 56) & 0x3);
+        const bool  pv = (e.data >> 58) & 1;
+
+        if (d <= 0 || d >= 256 + DEPTH_ENTRY_OFFSET)
+            continue;
+
+        // A peer may send anything. The search checks that the move is legal
+        // before playing it, what is stored here only has to be well formed.
+        if (b == BOUND_NONE || std::abs(v) >= VALUE_INFINITE
+            || (ev != VALUE_NONE && std::abs(ev) >= VALUE_INFINITE))
+            continue;
+
+        if (m != Move::none()
+            && (m == Move::null() || m.from_sq() == m.to_sq()
+                || (m.type_of() != PROMOTION && (m.raw() >> 12) & 3)
+                || (m.type_of() == PROMOTION && rank_of(m.to_sq()) != RANK_1
+                    && rank_of(m.to_sq()) != RANK_8)))
+            continue;
+
+        auto [found, ttData, writer] = probe(e.key);
+        if (!found || ttData.depth < d)
+            writer.entry->save(e.key, v, pv, b, d, m, ev, generation8);
+    }
+}
+
 }  // namespace Stockfish
@@ -21,7 +21,10 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <string>
 #include <tuple>
+#include <vector>
 
 #include "memory.h"
 #include "types.h"
@@ -31,6 +34,9 @@ namespace Stockfish {
 class ThreadPool;
 struct TTEntry;
 struct Cluster;
+class TTExportQueue;
+template<typename T>
+class SharedMemoryBackend;
 
 // There is only one global hash table for the engine and all its threads. For chess in particular, we even allow racy
 // updates between threads to and from the TT, as taking the time to synchronize access would cost thinking time and
@@ -73,18 +79,43 @@ struct TTWriter {
 
    private:
     friend class TranspositionTable;
-    TTEntry* entry;
-    TTWriter(TTEntry* tte);
+    TTEntry*       entry;
+    TTExportQueue* exports;
+    TTWriter(TTEntry* tte, TTExportQueue* eq);
+};
+
+
+// A TT write with its full key, as exchanged between the engines of a distributed
+// search. The fields are packed in 'data', and 'check' is key ^ data so that a
+// copy torn by a concurrent write is detected and dropped.
+struct TTExchangeEntry {
+    Key      key;
+    uint64_t data;
+    uint64_t check;
 };
 
 
 class TranspositionTable {
 
    public:
-    ~TranspositionTable() { aligned_large_pages_free(table); }
-
-    void resize(size_t mbSize, ThreadPool& threads);  // Set TT size
+    TranspositionTable();
+    ~TranspositionTable();
+
+    void resize(size_t             mbSize,
+                ThreadPool&        threads,
+                const std::string& shmName = "");  // Set TT size, optionally in named shared memory
+    bool is_shared() const;  // Whether the table lives in shared memory
+    size_t page_size() const { return large_page_size(table); }  // 0 unless explicit large pages
+    const void* address() const { return table; }
+    size_t      size_bytes() const;  // Bytes of the table
+    void set_numa_interleave(bool b) { numaInterleave = b; }  // Takes effect on the next resize
+    std::vector<size_t> numa_placement(const ThreadPool& threads) const;  // Bytes per NUMA node
     void clear(ThreadPool& threads);                  // Re-initialize memory, multithreaded
+    bool begin_clear();  // Resets the age, false when the table is not ours to zero
+    void clear_part(const ThreadPool& threads, size_t idx);  // Zeroes the part of thread idx
+    bool save(const std::string& filename) const;     // Dump the table to a file
+    bool load(const std::string& filename, ThreadPool& threads);  // Restore a dump of equal size
+    std::string stats() const;  // Probe and write statistics, compiled in with TT_STATS
     int  hashfull(int maxAge = 0)
       const;  // Approximate what fraction of entries (permille) have been written to during this root search
 
@@ -96,13 +127,28 @@ class TranspositionTable {
     TTEntry* first_entry(const Key key)
       const;  // This is the hash function; its only external use is memory prefetching.
 
+    // Recording of the writes at or above a depth, for a distributed search. While
+    // enabled, which must not be changed during a search, the writes are queued
+    // in a ring of fixed size and the oldest are lost if not drained in time.
+    void   set_export_depth(Depth d);  // Zero disables the recording
+    size_t drain_exports(std::vector<TTExchangeEntry>& out);  // One consumer at a time
+    void   import_entries(const std::vector<TTExchangeEntry>& entries);
+
    private:
     friend struct TTEntry;
 
-    size_t   clusterCount;
-    Cluster* table = nullptr;
+    void free_table();
+    void rehash(const Cluster* oldTable, size_t oldClusterCount, ThreadPool& threads);
+
+    size_t   clusterCount = 0;
+    Cluster* table        = nullptr;
+
+    std::unique_ptr<SharedMemoryBackend<Cluster>> sharedTable;
+    std::string                                   sharedName;
+    std::unique_ptr<TTExportQueue>                exports;
 
-    uint8_t generation8 = 0;  // Size must be not bigger than TTEntry::genBound8
+    uint8_t generation8    = 0;  // Size must be not bigger than TTEntry::genBound8
+    bool    numaInterleave = false;
 };
 
 }  // namespace Stockfish
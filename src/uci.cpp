@@ -22,17 +22,22 @@
 #include <cctype>
 #include <cmath>
 #include <cstdint>
+#include <fstream>
+#include <iomanip>
 #include <iterator>
 #include <optional>
 #include <sstream>
 #include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "benchmark.h"
+#include "book.h"
 #include "engine.h"
 #include "memory.h"
 #include "movegen.h"
+#include "numa.h"
 #include "position.h"
 #include "score.h"
 #include "search.h"
@@ -83,10 +88,71 @@ void UCIEngine::init_search_update_listeners() {
       [this](const auto& i) { on_update_full(i, engine.get_options()["UCI_ShowWDL"]); });
     engine.set_on_bestmove([](const auto& bm, const auto& p) { on_bestmove(bm, p); });
     engine.set_on_verify_networks([](const auto& s) { print_info_string(s); });
+    engine.set_on_cluster_info([](const auto& s) { print_info_string(s); });
+    engine.set_on_metrics(
+      [](std::string_view s) { async_cout("info string metrics " + std::string(s)); });
+
+    engine.set_group_listeners([this](size_t group) {
+        const std::string prefix = "job " + std::to_string(group) + " ";
+
+        return Search::SearchManager::UpdateContext{
+          [prefix](const auto& i) { on_update_no_moves(i, prefix); },
+          [this, prefix](const auto& i) {
+              on_update_full(i, engine.get_options()["UCI_ShowWDL"], prefix);
+          },
+          [prefix](const auto& i) { on_iter(i, prefix); },
+          [prefix](const auto& bm, const auto& p) { on_bestmove(bm, p, prefix); },
+          nullptr};
+    });
+}
+
+// The next line of stdin, or of the commands posted once a thread posts
+bool UCIEngine::next_command(std::string& cmd) {
+
+    if (!commands->fromThreads)
+        return bool(getline(std::cin, cmd));
+
+    std::unique_lock<std::mutex> lk(commands->mutex);
+    commands->cv.wait(lk, [&] { return !commands->lines.empty(); });
+    cmd = std::move(commands->lines.front());
+    commands->lines.pop_front();
+    return true;
+}
+
+// Called on the UCI thread before any post(). The reader owns the queue with
+// the engine, as it may outlive it blocked on stdin.
+void UCIEngine::read_stdin_in_thread() {
+
+    if (commands->fromThreads)
+        return;
+
+    commands->fromThreads = true;
+    std::thread([q = commands] {
+        std::string line;
+        bool        eof = false;
+
+        while (!eof)
+        {
+            eof = !getline(std::cin, line);
+
+            std::lock_guard<std::mutex> lk(q->mutex);
+            q->lines.push_back(eof ? "quit" : std::move(line));
+            q->cv.notify_one();
+        }
+    }).detach();
+}
+
+// Runs cmd on the UCI thread, after the commands before it
+void UCIEngine::post(std::string cmd) {
+
+    std::lock_guard<std::mutex> lk(commands->mutex);
+    commands->lines.push_back(std::move(cmd));
+    commands->cv.notify_one();
 }
 
 void UCIEngine::loop() {
     std::string token, cmd;
+    std::string clearInfo;  // The time of the last ucinewgame, reported on the next go
 
     for (int i = 1; i < cli.argc; ++i)
         cmd += std::string(cli.argv[i]) + " ";
@@ -94,7 +160,7 @@ void UCIEngine::loop() {
     do
     {
         if (cli.argc == 1
-            && !getline(std::cin, cmd))  // Wait for an input or an end-of-file (EOF) indication
+            && !next_command(cmd))  // Wait for an input or an end-of-file (EOF) indication
             cmd = "quit";
 
         std::istringstream is(cmd);
@@ -102,9 +168,20 @@ void UCIEngine::loop() {
         token.clear();  // Avoid a stale if getline() returns nothing or a blank line
         is >> std::skipws >> token;
 
+        // The engine loads in the background, see Engine::wait_for_loading(). Only
+        // the commands that need neither the networks nor the threads go ahead.
+        if (token != "uci" && token != "isready" && token != "position")
+            engine.wait_for_loading();
+
         if (token == "quit" || token == "stop")
+        {
             engine.stop();
 
+            if (token == "quit")
+                for (size_t group = 0; group < engine.search_groups(); ++group)
+                    engine.stop_group(group);
+        }
+
         // The GUI sends 'ponderhit' to tell that the user has played the expected move.
         // So, 'ponderhit' is sent if pondering was done on the same move that the user
         // has played. The search should continue, but should also switch from pondering
@@ -127,12 +204,21 @@ void UCIEngine::loop() {
             // send info strings after the go command is sent for old GUIs and python-chess
             print_info_string(engine.numa_config_information_as_string());
             print_info_string(engine.thread_allocation_information_as_string());
+            print_info_string(std::exchange(clearInfo, {}));
             go(is);
         }
         else if (token == "position")
             position(is);
+        else if (token == "job")
+            job(is);
+        else if (token == "cluster")
+            cluster(is);
         else if (token == "ucinewgame")
+        {
+            TimePoint elapsed = now();
             engine.search_clear();
+            clearInfo = "ucinewgame took " + std::to_string(now() - elapsed) + " ms";
+        }
         else if (token == "isready")
             sync_cout << "readyok" << sync_endl;
 
@@ -148,6 +234,21 @@ void UCIEngine::loop() {
             sync_cout << engine.visualize() << sync_endl;
         else if (token == "eval")
             engine.trace_eval();
+        else if (token == "evalbatch")
+            evaluate_batch(is);
+        else if (token == "analyse")
+            analyse(is);
+        else if (token == "datagen")
+            datagen(is);
+        else if (token == "makebook")
+            make_book(is);
+        else if (token == "nnuebench")
+        {
+            const std::string report = engine.benchmark_nnue();
+            sync_cout << report << sync_endl;
+        }
+        else if (token == "microbench")
+            sync_cout << Benchmark::microbench() << sync_endl;
         else if (token == "compiler")
             sync_cout << compiler_info() << sync_endl;
         else if (token == "export_net")
@@ -162,6 +263,49 @@ void UCIEngine::loop() {
 
             engine.save_network(files);
         }
+        else if (token == "export_image")
+        {
+            std::string bigFile, smallFile;
+            is >> std::skipws >> bigFile >> smallFile;
+
+            const bool saved = engine.save_network_images(bigFile, smallFile);
+            sync_cout << (saved ? "Network image saved successfully to " + bigFile
+                                    + (smallFile.empty() ? "" : " and " + smallFile)
+                                : "Failed to export a network image")
+                      << sync_endl;
+        }
+        else if (token == "export_hash")
+        {
+            std::string file;
+            is >> std::skipws >> file;
+
+            // Must not hold the IO lock while waiting for a running search to finish
+            const bool saved = engine.save_tt(file);
+            sync_cout << (saved ? "Hash saved successfully to " + file
+                                : "Failed to export the hash")
+                      << sync_endl;
+        }
+        else if (token == "import_hash")
+        {
+            std::string file;
+            is >> std::skipws >> file;
+
+            const bool loaded = engine.load_tt(file);
+            sync_cout << (loaded ? "Hash loaded successfully from " + file
+                                 : "Failed to import the hash, it must have been exported "
+                                   "with the current Hash size")
+                      << sync_endl;
+        }
+        else if (token == "hashstats")
+        {
+            sync_cout << engine.get_tt_stats() << sync_endl;
+            if (const std::string tbCacheStats = engine.get_tb_cache_stats(); !tbCacheStats.empty())
+                sync_cout << tbCacheStats << sync_endl;
+        }
+        else if (token == "memory")
+            sync_cout << engine.get_memory_report() << sync_endl;
+        else if (token == "searchcounters")
+            search_counters(is);
         else if (token == "--help" || token == "help" || token == "--license" || token == "license")
             sync_cout
               << "\nStockfish is a powerful chess engine for playing and analyzing."
@@ -209,6 +353,10 @@ Search::LimitsType UCIEngine::parse_limits(std::istream& is) {
             is >> limits.mate;
         else if (token == "perft")
             is >> limits.perft;
+        else if (token == "threads" && limits.perft)  // Only for 'go perft <depth> ...'
+            is >> limits.perftThreads;
+        else if (token == "hash" && limits.perft)
+            is >> limits.perftHash;
         else if (token == "infinite")
             limits.infinite = 1;
         else if (token == "ponder")
@@ -233,12 +381,32 @@ void UCIEngine::bench(std::istream& args) {
     uint64_t    nodesSearched = 0;
     const auto& options       = engine.get_options();
 
+    // With a last "json" argument the search output is left out, and the results
+    // are printed as JSON at the end
+    std::istringstream                     benchArgs;
+    const bool                             json = Benchmark::take_json_flag(args, benchArgs);
+    std::vector<Benchmark::PositionResult> results;
+    Benchmark::PositionResult              result{};
+
     engine.set_on_update_full([&](const auto& i) {
         nodesSearched = i.nodes;
-        on_update_full(i, options["UCI_ShowWDL"]);
+        result.depth    = i.depth;
+        result.selDepth = i.selDepth;
+        result.hashfull = i.hashfull;
+
+        if (!json)
+            on_update_full(i, options["UCI_ShowWDL"]);
     });
 
-    std::vector<std::string> list = Benchmark::setup_bench(engine.fen(), args);
+    if (json)
+    {
+        engine.set_on_iter([](const auto&) {});
+        engine.set_on_update_no_moves([](const auto&) {});
+        engine.set_on_bestmove([](const auto&, const auto&) {});
+        engine.set_on_verify_networks([](const auto&) {});
+    }
+
+    std::vector<std::string> list = Benchmark::setup_bench(engine.fen(), benchArgs);
 
     num = count_if(list.begin(), list.end(),
                    [](const std::string& s) { return s.find("go ") == 0 || s.find("eval") == 0; });
@@ -258,6 +426,9 @@ void UCIEngine::bench(std::istream& args) {
             {
                 Search::LimitsType limits = parse_limits(is);
 
+                result           = {engine.fen(), 0, 0, 0, 0, 0};
+                TimePoint search = now();
+
                 if (limits.perft)
                     nodesSearched = perft(limits);
                 else
@@ -266,6 +437,10 @@ void UCIEngine::bench(std::istream& args) {
                     engine.wait_for_search_finished();
                 }
 
+                result.nodes  = nodesSearched;
+                result.timeMs = now() - search;
+                results.push_back(result);
+
                 nodes += nodesSearched;
                 nodesSearched = 0;
             }
@@ -287,13 +462,36 @@ void UCIEngine::bench(std::istream& args) {
 
     dbg_print();
 
+    // Only reported when compiled with NNUE_STATS
+    if (const std::string refreshStats = engine.get_refresh_stats(); !refreshStats.empty())
+        std::cerr << "\n" << refreshStats << std::endl;
+
+    if (const std::string evalCacheStats = engine.get_eval_cache_stats(); !evalCacheStats.empty())
+        std::cerr << "\n" << evalCacheStats << std::endl;
+
+    if (const std::string tbCacheStats = engine.get_tb_cache_stats(); !tbCacheStats.empty())
+        std::cerr << "\n" << tbCacheStats << std::endl;
+
+    if (const std::string netChoiceStats = engine.get_net_choice_stats(); !netChoiceStats.empty())
+        std::cerr << "\n" << netChoiceStats << std::endl;
+
+    if (const std::string latencyStats = engine.get_latency_stats(); !latencyStats.empty())
+        std::cerr << "\n" << latencyStats << std::endl;
+
+    // Only reported when compiled with SEARCH_COUNTERS
+    if (const std::string counters = engine.get_search_counters(); !counters.empty())
+        std::cerr << "\n" << counters << std::endl;
+
     std::cerr << "\n==========================="    //
               << "\nTotal time (ms) : " << elapsed  //
               << "\nNodes searched  : " << nodes    //
               << "\nNodes/second    : " << 1000 * nodes / elapsed << std::endl;
 
-    // reset callback, to not capture a dangling reference to nodesSearched
-    engine.set_on_update_full([&](const auto& i) { on_update_full(i, options["UCI_ShowWDL"]); });
+    if (json)
+        sync_cout << Benchmark::results_json(results, nodes, elapsed) << sync_endl;
+
+    // reset callbacks, to not capture dangling references to nodesSearched and result
+    init_search_update_listeners();
 }
 
 void UCIEngine::benchmark(std::istream& args) {
@@ -304,14 +502,33 @@ void UCIEngine::benchmark(std::istream& args) {
     uint64_t    nodes = 0, cnt = 1;
     uint64_t    nodesSearched = 0;
 
-    engine.set_on_update_full([&](const Engine::InfoFull& i) { nodesSearched = i.nodes; });
+    // With a last "json" argument the results are also printed as JSON
+    std::istringstream                     benchmarkArgs;
+    const bool                             json = Benchmark::take_json_flag(args, benchmarkArgs);
+    std::vector<Benchmark::PositionResult> results;
+    Benchmark::PositionResult              result{};
+
+    // "speedtest sweep" runs it over several configurations instead
+    if (benchmarkArgs.str().rfind("sweep ", 0) == 0)
+    {
+        benchmarkArgs >> token;
+        benchmark_sweep(benchmarkArgs);
+        return;
+    }
+
+    engine.set_on_update_full([&](const Engine::InfoFull& i) {
+        nodesSearched   = i.nodes;
+        result.depth    = i.depth;
+        result.selDepth = i.selDepth;
+        result.hashfull = i.hashfull;
+    });
 
     engine.set_on_iter([](const auto&) {});
     engine.set_on_update_no_moves([](const auto&) {});
     engine.set_on_bestmove([](const auto&, const auto&) {});
     engine.set_on_verify_networks([](const auto&) {});
 
-    Benchmark::BenchmarkSetup setup = Benchmark::setup_benchmark(args);
+    Benchmark::BenchmarkSetup setup = Benchmark::setup_benchmark(benchmarkArgs);
 
     const auto numGoCommands = count_if(setup.commands.begin(), setup.commands.end(),
                                         [](const std::string& s) { return s.find("go ") == 0; });
@@ -391,6 +608,7 @@ void UCIEngine::benchmark(std::istream& args) {
             Search::LimitsType limits = parse_limits(is);
 
             nodesSearched     = 0;
+            result            = {engine.fen(), 0, 0, 0, 0, 0};
             TimePoint elapsed = now();
 
             // Run with silenced network verification
@@ -399,6 +617,10 @@ void UCIEngine::benchmark(std::istream& args) {
 
             totalTime += now() - elapsed;
 
+            result.nodes  = nodesSearched;
+            result.timeMs = now() - elapsed;
+            results.push_back(result);
+
             updateHashfullReadings();
 
             nodes += nodesSearched;
@@ -451,23 +673,596 @@ void UCIEngine::benchmark(std::istream& args) {
 
     // clang-format on
 
+    if (json)
+        sync_cout << Benchmark::results_json(results, nodes, totalTime) << sync_endl;
+
+    init_search_update_listeners();
+}
+
+// Runs the benchmark positions once for each configuration of the sweep. The
+// speeds are compared per thread with the first configuration, and the times
+// to depth are taken, for each position, to the deepest iteration that all the
+// configurations completed.
+void UCIEngine::benchmark_sweep(std::istream& args) {
+
+    static constexpr int NUM_WARMUP_POSITIONS = 3;
+
+    Benchmark::SweepSetup setup = Benchmark::setup_sweep(args);
+
+    const size_t numGoCommands = count_if(setup.commands.begin(), setup.commands.end(),
+                                          [](const std::string& s) { return s.find("go ") == 0; });
+
+    std::string token;
+    uint64_t    nodesSearched = 0;
+    size_t      config = 0, positionIdx = 0;
+
+    // For each configuration and position, the time at which each depth was completed
+    std::vector<std::vector<std::vector<size_t>>> depthTimes(
+      setup.configs.size(), std::vector<std::vector<size_t>>(numGoCommands));
+    std::vector<uint64_t>  nodes(setup.configs.size());
+    std::vector<TimePoint> times(setup.configs.size());
+
+    engine.set_on_update_full([&](const Engine::InfoFull& i) {
+        nodesSearched = i.nodes;
+
+        auto& t = depthTimes[config][positionIdx];
+        if (i.bound.empty() && size_t(i.depth) == t.size() + 1)
+            t.push_back(i.timeMs);
+    });
+
+    engine.set_on_iter([](const auto&) {});
+    engine.set_on_update_no_moves([](const auto&) {});
+    engine.set_on_bestmove([](const auto&, const auto&) {});
+    engine.set_on_verify_networks([](const auto&) {});
+
+    auto set = [&](const std::string& name, const std::string& value) {
+        auto ss = std::istringstream("name " + name + " value " + value);
+        setoption(ss);
+    };
+
+    auto run = [&](size_t maxSearches, bool measure) {
+        size_t searches = 0;
+
+        for (const auto& cmd : setup.commands)
+        {
+            std::istringstream is(cmd);
+            is >> std::skipws >> token;
+
+            if (token == "go")
+            {
+                if (searches++ == maxSearches)
+                    break;
+
+                std::cerr << "\rConfiguration " << config + 1 << '/' << setup.configs.size()
+                          << ", position " << searches << '/' << numGoCommands << "   ";
+
+                Search::LimitsType limits = parse_limits(is);
+
+                nodesSearched     = 0;
+                positionIdx       = searches - 1;
+                TimePoint elapsed = now();
+
+                engine.go(limits);
+                engine.wait_for_search_finished();
+
+                if (measure)
+                {
+                    times[config] += now() - elapsed;
+                    nodes[config] += nodesSearched;
+                }
+            }
+            else if (token == "position")
+                position(is);
+            else if (token == "ucinewgame")
+                engine.search_clear();  // search_clear may take a while
+        }
+    };
+
+    for (config = 0; config < setup.configs.size(); ++config)
+    {
+        const auto& c = setup.configs[config];
+
+        set("NumaPolicy", c.numaPolicy);
+        set("Threads", std::to_string(c.threads));
+        set("Hash", std::to_string(c.ttSize));
+        set("UCI_Chess960", "false");
+
+        if (!config)
+        {
+            run(NUM_WARMUP_POSITIONS, false);
+            depthTimes[0].assign(numGoCommands, {});
+        }
+
+        engine.search_clear();
+        run(numGoCommands, true);
+    }
+
+    std::cerr << "\n";
+
+    std::vector<uint64_t> timeToDepth(setup.configs.size());
+
+    for (size_t p = 0; p < numGoCommands; ++p)
+    {
+        size_t depth = depthTimes[0][p].size();
+        for (const auto& times_ : depthTimes)
+            depth = std::min(depth, times_[p].size());
+
+        for (size_t c = 0; c < setup.configs.size() && depth; ++c)
+            timeToDepth[c] += depthTimes[c][p][depth - 1];
+    }
+
+    auto nps = [&](size_t c) {
+        return 1000 * nodes[c] / uint64_t(std::max<TimePoint>(times[c], 1));
+    };
+
+    // clang-format off
+
+    std::cerr << "==========================="
+              << "\nVersion                    : " << engine_version_info()
+              << compiler_info()
+              << "Available processors       : " << engine.get_numa_config_as_string()
+              << "\nSeconds per configuration  : " << setup.desiredTimeS
+              << "\n\n"
+              << std::setw(8) << "Threads" << std::setw(12) << "Hash [MiB]"
+              << std::setw(12) << "NumaPolicy" << std::setw(14) << "Nodes/second"
+              << std::setw(12) << "Efficiency"
+              << std::setw(20) << "Time to depth [s]" << std::setw(10) << "Speedup" << "\n";
+
+    for (size_t c = 0; c < setup.configs.size(); ++c)
+    {
+        const auto& cfg = setup.configs[c];
+
+        // Efficiency is the speed per thread relative to that of the first configuration
+        const double efficiency = double(nps(c)) / cfg.threads
+                                / std::max(double(nps(0)) / setup.configs[0].threads, 1.0);
+        const double speedup =
+          double(timeToDepth[0]) / double(std::max<uint64_t>(timeToDepth[c], 1));
+
+        std::cerr << std::setw(8) << cfg.threads << std::setw(12) << cfg.ttSize
+                  << std::setw(12) << cfg.numaPolicy << std::setw(14) << nps(c)
+                  << std::setw(12) << std::fixed << std::setprecision(2) << efficiency
+                  << std::setw(20) << std::setprecision(3) << timeToDepth[c] / 1000.0
+                  << std::setw(10) << std::setprecision(2) << speedup << "\n";
+    }
+
+    std::cerr << std::defaultfloat << std::flush;
+
+    // clang-format on
+
     init_search_update_listeners();
 }
 
+namespace {
+
+// A FEN as a PackedPosition, for the packed output of text input
+PackedPosition pack_fen(const std::string& fen, bool chess960) {
+    StateInfo si;
+    Position  pos;
+    return pos.set(fen, chess960, &si).pack();
+}
+
+void write_packed(std::ostream& out, const PackedPosition& pp) {
+    out.write(reinterpret_cast<const char*>(&pp), sizeof(pp));
+}
+
+}
+
+// Prints the static evaluation of each position of a file with one FEN per line,
+// in centipawns from White's point of view, or "none" when the side to move is in check.
+// With 'packed' the file holds PackedPositions instead. With 'out' the positions not
+// in check are written to the file as PackedPositions with their evaluation, in
+// place of the printing. The file is read and evaluated in chunks:
+//   evalbatch <file> [packed] [out <file>]
+void UCIEngine::evaluate_batch(std::istream& args) {
+    constexpr size_t ChunkSize = 1 << 16;
+
+    std::string fenFile, outFile, token;
+    bool        packed = false;
+
+    args >> std::skipws >> fenFile;
+
+    while (args >> token)
+        if (token == "packed")
+            packed = true;
+        else if (token == "out")
+            args >> outFile;
+
+    std::ifstream file(fenFile, packed ? std::ios::binary : std::ios::in);
+    std::ofstream out;
+
+    if (!file.is_open())
+    {
+        sync_cout << "Unable to open file " << fenFile << sync_endl;
+        return;
+    }
+
+    if (!outFile.empty() && (out.open(outFile, std::ios::binary), !out.is_open()))
+    {
+        sync_cout << "Unable to open file " << outFile << sync_endl;
+        return;
+    }
+
+    const bool                  chess960 = engine.get_options()["UCI_Chess960"];
+    std::vector<std::string>    fens;
+    std::vector<PackedPosition> positions;
+    std::size_t                 count   = 0;
+    TimePoint                   elapsed = now();
+    bool                        valid   = true;  // An invalid position ends the reading
+
+    for (bool more = true; more;)
+    {
+        fens.clear();
+        positions.clear();
+
+        if (packed)
+        {
+            PackedPosition pp;
+            while (valid && positions.size() < ChunkSize
+                   && (more = bool(file.read(reinterpret_cast<char*>(&pp), sizeof(pp)))))
+                if ((valid = Position::is_valid(pp)))
+                    positions.push_back(pp);
+        }
+        else
+        {
+            std::string fen;
+            while (valid && fens.size() < ChunkSize && (more = bool(getline(file, fen))))
+                if (!fen.empty() && (valid = Position::is_valid_fen(fen)))
+                    fens.push_back(fen);
+        }
+
+        more &= valid;
+
+        auto values = packed ? engine.evaluate_batch(positions) : engine.evaluate_batch(fens);
+
+        if (values.empty())
+            continue;
+
+        if (out.is_open())
+        {
+            for (std::size_t i = 0; i < values.size(); ++i)
+                if (values[i])
+                {
+                    PackedPosition pp = packed ? positions[i] : pack_fen(fens[i], chess960);
+                    pp.eval           = int16_t(std::clamp(*values[i], -32767, 32767));
+                    write_packed(out, pp);
+                }
+        }
+        else
+        {
+            std::stringstream ss;
+            for (std::size_t i = 0; i < values.size(); ++i)
+                ss << (i ? "\n" : "") << (values[i] ? std::to_string(*values[i]) : "none");
+
+            sync_cout << ss.str() << sync_endl;
+        }
+
+        count += values.size();
+    }
+
+    if (!valid)
+        sync_cout << "info string Invalid position " << count << " in " << fenFile << sync_endl;
+
+    elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+
+    std::cerr << "\n==========================="
+              << "\nPositions evaluated: " << count
+              << "\nPositions/second   : " << 1000 * count / elapsed << std::endl;
+}
+
+namespace {
+
+// The FEN of a line of an EPD or FEN file, keeping the move counters only when
+// they are there, as EPD operations take their place
+std::string epd_to_fen(const std::string& line) {
+    std::istringstream ss(line);
+    std::string        token, fen;
+
+    for (int i = 0; i < 4 && ss >> token; ++i)
+        fen += (i ? " " : "") + token;
+
+    auto isNumber = [](const std::string& s) {
+        return !s.empty()
+            && std::all_of(s.begin(), s.end(), [](unsigned char c) { return std::isdigit(c); });
+    };
+
+    std::string halfmove, fullmove;
+    if (ss >> halfmove >> fullmove && isNumber(halfmove) && isNumber(fullmove))
+        fen += " " + halfmove + " " + fullmove;
+
+    return fen;
+}
+
+}
+
+// Searches each position of an EPD or FEN file with a single threaded search, on
+// all the threads at once, and prints the results in the order of the file:
+//   analyse <file> [packed] [out <file>] [threads <n>] [hash <mb>] <go limits>
+// With 'packed' the file holds PackedPositions instead. With 'out' the positions
+// are written to the file as PackedPositions with their score, in place of the
+// printing: mates as 32000 and tablebase results as for 'info', with a wdl only
+// for those, and PackedPosition::WdlUnknown for the others. Threads defaults to
+// the hardware threads, and a hash of zero, the default, shares the main hash. An
+// invalid position ends the analysis.
+void UCIEngine::analyse(std::istream& args) {
+    std::string fenFile, outFile, token, limitArgs;
+    size_t      threadCount = std::max<size_t>(1, get_hardware_concurrency()), hashMb = 0;
+    bool        packed = false;
+
+    args >> std::skipws >> fenFile;
+
+    while (args >> token)
+        if (token == "threads")
+            args >> threadCount;
+        else if (token == "hash")
+            args >> hashMb;
+        else if (token == "packed")
+            packed = true;
+        else if (token == "out")
+            args >> outFile;
+        else
+            limitArgs += token + " ";
+
+    std::istringstream limitStream(limitArgs);
+    Search::LimitsType limits = parse_limits(limitStream);
+    std::ifstream      file(fenFile, packed ? std::ios::binary : std::ios::in);
+    std::ofstream      out;
+
+    if (!file.is_open())
+    {
+        sync_cout << "Unable to open file " << fenFile << sync_endl;
+        return;
+    }
+
+    if (!outFile.empty() && (out.open(outFile, std::ios::binary), !out.is_open()))
+    {
+        sync_cout << "Unable to open file " << outFile << sync_endl;
+        return;
+    }
+
+    if (limits.perft || limits.infinite || limits.ponderMode)
+    {
+        sync_cout << "info string analyse needs a finite search, as depth or nodes" << sync_endl;
+        return;
+    }
+
+    size_t   positions = 0;
+    uint64_t nodes     = 0;
+
+    const bool chess960 = engine.get_options()["UCI_Chess960"];
+
+    // The number of positions read, and whether the last one was invalid, which
+    // ends the analysis as set() cannot take it
+    size_t read    = 0;
+    bool   invalid = false;
+
+    auto next = [&](Position& pos, StateInfo* si) {
+        if (packed)
+        {
+            PackedPosition pp;
+
+            if (!file.read(reinterpret_cast<char*>(&pp), sizeof(pp)))
+                return false;
+
+            if ((invalid = !Position::is_valid(pp)))
+                return false;
+
+            pos.set(pp, chess960, si);
+            ++read;
+            return true;
+        }
+
+        std::string line, fen;
+
+        while (getline(file, line))
+            if (!(fen = epd_to_fen(line)).empty())
+            {
+                if ((invalid = !Position::is_valid_fen(fen)))
+                    return false;
+
+                pos.set(fen, chess960, si);
+                ++read;
+                return true;
+            }
+
+        return false;
+    };
+
+    auto onResult = [&](const Engine::AnalysisResult& r) {
+        ++positions;
+        nodes += r.nodes;
+
+        if (out.is_open())
+        {
+            PackedPosition pp    = r.position;
+            const bool     black = pp.stmEpSquare & 0x80;
+            const auto     [cp, wdl] =
+              r.score.visit(overload{[](Score::Mate mate) {
+                                         return std::pair(mate.plies > 0 ? 32000 : -32000,
+                                                          mate.plies > 0 ? 2 : 0);
+                                     },
+                                     [](Score::Tablebase tb) {
+                                         return std::pair(tb.win ? 20000 - tb.plies
+                                                                 : -20000 - tb.plies,
+                                                          tb.win ? 2 : 0);
+                                     },
+                                     [](Score::InternalUnits units) {
+                                         return std::pair(std::clamp(units.value, -32767, 32767),
+                                                          -1);
+                                     }});
+
+            pp.eval = int16_t(black ? -cp : cp);
+            pp.wdl  = wdl < 0 ? PackedPosition::WdlUnknown : uint8_t(black ? 2 - wdl : wdl);
+            write_packed(out, pp);
+            return;
+        }
+
+        sync_cout << "result " << r.index << " bestmove " << r.bestmove << " score "
+                  << format_score(r.score) << " depth " << r.depth << " nodes " << r.nodes
+                  << " pv " << r.pv << sync_endl;
+    };
+
+    TimePoint elapsed = now();
+    engine.analyse(next, limits, std::max<size_t>(1, threadCount), hashMb, onResult);
+    elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+
+    if (invalid)
+        sync_cout << "info string Invalid position " << read << " in " << fenFile << sync_endl;
+
+    std::cerr << "\n==========================="
+              << "\nPositions analysed : " << positions
+              << "\nPositions/second   : " << 1000 * positions / elapsed
+              << "\nNodes/second       : " << 1000 * nodes / elapsed << std::endl;
+}
+
+// Generates training data by self-play on all the threads at once, see
+// PackedPosition for the format of the file:
+//   datagen <file> [threads <n>] [games <n>] [nodes <n>] [hash <mb>] [random <plies>]
+//           [maxplies <n>] [seed <n>] [openings <file>]
+// The games start from the PackedPositions of the openings file in turn, or else
+// from the start position. They are adjudicated by the tablebases of SyzygyPath
+// when they are set.
+void UCIEngine::datagen(std::istream& args) {
+    std::string     outFile, openingFile, token;
+    Datagen::Params params;
+
+    params.threads = std::max<size_t>(1, get_hardware_concurrency());
+
+    args >> std::skipws >> outFile;
+
+    while (args >> token)
+        if (token == "threads")
+            args >> params.threads;
+        else if (token == "games")
+            args >> params.games;
+        else if (token == "nodes")
+            args >> params.nodes;
+        else if (token == "hash")
+            args >> params.hashMb;
+        else if (token == "random")
+            args >> params.randomPlies;
+        else if (token == "maxplies")
+            args >> params.maxPlies;
+        else if (token == "seed")
+            args >> params.seed;
+        else if (token == "openings")
+            args >> openingFile;
+
+    std::ofstream file(outFile, std::ios::binary);
+    std::ifstream openings;
+
+    if (!file.is_open())
+    {
+        sync_cout << "Unable to open file " << outFile << sync_endl;
+        return;
+    }
+
+    if (!openingFile.empty())
+    {
+        openings.open(openingFile, std::ios::binary);
+
+        if (!openings.is_open())
+        {
+            sync_cout << "Unable to open file " << openingFile << sync_endl;
+            return;
+        }
+
+        params.openings = &openings;
+    }
+
+    params.threads = std::max<size_t>(1, params.threads);
+    params.hashMb  = std::max<size_t>(1, params.hashMb);
+    params.nodes   = std::max<uint64_t>(1, params.nodes);
+
+    TimePoint elapsed = now();
+    auto      stats   = engine.datagen(params, file);
+    elapsed           = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+
+    std::cerr << "\n==========================="
+              << "\nGames played       : " << stats.games
+              << "\nWhite/draw/black   : " << stats.results[2] << "/" << stats.results[1] << "/"
+              << stats.results[0]
+              << "\nPositions written  : " << stats.positions
+              << "\nPositions/second   : " << 1000 * stats.positions / elapsed << std::endl;
+}
+
+// Writes a book for the "Book File" option from a text file of lines as
+//   <fen or epd> ; <uci move> [weight]
+// with a weight of 1 when not given. A position and move on several lines has the
+// sum of their weights.
+void UCIEngine::make_book(std::istream& args) {
+    std::string inFile, outFile;
+    args >> std::skipws >> inFile >> outFile;
+
+    std::ifstream file(inFile);
+    std::ofstream out(outFile, std::ios::binary);
+
+    if (!file.is_open() || !out.is_open())
+    {
+        sync_cout << "Unable to open file " << (file.is_open() ? outFile : inFile) << sync_endl;
+        return;
+    }
+
+    const bool               chess960 = engine.get_options()["UCI_Chess960"];
+    std::vector<Book::Entry> entries;
+    std::string              line;
+    size_t                   skipped = 0;
+
+    while (getline(file, line))
+    {
+        const size_t semicolon = line.find(';');
+        std::string  fen       = epd_to_fen(line.substr(0, semicolon));
+
+        if (semicolon == std::string::npos || fen.empty())
+            continue;
+
+        std::istringstream ss(line.substr(semicolon + 1));
+        std::string        moveStr;
+        int                weight = 1;
+        ss >> moveStr >> weight;
+
+        Position  pos;
+        StateInfo st;
+        pos.set(fen, chess960, &st);
+
+        const Move m = to_move(pos, moveStr);
+
+        if (m == Move::none() || weight <= 0)
+        {
+            ++skipped;
+            continue;
+        }
+
+        entries.push_back({pos.raw_key(), m.raw(), uint16_t(std::min(weight, 65535)), 0});
+    }
+
+    const size_t written = Book::write(std::move(entries), out);
+
+    sync_cout << "info string Book " << outFile << " written with " << written << " entries"
+              << (skipped ? ", skipping " + std::to_string(skipped) + " illegal moves" : "")
+              << sync_endl;
+}
+
 void UCIEngine::setoption(std::istringstream& is) {
     engine.wait_for_search_finished();
     engine.get_options().setoption(is);
 }
 
 std::uint64_t UCIEngine::perft(const Search::LimitsType& limits) {
-    auto nodes = engine.perft(engine.fen(), limits.perft, engine.get_options()["UCI_Chess960"]);
+    auto nodes = engine.perft(engine.fen(), limits.perft, engine.get_options()["UCI_Chess960"],
+                              limits.perftThreads, limits.perftHash);
     sync_cout << "\nNodes searched: " << nodes << "\n" << sync_endl;
     return nodes;
 }
 
-void UCIEngine::position(std::istringstream& is) {
-    std::string token, fen;
+// Reads the arguments of the position command, up to the end of the stream or
+// to a "go" token, which is then consumed and reported in 'go'
+bool UCIEngine::parse_position(std::istream&             is,
+                               std::string&              fen,
+                               std::vector<std::string>& moves,
+                               bool&                     go) {
+    std::string token;
 
+    go = false;
     is >> token;
 
     if (token == "startpos")
@@ -476,19 +1271,141 @@ void UCIEngine::position(std::istringstream& is) {
         is >> token;  // Consume the "moves" token, if any
     }
     else if (token == "fen")
-        while (is >> token && token != "moves")
+        while (is >> token && token != "moves" && token != "go")
             fen += token + " ";
     else
-        return;
+        return false;
+
+    while (token != "go" && is >> token && token != "go")
+    {
+        moves.push_back(token);
+    }
+
+    go = token == "go";
+    return true;
+}
 
+void UCIEngine::position(std::istringstream& is) {
+    std::string              fen;
     std::vector<std::string> moves;
+    bool                     go;
 
-    while (is >> token)
+    if (parse_position(is, fen, moves, go))
+        engine.set_position(fen, moves);
+}
+
+// Distributed search, see Distributed::Link. A worker is started with
+// 'cluster serve <port>', then the main engine connects with
+// 'cluster connect <host:port> ...' and its searches use all the workers.
+//   cluster serve <port> | connect <host:port> ... | close | status
+void UCIEngine::cluster(std::istringstream& is) {
+    std::string token;
+    is >> token;
+
+    if (token == "serve")
     {
-        moves.push_back(token);
+        int port = 0;
+        is >> port;
+
+        // The searches of the main engine run as commands of the UCI thread, as
+        // from a GUI, and the main engine waits for the secret
+        read_stdin_in_thread();
+        const bool ok = port > 0 && port < 65536
+                     && engine.cluster_serve(
+                       std::uint16_t(port),
+                       [this](const std::string& fen, const std::vector<std::string>& moves) {
+                           std::string cmd = "position fen " + fen + " moves";
+                           for (const auto& m : moves)
+                               cmd += " " + m;
+
+                           post("stop");
+                           post(std::move(cmd));
+                           post("go infinite");
+                       },
+                       [this]() { post("stop"); });
+        print_info_string(ok ? "Distributed search: serving on port " + std::to_string(port)
+                             : "Distributed search: failed to serve on port "
+                                 + std::to_string(port) + ", needs a Cluster Secret and Address");
     }
+    else if (token == "connect")
+    {
+        std::vector<std::string> workers;
+        while (is >> token)
+            workers.push_back(token);
 
-    engine.set_position(fen, moves);
+        const bool ok = !workers.empty() && engine.cluster_connect(workers);
+        print_info_string(ok ? engine.cluster_status()
+                             : "Distributed search: failed to connect to the workers");
+    }
+    else if (token == "close")
+    {
+        engine.cluster_close();
+        print_info_string(engine.cluster_status());
+    }
+    else if (token == "status")
+        print_info_string(engine.cluster_status());
+}
+
+// Prints the search counters of all threads, summed over the searches since
+// startup, or clears them. They need a build with -DSEARCH_COUNTERS.
+//   searchcounters [clear]
+void UCIEngine::search_counters(std::istringstream& is) {
+    std::string token;
+    is >> token;
+
+    if (token == "clear")
+        engine.clear_search_counters();
+    else if (const std::string counters = engine.get_search_counters(); !counters.empty())
+        sync_cout << counters << sync_endl;
+    else
+        print_info_string("Search counters are disabled, compile with -DSEARCH_COUNTERS");
+}
+
+// Extension driving the search groups, which search side by side on threads of
+// their own (see the "Search Groups" option). Their output lines are prefixed
+// with "job <n>".
+//   job <n> position <startpos | fen <fen>> [moves ...] [go <limits>]
+//   job <n> go <limits>
+//   job <n> stop
+void UCIEngine::job(std::istringstream& is) {
+    size_t      group = 0;
+    std::string token;
+
+    if (!(is >> group >> token) || group >= engine.search_groups())
+    {
+        sync_cout << "info string job: no search group " << group << ", there are "
+                  << engine.search_groups() << sync_endl;
+        return;
+    }
+
+    if (token == "stop")
+    {
+        engine.stop_group(group);
+        return;
+    }
+
+    if (token == "position")
+    {
+        std::string              fen;
+        std::vector<std::string> moves;
+        bool                     go;
+
+        if (!parse_position(is, fen, moves, go))
+            return;
+
+        engine.set_group_position(group, fen, moves);
+        token = go ? "go" : "";
+    }
+
+    if (token == "go")
+    {
+        Search::LimitsType limits = parse_limits(is);
+
+        if (limits.perft)
+            return;
+
+        engine.go_group(group, limits);
+    }
 }
 
 namespace {
@@ -601,24 +1518,75 @@ std::string UCIEngine::to_lower(std::string str) {
     return str;
 }
 
-Move UCIEngine::to_move(const Position& pos, std::string str) {
-    str = to_lower(str);
+// Decodes the move from its squares instead of generating all the legal moves of
+// each position of a long 'position ... moves' command. The move is then checked
+// with pseudo_legal() and legal(), and must print back as the given string, in
+// any case. The string is read in place.
+Move UCIEngine::to_move(const Position& pos, std::string_view str) {
+
+    auto lower = [](char c) { return char(std::tolower(static_cast<unsigned char>(c))); };
+
+    if (str.size() != 4 && str.size() != 5)
+        return Move::none();
+
+    for (int i = 0; i < 4; i += 2)
+        if (lower(str[i]) < 'a' || lower(str[i]) > 'h' || str[i + 1] < '1' || str[i + 1] > '8')
+            return Move::none();
 
-    for (const auto& m : MoveList<LEGAL>(pos))
-        if (str == move(m, pos.is_chess960()))
-            return m;
+    const Color  us   = pos.side_to_move();
+    const Square from = make_square(File(lower(str[0]) - 'a'), Rank(str[1] - '1'));
+    Square       to   = make_square(File(lower(str[2]) - 'a'), Rank(str[3] - '1'));
+    const Piece  pc   = pos.piece_on(from);
+    Move         m;
 
-    return Move::none();
+    if (str.size() == 5)
+    {
+        auto pt = std::string_view("nbrq").find(lower(str[4]));
+        if (pt == std::string_view::npos)
+            return Move::none();
+
+        m = Move::make<PROMOTION>(from, to, PieceType(KNIGHT + pt));
+    }
+    else if (pc == make_piece(us, KING)
+             && (pos.is_chess960() ? pos.piece_on(to) == make_piece(us, ROOK)
+                                   : rank_of(from) == rank_of(to)
+                                       && std::abs(file_of(from) - file_of(to)) == 2))
+    {
+        CastlingRights cr = us & (to > from ? KING_SIDE : QUEEN_SIDE);
+        if (!pos.can_castle(cr))
+            return Move::none();
+
+        m = Move::make<CASTLING>(from, pos.castling_rook_square(cr));
+    }
+    else if (type_of(pc) == PAWN && to == pos.ep_square())
+        m = Move::make<EN_PASSANT>(from, to);
+    else
+        m = Move(from, to);
+
+    if (!pos.pseudo_legal(m) || !pos.legal(m))
+        return Move::none();
+
+    const std::string uci = move(m, pos.is_chess960());
+    return std::equal(uci.begin(), uci.end(), str.begin(), str.end(),
+                      [&](char a, char b) { return a == lower(b); })
+           ? m
+           : Move::none();
 }
 
-void UCIEngine::on_update_no_moves(const Engine::InfoShort& info) {
-    sync_cout << "info depth " << info.depth << " score " << format_score(info.score) << sync_endl;
+// The search output goes through async_cout(), so that a slow reader of stdout
+// never holds up the search threads
+
+void UCIEngine::on_update_no_moves(const Engine::InfoShort& info, std::string_view prefix) {
+    async_cout(std::string(prefix) + "info depth " + std::to_string(info.depth) + " score "
+               + format_score(info.score));
 }
 
-void UCIEngine::on_update_full(const Engine::InfoFull& info, bool showWDL) {
+void UCIEngine::on_update_full(const Engine::InfoFull& info,
+                               bool                    showWDL,
+                               std::string_view        prefix) {
     std::stringstream ss;
 
-    ss << "info";
+    ss << prefix << "info";
     ss << " depth " << info.depth                 //
        << " seldepth " << info.selDepth           //
        << " multipv " << info.multiPV             //
@@ -637,25 +1605,27 @@ void UCIEngine::on_update_full(const Engine::InfoFull& info, bool showWDL) {
        << " time " << info.timeMs        //
        << " pv " << info.pv;             //
 
-    sync_cout << ss.str() << sync_endl;
+    async_cout(ss.str());
 }
 
-void UCIEngine::on_iter(const Engine::InfoIter& info) {
+void UCIEngine::on_iter(const Engine::InfoIter& info, std::string_view prefix) {
     std::stringstream ss;
 
-    ss << "info";
+    ss << prefix << "info";
     ss << " depth " << info.depth                     //
        << " currmove " << info.currmove               //
        << " currmovenumber " << info.currmovenumber;  //
 
-    sync_cout << ss.str() << sync_endl;
+    async_cout(ss.str());
 }
 
-void UCIEngine::on_bestmove(std::string_view bestmove, std::string_view ponder) {
-    sync_cout << "bestmove " << bestmove;
+void UCIEngine::on_bestmove(std::string_view bestmove,
+                            std::string_view ponder,
+                            std::string_view prefix) {
+    std::string line = std::string(prefix) + "bestmove " + std::string(bestmove);
     if (!ponder.empty())
-        std::cout << " ponder " << ponder;
-    std::cout << sync_endl;
+        line += " ponder " + std::string(ponder);
+    async_cout(std::move(line));
 }
 
 }  // namespace Stockfish
@@ -19,10 +19,15 @@
 #ifndef UCI_H_INCLUDED
 #define UCI_H_INCLUDED
 
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "engine.h"
 #include "misc.h"
@@ -48,29 +53,57 @@ class UCIEngine {
     static std::string move(Move m, bool chess960);
     static std::string wdl(Value v, const Position& pos);
     static std::string to_lower(std::string str);
-    static Move        to_move(const Position& pos, std::string str);
+    static Move        to_move(const Position& pos, std::string_view str);
 
     static Search::LimitsType parse_limits(std::istream& is);
 
     auto& engine_options() { return engine.get_options(); }
 
    private:
-    Engine      engine;
-    CommandLine cli;
+    // Commands from other threads, as a worker of a distributed search gets them.
+    // Once a thread posts, stdin is read by a thread of its own, see post().
+    struct Commands {
+        std::mutex              mutex;
+        std::condition_variable cv;
+        std::deque<std::string> lines;
+        bool                    fromThreads = false;
+    };
+
+    Engine                    engine;
+    CommandLine               cli;
+    std::shared_ptr<Commands> commands = std::make_shared<Commands>();
+
+    bool next_command(std::string& cmd);
+    void read_stdin_in_thread();
+    void post(std::string cmd);
 
     static void print_info_string(std::string_view str);
 
     void          go(std::istringstream& is);
     void          bench(std::istream& args);
     void          benchmark(std::istream& args);
+    void          benchmark_sweep(std::istream& args);
+    void          evaluate_batch(std::istream& args);
+    void          analyse(std::istream& args);
+    void          datagen(std::istream& args);
+    void          make_book(std::istream& args);
     void          position(std::istringstream& is);
+    void          job(std::istringstream& is);
+    void          cluster(std::istringstream& is);
+    void          search_counters(std::istringstream& is);
     void          setoption(std::istringstream& is);
     std::uint64_t perft(const Search::LimitsType&);
 
-    static void on_update_no_moves(const Engine::InfoShort& info);
-    static void on_update_full(const Engine::InfoFull& info, bool showWDL);
-    static void on_iter(const Engine::InfoIter& info);
-    static void on_bestmove(std::string_view bestmove, std::string_view ponder);
+    static bool
+    parse_position(std::istream& is, std::string& fen, std::vector<std::string>& moves, bool& go);
+
+    // The prefix tells the output of a search group from that of the main search
+    static void on_update_no_moves(const Engine::InfoShort& info, std::string_view prefix = {});
+    static void
+    on_update_full(const Engine::InfoFull& info, bool showWDL, std::string_view prefix = {});
+    static void on_iter(const Engine::InfoIter& info, std::string_view prefix = {});
+    static void
+    on_bestmove(std::string_view bestmove, std::string_view ponder, std::string_view prefix = {});
 
     void init_search_update_listeners();
 };
@@ -170,6 +170,39 @@ class TestCLI(metaclass=OrderedClassMembers):
         )
         assert self.stockfish.process.returncode == 0
 
+    def test_evalbatch_bench_tmp_epd(self):
+        self.stockfish = Stockfish(
+            f"evalbatch {os.path.join(PATH, 'bench_tmp.epd')}".split(" "), True
+        )
+        assert self.stockfish.process.returncode == 0
+        assert "Positions evaluated: 4" in self.stockfish.process.stderr
+
+    def test_analyse_bench_tmp_epd_depth_4(self):
+        self.stockfish = Stockfish(
+            f"analyse {os.path.join(PATH, 'bench_tmp.epd')} threads {get_threads()} depth 4".split(
+                " "
+            ),
+            True,
+        )
+        assert self.stockfish.process.returncode == 0
+        assert "Positions analysed : 4" in self.stockfish.process.stderr
+
+    def test_datagen_games_2_nodes_500(self):
+        current_path = os.path.abspath(os.getcwd())
+        self.stockfish = Stockfish(
+            f"datagen {os.path.join(current_path, 'datagen.bin')} threads {get_threads()} games 2 nodes 500".split(
+                " "
+            ),
+            True,
+        )
+        assert self.stockfish.process.returncode == 0
+        assert os.path.getsize(os.path.join(current_path, "datagen.bin")) > 0
+
+    def test_memory(self):
+        self.stockfish = Stockfish("memory".split(" "), True)
+        assert self.stockfish.process.returncode == 0
+        assert "Memory use in MB" in self.stockfish.process.stdout
+
     # verify the generated net equals the base net
 
     def test_network_equals_base(self):
@@ -411,6 +444,58 @@ class TestInteractive(metaclass=OrderedClassMembers):
 
         self.stockfish.send_command("setoption name Skill Level value 20")
 
+    def test_export_and_import_hash(self):
+        current_path = os.path.abspath(os.getcwd())
+        hash_file = os.path.join(current_path, "hash.bin")
+
+        self.stockfish.send_command("setoption name Hash value 16")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command(f"export_hash {hash_file}")
+        self.stockfish.equals(f"Hash saved successfully to {hash_file}")
+
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command(f"import_hash {hash_file}")
+        self.stockfish.equals(f"Hash loaded successfully from {hash_file}")
+
+        # The hash can only be imported with the size it was exported with
+        self.stockfish.send_command("setoption name Hash value 32")
+        self.stockfish.send_command(f"import_hash {hash_file}")
+        self.stockfish.starts_with("Failed to import the hash")
+
+        self.stockfish.send_command("setoption name Hash value 16")
+
+    def test_makebook_and_book_file(self):
+        current_path = os.path.abspath(os.getcwd())
+        book_input = os.path.join(current_path, "book.txt")
+        book_file = os.path.join(current_path, "test.book")
+
+        with open(book_input, "w") as f:
+            f.write("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 ; e2e4\n")
+
+        self.stockfish.send_command(f"makebook {book_input} {book_file}")
+        self.stockfish.equals(f"info string Book {book_file} written with 1 entries")
+
+        # With "Book Instant" a search on the clock only plays the book move
+        self.stockfish.send_command(f"setoption name Book File value {book_file}")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go wtime 8000 btime 8000")
+        self.stockfish.starts_with("bestmove e2e4")
+
+        self.stockfish.send_command("setoption name Book File value <empty>")
+
+    def test_job_search_group(self):
+        self.stockfish.send_command("setoption name Search Groups value 2")
+        self.stockfish.send_command("job 1 position startpos go depth 5")
+        self.stockfish.starts_with("job 1 bestmove")
+
+        self.stockfish.send_command("job 2 go depth 5")
+        self.stockfish.equals("info string job: no search group 2, there are 2")
+
+        self.stockfish.send_command("setoption name Search Groups value 0")
+
 
 class TestSyzygy(metaclass=OrderedClassMembers):
     def beforeAll(self):
@@ -17,13 +17,16 @@ EXPECT_SCRIPT=$(mktemp)
 cat << 'EOF' > $EXPECT_SCRIPT
 #!/usr/bin/expect -f
 set timeout 120
-lassign [lrange $argv 0 4] pos depth result chess960 logfile
+lassign [lrange $argv 0 5] pos depth result chess960 logfile perftargs
 log_file -noappend $logfile
 spawn ./stockfish
 if {$chess960 == "true"} {
   send "setoption name UCI_Chess960 value true\n"
 }
-send "position $pos\ngo perft $depth\n"
+if {[string match "*threads*" $perftargs]} {
+  send "setoption name Threads value 2\n"
+}
+send "position $pos\ngo perft $depth $perftargs\n"
 expect {
   "Nodes searched: $result" {}
   timeout {puts "TIMEOUT: Expected $result nodes"; exit 1}
@@ -40,11 +43,12 @@ run_test() {
   local depth="$2"
   local expected="$3"
   local chess960="$4"
+  local perftargs="$5"
   local tmp_file=$(mktemp)
 
-  echo -n "Testing depth $depth: ${pos:0:40}... "
+  echo -n "Testing depth $depth: ${pos:0:40}... $perftargs "
 
-  if $EXPECT_SCRIPT "$pos" "$depth" "$expected" "$chess960" "$tmp_file" > /dev/null 2>&1; then
+  if $EXPECT_SCRIPT "$pos" "$depth" "$expected" "$chess960" "$tmp_file" "$perftargs" > /dev/null 2>&1; then
     echo "OK"
     rm -f "$tmp_file"
   else
@@ -84,6 +88,14 @@ run_test "fen rr6/2kpp3/1ppnb1p1/p4q1p/P4P1P/1PNN2P1/2PP2Q1/1K2RR2 w E - 1 19" 4
 run_test "fen rr6/2kpp3/1ppnb1p1/p4q1p/P4P1P/1PNN2P1/2PP2Q1/1K2RR2 w E - 1 19" 5 79014522 "true"
 run_test "fen rr6/2kpp3/1ppnb1p1/p4q1p/P4P1P/1PNN2P1/2PP2Q1/1K2RR2 w E - 1 19" 6 2998685421 "true"
 
+# parallel hashed perft
+
+run_test "startpos" 7 3195901860 "false" "threads 2 hash 64"
+run_test "fen r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -" 5 193690690 "false" "threads 2"
+run_test "fen r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1" 6 706045033 "false" "threads 2 hash 16"
+run_test "fen 8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1" 6 1440467 "false" "hash 1"
+run_test "fen 1rkr3b/1ppn3p/3pB1n1/6q1/R2P4/4N1P1/1P5P/2KRQ1B1 b Dbd - 0 14" 6 2678022813 "true" "threads 2 hash 64"
+
 rm -f $EXPECT_SCRIPT
 echo "perft testing completed"
 